@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <fcntl.h>
 #include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
@@ -246,5 +247,21 @@ class filesystem {
         debug_info(">> End  pread(" << fd << ", " << len << ", " << offset << ")= " << ret << print_errno(ret));
         return ret;
     }
+
+    // Free the space of the range keeping the size of the file, it reads as zeros after it
+    static int punch_hole(int fd, uint64_t len, int64_t offset) {
+        debug_info(">> Begin punch_hole(" << fd << ", " << len << ", " << offset << ")");
+        int ret = PROXY(fallocate)(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len);
+        debug_info(">> End punch_hole(" << fd << ", " << len << ", " << offset << ") = " << ret << print_errno(ret));
+        return ret;
+    }
+
+    // False when the range is a hole of the file, so it is zeros without reading it
+    static bool has_data(int fd, uint64_t len, int64_t offset) {
+        off_t next_data = PROXY(lseek)(fd, offset, SEEK_DATA);
+        // ENXIO is no data after the offset, the other errors are filesystems without SEEK_DATA
+        if (next_data < 0) return errno != ENXIO;
+        return next_data < offset + (int64_t)len;
+    }
 };
 }  // namespace XPN
\ No newline at end of file
@@ -0,0 +1,136 @@
+
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "fixed_function.hpp"
+#include "workers.hpp"
+
+namespace XPN {
+
+// Run fn(i) for each i in [0, count) with the calling thread and the idle threads of the pool.
+// The caller takes indexes too and the helpers that start late find nothing to do, so it never waits
+// for a task queued behind other work, and it can be called from a task of the same pool.
+template <typename F>
+void parallel_for(workers *pool, size_t count, F &&fn) {
+    if (count == 0) return;
+    if (pool == nullptr || count == 1) {
+        for (size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    // Shared with the helpers, they can outlive the call if they were queued
+    struct state {
+        std::atomic_size_t next = 0;
+        size_t count = 0;
+        void *fn = nullptr;
+        void (*call)(void *, size_t) = nullptr;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool closed = false;
+        int active = 0;
+
+        void run() {
+            for (size_t i = next++; i < count; i = next++) call(fn, i);
+        }
+    };
+    auto st = std::make_shared<state>();
+    st->count = count;
+    st->fn = &fn;
+    st->call = [](void *f, size_t i) { (*static_cast<std::remove_reference_t<F> *>(f))(i); };
+
+    size_t helpers = std::min<size_t>(count - 1, pool->size());
+    for (size_t h = 0; h < helpers; h++) {
+        bool launched = pool->try_launch_no_future([st]() {
+            {
+                std::unique_lock lock(st->mutex);
+                if (st->closed) return;
+                st->active++;
+            }
+            st->run();
+            std::unique_lock lock(st->mutex);
+            if (--st->active == 0) st->cv.notify_all();
+        });
+        if (!launched) break;
+    }
+
+    st->run();
+
+    // No more helpers can enter, wait the ones still working on an index
+    std::unique_lock lock(st->mutex);
+    st->closed = true;
+    st->cv.wait(lock, [&st]() { return st->active == 0; });
+}
+
+
+// A task run by an idle thread of the pool while the caller goes on. The caller runs it itself when it waits for it
+// and no thread took it yet, so as parallel_for it never waits for a task queued behind other work.
+class background_task {
+   public:
+    background_task() = default;
+    background_task(const background_task &) = delete;
+    background_task &operator=(const background_task &) = delete;
+    ~background_task() { wait(); }
+
+    // The task has to be waited before starting another one
+    void start(workers *pool, FixedFunction<void()> fn) {
+        m_state = std::make_shared<state>();
+        m_state->fn = std::move(fn);
+        if (pool != nullptr) {
+            pool->try_launch_no_future([st = m_state]() { st->run(); });
+        }
+    }
+
+    void wait() {
+        if (!m_state) return;
+        m_state->run();
+        while (m_state->status.load() != state::DONE) {
+            m_state->status.wait(state::RUNNING);
+        }
+        m_state.reset();
+    }
+
+   private:
+    // Shared with the helper, it can outlive the task if it was queued
+    struct state {
+        enum status_t { PENDING, RUNNING, DONE };
+        std::atomic<status_t> status = PENDING;
+        FixedFunction<void()> fn;
+
+        void run() {
+            status_t expected = PENDING;
+            if (!status.compare_exchange_strong(expected, RUNNING)) return;
+            fn();
+            status.store(DONE);
+            status.notify_all();
+        }
+    };
+    std::shared_ptr<state> m_state;
+};
+
+}  // namespace XPN
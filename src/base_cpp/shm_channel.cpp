@@ -0,0 +1,263 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "shm_channel.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstring>
+#include <new>
+
+#include "base_cpp/debug.hpp"
+#include "base_cpp/proxy.hpp"
+
+namespace XPN {
+
+struct shm_channel::ring {
+    alignas(64) std::atomic_uint64_t head;  // Bytes written, only updated by the producer
+    alignas(64) std::atomic_uint64_t tail;  // Bytes read, only updated by the consumer
+    alignas(64) std::atomic_uint32_t data_seq;
+    std::atomic_uint32_t consumer_waiting;
+    alignas(64) std::atomic_uint32_t space_seq;
+    std::atomic_uint32_t producer_waiting;
+};
+
+struct shm_channel::segment {
+    uint64_t magic;
+    uint64_t ring_size;
+    ring rings[2];  // 0 from the client to the server, 1 from the server to the client
+};
+
+namespace {
+static_assert(std::atomic_uint64_t::is_always_lock_free && std::atomic_uint32_t::is_always_lock_free,
+              "the atomics of the segment are shared between processes");
+
+constexpr uint64_t SEGMENT_MAGIC = 0x31304d48534e5058;  // "XPNSHM01"
+constexpr uint64_t SEGMENT_PAGE = 4096;
+// Iterations checking the ring before sleeping, the replies of the small requests usually come in this time
+constexpr int SPIN_ITERATIONS = 4096;
+// The sleeps wake up to check that the other side is alive
+constexpr int WAIT_TIMEOUT_MS = 100;
+
+std::atomic_uint64_t s_segment_count = 0;
+
+long futex_wait(std::atomic_uint32_t *word, uint32_t value, int timeout_ms) {
+    struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    return ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+
+void futex_wake(std::atomic_uint32_t *word) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// The rings start in the page after the header of the segment
+constexpr uint64_t HEADER_SIZE = SEGMENT_PAGE;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+}  // namespace
+
+std::unique_ptr<shm_channel> shm_channel::create(uint64_t ring_size, int socket) {
+    static_assert(sizeof(segment) <= HEADER_SIZE);
+    if (ring_size == 0 || (ring_size & (ring_size - 1)) != 0 || ring_size % SEGMENT_PAGE != 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    std::string name = "/xpn_shm_" + std::to_string(::getpid()) + "_" + std::to_string(s_segment_count++);
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        debug_error("[SHM_CHANNEL] [create] ERROR: shm_open " << name << " " << strerror(errno));
+        return nullptr;
+    }
+    std::unique_ptr<shm_channel> channel(new shm_channel(name, socket));
+    channel->m_ring_size = ring_size;
+    channel->m_segment_size = HEADER_SIZE + 2 * ring_size;
+    if (PROXY(ftruncate)(fd, channel->m_segment_size) < 0 || channel->map(fd, true) < 0) {
+        debug_error("[SHM_CHANNEL] [create] ERROR: segment " << name << " " << strerror(errno));
+        PROXY(close)(fd);
+        ::shm_unlink(name.c_str());
+        return nullptr;
+    }
+    PROXY(close)(fd);
+
+    new (channel->m_segment) segment{};
+    channel->m_segment->ring_size = ring_size;
+    std::atomic_thread_fence(std::memory_order_release);
+    channel->m_segment->magic = SEGMENT_MAGIC;
+    debug_info("[SHM_CHANNEL] [create] " << name << " ring size " << ring_size);
+    return channel;
+}
+
+std::unique_ptr<shm_channel> shm_channel::open(const std::string &name, int socket) {
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        debug_error("[SHM_CHANNEL] [open] ERROR: shm_open " << name << " " << strerror(errno));
+        return nullptr;
+    }
+    std::unique_ptr<shm_channel> channel(new shm_channel(name, socket));
+    struct ::stat st;
+    if (::fstat(fd, &st) < 0 || (uint64_t)st.st_size <= HEADER_SIZE) {
+        PROXY(close)(fd);
+        errno = EINVAL;
+        return nullptr;
+    }
+    channel->m_segment_size = st.st_size;
+    channel->m_ring_size = (st.st_size - HEADER_SIZE) / 2;
+    int ret = channel->map(fd, false);
+    PROXY(close)(fd);
+    if (ret < 0 || channel->m_segment->magic != SEGMENT_MAGIC ||
+        channel->m_segment->ring_size != channel->m_ring_size) {
+        debug_error("[SHM_CHANNEL] [open] ERROR: segment " << name << " is not valid");
+        errno = EINVAL;
+        return nullptr;
+    }
+    debug_info("[SHM_CHANNEL] [open] " << name << " ring size " << channel->m_ring_size);
+    return channel;
+}
+
+int shm_channel::map(int fd, bool is_client) {
+    void *addr = ::mmap(nullptr, m_segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) return -1;
+    m_segment = static_cast<segment *>(addr);
+    char *data = static_cast<char *>(addr) + HEADER_SIZE;
+    int send_ring = is_client ? 0 : 1;
+    m_send = &m_segment->rings[send_ring];
+    m_recv = &m_segment->rings[1 - send_ring];
+    m_send_data = data + send_ring * m_ring_size;
+    m_recv_data = data + (1 - send_ring) * m_ring_size;
+    return 0;
+}
+
+shm_channel::~shm_channel() {
+    if (m_segment) ::munmap(m_segment, m_segment_size);
+}
+
+void shm_channel::unlink() { ::shm_unlink(m_name.c_str()); }
+
+void shm_channel::close() {
+    m_closed = true;
+    if (!m_segment) return;
+    m_send->space_seq.fetch_add(1);
+    futex_wake(&m_send->space_seq);
+    m_recv->data_seq.fetch_add(1);
+    futex_wake(&m_recv->data_seq);
+}
+
+bool shm_channel::peer_alive() {
+    struct pollfd pfd = {m_socket, POLLRDHUP, 0};
+    int ret = ::poll(&pfd, 1, 0);
+    return !(ret > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL)));
+}
+
+bool shm_channel::wait(std::atomic_uint32_t &word, std::atomic_uint32_t &waiting, const std::atomic_uint64_t &pos,
+                       uint64_t old_pos) {
+    for (int i = 0; i < SPIN_ITERATIONS; i++) {
+        if (pos.load(std::memory_order_acquire) != old_pos) return true;
+        cpu_relax();
+    }
+    while (!m_closed) {
+        // The other side bumps the word after moving the position, and wakes when it sees the waiting flag
+        uint32_t value = word.load();
+        waiting.store(1);
+        if (pos.load() != old_pos) {
+            waiting.store(0);
+            return true;
+        }
+        long ret = futex_wait(&word, value, WAIT_TIMEOUT_MS);
+        waiting.store(0);
+        if (pos.load(std::memory_order_acquire) != old_pos) return true;
+        if (ret < 0 && errno == ETIMEDOUT && !peer_alive()) {
+            debug_warning("[SHM_CHANNEL] [wait] the other side of " << m_name << " is gone");
+            return false;
+        }
+    }
+    return false;
+}
+
+int64_t shm_channel::send(const void *data, uint64_t size) {
+    const char *in = static_cast<const char *>(data);
+    uint64_t sent = 0;
+    while (sent < size) {
+        uint64_t head = m_send->head.load(std::memory_order_relaxed);
+        uint64_t tail = m_send->tail.load(std::memory_order_acquire);
+        uint64_t space = m_ring_size - (head - tail);
+        if (space == 0) {
+            if (!wait(m_send->space_seq, m_send->producer_waiting, m_send->tail, tail)) return -1;
+            continue;
+        }
+        uint64_t len = std::min(space, size - sent);
+        uint64_t pos = head & (m_ring_size - 1);
+        uint64_t first = std::min(len, m_ring_size - pos);
+        std::memcpy(m_send_data + pos, in + sent, first);
+        std::memcpy(m_send_data, in + sent + first, len - first);
+        m_send->head.store(head + len);
+        m_send->data_seq.fetch_add(1);
+        if (m_send->consumer_waiting.load()) futex_wake(&m_send->data_seq);
+        sent += len;
+    }
+    return m_closed ? -1 : (int64_t)sent;
+}
+
+int64_t shm_channel::sendv(const struct iovec *iov, int iovcnt) {
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (send(iov[i].iov_base, iov[i].iov_len) < 0) return -1;
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+int64_t shm_channel::recv(void *data, uint64_t size) {
+    char *out = static_cast<char *>(data);
+    uint64_t received = 0;
+    while (received < size) {
+        uint64_t tail = m_recv->tail.load(std::memory_order_relaxed);
+        uint64_t head = m_recv->head.load(std::memory_order_acquire);
+        if (head == tail) {
+            if (!wait(m_recv->data_seq, m_recv->consumer_waiting, m_recv->head, head)) return -1;
+            continue;
+        }
+        uint64_t len = std::min(head - tail, size - received);
+        uint64_t pos = tail & (m_ring_size - 1);
+        uint64_t first = std::min(len, m_ring_size - pos);
+        std::memcpy(out + received, m_recv_data + pos, first);
+        std::memcpy(out + received + first, m_recv_data, len - first);
+        m_recv->tail.store(tail + len);
+        m_recv->space_seq.fetch_add(1);
+        if (m_recv->producer_waiting.load()) futex_wake(&m_recv->space_seq);
+        received += len;
+    }
+    return m_closed ? -1 : (int64_t)received;
+}
+
+}  // namespace XPN
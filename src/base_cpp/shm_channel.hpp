@@ -0,0 +1,80 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace XPN {
+
+// Byte stream between a client and a server of the same node over a segment of /dev/shm, one ring per direction.
+// The side that waits for data or space sleeps in a futex of the segment, the socket of the connection is only
+// polled to know when the other side is gone.
+class shm_channel {
+   public:
+    static constexpr uint64_t DEFAULT_RING_SIZE = 4 * 1024 * 1024;
+
+    // The client creates the segment with a unique name and the server opens it by that name
+    static std::unique_ptr<shm_channel> create(uint64_t ring_size, int socket);
+    static std::unique_ptr<shm_channel> open(const std::string &name, int socket);
+    ~shm_channel();
+
+    const std::string &name() const { return m_name; }
+    uint64_t ring_size() const { return m_ring_size; }
+    // Remove the name when both sides have it mapped, the segment is freed with the last mapping
+    void unlink();
+    // Wake the waits of this side, the pending and next operations fail
+    void close();
+
+    // Block until all the bytes are transferred, -1 when the other side is gone or the channel is closed
+    int64_t send(const void *data, uint64_t size);
+    int64_t sendv(const struct iovec *iov, int iovcnt);
+    int64_t recv(void *data, uint64_t size);
+
+   private:
+    struct ring;
+    struct segment;
+
+    std::string m_name;
+    int m_socket;
+    uint64_t m_ring_size = 0;
+    segment *m_segment = nullptr;
+    uint64_t m_segment_size = 0;
+    ring *m_send = nullptr;
+    ring *m_recv = nullptr;
+    char *m_send_data = nullptr;
+    char *m_recv_data = nullptr;
+    std::atomic_bool m_closed = false;
+
+    shm_channel(std::string name, int socket) : m_name(std::move(name)), m_socket(socket) {}
+    int map(int fd, bool is_client);
+    // Wait until the position moves from old_pos, sleeping in the futex word. False when the channel must stop
+    bool wait(std::atomic_uint32_t &word, std::atomic_uint32_t &waiting, const std::atomic_uint64_t &pos,
+              uint64_t old_pos);
+    bool peer_alive();
+};
+
+}  // namespace XPN
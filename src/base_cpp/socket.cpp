@@ -31,6 +31,7 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <string.h>
 #include <unistd.h>
 #include <thread>
@@ -62,6 +63,83 @@ namespace XPN
         return ret;
     }
     
+    // Advance the iovec after a partial transfer of size bytes
+    static void iov_advance ( struct msghdr &hdr, uint64_t size )
+    {
+        while (hdr.msg_iovlen > 0 && size >= hdr.msg_iov->iov_len) {
+            size -= hdr.msg_iov->iov_len;
+            hdr.msg_iov++;
+            hdr.msg_iovlen--;
+        }
+        if (hdr.msg_iovlen > 0) {
+            hdr.msg_iov->iov_base = static_cast<char *>(hdr.msg_iov->iov_base) + size;
+            hdr.msg_iov->iov_len -= size;
+        }
+    }
+
+    int64_t socket::sendv ( int socket, const struct iovec *iov, int iovcnt )
+    {
+        struct iovec pending[MAX_IOV];
+        struct msghdr hdr = {};
+        int64_t total = 0;
+
+        if (iovcnt > MAX_IOV) {
+            for (int i = 0; i < iovcnt; i++) {
+                int64_t ret = socket::send(socket, iov[i].iov_base, iov[i].iov_len);
+                if (ret < 0) return ret;
+                total += ret;
+            }
+            return total;
+        }
+
+        std::copy(iov, iov + iovcnt, pending);
+        hdr.msg_iov = pending;
+        hdr.msg_iovlen = iovcnt;
+        while (hdr.msg_iovlen > 0) {
+            int64_t ret = PROXY(sendmsg)(socket, &hdr, MSG_NOSIGNAL);
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret < 0) {
+                debug_error("[SOCKET] [socket::sendv] ERROR: socket sendmsg "<<strerror(errno));
+                return -1;
+            }
+            total += ret;
+            iov_advance(hdr, ret);
+        }
+        return total;
+    }
+
+    int64_t socket::recvv ( int socket, const struct iovec *iov, int iovcnt )
+    {
+        struct iovec pending[MAX_IOV];
+        struct msghdr hdr = {};
+        int64_t total = 0;
+
+        if (iovcnt > MAX_IOV) {
+            for (int i = 0; i < iovcnt; i++) {
+                int64_t ret = socket::recv(socket, iov[i].iov_base, iov[i].iov_len);
+                if (ret < 0) return ret;
+                total += ret;
+            }
+            return total;
+        }
+
+        std::copy(iov, iov + iovcnt, pending);
+        hdr.msg_iov = pending;
+        hdr.msg_iovlen = iovcnt;
+        while (hdr.msg_iovlen > 0) {
+            int64_t ret = PROXY(readv)(socket, hdr.msg_iov, hdr.msg_iovlen);
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret < 0) {
+                debug_error("[SOCKET] [socket::recvv] ERROR: socket readv "<<strerror(errno));
+                return -1;
+            }
+            if (ret == 0) break;
+            total += ret;
+            iov_advance(hdr, ret);
+        }
+        return total;
+    }
+
     int64_t socket::send_line ( int socket, const char *buffer )
     {
         return socket::send(socket, buffer, strlen(buffer)+1);
@@ -383,6 +461,25 @@ namespace XPN
         return ret;
     }
 
+    int socket::set_keepalive ( int socket, int idle_s )
+    {
+        int on = 1, idle = std::max(idle_s, 1), interval = std::max(idle_s / 3, 1), count = 3;
+        if (::setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) < 0 ||
+            ::setsockopt(socket, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) < 0 ||
+            ::setsockopt(socket, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) < 0 ||
+            ::setsockopt(socket, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) < 0) {
+            debug_error("[SOCKET] [socket::set_keepalive] ERROR: setsockopt "<<strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    bool socket::is_readable ( int socket )
+    {
+        struct pollfd pfd = {.fd = socket, .events = POLLIN, .revents = 0};
+        return ::poll(&pfd, 1, 0) != 0;
+    }
+
     int socket::close ( int socket )
     {
         int ret;
@@ -26,6 +26,7 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 
 namespace XPN
 {
@@ -45,6 +46,7 @@ namespace XPN
             constexpr static const int DEFAULT_XPN_SCK_PORT     = 3456;
             constexpr static const int ACCEPT_CODE              = 123;
             constexpr static const int CONNECTIONLESS_PORT_CODE = 124;
+            constexpr static const int CONNECTIONS_CODE         = 125;
             constexpr static const int FINISH_CODE              = 666;
             constexpr static const int FINISH_CODE_AWAIT        = 667;
             constexpr static const int STATS_CODE               = 444;
@@ -52,8 +54,13 @@ namespace XPN
             constexpr static const int PING_CODE                = 333;
         };
     public:
+        constexpr static const int MAX_IOV = 16;
+
         static int64_t send ( int socket, const void * buffer, uint64_t size );
         static int64_t recv ( int socket, void * buffer, uint64_t size );
+        // Gather and scatter versions, the whole iovec goes in the minimum of syscalls
+        static int64_t sendv ( int socket, const struct iovec *iov, int iovcnt );
+        static int64_t recvv ( int socket, const struct iovec *iov, int iovcnt );
         static int64_t send_line ( int socket, const char *buffer );
         static int64_t recv_line ( int socket, char *buffer, uint64_t n );
         static int64_t send_str ( int socket, const std::string& str );
@@ -65,6 +72,10 @@ namespace XPN
         static int server_accept ( int socket, int &out_conection_socket );
         static int client_connect ( std::string_view srv_name, int port, int &out_socket );
         static int client_connect ( std::string_view srv_name, int port, int timeout_ms, int &out_socket, int time_to_sleep_ms = 200 );
+        // The connections that stay idle for long are probed, a peer that is gone is detected after idle_s seconds
+        static int set_keepalive ( int socket, int idle_s );
+        // True when the peer has closed the connection or has sent something that nobody is waiting for
+        static bool is_readable ( int socket );
         static int close ( int socket );
 	};
 } // namespace XPN
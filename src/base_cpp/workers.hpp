@@ -51,6 +51,8 @@ namespace XPN
 
         virtual void launch(FixedFunction<WorkerResult()> task, TaskResult<WorkerResult>& result, FixedFunction<void(), 8> on_complete) = 0;
         virtual void launch_no_future(FixedFunction<void()> task) = 0;
+        // Launch only if there is a free slot, without waiting, false when the task was not launched
+        virtual bool try_launch_no_future(FixedFunction<void()> task) = 0;
         virtual void wait_all() = 0;
         virtual uint32_t size() const = 0;
     public:
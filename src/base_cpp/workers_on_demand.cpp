@@ -100,6 +100,33 @@ namespace XPN
         t.detach();
     }
 
+    bool workers_on_demand::try_launch_no_future(FixedFunction<void()> task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_wait_mutex);
+            if (m_wait >= m_num_threads) {
+                return false;
+            }
+
+            m_wait++;
+        }
+        std::thread t([this, task = std::move(task)] { 
+            task(); 
+
+            {
+                std::unique_lock<std::mutex> lock(m_wait_mutex); 
+                m_wait--;
+                if (m_wait == 0){
+                    m_wait_cv.notify_one();
+                }
+                m_full_cv.notify_one();
+            }
+        });
+
+        t.detach();
+        return true;
+    }
+
     void workers_on_demand::wait_all() 
     {
         std::unique_lock<std::mutex> lock(m_wait_mutex);
@@ -122,6 +122,24 @@ namespace XPN
         m_cv.notify_one(); 
     }
 
+    bool workers_pool::try_launch_no_future(FixedFunction<void()> task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_queue_mutex);
+            if (m_tasks.size() > m_num_threads) {
+                return false;
+            }
+
+            m_tasks.emplace(std::move(task)); 
+        }
+        {
+            std::unique_lock<std::mutex> lock(m_wait_mutex);
+            m_wait++;
+        } 
+        m_cv.notify_one(); 
+        return true;
+    }
+
     void workers_pool::wait_all() 
     {
         std::unique_lock<std::mutex> lock(m_wait_mutex);
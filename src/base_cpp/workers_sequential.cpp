@@ -38,6 +38,12 @@ namespace XPN
         task();
     }
 
+    bool workers_sequential::try_launch_no_future([[maybe_unused]] FixedFunction<void()> task)
+    {
+        // There is no other thread to run it
+        return false;
+    }
+
     void workers_sequential::wait_all() {}
     uint32_t workers_sequential::size() const { return 1; }
 } // namespace XPN
\ No newline at end of file
@@ -33,6 +33,7 @@ namespace XPN
 
         void launch(FixedFunction<WorkerResult()> task, TaskResult<WorkerResult>& result, FixedFunction<void(), 8> on_complete) override;
         void launch_no_future(FixedFunction<void()> task) override;
+        bool try_launch_no_future(FixedFunction<void()> task) override;
         void wait_all() override;
         uint32_t size() const override;
     };
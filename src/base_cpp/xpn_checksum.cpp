@@ -0,0 +1,45 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "base_cpp/xpn_checksum.hpp"
+
+#include <xxhash.h>
+
+#include <cstdio>
+
+namespace XPN {
+
+uint64_t xpn_checksum(const void *data, uint64_t size) {
+    uint64_t checksum = XXH64(data, size, 0);
+    return checksum == 0 ? 1 : checksum;
+}
+
+xpn_fingerprint xpn_fingerprint::of(const void *data, uint64_t size) {
+    return {XXH64(data, size, 0), XXH64(data, size, 0x9e3779b97f4a7c15ULL)};
+}
+
+std::string xpn_fingerprint::str() const {
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%016lx%016lx", (unsigned long)high, (unsigned long)low);
+    return buffer;
+}
+
+}  // namespace XPN
@@ -0,0 +1,46 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace XPN {
+
+// Checksum of the data of the requests and of the blocks in disk, the XXH64 of the data.
+// 0 is never returned, it is left to mark the data without checksum.
+uint64_t xpn_checksum(const void *data, uint64_t size);
+
+// Fingerprint of the content of a block for the deduplication, two XXH64 of the data with different seeds.
+// It is not a cryptographic hash, the 128 bits only make the accidental collisions negligible.
+struct xpn_fingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    static xpn_fingerprint of(const void *data, uint64_t size);
+    bool empty() const { return low == 0 && high == 0; }
+    bool operator==(const xpn_fingerprint &other) const = default;
+    // 32 hex digits
+    std::string str() const;
+};
+
+}  // namespace XPN
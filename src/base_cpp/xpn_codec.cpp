@@ -0,0 +1,84 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "base_cpp/xpn_codec.hpp"
+
+#include <lz4.h>
+#include <lz4hc.h>
+
+#include <charconv>
+#include <sstream>
+
+namespace XPN {
+
+int xpn_codec::compress(const char *src, char *dst, int src_size, int dst_capacity) const {
+    switch (type) {
+        case codec_type::LZ4:
+            return LZ4_compress_fast(src, dst, src_size, dst_capacity, level == 0 ? DEFAULT_LZ4_ACCELERATION : level);
+        case codec_type::LZ4HC: {
+            // The state of HC is big, one per thread instead of the allocation of LZ4_compress_HC in each call
+            thread_local LZ4_streamHC_t state;
+            return LZ4_compress_HC_extStateHC(&state, src, dst, src_size, dst_capacity,
+                                              level == 0 ? DEFAULT_LZ4HC_LEVEL : level);
+        }
+    }
+    return 0;
+}
+
+int xpn_codec::decompress(codec_type type, const char *src, char *dst, int src_size, int dst_capacity) {
+    switch (type) {
+        case codec_type::LZ4:
+        case codec_type::LZ4HC:
+            return LZ4_decompress_safe(src, dst, src_size, dst_capacity);
+    }
+    return -1;
+}
+
+bool xpn_codec::from_string(std::string_view str, xpn_codec &out) {
+    auto sep = str.find(':');
+    std::string_view name = str.substr(0, sep);
+    xpn_codec codec;
+    if (name == "lz4") {
+        codec.type = codec_type::LZ4;
+    } else if (name == "lz4hc") {
+        codec.type = codec_type::LZ4HC;
+    } else {
+        return false;
+    }
+    if (sep != std::string_view::npos) {
+        std::string_view level_str = str.substr(sep + 1);
+        int level = 0;
+        auto [ptr, ec] = std::from_chars(level_str.begin(), level_str.end(), level);
+        if (ec != std::errc() || ptr != level_str.end() || level < 0 || level > UINT8_MAX) return false;
+        if (codec.type == codec_type::LZ4HC && level > LZ4HC_CLEVEL_MAX) return false;
+        codec.level = level;
+    }
+    out = codec;
+    return true;
+}
+
+std::string xpn_codec::to_string() const {
+    std::stringstream out;
+    out << (type == codec_type::LZ4HC ? "lz4hc" : "lz4");
+    if (level != 0) out << ":" << static_cast<int>(level);
+    return out.str();
+}
+
+}  // namespace XPN
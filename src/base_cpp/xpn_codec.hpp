@@ -0,0 +1,56 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace XPN {
+
+// Compressors of the blocks on the wire and on the disk. All of them write the LZ4 block format, they only change
+// the effort, so any block is decompressed with LZ4_decompress_safe and the compressed blocks can go from the disk to
+// the wire as they are.
+enum class codec_type : uint8_t {
+    LZ4 = 0,    // level is the acceleration
+    LZ4HC = 1,  // level is the compression level, 1 to 12
+};
+
+struct xpn_codec {
+    codec_type type = codec_type::LZ4;
+    uint8_t level = 0;  // 0 is the default of the codec
+
+    static constexpr int DEFAULT_LZ4_ACCELERATION = 10;
+    static constexpr int DEFAULT_LZ4HC_LEVEL = 9;
+
+    bool operator==(const xpn_codec &other) const = default;
+
+    // Same return than LZ4_compress_*, the compressed size or 0 on error
+    int compress(const char *src, char *dst, int src_size, int dst_capacity) const;
+    // Same return than LZ4_decompress_safe, the decompressed size or negative on error
+    static int decompress(codec_type type, const char *src, char *dst, int src_size, int dst_capacity);
+
+    // Format "codec[:level]", like "lz4", "lz4:1" or "lz4hc:12"
+    static bool from_string(std::string_view str, xpn_codec &out);
+    std::string to_string() const;
+};
+
+}  // namespace XPN
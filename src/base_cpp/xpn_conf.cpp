@@ -123,6 +123,15 @@ xpn_conf::xpn_conf() {
                 partitions[actual_index].controler_url = value;
             } else if (key == XPN_CONF::TAG_COMPRESSED) {
                 partitions[actual_index].compressed = value == "true";
+            } else if (key == XPN_CONF::TAG_NET_CODEC || key == XPN_CONF::TAG_DISK_CODEC) {
+                auto &codec = key == XPN_CONF::TAG_NET_CODEC ? partitions[actual_index].net_codec
+                                                             : partitions[actual_index].disk_codec;
+                if (!xpn_codec::from_string(value, codec)) {
+                    std::cerr << "Error: Invalid codec '" << value << "' for " << key << std::endl;
+                    std::raise(SIGTERM);
+                }
+            } else if (key == XPN_CONF::TAG_DICTIONARY) {
+                partitions[actual_index].dictionary = value;
             } else if (key == XPN_CONF::TAG_BLOCKSIZE) {
                 auto res = getSizeFactor(value);
                 if (res < 0) {
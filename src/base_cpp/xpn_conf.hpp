@@ -28,6 +28,7 @@
 #include "base_cpp/fixed_string.hpp"
 #include "base_cpp/grow_fixed_string.hpp"
 #include "base_cpp/grow_fixed_vector.hpp"
+#include "base_cpp/xpn_codec.hpp"
 
 namespace XPN
 {
@@ -46,6 +47,9 @@ namespace XPN
         constexpr const char * TAG_REPLICATION_LEVEL = "replication_level";
         constexpr const char * TAG_BLOCKSIZE = "bsize";
         constexpr const char * TAG_COMPRESSED = "compressed";
+        constexpr const char * TAG_NET_CODEC = "net_codec";
+        constexpr const char * TAG_DISK_CODEC = "disk_codec";
+        constexpr const char * TAG_DICTIONARY = "dictionary";
         constexpr const char * TAG_CONTROLER_URL = "controler_url";
         constexpr const char * TAG_SERVER_URL = "server_url";
         constexpr const char * DEFAULT_CONTROLER_URL = "localhost";
@@ -66,6 +70,9 @@ namespace XPN
             int bsize = XPN_CONF::DEFAULT_BLOCKSIZE;
             int replication_level = XPN_CONF::DEFAULT_REPLICATION_LEVEL;
             bool compressed = XPN_CONF::DEFAULT_COMPRESSED;
+            xpn_codec net_codec = {};
+            xpn_codec disk_codec = {};
+            std::string dictionary;
             FixedString<HOST_NAME_MAX> controler_url = XPN_CONF::DEFAULT_CONTROLER_URL;
             std::vector<GrowFixedString<64>> server_urls;
 
@@ -76,6 +83,9 @@ namespace XPN
                 out << XPN_CONF::TAG_PARTITION_NAME << " = " << partition_name << std::endl;
                 out << XPN_CONF::TAG_BLOCKSIZE << " = " << bsize << std::endl;
                 out << XPN_CONF::TAG_COMPRESSED << " = " << (compressed?"true":"false") << std::endl;
+                out << XPN_CONF::TAG_NET_CODEC << " = " << net_codec.to_string() << std::endl;
+                out << XPN_CONF::TAG_DISK_CODEC << " = " << disk_codec.to_string() << std::endl;
+                if (!dictionary.empty()) out << XPN_CONF::TAG_DICTIONARY << " = " << dictionary << std::endl;
                 out << XPN_CONF::TAG_CONTROLER_URL << " = " << controler_url << std::endl;
                 out << XPN_CONF::TAG_REPLICATION_LEVEL << " = " << replication_level << std::endl;
                 for (auto &srv : server_urls)
@@ -0,0 +1,161 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "base_cpp/xpn_dictionary.hpp"
+
+#define LZ4_HC_STATIC_LINKING_ONLY
+#include <lz4.h>
+#include <lz4hc.h>
+#include <xxhash.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "base_cpp/debug.hpp"
+
+namespace XPN {
+
+std::mutex xpn_dictionary::s_mutex;
+std::string xpn_dictionary::s_directory;
+std::unordered_map<uint32_t, std::shared_ptr<const xpn_dictionary>> xpn_dictionary::s_dictionaries;
+
+xpn_dictionary::xpn_dictionary(std::string_view content)
+    : m_content(content.size() > MAX_SIZE ? content.substr(content.size() - MAX_SIZE) : content),
+      m_id(get_id(m_content)),
+      m_stream(std::make_unique<LZ4_stream_t>()) {
+    LZ4_initStream(m_stream.get(), sizeof(LZ4_stream_t));
+    LZ4_loadDictSlow(m_stream.get(), m_content.data(), m_content.size());
+}
+
+xpn_dictionary::~xpn_dictionary() = default;
+
+uint32_t xpn_dictionary::get_id(std::string_view content) {
+    uint32_t id = XXH32(content.data(), content.size(), 0);
+    return id == 0 ? 1 : id;
+}
+
+const LZ4_streamHC_t *xpn_dictionary::get_stream_hc(int level) const {
+    // The tables of HC depend on the level, so there is one stream per level used
+    std::unique_lock lock(m_stream_hc_mutex);
+    auto &stream = m_stream_hc[level];
+    if (!stream) {
+        stream = std::make_unique<LZ4_streamHC_t>();
+        LZ4_initStreamHC(stream.get(), sizeof(LZ4_streamHC_t));
+        LZ4_resetStreamHC_fast(stream.get(), level);
+        LZ4_loadDictHC(stream.get(), m_content.data(), m_content.size());
+    }
+    return stream.get();
+}
+
+int xpn_dictionary::compress(const xpn_codec &codec, const char *src, char *dst, int src_size,
+                             int dst_capacity) const {
+    switch (codec.type) {
+        case codec_type::LZ4: {
+            thread_local LZ4_stream_t working;
+            LZ4_resetStream_fast(&working);
+            LZ4_attach_dictionary(&working, m_stream.get());
+            return LZ4_compress_fast_continue(&working, src, dst, src_size, dst_capacity,
+                                              codec.level == 0 ? xpn_codec::DEFAULT_LZ4_ACCELERATION : codec.level);
+        }
+        case codec_type::LZ4HC: {
+            int level = codec.level == 0 ? xpn_codec::DEFAULT_LZ4HC_LEVEL : codec.level;
+            thread_local LZ4_streamHC_t working;
+            LZ4_resetStreamHC_fast(&working, level);
+            LZ4_attach_HC_dictionary(&working, get_stream_hc(level));
+            return LZ4_compress_HC_continue(&working, src, dst, src_size, dst_capacity);
+        }
+    }
+    return 0;
+}
+
+int xpn_dictionary::decompress(const char *src, char *dst, int src_size, int dst_capacity) const {
+    return LZ4_decompress_safe_usingDict(src, dst, src_size, dst_capacity, m_content.data(), m_content.size());
+}
+
+static std::string dictionary_path(std::string_view dir, uint32_t id) {
+    std::stringstream path;
+    path << dir << "/" << std::hex << std::setw(8) << std::setfill('0') << id << ".dict";
+    return path.str();
+}
+
+void xpn_dictionary::set_directory(std::string_view dir) {
+    std::unique_lock lock(s_mutex);
+    s_directory = dir;
+    std::error_code ec;
+    std::filesystem::create_directories(s_directory, ec);
+    if (ec) {
+        debug_error("Error: cannot create the dictionary directory '" << s_directory << "': " << ec.message());
+    }
+}
+
+std::shared_ptr<const xpn_dictionary> xpn_dictionary::add(std::string_view content) { return insert(content, true); }
+
+std::shared_ptr<const xpn_dictionary> xpn_dictionary::insert(std::string_view content, bool save) {
+    auto dict = std::make_shared<const xpn_dictionary>(content);
+    std::unique_lock lock(s_mutex);
+    auto [it, inserted] = s_dictionaries.emplace(dict->id(), dict);
+    if (!inserted) return it->second;
+
+    if (save && !s_directory.empty()) {
+        auto path = dictionary_path(s_directory, dict->id());
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.write(dict->data(), dict->size())) {
+            debug_error("Error: cannot save the dictionary '" << path << "'");
+        }
+    }
+    debug_info("Add dictionary " << std::hex << dict->id() << std::dec << " of size " << dict->size());
+    return dict;
+}
+
+std::shared_ptr<const xpn_dictionary> xpn_dictionary::get(uint32_t id) {
+    if (id == 0) return nullptr;
+    std::string path;
+    {
+        std::unique_lock lock(s_mutex);
+        auto it = s_dictionaries.find(id);
+        if (it != s_dictionaries.end()) return it->second;
+        if (s_directory.empty()) return nullptr;
+        path = dictionary_path(s_directory, id);
+    }
+    std::string content;
+    if (!read_file(path, content) || get_id(content) != id) {
+        debug_error("Error: dictionary " << std::hex << id << std::dec << " not found in '" << path << "'");
+        return nullptr;
+    }
+    return insert(content, false);
+}
+
+bool xpn_dictionary::read_file(std::string_view path, std::string &content) {
+    std::ifstream file(std::string(path), std::ios::binary);
+    if (!file) return false;
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !content.empty();
+}
+
+std::shared_ptr<const xpn_dictionary> xpn_dictionary::load_file(std::string_view path) {
+    std::string content;
+    if (!read_file(path, content)) return nullptr;
+    return add(content);
+}
+
+}  // namespace XPN
@@ -0,0 +1,89 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "base_cpp/xpn_codec.hpp"
+
+union LZ4_stream_u;
+union LZ4_streamHC_u;
+
+namespace XPN {
+
+// Dictionary of a partition to compress the small blocks. LZ4 only references the last 64 KB before the data, so the
+// small writes that share headers or field names (like the messages of the sensors) compress well when they are
+// preceded by a dictionary of samples of them. The id is the hash of the content, the same in all the nodes.
+class xpn_dictionary {
+   public:
+    static constexpr uint32_t MAX_SIZE = 64 * 1024;
+    // Blocks up to this size are compressed with the dictionary, the bigger ones have enough history by themselves
+    static constexpr uint64_t SMALL_BLOCK_SIZE = 64 * 1024;
+
+    xpn_dictionary(std::string_view content);
+    ~xpn_dictionary();
+    // Delete copy and move, the streams reference the content
+    xpn_dictionary(const xpn_dictionary &) = delete;
+    xpn_dictionary &operator=(const xpn_dictionary &) = delete;
+
+    uint32_t id() const { return m_id; }
+    const char *data() const { return m_content.data(); }
+    uint32_t size() const { return m_content.size(); }
+
+    // Same return than xpn_codec::compress and xpn_codec::decompress
+    int compress(const xpn_codec &codec, const char *src, char *dst, int src_size, int dst_capacity) const;
+    int decompress(const char *src, char *dst, int src_size, int dst_capacity) const;
+
+    // Id of the content, never 0 that means without dictionary
+    static uint32_t get_id(std::string_view content);
+
+    // Registry of the dictionaries known by the process. With a directory the added dictionaries are saved as
+    // <dir>/<id>.dict and the misses are loaded from there, so the blocks in disk can be read after a restart.
+    static void set_directory(std::string_view dir);
+    static std::shared_ptr<const xpn_dictionary> add(std::string_view content);
+    static std::shared_ptr<const xpn_dictionary> get(uint32_t id);
+    static std::shared_ptr<const xpn_dictionary> load_file(std::string_view path);
+
+   private:
+    static std::shared_ptr<const xpn_dictionary> insert(std::string_view content, bool save);
+    static bool read_file(std::string_view path, std::string &content);
+    const LZ4_streamHC_u *get_stream_hc(int level) const;
+
+    std::string m_content;
+    uint32_t m_id;
+    // Streams with the dictionary loaded once, attached to the working stream of each compression
+    std::unique_ptr<LZ4_stream_u> m_stream;
+    mutable std::mutex m_stream_hc_mutex;
+    mutable std::map<int, std::unique_ptr<LZ4_streamHC_u>> m_stream_hc;
+
+    static std::mutex s_mutex;
+    static std::string s_directory;
+    static std::unordered_map<uint32_t, std::shared_ptr<const xpn_dictionary>> s_dictionaries;
+};
+
+}  // namespace XPN
@@ -71,6 +71,35 @@ class xpn_env {
         parse_env("XPN_COMPRESSION_NET_MULTIPLIER", xpn_compression_net_multiplier);
         parse_env("XPN_RW_V2", xpn_rw_v2);
         parse_env("XPN_BUFFERING_WRITES", xpn_buffering_writes);
+        // 0 disable, 1 writes and blocks in disk, 2 also reads
+        parse_env("XPN_CHECKSUM", xpn_checksum);
+        // 0 disable, 1 the zero ranges of the writes are sent without data
+        parse_env("XPN_SPARSE", xpn_sparse);
+        // 0 disable, 1 the whole blocks that the servers with deduplication already have are not sent
+        parse_env("XPN_DEDUP", xpn_dedup);
+        // 0 disable, 1 the sck connections to a server of the same node go by shared memory
+        parse_env("XPN_SHM", xpn_shm);
+        // 0 disable, 1 the reads and writes of the files of a server of the same node go directly to its disk
+        parse_env("XPN_SHORT_CIRCUIT", xpn_short_circuit);
+        // 0 disable, 1 the reads and writes of the files opened without session go by a handle of the server
+        parse_env("XPN_HANDLES", xpn_handles);
+        // idle connections kept per server without XPN_CONNECT, 0 closes them after each request
+        parse_env("XPN_CONNECTION_POOL", xpn_connection_pool);
+        parse_env("XPN_CONNECTION_IDLE_MS", xpn_connection_idle_ms);
+        // servers connected at the same time in the init, 1 to connect them one after another
+        parse_env("XPN_CONNECT_PARALLEL", xpn_connect_parallel);
+        // 0 disable, 1 the socket servers are connected in their first request instead of in the init
+        parse_env("XPN_CONNECT_LAZY", xpn_connect_lazy);
+        // connections asked to each sck server, the large transfers are striped across the ones granted
+        parse_env("XPN_CONNECTIONS", xpn_connections);
+        parse_env("XPN_STRIPE_SIZE", xpn_stripe_size);
+        // raw reads and writes to fabric servers of at least this size go one-sided, 0 disable
+        parse_env("XPN_RDMA_MIN_SIZE", xpn_rdma_min_size);
+        parse_env("XPN_RDMA_CACHE", xpn_rdma_cache);
+        // bytes of the chunks of the compressed reads and writes of each transport
+        parse_env("XPN_SCK_CHUNK_SIZE", xpn_sck_chunk_size);
+        parse_env("XPN_MPI_CHUNK_SIZE", xpn_mpi_chunk_size);
+        parse_env("XPN_FABRIC_CHUNK_SIZE", xpn_fabric_chunk_size);
     }
     // Delete copy constructor
     xpn_env(const xpn_env&) = delete;
@@ -101,6 +130,56 @@ class xpn_env {
     int xpn_compression_net_multiplier = 1;
     int xpn_rw_v2 = 0;
     int xpn_buffering_writes = 0;
+    // 0 desactivated, 1 the writes are verified by the server and the compressed blocks in disk when they are read,
+    // 2 also the reads are verified by the client
+    int xpn_checksum = 0;
+    // 0 desactivated, 1 the zero ranges of the writes are sent without data and the servers store them as holes
+    int xpn_sparse = 1;
+    // 0 desactivated, 1 the fingerprints of the whole blocks of the writes are sent before the data to the servers
+    // with deduplication, the blocks they already have are not sent
+    int xpn_dedup = 1;
+    // 0 desactivated, 1 the sck connections to the servers of the same node move to a shared memory channel after
+    // the connect, the socket is kept to detect when the other side is gone
+    int xpn_shm = 1;
+    // 0 desactivated, 1 the reads and writes of the servers of the same node that are not replaced by nfi_local
+    // (XPN_LOCALITY) go directly to the backing files while the server grants a lease of them, the compressed files
+    // and the servers that do not store the files as they are read go through the server. The removes and renames
+    // of the leased files wait the end of the lease
+    int xpn_short_circuit = 0;
+    // 0 desactivated, 1 the open of the files without XPN_SESSION_FILE asks the server for a handle that keeps the
+    // file open, the reads and writes send it instead of the path and repeat the request by path when it is stale
+    int xpn_handles = 1;
+    // Without XPN_CONNECT the requests take an idle connection of the server from a pool of up to this size and
+    // return it after the request, 0 to connect in each request
+    int xpn_connection_pool = 8;
+    // The idle connections of the pool are closed after this time, they are probed by keepalive meanwhile
+    int xpn_connection_idle_ms = 30000;
+    // The init connects up to this number of socket servers at the same time, so the unreachable ones wait their
+    // connect timeout together, the mpi and fabric servers are always connected one after another
+    int xpn_connect_parallel = 32;
+    // 0 desactivated, 1 the socket servers are connected in the first request to each one, a server that cannot be
+    // connected is marked with error then and the next requests skip it as in the init
+    int xpn_connect_lazy = 0;
+    // Connections asked to each sck server, the server grants up to its limit of connections per client and the
+    // descriptors it has free. The requests take the first connection that is free and the transfers of at least two
+    // stripes are split in ranges sent at the same time by different connections
+    int xpn_connections = 1;
+    // Minimum bytes of each range of a striped transfer, the blocks of the compressed files are not split
+    int xpn_stripe_size = 128 * 1024;
+    // Bytes from which the raw reads and writes to fabric servers register the buffer of the user and the server
+    // reads or writes it directly, the smaller ones are sent in messages. 0 desactivated, all of them are sent in
+    // messages until the one-sided path is tested with LFI, 65536 is a starting value
+    int xpn_rdma_min_size = 0;
+    // Registrations of the user buffers kept for the next transfers, 0 registers each transfer. The cache must only
+    // be used when the buffers are not unmapped while the application runs, a buffer mapped again at the same
+    // address would be reached with the old registration
+    int xpn_rdma_cache = 0;
+    // Chunks in which the compressed reads and writes are split, each one is a request to the server. A window of
+    // chunks is compressed or decompressed while the one before is in the network, the smaller chunks start it
+    // sooner and the larger ones need less requests
+    int xpn_sck_chunk_size = 512 * 1024;
+    int xpn_mpi_chunk_size = 512 * 1024;
+    int xpn_fabric_chunk_size = 512 * 1024;
 
    public:
     static xpn_env& get_instance() {
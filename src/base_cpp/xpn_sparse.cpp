@@ -0,0 +1,49 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "base_cpp/xpn_sparse.hpp"
+
+#include <cstring>
+
+namespace XPN {
+
+bool xpn_is_zero(const void *data, uint64_t size) {
+    const char *ptr = static_cast<const char *>(data);
+    // The words of a slice are or'ed without branches, so the loop is vectorized
+    constexpr uint64_t slice = 256;
+    while (size >= slice) {
+        uint64_t acc = 0;
+        for (uint64_t i = 0; i < slice; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, ptr + i, sizeof(word));
+            acc |= word;
+        }
+        if (acc != 0) return false;
+        ptr += slice;
+        size -= slice;
+    }
+    for (; size > 0; ptr++, size--) {
+        if (*ptr != 0) return false;
+    }
+    return true;
+}
+
+}  // namespace XPN
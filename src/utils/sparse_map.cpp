@@ -11,17 +11,14 @@
 #include "base_cpp/debug.hpp"
 #include "base_cpp/filesystem.hpp"
 #include "base_cpp/xpn_conf.hpp"
-#include "lz4.h"
 #include "xpn/xpn_metadata.hpp"
-
-static constexpr uint32_t META_SIZE = sizeof(uint32_t) * 2;
+#include "xpn_server/filesystem/xpn_server_filesystem_lz4_block.hpp"
 
 int count_data_units(int fd, off_t start, off_t end, size_t sub_size) {
     int count = 0;
     for (off_t offset = start; offset < end; offset += sub_size) {
         off_t current_sub_end = std::min(offset + (off_t)sub_size, end);
-        off_t next_data = lseek(fd, offset, SEEK_DATA);
-        if (next_data != -1 && next_data < current_sub_end) {
+        if (XPN::filesystem::has_data(fd, current_sub_end - offset, offset)) {
             count++;
         }
     }
@@ -32,9 +29,8 @@ void draw_range(int fd, off_t start, off_t end, size_t sub_size) {
     std::cout << "|";
     for (off_t offset = start; offset < end; offset += sub_size) {
         off_t current_sub_end = std::min(offset + (off_t)sub_size, end);
-        off_t next_data = lseek(fd, offset, SEEK_DATA);
 
-        if (next_data != -1 && next_data < current_sub_end) {
+        if (XPN::filesystem::has_data(fd, current_sub_end - offset, offset)) {
             std::cout << "█";
         } else {
             std::cout << " ";
@@ -45,9 +41,7 @@ void draw_range(int fd, off_t start, off_t end, size_t sub_size) {
 
 void draw_sparse_map(const char* filename, const char* block_size) {
     const int LOGICAL_BLOCK_SIZE = XPN::xpn_conf::getSizeFactor(block_size);
-    const uint32_t MAX_COMP_SIZE = LZ4_COMPRESSBOUND(LOGICAL_BLOCK_SIZE);
-    constexpr uint32_t ALIGNMENT = 4096;
-    uint32_t PHYSICAL_BLOCK_SIZE = (META_SIZE + MAX_COMP_SIZE + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1);
+    uint32_t PHYSICAL_BLOCK_SIZE = XPN::lz4_block_header::slot_size(LOGICAL_BLOCK_SIZE);
 
     int fd = open(filename, O_RDONLY);
     if (fd < 0) {
@@ -67,6 +61,7 @@ void draw_sparse_map(const char* filename, const char* block_size) {
 
     int data_visual_blocks = 0;
     int empty_visual_blocks = 0;
+    int zero_blocks = 0;
 
     std::cout << "\nVisual Map of " << filename << " (Sub-block: " << sub_block_sz / 1024 << " KB)\n";
     std::cout << std::string(60, '-') << "\n";
@@ -122,6 +117,21 @@ void draw_sparse_map(const char* filename, const char* block_size) {
 
         // C. Dibujar el mapa visual
         draw_range(fd, current_offset, b_end, sub_block_sz);
+
+        // The blocks of zeros only store the header, with compressed size 0
+        char raw_header[XPN::lz4_block_header::SIZE];
+        XPN::lz4_block_header header;
+        auto header_len = XPN::filesystem::pread(fd, raw_header, sizeof(raw_header), current_offset);
+        auto data_off = header_len > 0 ? XPN::lz4_block_header::parse(raw_header, header_len, header) : 0;
+        if (data_off < 0) {
+            std::cout << " unknown version";
+        } else if (data_off == XPN::lz4_block_header::LEGACY_SIZE && header.uncompressed_size != 0) {
+            std::cout << " old layout";
+        }
+        if (data_off > 0 && header.compressed_size == 0 && header.uncompressed_size != 0) {
+            std::cout << " zeros";
+            zero_blocks++;
+        }
         std::cout << "\n";
 
         current_offset += PHYSICAL_BLOCK_SIZE;
@@ -139,6 +149,7 @@ void draw_sparse_map(const char* filename, const char* block_size) {
     std::cout << std::left << std::setw(25) << "FS Block size:" << st.st_blksize << "\n";
     std::cout << std::left << std::setw(25) << "Visual Units (Data):" << data_visual_blocks << " [█]\n";
     std::cout << std::left << std::setw(25) << "Visual Units (Hole):" << empty_visual_blocks << " [ ]\n";
+    std::cout << std::left << std::setw(25) << "Blocks of zeros:" << zero_blocks << "\n";
     std::cout << std::left << std::setw(25) << "Actual Occupancy:" << std::fixed << std::setprecision(2) << data_pct
               << "%\n";
 
@@ -36,14 +36,18 @@ namespace actions
     constexpr const char * all = "all";
     constexpr const char * bw = "bw";
     constexpr const char * ops = "ops";
+    constexpr const char * queue = "queue";
+    constexpr const char * residency = "residency";
     constexpr const char * comb_bw = "comb_bw";
     constexpr const char * comb_ops = "comb_ops";
     constexpr const char * comb_all = "comb_all";
     
-    constexpr const std::array<const char *, 6> list = {
+    constexpr const std::array<const char *, 8> list = {
         all,
         bw,
         ops,
+        queue,
+        residency,
         comb_bw,
         comb_ops,
         comb_all,
@@ -132,6 +136,14 @@ void print_stats(std::string hostfile, std::string action)
                 std::cout << "Ops :" << std::endl;
                 std::cout << stat_buff.to_string_ops() << std::endl;
             }
+            if (action == actions::queue || action == actions::all){
+                std::cout << "Queue :" << std::endl;
+                std::cout << stat_buff.to_string_queue() << std::endl;
+            }
+            if (action == actions::residency || action == actions::all){
+                std::cout << "Residency :" << std::endl;
+                std::cout << stat_buff.to_string_residency() << std::endl;
+            }
             std::cout << std::endl;
         }
 
@@ -21,8 +21,12 @@
 
 #include "nfi_fabric_server_comm.hpp"
 
+#include <unistd.h>
+
 #include <charconv>
 #include <csignal>
+#include <map>
+#include <mutex>
 #include <xpn_server/xpn_server_ops.hpp>
 
 #include "base_cpp/debug.hpp"
@@ -34,6 +38,85 @@
 
 namespace XPN {
 
+// The buffers registered for the one-sided transfers. A region is unregistered when the last transfer that uses it
+// ends and it is out of the cache, the cache keeps up to XPN_RDMA_CACHE regions of whole pages
+class fabric_rdma_regions {
+   public:
+    struct region {
+        uintptr_t begin = 0;
+        uintptr_t end = 0;
+        lfi_mr_key key = {};
+        uint64_t last_use = 0;
+        ~region() {
+            if (begin != 0 && lfi_mr_unreg(key) < 0) {
+                debug_error("[NFI_FABRIC_SERVER_COMM] [fabric_rdma_regions] ERROR: lfi_mr_unreg fails");
+            }
+        }
+    };
+
+    static fabric_rdma_regions &get_instance() {
+        static fabric_rdma_regions instance;
+        return instance;
+    }
+
+    std::shared_ptr<region> get(const void *data, uint64_t size) {
+        static const uintptr_t page_size = ::sysconf(_SC_PAGESIZE);
+        uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+        uintptr_t end = begin + size;
+        size_t capacity = xpn_env::get_instance().xpn_rdma_cache;
+
+        std::unique_lock lock(m_mutex);
+        auto it = m_regions.upper_bound(begin);
+        if (it != m_regions.begin()) {
+            auto &found = std::prev(it)->second;
+            if (found->end >= end) {
+                found->last_use = ++m_clock;
+                return found;
+            }
+        }
+
+        auto new_region = std::make_shared<region>();
+        new_region->begin = begin & ~(page_size - 1);
+        new_region->end = (end + page_size - 1) & ~(page_size - 1);
+        new_region->key = lfi_mr_reg(reinterpret_cast<void *>(new_region->begin), new_region->end - new_region->begin);
+        if (new_region->key.shm_key == 0 && new_region->key.peer_key == 0) {
+            debug_error("[NFI_FABRIC_SERVER_COMM] [fabric_rdma_regions] ERROR: lfi_mr_reg fails");
+            new_region->begin = 0;
+            return nullptr;
+        }
+        if (capacity == 0) {
+            return new_region;
+        }
+        // The regions that overlap the new one are replaced by it
+        auto first = m_regions.lower_bound(new_region->begin);
+        if (first != m_regions.begin() && std::prev(first)->second->end > new_region->begin) {
+            first = std::prev(first);
+        }
+        auto last = m_regions.lower_bound(new_region->end);
+        m_regions.erase(first, last);
+        while (m_regions.size() >= capacity) {
+            auto oldest = m_regions.begin();
+            for (auto r = m_regions.begin(); r != m_regions.end(); ++r) {
+                if (r->second->last_use < oldest->second->last_use) oldest = r;
+            }
+            m_regions.erase(oldest);
+        }
+        new_region->last_use = ++m_clock;
+        m_regions.emplace(new_region->begin, new_region);
+        return new_region;
+    }
+
+    void clear() {
+        std::unique_lock lock(m_mutex);
+        m_regions.clear();
+    }
+
+   private:
+    std::mutex m_mutex;
+    std::map<uintptr_t, std::shared_ptr<region>> m_regions;
+    uint64_t m_clock = 0;
+};
+
 std::unique_ptr<nfi_xpn_server_comm> nfi_fabric_server_control_comm::control_connect(std::string_view srv_name,
                                                                                      int srv_port) {
     XPN_PROFILE_FUNCTION();
@@ -121,6 +204,9 @@ void nfi_fabric_server_control_comm::disconnect(std::unique_ptr<nfi_xpn_server_c
     // Disconnect
     debug_info("[NFI_FABRIC_SERVER_COMM] [nfi_fabric_server_comm_disconnect] Disconnect");
 
+    // The registrations must not outlive the connections of the fabric
+    fabric_rdma_regions::get_instance().clear();
+
     ret = lfi_client_close(in_comm->m_comm);
     if (ret < 0) {
         debug_error("[NFI_FABRIC_SERVER_COMM] [nfi_fabric_server_comm_disconnect] ERROR: lfi_client_close fails");
@@ -157,6 +243,19 @@ int64_t nfi_fabric_server_comm::write_operation(xpn_server_msg &msg) {
     return 0;
 }
 
+std::shared_ptr<void> nfi_fabric_server_comm::rdma_register(const void *data, uint64_t size, xpn_server_rdma &rdma) {
+    XPN_PROFILE_FUNCTION_ARGS(size);
+    auto found = fabric_rdma_regions::get_instance().get(data, size);
+    if (!found) {
+        return nullptr;
+    }
+    rdma.addr = reinterpret_cast<uint64_t>(data);
+    rdma.shm_key = found->key.shm_key;
+    rdma.peer_key = found->key.peer_key;
+    debug_info("[NFI_FABRIC_SERVER_COMM] [nfi_fabric_server_comm_rdma_register] " << data << " " << size);
+    return found;
+}
+
 int64_t nfi_fabric_server_comm::write_data(const void *data, int64_t size, int64_t tag) {
     XPN_PROFILE_FUNCTION_ARGS(size);
     int64_t ret;
@@ -41,6 +41,7 @@ namespace XPN
     int64_t write_data(const void *data, int64_t size, int64_t tag = -1) override;
     int64_t readv_data(const iovec *iov, int64_t count, int64_t tag = -1) override;
     int64_t writev_data(const iovec *iov, int64_t count, int64_t tag = -1) override;
+    std::shared_ptr<void> rdma_register(const void *data, uint64_t size, xpn_server_rdma &rdma) override;
   public:
     int m_comm;
   };
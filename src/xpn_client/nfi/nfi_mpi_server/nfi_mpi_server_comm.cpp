@@ -354,11 +354,93 @@ int64_t nfi_mpi_server_comm::read_data(void *data, int64_t size, int64_t tag) {
     return size;
 }
 
-int64_t nfi_mpi_server_comm::writev_data([[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int64_t tag) {
-    unreachable("unimplemented");
+// Datatype with the absolute addresses of the iovec, to send or receive it as one message from MPI_BOTTOM
+static int mpi_iov_type(const iovec *iov, int64_t count, MPI_Datatype base, MPI_Datatype &type) {
+    int lengths[socket::MAX_IOV];
+    MPI_Aint displs[socket::MAX_IOV];
+
+    if (count <= 0 || count > socket::MAX_IOV) {
+        return MPI_ERR_COUNT;
+    }
+    for (int64_t i = 0; i < count; i++) {
+        lengths[i] = static_cast<int>(iov[i].iov_len);
+        MPI_Get_address(iov[i].iov_base, &displs[i]);
+    }
+    int ret = MPI_Type_create_hindexed(count, lengths, displs, base, &type);
+    if (MPI_SUCCESS == ret) {
+        ret = MPI_Type_commit(&type);
+    }
+    return ret;
 }
-int64_t nfi_mpi_server_comm::readv_data([[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int64_t tag) {
-    unreachable("unimplemented");
+
+int64_t nfi_mpi_server_comm::writev_data(const iovec *iov, int64_t count, int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+    int ret;
+    int64_t size = 0;
+    MPI_Datatype type;
+
+    debug_info("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_writev_data] >> Begin");
+
+    if (tag == -1) {
+        tag = (int)(pthread_self() % 32450) + 1;
+    }
+
+    // The tag 0 is the one of the operations, that the server receives as bytes
+    ret = mpi_iov_type(iov, count, tag == 0 ? MPI_BYTE : MPI_CHAR, type);
+    if (MPI_SUCCESS != ret) {
+        printf("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_writev_data] ERROR: MPI_Type_create_hindexed fails");
+        return -1;
+    }
+
+    debug_info("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_writev_data] Write data ("<<count<<" iovs, "<<tag<<")");
+
+    ret = MPI_Send(MPI_BOTTOM, 1, type, 0, tag, m_comm);
+    MPI_Type_free(&type);
+    if (MPI_SUCCESS != ret) {
+        printf("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_writev_data] ERROR: MPI_Send fails");
+        return -1;
+    }
+    for (int64_t i = 0; i < count; i++) size += iov[i].iov_len;
+
+    debug_info("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_writev_data] << End = "<<size);
+
+    // Return bytes written
+    return size;
+}
+
+int64_t nfi_mpi_server_comm::readv_data(const iovec *iov, int64_t count, int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+    int ret, size = 0;
+    MPI_Status status;
+    MPI_Datatype type;
+
+    debug_info("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_readv_data] >> Begin");
+
+    if (tag == -1) {
+        tag = (int)(pthread_self() % 32450) + 1;
+    }
+
+    ret = mpi_iov_type(iov, count, MPI_CHAR, type);
+    if (MPI_SUCCESS != ret) {
+        printf("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_readv_data] ERROR: MPI_Type_create_hindexed fails");
+        return -1;
+    }
+
+    debug_info("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_readv_data] Read data ("<<count<<" iovs, "<<tag<<")");
+
+    // The message can be shorter than the iovec, as the replies with errors
+    ret = MPI_Recv(MPI_BOTTOM, 1, type, 0, tag, m_comm, &status);
+    MPI_Type_free(&type);
+    if (MPI_SUCCESS != ret) {
+        printf("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_readv_data] ERROR: MPI_Recv fails");
+        return -1;
+    }
+    MPI_Get_count(&status, MPI_CHAR, &size);
+
+    debug_info("[NFI_MPI_SERVER_COMM] [nfi_mpi_server_comm_readv_data] << End = "<<size);
+
+    // Return bytes read
+    return size;
 }
 
 } // namespace XPN
\ No newline at end of file
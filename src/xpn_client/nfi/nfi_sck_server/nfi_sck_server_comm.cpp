@@ -24,7 +24,9 @@
 #include "base_cpp/debug.hpp"
 #include "base_cpp/socket.hpp"
 #include "base_cpp/ns.hpp"
+#include "nfi/nfi_server.hpp"
 #include <charconv>
+#include <cstring>
 #include <csignal>
 #include <xpn_server/xpn_server_ops.hpp>
 
@@ -82,7 +84,51 @@ std::unique_ptr<nfi_xpn_server_comm> nfi_sck_server_control_comm::control_connec
   debug_info("[NFI_SCK_SERVER_COMM] ----SERVER = "<<srv_name<<" PORT = "<<port_name);
 
   // Connect...
-  return connect(srv_name, port_name);
+  std::unique_ptr<nfi_xpn_server_comm> comm = connect(srv_name, port_name);
+  if (comm && !m_is_mqtt && xpn_env::get_instance().xpn_shm != 0 && nfi_server::is_local_server(srv_name)) {
+    return shm_connect(std::move(comm));
+  }
+  return comm;
+}
+
+std::unique_ptr<nfi_xpn_server_comm> nfi_sck_server_control_comm::shm_connect(std::unique_ptr<nfi_xpn_server_comm> comm)
+{
+  XPN_PROFILE_FUNCTION();
+  nfi_sck_server_comm *sck_comm = static_cast<nfi_sck_server_comm*>(comm.get());
+
+  debug_info("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_shm_connect] >> Begin");
+
+  std::unique_ptr<shm_channel> channel = shm_channel::create(shm_channel::DEFAULT_RING_SIZE, sck_comm->m_socket);
+  if (!channel) {
+    debug_info("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_shm_connect] cannot create the channel, stay in the socket");
+    return comm;
+  }
+
+  xpn_server_msg msg = {};
+  st_xpn_server_shm_connect *head = reinterpret_cast<st_xpn_server_shm_connect*>(msg.msg_buffer);
+  head->ring_size = channel->ring_size();
+  std::strncpy(head->name, channel->name().c_str(), NAME_MAX - 1);
+  msg.op = static_cast<int>(xpn_server_ops::SHM_CONNECT);
+  msg.msg_size = head->get_size();
+
+  st_xpn_server_status status = {};
+  int64_t ret = sck_comm->write_operation(msg);
+  if (ret >= 0) {
+    ret = sck_comm->read_data(&status, sizeof(status));
+  }
+  // Both sides have it mapped or the server has refused it
+  channel->unlink();
+  if (ret < 0) {
+    debug_error("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_shm_connect] ERROR: negotiation of the channel fails");
+    return nullptr;
+  }
+  if (status.ret < 0) {
+    debug_info("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_shm_connect] the server refused the channel, stay in the socket");
+    return comm;
+  }
+
+  debug_info("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_shm_connect] << End " << channel->name());
+  return std::make_unique<nfi_shm_server_comm>(sck_comm->m_socket, sck_comm->m_mqtt, std::move(channel));
 }
 
 std::unique_ptr<nfi_xpn_server_comm> nfi_sck_server_control_comm::connect(std::string_view srv_name, std::string_view port_name) {
@@ -237,11 +283,106 @@ int64_t nfi_sck_server_comm::read_data(void *data, int64_t size, [[maybe_unused]
     return ret;
 }
 
-int64_t nfi_sck_server_comm::writev_data([[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int64_t tag) {
-    unreachable("unimplemented");
+int64_t nfi_sck_server_comm::write_operation_data(xpn_server_msg& msg, const void *data, int64_t size) {
+    XPN_PROFILE_FUNCTION();
+
+    debug_info("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_write_operation_data] >> Begin");
+
+    // Message generation
+    msg.tag = (int)(pthread_self() % 32450) + 1;
+
+    // Send the operation and the payload with one syscall
+    struct iovec iovs[2] = {
+        {.iov_base = &msg, .iov_len = msg.get_size()},
+        {.iov_base = const_cast<void*>(data), .iov_len = static_cast<size_t>(size)}
+    };
+    if (writev_data(iovs, 2) < 0) {
+        debug_error("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_write_operation_data] ERROR: writev_data fails");
+        return -1;
+    }
+
+    debug_info("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_write_operation_data] << End = "<<size);
+
+    // Return bytes written of the payload
+    return size;
+}
+
+int64_t nfi_sck_server_comm::writev_data(const iovec *iov, int64_t count, [[maybe_unused]] int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+    int64_t size = 0;
+    for (int64_t i = 0; i < count; i++) size += iov[i].iov_len;
+
+    int64_t ret = socket::sendv(m_socket, iov, count);
+    if (ret != size) {
+        debug_error("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_writev_data] ERROR: socket::sendv "<<ret<<" of "<<size);
+        return -1;
+    }
+    return ret;
+}
+
+int64_t nfi_sck_server_comm::readv_data(const iovec *iov, int64_t count, [[maybe_unused]] int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+    int64_t size = 0;
+    for (int64_t i = 0; i < count; i++) size += iov[i].iov_len;
+
+    int64_t ret = socket::recvv(m_socket, iov, count);
+    if (ret != size) {
+        debug_error("[NFI_SCK_SERVER_COMM] [nfi_sck_server_comm_readv_data] ERROR: socket::recvv "<<ret<<" of "<<size);
+        return -1;
+    }
+    return ret;
+}
+
+int64_t nfi_shm_server_comm::write_operation(xpn_server_msg& msg) {
+    XPN_PROFILE_FUNCTION();
+
+    msg.tag = (int)(pthread_self() % 32450) + 1;
+    if (m_channel->send(&msg, msg.get_size()) < 0) {
+        debug_error("[NFI_SCK_SERVER_COMM] [nfi_shm_server_comm_write_operation] ERROR: channel send fails");
+        return -1;
+    }
+    return msg.get_size();
 }
-int64_t nfi_sck_server_comm::readv_data([[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int64_t tag) {
-    unreachable("unimplemented");
+
+int64_t nfi_shm_server_comm::write_data(const void *data, int64_t size, [[maybe_unused]] int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+
+    if (size == 0) {
+        return 0;
+    }
+    if (size < 0 || m_channel->send(data, size) < 0) {
+        debug_error("[NFI_SCK_SERVER_COMM] [nfi_shm_server_comm_write_data] ERROR: channel send fails, size " << size);
+        return -1;
+    }
+    return size;
+}
+
+int64_t nfi_shm_server_comm::read_data(void *data, int64_t size, [[maybe_unused]] int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+
+    if (size == 0) {
+        return 0;
+    }
+    if (size < 0 || m_channel->recv(data, size) < 0) {
+        debug_error("[NFI_SCK_SERVER_COMM] [nfi_shm_server_comm_read_data] ERROR: channel recv fails, size " << size);
+        return -1;
+    }
+    return size;
+}
+
+int64_t nfi_shm_server_comm::writev_data(const iovec *iov, int64_t count, [[maybe_unused]] int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+    return m_channel->sendv(iov, count);
+}
+
+int64_t nfi_shm_server_comm::readv_data(const iovec *iov, int64_t count, [[maybe_unused]] int64_t tag) {
+    XPN_PROFILE_FUNCTION();
+    int64_t total = 0;
+    for (int64_t i = 0; i < count; i++) {
+        if (m_channel->recv(iov[i].iov_base, iov[i].iov_len) < 0) return -1;
+        total += iov[i].iov_len;
+    }
+    return total;
 }
 
 } //namespace XPN
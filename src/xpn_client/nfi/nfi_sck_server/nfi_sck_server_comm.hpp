@@ -24,6 +24,7 @@
 #include <string>
 #include <memory>
 
+#include "base_cpp/shm_channel.hpp"
 #include "nfi/nfi_xpn_server_comm.hpp"
 
 namespace XPN
@@ -37,6 +38,7 @@ namespace XPN
     }
 
     int64_t write_operation(xpn_server_msg& msg) override;
+    int64_t write_operation_data(xpn_server_msg& msg, const void *data, int64_t size) override;
     int64_t read_data(void *data, int64_t size, int64_t tag = -1) override;
     int64_t write_data(const void *data, int64_t size, int64_t tag = -1) override;
     int64_t readv_data(const iovec *iov, int64_t count, int64_t tag = -1) override;
@@ -47,6 +49,23 @@ namespace XPN
     std::mutex m_mutex = {};
   };
   
+  // Connection to a server of the same node moved to a shared memory channel, the socket is kept to detect when the
+  // server is gone
+  class nfi_shm_server_comm : public nfi_sck_server_comm
+  {
+  public:
+    nfi_shm_server_comm(int socket, void *mqtt, std::unique_ptr<shm_channel> channel)
+        : nfi_sck_server_comm(socket, mqtt), m_channel(std::move(channel)) {}
+
+    int64_t write_operation(xpn_server_msg& msg) override;
+    int64_t read_data(void *data, int64_t size, int64_t tag = -1) override;
+    int64_t write_data(const void *data, int64_t size, int64_t tag = -1) override;
+    int64_t readv_data(const iovec *iov, int64_t count, int64_t tag = -1) override;
+    int64_t writev_data(const iovec *iov, int64_t count, int64_t tag = -1) override;
+  public:
+    std::unique_ptr<shm_channel> m_channel;
+  };
+
   class nfi_sck_server_control_comm : public nfi_xpn_server_control_comm
   {
   public:
@@ -58,6 +77,9 @@ namespace XPN
     void disconnect(std::unique_ptr<nfi_xpn_server_comm> &comm, bool needSendCode = true) override;
 
   private:
+    // The connection stays in the socket when the server cannot open the channel
+    std::unique_ptr<nfi_xpn_server_comm> shm_connect(std::unique_ptr<nfi_xpn_server_comm> comm);
+
     bool m_is_mqtt;
   };
 
@@ -0,0 +1,133 @@
+
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nfi_sck_server_pool.hpp"
+
+#include "base_cpp/debug.hpp"
+#include "base_cpp/socket.hpp"
+#include "base_cpp/xpn_env.hpp"
+#include "nfi_sck_server_comm.hpp"
+
+namespace XPN
+{
+
+nfi_sck_server_pool::nfi_sck_server_pool(nfi_xpn_server_control_comm &control, std::string_view server, std::string_view port)
+    : m_control(control),
+      m_server(server),
+      m_port(port),
+      m_max_idle(std::max(xpn_env::get_instance().xpn_connection_pool, 0)),
+      m_idle_timeout(std::chrono::milliseconds(std::max(xpn_env::get_instance().xpn_connection_idle_ms, 0)))
+{
+}
+
+nfi_sck_server_pool::~nfi_sck_server_pool()
+{
+  for (auto &&idle : m_idle) {
+    m_control.disconnect(idle.comm);
+  }
+  for (auto &&[id, ordered] : m_ordered) {
+    m_control.disconnect(ordered.comm);
+  }
+}
+
+std::unique_ptr<nfi_xpn_server_comm> nfi_sck_server_pool::acquire()
+{
+  std::vector<idle_comm> expired;
+  std::unique_ptr<nfi_xpn_server_comm> comm;
+  {
+    std::unique_lock lock(m_mutex);
+    auto now = clock::now();
+    auto first_valid = m_idle.begin();
+    while (first_valid != m_idle.end() && now - first_valid->since > m_idle_timeout) {
+      ++first_valid;
+    }
+    expired.insert(expired.end(), std::make_move_iterator(m_idle.begin()), std::make_move_iterator(first_valid));
+    m_idle.erase(m_idle.begin(), first_valid);
+    // The one of this thread first, the ones of the threads without other request for long have nothing left to
+    // keep in order
+    for (auto it = m_ordered.begin(); it != m_ordered.end();) {
+      if (it->first == std::this_thread::get_id()) {
+        comm = std::move(it->second.comm);
+      } else if (now - it->second.since > m_idle_timeout) {
+        expired.push_back(std::move(it->second));
+      } else {
+        ++it;
+        continue;
+      }
+      it = m_ordered.erase(it);
+    }
+    if (!comm && !m_idle.empty()) {
+      comm = std::move(m_idle.back().comm);
+      m_idle.pop_back();
+    }
+  }
+  for (auto &&idle : expired) {
+    debug_info("[NFI_SCK_SERVER_POOL] [acquire] close idle connection to "<<m_server);
+    m_control.disconnect(idle.comm);
+  }
+
+  // The server closes the connections when it ends, nothing else can be pending in an idle one
+  while (comm && socket::is_readable(static_cast<nfi_sck_server_comm*>(comm.get())->m_socket)) {
+    debug_info("[NFI_SCK_SERVER_POOL] [acquire] the server closed an idle connection");
+    m_control.disconnect(comm, false);
+    std::unique_lock lock(m_mutex);
+    if (!m_idle.empty()) {
+      comm = std::move(m_idle.back().comm);
+      m_idle.pop_back();
+    }
+  }
+  if (comm) {
+    return comm;
+  }
+
+  comm = m_control.connect(m_server, m_port);
+  if (comm && m_max_idle > 0) {
+    socket::set_keepalive(static_cast<nfi_sck_server_comm*>(comm.get())->m_socket,
+                          std::chrono::duration_cast<std::chrono::seconds>(m_idle_timeout).count());
+  }
+  return comm;
+}
+
+void nfi_sck_server_pool::release(std::unique_ptr<nfi_xpn_server_comm> &comm, bool without_response)
+{
+  if (!comm) return;
+  {
+    std::unique_lock lock(m_mutex);
+    if (without_response) {
+      auto &ordered = m_ordered[std::this_thread::get_id()];
+      std::swap(ordered.comm, comm);
+      ordered.since = clock::now();
+      if (!comm) return;
+    } else if (m_idle.size() < m_max_idle) {
+      m_idle.push_back({std::move(comm), clock::now()});
+      return;
+    }
+  }
+  m_control.disconnect(comm);
+}
+
+void nfi_sck_server_pool::discard(std::unique_ptr<nfi_xpn_server_comm> &comm)
+{
+  if (!comm) return;
+  m_control.disconnect(comm, false);
+}
+
+} // namespace XPN
@@ -0,0 +1,77 @@
+
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "nfi/nfi_xpn_server_comm.hpp"
+
+namespace XPN
+{
+
+  // Idle connections to the connectionless port of a server, shared by the threads of the client. A request takes
+  // one and returns it when it ends well, so only the first request of a burst pays the connect
+  class nfi_sck_server_pool
+  {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    nfi_sck_server_pool(nfi_xpn_server_control_comm &control, std::string_view server, std::string_view port);
+    ~nfi_sck_server_pool();
+    nfi_sck_server_pool(const nfi_sck_server_pool &) = delete;
+    nfi_sck_server_pool &operator=(const nfi_sck_server_pool &) = delete;
+
+    // The connection of the last request without response of this thread, an idle connection or a new one,
+    // nullptr when the server cannot be connected
+    std::unique_ptr<nfi_xpn_server_comm> acquire();
+    // The connection is kept for the next request while the pool has room. After a request without response it is
+    // kept for the next one of the same thread, that the server serves after it as they come by the same connection
+    void release(std::unique_ptr<nfi_xpn_server_comm> &comm, bool without_response = false);
+    // The connection is in an unknown state after an error, it is closed
+    void discard(std::unique_ptr<nfi_xpn_server_comm> &comm);
+
+  private:
+    struct idle_comm {
+      std::unique_ptr<nfi_xpn_server_comm> comm;
+      clock::time_point since;
+    };
+
+    nfi_xpn_server_control_comm &m_control;
+    const std::string m_server;
+    const std::string m_port;
+    const size_t m_max_idle;
+    const clock::duration m_idle_timeout;
+
+    std::mutex m_mutex;
+    // The most recently used at the back
+    std::vector<idle_comm> m_idle;
+    // The connections of the last requests without response, by thread
+    std::unordered_map<std::thread::id, idle_comm> m_ordered;
+  };
+
+} // namespace XPN
@@ -27,6 +27,7 @@
 #include "nfi/nfi_xpn_server/nfi_xpn_server.hpp"
 #include "nfi/nfi_local/nfi_local.hpp"
 
+#include <algorithm>
 #include <charconv>
 #include <iostream>
 #include <csignal>
@@ -98,7 +99,22 @@ namespace XPN
 
         if (m_comm == nullptr){
             m_error = ERROR;
-            res = -1;
+            XPN_DEBUG_END;
+            return -1;
+        }
+
+        if (xpn_env::get_instance().xpn_connect && m_protocol_type == protocol_t::sck) {
+            m_num_connections = negotiate_connections(xpn_env::get_instance().xpn_connections);
+            for (int i = 1; i < m_num_connections; i++) {
+                auto comm = m_control_comm->control_connect(m_server, m_server_port);
+                if (!comm) {
+                    debug_error("[NFI_SERVER] [init_comm] ERROR: connection "<<i<<" of "<<m_num_connections<<" fails");
+                    break;
+                }
+                m_parallel_comms.emplace_back(std::move(comm));
+            }
+            m_num_connections = 1 + m_parallel_comms.size();
+            debug_info("[NFI_SERVER] [init_comm] "<<m_num_connections<<" connections to "<<m_server);
         }
 
         if (!xpn_env::get_instance().xpn_connect){
@@ -110,6 +126,7 @@ namespace XPN
             int ret = socket::client_connect(m_server, m_server_port, xpn_env::get_instance().xpn_connect_timeout_ms, connection_socket);
             if (ret < 0) {
                 debug_error("[NFI_SERVER] [init_comm] ERROR: socket connect\n");
+                m_error = ERROR;
                 return -1;
             }
             int buffer = socket::xpn_server::CONNECTIONLESS_PORT_CODE;
@@ -117,6 +134,7 @@ namespace XPN
             if (ret < 0)
             {
                 debug_error("[NFI_SERVER] [init_comm] ERROR: socket send\n");
+                m_error = ERROR;
                 socket::close(connection_socket);
                 return -1;
             }
@@ -124,6 +142,7 @@ namespace XPN
             if (ret < 0)
             {
                 debug_error("[NFI_SERVER] [init_comm] ERROR: socket read\n");
+                m_error = ERROR;
                 socket::close(connection_socket);
                 return -1;
             }
@@ -136,12 +155,21 @@ namespace XPN
                 print("Error: to use without XPN_SESSION_CONNECT xpn_server needs to be build with SCK_SERVER support")
                 std::raise(SIGTERM);
             }
+            m_connectionless_pool = std::make_unique<nfi_sck_server_pool>(*m_control_comm_connectionless, m_server, m_connectionless_port);
+            // The ranges of the striped transfers take connections of the pool
+            m_num_connections = negotiate_connections(xpn_env::get_instance().xpn_connections);
         }
 
         XPN_DEBUG_END;
         return res;
     }
 
+    int nfi_server::init_comm_once()
+    {
+        std::call_once(m_comm_once, [this]() { m_comm_res = init_comm(); });
+        return m_comm_res;
+    }
+
     int nfi_server::destroy_comm()
     {
         XPN_DEBUG_BEGIN;
@@ -149,6 +177,11 @@ namespace XPN
         if (m_comm != nullptr){
             m_control_comm->disconnect(m_comm);
         }
+        for (auto &comm : m_parallel_comms) {
+            m_control_comm->disconnect(comm);
+        }
+        m_parallel_comms.clear();
+        m_connectionless_pool.reset();
 
         m_control_comm.reset();
 
@@ -156,6 +189,114 @@ namespace XPN
         return res;
     }
 
+    int nfi_server::negotiate_connections(int requested)
+    {
+        if (requested <= 1) return 1;
+        int connection_socket = 0;
+        int ret = socket::client_connect(m_server, m_server_port, xpn_env::get_instance().xpn_connect_timeout_ms, connection_socket);
+        if (ret < 0) {
+            debug_error("[NFI_SERVER] [negotiate_connections] ERROR: socket connect\n");
+            return 1;
+        }
+        int buffer = socket::xpn_server::CONNECTIONS_CODE;
+        int granted = 1;
+        ret = socket::send(connection_socket, &buffer, sizeof(buffer));
+        if (ret >= 0) {
+            ret = socket::send(connection_socket, &requested, sizeof(requested));
+        }
+        if (ret >= 0) {
+            ret = socket::recv(connection_socket, &granted, sizeof(granted));
+        }
+        socket::close(connection_socket);
+        // The servers without the code close the socket without reply
+        if (ret < 0) {
+            debug_info("[NFI_SERVER] [negotiate_connections] the server does not grant connections");
+            return 1;
+        }
+        debug_info("[NFI_SERVER] [negotiate_connections] requested "<<requested<<" granted "<<granted);
+        return std::clamp(granted, 1, requested);
+    }
+
+    nfi_server::comm_scope::comm_scope(nfi_server &server, bool any_connection) : m_server(server), m_prev(t_scope)
+    {
+        if (t_scope && &t_scope->m_server == &server) {
+            // A request inside another of the same server goes by its connection
+            m_comm = t_scope->m_comm;
+            m_owner = t_scope->m_nested ? t_scope->m_owner : t_scope;
+            m_nested = true;
+            return;
+        }
+        // With XPN_CONNECT_LAZY the first request connects
+        server.init_comm_once();
+        if (!xpn_env::get_instance().xpn_connect) {
+            if (server.m_connectionless_pool) {
+                m_pooled = server.m_connectionless_pool->acquire();
+            }
+            m_comm = m_pooled.get();
+        } else {
+            m_comm = server.m_comm.get();
+            if (m_comm && m_comm->m_type == server_type::SCK) {
+                // Necessary lock, because the nfi sck comm is not reentrant in the communication part
+                auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm);
+                if (any_connection && !server.m_parallel_comms.empty()) {
+                    // The first connection free from the next one in round robin, or wait for that one
+                    uint32_t count = 1 + server.m_parallel_comms.size();
+                    uint32_t next = server.m_next_comm++ % count;
+                    auto connection = [&server](uint32_t i) {
+                        return static_cast<nfi_sck_server_comm*>(i == 0 ? server.m_comm.get() : server.m_parallel_comms[i - 1].get());
+                    };
+                    sck_comm = connection(next);
+                    for (uint32_t i = 0; i < count; i++) {
+                        auto candidate = connection((next + i) % count);
+                        std::unique_lock<std::mutex> lock(candidate->m_mutex, std::try_to_lock);
+                        if (lock) {
+                            sck_comm = candidate;
+                            m_lock.emplace(std::move(lock));
+                            break;
+                        }
+                    }
+                    m_comm = sck_comm;
+                }
+                if (!m_lock) {
+                    m_lock.emplace(sck_comm->m_mutex);
+                }
+                debug_info("lock sck comm mutex");
+            }
+        }
+        t_scope = this;
+    }
+
+    nfi_server::comm_scope::~comm_scope()
+    {
+        if (m_nested) return;
+        t_scope = m_prev;
+        if (m_pooled) {
+            if (m_done) {
+                m_server.m_connectionless_pool->release(m_pooled, m_sent);
+            } else {
+                m_server.m_connectionless_pool->discard(m_pooled);
+            }
+        }
+    }
+
+    int nfi_server::nfi_open_mdata(std::string_view path, int flags, mode_t mode, xpn_fh &fho, xpn_metadata &mdata)
+    {
+        int ret = nfi_read_mdata(path, mdata);
+        if (ret < 0) {
+            return ret;
+        }
+        return nfi_open(path, flags, mode, fho);
+    }
+
+    int nfi_server::nfi_getattr_mdata(std::string_view path, xpn_metadata &mdata, struct ::stat &st)
+    {
+        int ret = nfi_read_mdata(path, mdata);
+        if (ret < 0) {
+            return ret;
+        }
+        return nfi_getattr(path, st);
+    }
+
     bool nfi_server::is_local_server(std::string_view server)
     {
         return (server == ns::get_host_name() ||
@@ -21,9 +21,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <optional>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <tuple>
 #include <sys/vfs.h>
 #include <sys/stat.h>
@@ -33,6 +36,7 @@
 #include "xpn_server/xpn_server_ops.hpp"
 #include "nfi_xpn_server_comm.hpp"
 #include "nfi_sck_server/nfi_sck_server_comm.hpp"
+#include "nfi_sck_server/nfi_sck_server_pool.hpp"
 #include "base_cpp/debug.hpp"
 #include "base_cpp/xpn_parser.hpp"
 
@@ -48,7 +52,11 @@ namespace XPN
         nfi_server(xpn_url url);
         virtual ~nfi_server() = default;
         int init_comm();
+        // init_comm the first time, the next calls wait for it and return its result without trying it again
+        int init_comm_once();
         int destroy_comm();
+        // The sockets can be connected from any thread, the other protocols only from the thread of the init
+        bool can_connect_async() const { return m_protocol_type == protocol_t::sck || m_protocol_type == protocol_t::mqtt; }
         static bool is_local_server(std::string_view server);
         
         static std::unique_ptr<nfi_server> Create(std::string_view url, uint32_t num_servers);
@@ -80,6 +88,55 @@ namespace XPN
         std::unique_ptr<nfi_xpn_server_control_comm> m_control_comm = nullptr;
         std::unique_ptr<nfi_xpn_server_control_comm> m_control_comm_connectionless = nullptr;
         std::unique_ptr<nfi_xpn_server_comm>         m_comm = nullptr;
+        std::unique_ptr<nfi_sck_server_pool>         m_connectionless_pool = nullptr;
+        std::once_flag m_comm_once;
+        int m_comm_res = 0;
+        // The other connections of the server granted with XPN_CONNECTIONS, the requests take the first one free
+        std::vector<std::unique_ptr<nfi_xpn_server_comm>> m_parallel_comms;
+        std::atomic_uint32_t m_next_comm = 0;
+        // Connections that a transfer can use at the same time
+        int m_num_connections = 1;
+        // Ask the server for the connections of XPN_CONNECTIONS, it returns the ones granted, 1 when it cannot
+        int negotiate_connections(int requested);
+
+        // Hold the connection of a request: without XPN_CONNECT one of the pool, that goes back to it when the
+        // request ends well, otherwise the connection of the server, locked when it is a socket. The reads and writes
+        // can take any connection of XPN_CONNECTIONS, the other requests go by the first one in the order they are
+        // sent, as some of them have no response
+        class comm_scope
+        {
+        public:
+            explicit comm_scope(nfi_server &server, bool any_connection = false);
+            ~comm_scope();
+            comm_scope(const comm_scope &) = delete;
+            comm_scope &operator=(const comm_scope &) = delete;
+
+            explicit operator bool() const { return m_comm != nullptr; }
+            // The request has ended well, the connection can serve the next one
+            void done() { m_done = true; }
+            // The request without response has been sent, the next one of this thread has to go after it
+            void sent()
+            {
+                m_done = true;
+                (m_nested ? *m_owner : *this).m_sent = true;
+            }
+
+        private:
+            friend class nfi_server;
+            nfi_server &m_server;
+            nfi_xpn_server_comm *m_comm = nullptr;
+            std::unique_ptr<nfi_xpn_server_comm> m_pooled = nullptr;
+            std::optional<std::unique_lock<std::mutex>> m_lock = std::nullopt;
+            comm_scope *m_prev = nullptr;
+            comm_scope *m_owner = nullptr;
+            bool m_nested = false;
+            bool m_done = false;
+            bool m_sent = false;
+        };
+        inline static thread_local comm_scope *t_scope = nullptr;
+
+        // The connection of the request in course in this thread
+        nfi_xpn_server_comm *comm() { return t_scope && &t_scope->m_server == this ? t_scope->m_comm : m_comm.get(); }
 
     public:
         // Operations 
@@ -100,6 +157,10 @@ namespace XPN
         virtual int nfi_statvfs     (std::string_view path, struct ::statvfs &inf) = 0;
         virtual int nfi_read_mdata  (std::string_view path, xpn_metadata &mdata) = 0;
         virtual int nfi_write_mdata (std::string_view path, const xpn_fh &fh, const xpn_metadata::data &mdata, bool only_file_size) = 0;
+        // The open and the getattr with the read of the metadata header before them, the servers that can do it
+        // in one request override them
+        virtual int nfi_open_mdata    (std::string_view path, int flags, mode_t mode, xpn_fh &fho, xpn_metadata &mdata);
+        virtual int nfi_getattr_mdata (std::string_view path, xpn_metadata &mdata, struct ::stat &st);
 
         virtual int nfi_flush       (const char *path) = 0;
         virtual int nfi_preload     (const char *path) = 0;
@@ -121,26 +182,27 @@ namespace XPN
             message.msg_size = msg.get_size();
             std::memcpy(message.msg_buffer, &msg, msg.get_size());
 
-            std::optional<std::unique_lock<std::mutex>> lock = std::nullopt;
+            // With XPN_CONNECT_LAZY the first request connects
+            init_comm_once();
+
+            // With response the caller holds the connection until the response is read
+            std::optional<comm_scope> scope = std::nullopt;
             if (!haveResponse) {
-                if (!xpn_env::get_instance().xpn_connect && m_comm == nullptr) {
-                    m_comm = m_control_comm_connectionless->connect(m_server, m_connectionless_port);
-                } else if (m_comm && m_comm->m_type == server_type::SCK) {
-                    // Necessary lock, because the nfi sck comm is not reentrant in the communication part 
-                    auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm.get());
-                    lock = std::unique_lock<std::mutex>(sck_comm->m_mutex);
-                    debug_info("lock sck comm mutex");
-                }
+                scope.emplace(*this);
             }
-            ret = m_comm->write_operation(message);
+            if (comm() == nullptr) {
+                m_error = ERROR_COMM;
+                debug_error("[NFI_XPN] [nfi_write_operation] ERROR: not connected");
+                return -1;
+            }
+            ret = comm()->write_operation(message);
             if (ret < 0){
                 m_error = ERROR_COMM;
                 printf("[NFI_XPN] [nfi_write_operation] ERROR: nfi_write_operation fails\n");
                 return -1;
             }
-            if (!haveResponse && !xpn_env::get_instance().xpn_connect) {
-                m_control_comm_connectionless->disconnect(m_comm);
-                m_comm = nullptr;
+            if (scope) {
+                scope->sent();
             }
 
             debug_info("[NFI_XPN] [nfi_write_operation] Execute operation: "<<static_cast<int>(op)<<" "<<xpn_server_ops_name(op)<<" -> "<<ret);
@@ -150,20 +212,44 @@ namespace XPN
             return ret;
         }
 
+        // The operation with its payload behind, the caller has to hold the comm as in the reads and writes
+        template<typename msg_struct>
+        int nfi_write_operation_data( xpn_server_ops op, msg_struct &msg, const void *data, int64_t size )
+        {
+            int64_t ret;
+
+            debug_info("[NFI_XPN] [nfi_write_operation_data] >> Begin");
+
+            xpn_server_msg message;
+            message.op = static_cast<int>(op);
+            message.msg_size = msg.get_size();
+            std::memcpy(message.msg_buffer, &msg, msg.get_size());
+
+            ret = comm()->write_operation_data(message, data, size);
+            if (ret < 0){
+                m_error = ERROR_COMM;
+                printf("[NFI_XPN] [nfi_write_operation_data] ERROR: write_operation_data fails\n");
+                return -1;
+            }
+
+            debug_info("[NFI_XPN] [nfi_write_operation_data] Execute operation: "<<static_cast<int>(op)<<" "<<xpn_server_ops_name(op)<<" -> "<<ret);
+
+            debug_info("[NFI_XPN] [nfi_write_operation_data] >> End");
+
+            return ret;
+        }
+
         template<typename msg_struct, typename req_struct>
         int nfi_do_request ( xpn_server_ops op, msg_struct &msg, req_struct &req )
         {
             int64_t ret;
             debug_info("[NFI_XPN] [nfi_server_do_request] >> Begin");
 
-            std::optional<std::unique_lock<std::mutex>> lock = std::nullopt;
-            if (!xpn_env::get_instance().xpn_connect && m_comm == nullptr){
-                m_comm = m_control_comm_connectionless->connect(m_server, m_connectionless_port);
-            } else if (m_comm->m_type == server_type::SCK) {
-                    // Necessary lock, because the nfi sck comm is not reentrant in the communication part 
-                auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm.get());
-                lock = std::unique_lock<std::mutex>(sck_comm->m_mutex);
-                debug_info("lock sck comm mutex");
+            comm_scope scope(*this);
+            if (!scope) {
+                m_error = ERROR_COMM;
+                debug_error("[NFI_XPN] [nfi_server_do_request] ERROR: not connected");
+                return -1;
             }
 
             // send request...
@@ -177,7 +263,7 @@ namespace XPN
 
             // read response...
             debug_info("[NFI_XPN] [nfi_server_do_request] Response operation: "<<static_cast<int>(op)<<" "<<xpn_server_ops_name(op)<<" to read "<<sizeof(req));
-            ret = m_comm->read_data((void *)&(req), sizeof(req));
+            ret = comm()->read_data((void *)&(req), sizeof(req));
             if (ret < 0) {
                 m_error = ERROR_COMM;
                 return -1;
@@ -189,10 +275,7 @@ namespace XPN
             }
             #endif
 
-            if (!xpn_env::get_instance().xpn_connect){
-                m_control_comm_connectionless->disconnect(m_comm);
-                m_comm = nullptr;
-            }
+            scope.done();
             debug_info("[NFI_XPN] [nfi_server_do_request] >> End");
 
             return 0;
@@ -208,7 +291,7 @@ namespace XPN
             // read response...
             debug_info("[NFI_XPN] [nfi_read_response] Read response");
 
-            ret = m_comm->read_data((void *)&(req), sizeof(req));
+            ret = comm()->read_data((void *)&(req), sizeof(req));
             if (ret < 0) {
                 m_error = ERROR_COMM;
                 return -1;
@@ -22,6 +22,9 @@
 // #define DEBUG
 #include "adaptative_compressor.hpp"
 
+#include <array>
+#include <cmath>
+
 #include "base_cpp/debug.hpp"
 #include "base_cpp/xpn_env.hpp"
 
@@ -57,7 +60,17 @@ void AdaptiveCompressorStats::add_metric_comp(uint64_t original_size, uint64_t c
     m_count++;
     m_count_comp++;
     m_times_comp++;
+    m_comp_original_size += original_size;
+}
+
+void AdaptiveCompressorStats::add_skip(uint64_t size, uint64_t check_us) {
+    m_times_skip++;
+    m_skip_size += size;
+    m_skip_check_us += check_us;
 }
+
+void AdaptiveCompressorStats::add_resume() { m_times_resume++; }
+
 std::ostream& operator<<(std::ostream& os, AdaptiveCompressorStats& stats) {
     const uint64_t count = (stats.m_count == 0 ? 1 : stats.m_count);
     const uint64_t count_comp = (stats.m_count_comp == 0 ? 1 : stats.m_count_comp);
@@ -81,6 +94,10 @@ std::ostream& operator<<(std::ostream& os, AdaptiveCompressorStats& stats) {
         DIV_0((static_cast<double>(stats.m_original_size) * perc_no_comp * factor), stats.m_total_us);
     const double mbps_total_comp =
         DIV_0((static_cast<double>(stats.m_original_size) * perc_comp * factor), stats.m_total_comp_us);
+    // Compression time not spent in the skipped blocks, at the measured compression speed
+    const double skip_saved_us = DIV_0(static_cast<double>(stats.m_skip_size) * stats.m_comp_us,
+                                       static_cast<double>(stats.m_comp_original_size)) -
+                                 stats.m_skip_check_us;
 
     os << (stats.m_type == AdaptiveCompressor::type_t::Read ? "Read" : "Write");
     os << " times " << total_times << " comp " << stats.m_times_comp << " (" << static_cast<uint32_t>(perc_comp * 100.0)
@@ -95,6 +112,9 @@ std::ostream& operator<<(std::ostream& os, AdaptiveCompressorStats& stats) {
     os << " comp_us " << comp_us << " (" << stats.m_comp_us << ")";
     os << " decomp_us " << decomp_us << " (" << stats.m_decomp_us << ")";
     os << " ratio " << ratio;
+    os << " skip " << stats.m_times_skip << " (" << stats.m_skip_size << ") check_us " << stats.m_skip_check_us
+       << " saved_us " << static_cast<int64_t>(skip_saved_us);
+    os << " resume " << stats.m_times_resume;
     return os;
 }
 
@@ -138,7 +158,7 @@ bool AdaptiveCompressor::should_compress(uint64_t size) {
     }
 
     const double t_original = get_t_no_comp(size);
-    const double t_teoric = get_t_comp(size);
+    const double t_teoric = get_t_comp(size, m_avg_comp_ratio);
 
     const bool old_state = m_is_compressing_active;
     enum class want_change_t {
@@ -219,6 +239,66 @@ bool AdaptiveCompressor::should_compress(uint64_t size) {
     return m_is_compressing_active;
 }
 
+bool AdaptiveCompressor::should_compress(uint64_t size, const char *data) {
+    if (should_compress(size)) return true;
+    if (!precheck_enabled() || size < ignore_compress_size) return false;
+
+    const double ratio = estimate_ratio(data, size);
+    if (ratio >= skip_ratio || get_t_comp(size, ratio) >= get_t_no_comp(size)) return false;
+
+    debug_info(m_debug_name << " Resume compression with sampled ratio " << ratio << " average ratio "
+                            << m_avg_comp_ratio);
+    get_stats().add_resume();
+    return true;
+}
+
+double AdaptiveCompressor::estimate_ratio(const char *data, uint64_t size) {
+    if (size == 0) return 1.0;
+    const auto *bytes = reinterpret_cast<const uint8_t *>(data);
+
+    // Byte histogram of slices spread along the block
+    std::array<uint32_t, 256> histogram{};
+    uint64_t sampled;
+    if (size <= sample_slices * sample_slice_size) {
+        for (uint64_t i = 0; i < size; i++) histogram[bytes[i]]++;
+        sampled = size;
+    } else {
+        const uint64_t stride = (size - sample_slice_size) / (sample_slices - 1);
+        for (uint64_t s = 0; s < sample_slices; s++) {
+            const uint8_t *slice = bytes + s * stride;
+            for (uint64_t i = 0; i < sample_slice_size; i++) histogram[slice[i]]++;
+        }
+        sampled = sample_slices * sample_slice_size;
+    }
+    double entropy = 0.0;
+    for (auto count : histogram) {
+        if (count == 0) continue;
+        const double p = static_cast<double>(count) / sampled;
+        entropy -= p * std::log2(p);
+    }
+    // Random or already compressed data
+    if (entropy >= skip_entropy) return 1.0;
+
+    // LZ4 only finds repetitions so a low entropy is not enough, try a slice from the middle of the block
+    char trial_data[LZ4_COMPRESSBOUND(trial_size)];
+    const uint64_t trial_len = std::min(size, trial_size);
+    const int compressed =
+        LZ4_compress_fast(data + (size - trial_len) / 2, trial_data, trial_len, sizeof(trial_data), 10);
+    if (compressed <= 0) return 1.0;
+    return static_cast<double>(compressed) / trial_len;
+}
+
+void AdaptiveCompressor::update_skip(uint64_t size, std::chrono::microseconds check_duration) {
+    get_stats().add_skip(size, check_duration.count());
+}
+
+AdaptiveCompressorStats &AdaptiveCompressor::get_stats() {
+    if (m_type == type_t::Read) {
+        return AdaptiveCompressorStats::get_instance_read();
+    }
+    return AdaptiveCompressorStats::get_instance_write();
+}
+
 double AdaptiveCompressor::get_t_no_comp(uint64_t size) {
     // Convert to Mb
     const double size_mb = (size / (1024.0 * 1024.0));
@@ -270,7 +350,7 @@ double AdaptiveCompressor::get_t_no_comp(uint64_t size) {
     return t_original;
 }
 
-double AdaptiveCompressor::get_t_comp(uint64_t size) {
+double AdaptiveCompressor::get_t_comp(uint64_t size, double ratio) {
     // Convert to Mb
     const double size_mb = (size / (1024.0 * 1024.0));
 
@@ -296,7 +376,7 @@ double AdaptiveCompressor::get_t_comp(uint64_t size) {
     //            mbps_avg_comp   mbps_avg_net   mbps_avg_rw   mbps_avg_decomp
     const double t_rw_measure = DIV_0(size_mb, m_mbps_avg_rw);
     const double t_comp_measure = DIV_0(size_mb, m_mbps_avg_comp);
-    const double t_net_ratio_measure = DIV_0((size_mb * m_avg_comp_ratio), aprox_net);
+    const double t_net_ratio_measure = DIV_0((size_mb * ratio), aprox_net);
     const double t_decomp_measure = DIV_0(size_mb, m_mbps_avg_decomp);
     const double t_teoric = t_comp_measure + t_net_ratio_measure + t_rw_measure + t_decomp_measure;
 
@@ -451,12 +531,7 @@ void AdaptiveCompressor::update_metrics_internal(update_type_t type, uint64_t or
         decomp_mbps = original_size_mb / (decomp_duration.count() / 1e6);
         apply_metric(m_mbps_avg_decomp, decomp_mbps, m_alpha);
     }
-    AdaptiveCompressorStats* instance;
-    if (m_type == type_t::Read) {
-        instance = &AdaptiveCompressorStats::get_instance_read();
-    } else {
-        instance = &AdaptiveCompressorStats::get_instance_write();
-    }
+    AdaptiveCompressorStats* instance = &get_stats();
     if (type == update_type_t::NO_COMP) {
         instance->add_metric(original_size, current_total_duration.count(), net_duration.count(), rw_duration.count());
     } else {
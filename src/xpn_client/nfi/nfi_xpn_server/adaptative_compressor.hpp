@@ -35,6 +35,8 @@
 
 namespace XPN {
 
+class AdaptiveCompressorStats;
+
 class AdaptiveCompressor {
    public:
     enum class type_t { Read, Write };
@@ -75,11 +77,30 @@ class AdaptiveCompressor {
     const uint64_t m_exploration_interval = 100;
     const uint64_t ignore_compress_size = 16 * 1024;  // 16 KB
 
+    // Per block pre-check
+    static constexpr uint64_t sample_slices = 8;  // Slices of the byte histogram along the block
+    static constexpr uint64_t sample_slice_size = 512;
+    static constexpr uint64_t trial_size = 4 * 1024;  // Slice compressed as a trial
+    static constexpr double skip_entropy = 7.5;       // Bits per byte of random or compressed data
+    static constexpr double skip_ratio = 0.95;
+
    public:
     AdaptiveCompressor(type_t type, const std::string debug_name, uint32_t num_servers)
         : m_type(type), m_debug_name(debug_name), m_num_servers(num_servers) {}
 
     bool should_compress(uint64_t size);
+    // Like should_compress(size), but when the model says raw a sample of the data can resume the compression without
+    // waiting for the exploration, the average ratio only learns from the blocks that are compressed
+    bool should_compress(uint64_t size, const char *data);
+
+    // The pre-check of the blocks is only done in the adaptive mode, the others are forced
+    static bool precheck_enabled() { return xpn_env::get_instance().xpn_net_compression == 1; }
+    // Estimated compressed/original ratio of a block from the entropy of a sample and a trial compression of a slice
+    static double estimate_ratio(const char *data, uint64_t size);
+    // Cheap per block decision, false for the blocks that are not worth compressing
+    static bool is_compressible(const char *data, uint64_t size) { return estimate_ratio(data, size) < skip_ratio; }
+    // A block sent raw because of the pre-check
+    void update_skip(uint64_t size, std::chrono::microseconds check_duration);
 
     void update_metrics(uint64_t size, uint32_t num_clients, std::chrono::microseconds total_duration,
                         std::chrono::microseconds rw_duration);
@@ -98,7 +119,8 @@ class AdaptiveCompressor {
                                  std::chrono::microseconds total_comp_duration, std::chrono::microseconds rw_duration,
                                  std::chrono::microseconds comp_duration, std::chrono::microseconds decomp_duration);
     double get_t_no_comp(uint64_t size);
-    double get_t_comp(uint64_t size);
+    double get_t_comp(uint64_t size, double ratio);
+    AdaptiveCompressorStats &get_stats();
 };
 
 class AdaptiveCompressorStats {
@@ -116,6 +138,11 @@ class AdaptiveCompressorStats {
     uint64_t m_ratio_x_1000;
     uint64_t m_count;
     uint64_t m_count_comp;
+    uint64_t m_comp_original_size;
+    uint64_t m_times_skip;
+    uint64_t m_skip_size;
+    uint64_t m_skip_check_us;
+    uint64_t m_times_resume;
 
    public:
     AdaptiveCompressorStats(AdaptiveCompressor::type_t type) : m_type(type) {}
@@ -124,6 +151,8 @@ class AdaptiveCompressorStats {
     void add_metric(uint64_t original_size, uint64_t total_us, uint64_t net_us, uint64_t rw_us);
     void add_metric_comp(uint64_t original_size, uint64_t compressed_size, uint64_t total_us, uint64_t net_us,
                          uint64_t rw_us, uint64_t comp_us, uint64_t decomp_us, uint64_t ratio_x_1000);
+    void add_skip(uint64_t size, uint64_t check_us);
+    void add_resume();
     friend std::ostream& operator<<(std::ostream& os, AdaptiveCompressorStats& stats);
 
     static AdaptiveCompressorStats& get_instance_read() {
@@ -22,14 +22,21 @@
 #include <assert.h>
 #include "nfi_xpn_server.hpp"
 #include "lz4.h"
+#include "base_cpp/filesystem.hpp"
 #include "base_cpp/timer.hpp"
+#include "base_cpp/xpn_checksum.hpp"
+#include "base_cpp/xpn_sparse.hpp"
 #include "xpn/xpn_file.hpp"
 #include "base_cpp/debug.hpp"
 #include "base_cpp/xpn_env.hpp"
+#include "base_cpp/parallel_for.hpp"
+#include "xpn/xpn_api.hpp"
 #include "xpn_server/xpn_server_ops.hpp"
 #include <fcntl.h>
+#include <array>
 #include <chrono>
 #include <mutex>
+#include <thread>
 
 #include "../nfi_sck_server/nfi_sck_server_comm.hpp"
 #include "xpn_server/xpn_server_params.hpp"
@@ -66,7 +73,8 @@ int nfi_xpn_server::nfi_open (std::string_view path, int flags, mode_t mode, xpn
 {
   int ret;
   st_xpn_server_path_flags msg{};
-  st_xpn_server_status status{};
+  st_xpn_server_open_req req{};
+  st_xpn_server_status &status = req.status;
 
   debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open] >> Begin");
 
@@ -75,10 +83,13 @@ int nfi_xpn_server::nfi_open (std::string_view path, int flags, mode_t mode, xpn
   msg.flags = flags;
   msg.mode = mode;
   msg.xpn_session = xpn_env::get_instance().xpn_session_file;
+  // With session the fd already references the file, mqtt is connectionless
+  msg.want_handle = msg.xpn_session == 0 && xpn_env::get_instance().xpn_handles != 0 &&
+                    m_protocol_type != protocol_t::mqtt ? 1 : 0;
 
   debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open] nfi_xpn_server_open("<<msg.path.path<<", "<<flags<<", "<<mode<<")");
   
-  ret = nfi_do_request(xpn_server_ops::OPEN_FILE, msg, status);
+  ret = nfi_do_request(xpn_server_ops::OPEN_FILE, msg, req);
   if (status.ret < 0 || ret < 0){ 
     errno = status.server_errno;
     debug_error("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open] ERROR: remote open fails to open '"<<msg.path.path<<"'");
@@ -86,9 +97,15 @@ int nfi_xpn_server::nfi_open (std::string_view path, int flags, mode_t mode, xpn
   }
 
   debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open] nfi_xpn_server_open("<<msg.path.path<<")="<<status.ret);
+
+  // Like close-to-open, the first direct access after the open renews the lease
+  m_short_circuit.expire(msg.path.path);
   
   fho.type = xpn_fh::type_t::File;
   fho.as.file.fd = status.ret;
+  fho.as.file.handle_id = req.handle.id;
+  fho.as.file.handle_epoch = req.handle.epoch;
+  fho.as.file.handle_generation = req.handle.generation;
 
   debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open] >> End");
 
@@ -104,13 +121,18 @@ int nfi_xpn_server::nfi_create (std::string_view path, mode_t mode, xpn_fh &fho)
 int nfi_xpn_server::nfi_close (std::string_view path, const xpn_fh &fh)
 {
   bool is_mqtt = false;
-  if (m_comm->m_type == server_type::SCK) {
+  if (m_comm && m_comm->m_type == server_type::SCK) {
       auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm.get());
       if (sck_comm->m_mqtt) {
         is_mqtt = true;
       }
   }
-  if (xpn_env::get_instance().xpn_session_file == 1 || is_mqtt){
+  xpn_server_handle handle = nfi_handle(fh);
+  if (fh.as.file.handle_generation != 0) {
+    std::unique_lock lock(m_stale_mutex);
+    m_stale_handles.erase(fh.as.file.handle_generation);
+  }
+  if (xpn_env::get_instance().xpn_session_file == 1 || is_mqtt || handle.valid()){
     st_xpn_server_close msg{};
     st_xpn_server_status status{};
 
@@ -120,6 +142,7 @@ int nfi_xpn_server::nfi_close (std::string_view path, const xpn_fh &fh)
 
     msg.fd = fh.as.file.fd;
     msg.xpn_session = xpn_env::get_instance().xpn_session_file;
+    msg.handle = handle;
     // Only pass the path in mqtt
     if (is_mqtt) {
       uint32_t length = concatenate_path(msg.path.path, m_path, path);
@@ -147,31 +170,97 @@ int nfi_xpn_server::nfi_close (std::string_view path, const xpn_fh &fh)
 int64_t nfi_xpn_server::nfi_read_v1(const xpn_file &file, const xpn_fh &fh, char *buffer, int64_t offset, uint64_t size)
 {
     if (size == 0) return 0;
+    uint32_t dict_id = nfi_register_dict(file.m_part.m_dictionary.get());
   
-    std::optional<std::unique_lock<std::mutex>> lock = std::nullopt;
-    if (!xpn_env::get_instance().xpn_connect && m_comm == nullptr) {
-        m_comm = m_control_comm_connectionless->connect(m_server, m_connectionless_port);
-    } else if (m_comm->m_type == server_type::SCK) {
-        auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm.get());
-        lock = std::unique_lock<std::mutex>(sck_comm->m_mutex);
-        debug_info("lock sck comm mutex");
+    comm_scope scope(*this, true);
+    if (!scope) {
+        m_error = ERROR_COMM;
+        return -1;
     }
 
     char xpn_compression = xpn_env::get_instance().xpn_net_compression;
     uint64_t remaining = size;
     int64_t current_offset = offset;
     int64_t total_read = 0;
-    bool must_compress = m_read_compressor.should_compress(size);
+    bool net_dict = use_dict(dict_id, size);
+    bool must_compress = net_dict || m_read_compressor.should_compress(size);
+
+    // The compressed chunks are received by windows and decompressed in parallel with the idle workers. A full
+    // window is decompressed in the background while the chunks of the next one are received.
+    const uint64_t max_chunk = nfi_chunk_size();
+    const uint64_t comp_bound = LZ4_COMPRESSBOUND(max_chunk);
+    struct compressed_chunk {
+        char *dst;
+        st_xpn_server_rw_req req;
+        std::chrono::microseconds net_time;
+        std::chrono::microseconds decomp_time;
+        int result;
+        bool corrupted;
+    };
+    struct decompress_window {
+        std::array<compressed_chunk, COMPRESS_WINDOW> chunks;
+        std::unique_ptr<char[]> data;
+        uint64_t count = 0;
+        background_task task;
+    };
+    auto decompress_chunks = [&](decompress_window &win) {
+        parallel_for(xpn_api::get_instance().m_worker.get(), win.count, [&](size_t i) {
+            auto &chunk = win.chunks[i];
+            auto decom_t1 = std::chrono::high_resolution_clock::now();
+            if (chunk.req.dict_id != 0) {
+                auto dict = xpn_dictionary::get(chunk.req.dict_id);
+                chunk.result = dict ? dict->decompress(win.data.get() + i * comp_bound, chunk.dst,
+                                                       chunk.req.compressed_size, chunk.req.uncompressed_size)
+                                    : -1;
+            } else {
+                chunk.result = xpn_codec::decompress(file.m_part.m_net_codec.type, win.data.get() + i * comp_bound,
+                                                     chunk.dst, chunk.req.compressed_size, chunk.req.uncompressed_size);
+            }
+            auto decom_t2 = std::chrono::high_resolution_clock::now();
+            chunk.decomp_time = std::chrono::duration_cast<std::chrono::microseconds>(decom_t2 - decom_t1);
+            chunk.corrupted = chunk.result >= 0 && chunk.req.checksum != 0 &&
+                              xpn_checksum(chunk.dst, chunk.result) != chunk.req.checksum;
+        });
+    };
+    // Wait the decompression of a window and check its chunks, the window can be filled again after it
+    auto finish_window = [&](decompress_window &win) {
+        win.task.wait();
+        uint64_t count = win.count;
+        win.count = 0;
+        for (uint64_t i = 0; i < count; i++) {
+            auto &chunk = win.chunks[i];
+            if (chunk.corrupted) {
+                errno = EIO;
+                debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: checksum mismatch");
+                return false;
+            }
+            if (chunk.result < 0) {
+                debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: decompress fails");
+                return false;
+            }
+            if (xpn_compression != 0) {
+                m_read_compressor.update_metrics_comp(
+                    chunk.req.uncompressed_size, chunk.req.compressed_size, chunk.req.num_clients, chunk.net_time,
+                    std::chrono::microseconds(chunk.req.rw_time_us), std::chrono::microseconds(chunk.req.compress_time_us),
+                    chunk.decomp_time);
+            }
+        }
+        return true;
+    };
+    // Declared after what the background decompressions use, so they are waited before it is destroyed
+    std::array<decompress_window, PIPELINE_WINDOWS> windows;
+    uint64_t window_idx = 0;
 
     debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] >> Begin V1");
 
     do {
-        uint64_t chunk_size = must_compress ? std::min(remaining, (uint64_t)MAX_BUFFER_SIZE) : remaining;
+        uint64_t chunk_size = must_compress ? std::min(remaining, max_chunk) : remaining;
         st_xpn_server_rw msg{};
         st_xpn_server_rw_req req{};
         
-        uint32_t length = concatenate_path(msg.path.path, m_path, file.m_path);
-        msg.path.size = length;
+        // The requests by handle go without the path
+        msg.handle = nfi_handle(fh);
+        msg.path.size = msg.handle.valid() ? 0 : concatenate_path(msg.path.path, m_path, file.m_path);
         msg.offset = current_offset;
         msg.size = chunk_size;
         msg.fd = fh.as.file.fd;
@@ -180,10 +269,20 @@ int64_t nfi_xpn_server::nfi_read_v1(const xpn_file &file, const xpn_fh &fh, char
         msg.xpn_compression = xpn_compression;
         msg.bsize = file.m_part.m_block_size;
         msg.disk_compress = file.m_part.m_compressed;
+        msg.net_codec = file.m_part.m_net_codec;
+        msg.disk_codec = file.m_part.m_disk_codec;
+        msg.dict_id = dict_id;
+        msg.net_dict = net_dict ? 1 : 0;
+        msg.checksum = xpn_env::get_instance().xpn_checksum;
+        // The server writes the raw data in the buffer and replies only the header
+        std::shared_ptr<void> rdma_region;
+        if (!must_compress && nfi_use_rdma(chunk_size)) {
+            rdma_region = comm()->rdma_register(buffer + (size - remaining), chunk_size, msg.rdma);
+        }
 
         debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] chunk(" << msg.path.path << ", " << current_offset << ", " << chunk_size << ")");
 
-        std::chrono::time_point<std::chrono::high_resolution_clock> net_t1, net_t2, decom_t1, decom_t2;
+        std::chrono::time_point<std::chrono::high_resolution_clock> net_t1, net_t2;
         if (xpn_compression != 0) net_t1 = std::chrono::high_resolution_clock::now();
 
         if (nfi_write_operation(xpn_server_ops::READ_FILE, msg) < 0) {
@@ -191,12 +290,18 @@ int64_t nfi_xpn_server::nfi_read_v1(const xpn_file &file, const xpn_fh &fh, char
             return -1;
         }
 
-        if (m_comm->read_data(&req, sizeof(req)) < 0) {
+        if (comm()->read_data(&req, sizeof(req)) < 0) {
             m_error = ERROR_COMM;
             debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: nfi_xpn_server_comm_read_data fails");
             return -1;
         }
 
+        if (req.status.ret < 0 && rdma_region) {
+            // The chunk is asked again to be sent in messages, and so are the next ones
+            debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: one-sided read fails, continue without it");
+            m_rdma_enabled = false;
+            continue;
+        }
         if (req.status.ret < 0) {
             errno = req.status.server_errno;
             debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: req.status.ret " << req.status.ret << " fails " << strerror(errno));
@@ -205,37 +310,55 @@ int64_t nfi_xpn_server::nfi_read_v1(const xpn_file &file, const xpn_fh &fh, char
 
         if (req.size > 0) {
             if (req.compressed_size > 0) {
-                char compressed_data[LZ4_COMPRESSBOUND(MAX_BUFFER_SIZE)];
-                if (m_comm->read_data(compressed_data, req.compressed_size) < 0) {
+                auto &win = windows[window_idx % PIPELINE_WINDOWS];
+                if (!win.data) {
+                    uint64_t chunks = (size + max_chunk - 1) / max_chunk;
+                    win.data = std::make_unique_for_overwrite<char[]>(std::min(chunks, COMPRESS_WINDOW) * comp_bound);
+                }
+                if (comm()->read_data(win.data.get() + win.count * comp_bound, req.compressed_size) < 0) {
                   m_error = ERROR_COMM;
                   return -1;
                 }
-                
-                if (xpn_compression != 0) decom_t1 = std::chrono::high_resolution_clock::now();
-                
-                int decomp_ret = LZ4_decompress_safe(compressed_data, buffer + (size - remaining), req.compressed_size, req.uncompressed_size);
-                
-                if (xpn_compression != 0) decom_t2 = std::chrono::high_resolution_clock::now();
                 if (xpn_compression != 0) net_t2 = std::chrono::high_resolution_clock::now();
 
-                if (decomp_ret < 0) {
-                    debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: LZ4_decompress_safe fails");
-                    return -1;
+                auto &chunk = win.chunks[win.count++];
+                chunk.dst = buffer + (size - remaining);
+                chunk.req = req;
+                chunk.net_time = std::chrono::duration_cast<std::chrono::microseconds>(net_t2 - net_t1);
+                if (win.count == COMPRESS_WINDOW) {
+                    win.task.start(xpn_api::get_instance().m_worker.get(), [&decompress_chunks, &win]() { decompress_chunks(win); });
+                    window_idx++;
+                    if (!finish_window(windows[window_idx % PIPELINE_WINDOWS])) {
+                        return -1;
+                    }
                 }
-
+            } else if (req.stream_chunk > 0) {
+                req.size = nfi_read_stream(buffer + (size - remaining), chunk_size, req.stream_chunk);
+                if (req.size < 0) {
+                  return -1;
+                }
+                if (xpn_compression != 0) net_t2 = std::chrono::high_resolution_clock::now();
                 if (xpn_compression != 0) {
-                    m_read_compressor.update_metrics_comp(
-                        req.uncompressed_size, req.compressed_size, req.num_clients,
+                    m_read_compressor.update_metrics(
+                        req.size, req.num_clients,
                         std::chrono::duration_cast<std::chrono::microseconds>(net_t2 - net_t1),
-                        std::chrono::microseconds(req.rw_time_us), std::chrono::microseconds(req.compress_time_us),
-                        std::chrono::duration_cast<std::chrono::microseconds>(decom_t2 - decom_t1));
+                        std::chrono::microseconds(req.rw_time_us));
                 }
             } else {
-                if (m_comm->read_data(buffer + (size - remaining), req.size) < 0) {
+                if (!rdma_region && comm()->read_data(buffer + (size - remaining), req.size) < 0) {
                   m_error = ERROR_COMM;
                   return -1;
                 }
+                if (req.checksum != 0 && xpn_checksum(buffer + (size - remaining), req.size) != req.checksum) {
+                  errno = EIO;
+                  debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: checksum mismatch");
+                  return -1;
+                }
                 if (xpn_compression != 0) net_t2 = std::chrono::high_resolution_clock::now();
+                // Asked compressed but the server pre-check sent it raw
+                if (must_compress) {
+                    m_read_compressor.update_skip(req.size, std::chrono::microseconds(req.compress_time_us));
+                }
                 if (xpn_compression != 0) {
                     m_read_compressor.update_metrics(
                         req.size, req.num_clients,
@@ -251,25 +374,108 @@ int64_t nfi_xpn_server::nfi_read_v1(const xpn_file &file, const xpn_fh &fh, char
 
     } while (remaining > 0);
 
-    if (!xpn_env::get_instance().xpn_connect) {
-        m_control_comm_connectionless->disconnect(m_comm);
-        m_comm = nullptr;
+    // The last window is not full, it is decompressed after the one that is still in the background
+    decompress_chunks(windows[window_idx % PIPELINE_WINDOWS]);
+    for (uint64_t i = 1; i <= PIPELINE_WINDOWS; i++) {
+        if (!finish_window(windows[(window_idx + i) % PIPELINE_WINDOWS])) {
+            return -1;
+        }
     }
 
+    scope.done();
+
     return total_read;
 }
 
+bool nfi_xpn_server::nfi_use_rw_v2() const
+{
+    if (xpn_env::get_instance().xpn_rw_v2 == 0) return false;
+    // The messages of V2 have not the checksums of the data
+    if (xpn_env::get_instance().xpn_checksum != 0) return false;
+    return m_protocol_type == nfi_server::protocol_t::fabric || m_protocol_type == nfi_server::protocol_t::sck ||
+           m_protocol_type == nfi_server::protocol_t::mpi;
+}
+
+int64_t nfi_xpn_server::nfi_read_stream(char *buffer, uint64_t size, uint64_t chunk_size)
+{
+    uint64_t received = 0;
+    while (received < size) {
+        int64_t len;
+        if (comm()->read_data(&len, sizeof(len)) < 0) {
+            m_error = ERROR_COMM;
+            return -1;
+        }
+        if (len < 0) {
+            errno = -len;
+            debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_read_stream] ERROR: server read fails " << strerror(errno));
+            return -1;
+        }
+        uint64_t expected = std::min(chunk_size, size - received);
+        if ((uint64_t)len > expected) {
+            m_error = ERROR_COMM;
+            debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_read_stream] ERROR: chunk of " << len << " bytes, more than " << expected);
+            return -1;
+        }
+        if (len > 0 && comm()->read_data(buffer + received, len) < 0) {
+            m_error = ERROR_COMM;
+            return -1;
+        }
+        received += len;
+        if ((uint64_t)len < expected) break;
+    }
+    return received;
+}
+
+uint64_t nfi_xpn_server::nfi_chunk_size() const
+{
+    int64_t chunk_size;
+    switch (m_protocol_type) {
+        case nfi_server::protocol_t::mpi:    chunk_size = xpn_env::get_instance().xpn_mpi_chunk_size; break;
+        case nfi_server::protocol_t::fabric: chunk_size = xpn_env::get_instance().xpn_fabric_chunk_size; break;
+        default:                             chunk_size = xpn_env::get_instance().xpn_sck_chunk_size; break;
+    }
+    return std::clamp<int64_t>(chunk_size, MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
+}
+
+bool nfi_xpn_server::nfi_use_rdma(uint64_t size) const
+{
+    auto min_size = xpn_env::get_instance().xpn_rdma_min_size;
+    return m_protocol_type == nfi_server::protocol_t::fabric && m_rdma_enabled && min_size > 0 &&
+           size >= static_cast<uint64_t>(min_size);
+}
+
+int64_t nfi_xpn_server::nfi_read_reply_v2(st_xpn_server_read_v2_req &req, char *data, uint64_t size, bool compressed)
+{
+    // The message transports receive the reply and its data at once, the shorter replies fill less
+    if (comm()->m_type != server_type::SCK) {
+        struct iovec iovs[2] = {
+            {.iov_base = &req, .iov_len = sizeof(req)},
+            {.iov_base = data, .iov_len = size}
+        };
+        return comm()->readv_data(iovs, 2);
+    }
+
+    // In a stream only the bytes that the server says can be read, nothing follows an error
+    if (comm()->read_data(&req, sizeof(req)) < 0) return -1;
+    if (req.status.ret < 0 || req.size < 0) return sizeof(req);
+    uint64_t data_size = compressed ? req.compressed_size : req.size;
+    if (data_size > size) {
+        debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: reply of " << data_size << " for a buffer of " << size);
+        return -1;
+    }
+    if (comm()->read_data(data, data_size) < 0) return -1;
+    return sizeof(req) + data_size;
+}
+
 int64_t nfi_xpn_server::nfi_read_v2(const xpn_file& file, const xpn_fh &fh, char *buffer, int64_t offset, uint64_t size)
 {
     if (size == 0) return 0;
+    uint32_t dict_id = nfi_register_dict(file.m_part.m_dictionary.get());
   
-    std::optional<std::unique_lock<std::mutex>> lock = std::nullopt;
-    if (!xpn_env::get_instance().xpn_connect && m_comm == nullptr) {
-        m_comm = m_control_comm_connectionless->connect(m_server, m_connectionless_port);
-    } else if (m_comm->m_type == server_type::SCK) {
-        auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm.get());
-        lock = std::unique_lock<std::mutex>(sck_comm->m_mutex);
-        debug_info("lock sck comm mutex");
+    comm_scope scope(*this, true);
+    if (!scope) {
+        m_error = ERROR_COMM;
+        return -1;
     }
 
     char xpn_compression = xpn_env::get_instance().xpn_net_compression;
@@ -285,8 +491,9 @@ int64_t nfi_xpn_server::nfi_read_v2(const xpn_file& file, const xpn_fh &fh, char
         st_xpn_server_read_v2 msg{};
         st_xpn_server_read_v2_req req{};
 
-        uint32_t length = concatenate_path(msg.path.path, m_path, file.m_path);
-        msg.path.size = length;
+        // The requests by handle go without the path
+        msg.handle = nfi_handle(fh);
+        msg.path.size = msg.handle.valid() ? 0 : concatenate_path(msg.path.path, m_path, file.m_path);
         msg.offset = current_offset;
         msg.size = chunk_size;
         msg.fd = fh.as.file.fd;
@@ -295,6 +502,9 @@ int64_t nfi_xpn_server::nfi_read_v2(const xpn_file& file, const xpn_fh &fh, char
         msg.xpn_compression = xpn_compression;
         msg.bsize = file.m_part.m_block_size;
         msg.disk_compress = file.m_part.m_compressed;
+        msg.net_codec = file.m_part.m_net_codec;
+        msg.disk_codec = file.m_part.m_disk_codec;
+        msg.dict_id = dict_id;
 
         std::chrono::time_point<std::chrono::high_resolution_clock> net_t1, net_t2, decom_t1, decom_t2;
         if (xpn_compression != 0) net_t1 = std::chrono::high_resolution_clock::now();
@@ -306,24 +516,20 @@ int64_t nfi_xpn_server::nfi_read_v2(const xpn_file& file, const xpn_fh &fh, char
 
         if (msg.should_compressed == 1) {
             char compressed_data[LZ4_COMPRESSBOUND(MAX_BUFFER_SIZE)];
-            struct iovec iovs[2] = {
-                {.iov_base = &req, .iov_len = sizeof(req)},
-                {.iov_base = compressed_data, .iov_len = sizeof(compressed_data)}
-            };
-            if (m_comm->readv_data(iovs, 2) < 0) {
+            if (nfi_read_reply_v2(req, compressed_data, sizeof(compressed_data), true) < 0) {
               m_error = ERROR_COMM;
               return -1;
             }
 
             if (xpn_compression != 0) decom_t1 = std::chrono::high_resolution_clock::now();
 
-            int decomp_ret = LZ4_decompress_safe(compressed_data, buffer + (size - remaining), req.compressed_size, req.uncompressed_size);
+            int decomp_ret = xpn_codec::decompress(file.m_part.m_net_codec.type, compressed_data, buffer + (size - remaining), req.compressed_size, req.uncompressed_size);
 
             if (xpn_compression != 0) decom_t2 = std::chrono::high_resolution_clock::now();
             if (xpn_compression != 0) net_t2 = std::chrono::high_resolution_clock::now();
 
             if (decomp_ret < 0) {
-                debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: LZ4_decompress_safe fails");
+                debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] ERROR: decompress fails");
                 return -1;
             }
 
@@ -335,11 +541,7 @@ int64_t nfi_xpn_server::nfi_read_v2(const xpn_file& file, const xpn_fh &fh, char
                     std::chrono::duration_cast<std::chrono::microseconds>(decom_t2 - decom_t1));
             }
         } else {
-            struct iovec iovs[2] = {
-                {.iov_base = &req, .iov_len = sizeof(req)},
-                {.iov_base = buffer + (size - remaining), .iov_len = chunk_size}
-            };
-            if (m_comm->readv_data(iovs, 2) < 0) {
+            if (nfi_read_reply_v2(req, buffer + (size - remaining), chunk_size, false) < 0) {
               m_error = ERROR_COMM;
               return -1;
             }
@@ -362,10 +564,7 @@ int64_t nfi_xpn_server::nfi_read_v2(const xpn_file& file, const xpn_fh &fh, char
 
     } while (remaining > 0);
 
-    if (!xpn_env::get_instance().xpn_connect) {
-        m_control_comm_connectionless->disconnect(m_comm);
-        m_comm = nullptr;
-    }
+    scope.done();
 
     return total_read;
 }
@@ -373,11 +572,21 @@ int64_t nfi_xpn_server::nfi_read_v2(const xpn_file& file, const xpn_fh &fh, char
 int64_t nfi_xpn_server::nfi_read(const xpn_file& file, const xpn_fh &fh, char *buffer, int64_t offset, uint64_t size)
 {
     int64_t ret;
-    if (xpn_env::get_instance().xpn_rw_v2 == 0 || m_protocol_type != nfi_server::protocol_t::fabric) {
-        ret = nfi_read_v1(file, fh, buffer, offset, size);
-    } else {
-        ret = nfi_read_v2(file, fh, buffer, offset, size);
+    if (auto local = nfi_local_file(file, false)) {
+        ret = filesystem::pread(local->fd(), buffer, size, offset);
+        debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] local read(" << local->fd() << ", " << offset << ", " << size << ")=" << ret);
+        return ret;
     }
+    bool by_path = false;
+    do {
+        ret = nfi_striped(offset, size, file.m_part.m_compressed ? file.m_part.m_block_size : STRIPE_ALIGN, [&](int64_t stripe_offset, uint64_t pos, uint64_t stripe_size) {
+            if (!nfi_use_rw_v2()) {
+                return nfi_read_v1(file, fh, buffer + pos, stripe_offset, stripe_size);
+            }
+            return nfi_read_v2(file, fh, buffer + pos, stripe_offset, stripe_size);
+        });
+        // The read is repeated once by path when the server has closed the file of the handle
+    } while (ret < 0 && errno == ESTALE && !by_path && (by_path = nfi_stale_handle(fh)));
     debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_read] >> End");
     return ret;
 }
@@ -385,47 +594,120 @@ int64_t nfi_xpn_server::nfi_read(const xpn_file& file, const xpn_fh &fh, char *b
 int64_t nfi_xpn_server::nfi_write_v1(const xpn_file &file, const xpn_fh &fh, const char *uncompressed_buffer, int64_t offset, uint64_t uncompressed_size)
 {
     if (uncompressed_size == 0) return 0;
+    uint32_t dict_id = nfi_register_dict(file.m_part.m_dictionary.get());
     
-    std::optional<std::unique_lock<std::mutex>> lock = std::nullopt;
-    if (!xpn_env::get_instance().xpn_connect && m_comm == nullptr) {
-        m_comm = m_control_comm_connectionless->connect(m_server, m_connectionless_port);
-    } else if (m_comm->m_type == server_type::SCK) {
-        auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm.get());
-        lock = std::unique_lock<std::mutex>(sck_comm->m_mutex);
-        debug_info("lock sck comm mutex");
+    comm_scope scope(*this, true);
+    if (!scope) {
+        m_error = ERROR_COMM;
+        return -1;
     }
 
     char xpn_compression = xpn_env::get_instance().xpn_net_compression;
     uint64_t remaining = uncompressed_size;
     int64_t current_offset = offset;
     int64_t total_written = 0;
-    bool must_compress = m_write_compressor.should_compress(uncompressed_size);
+    bool net_dict = use_dict(dict_id, uncompressed_size);
+    bool must_compress = net_dict || m_write_compressor.should_compress(uncompressed_size, uncompressed_buffer);
+    bool precheck = must_compress && AdaptiveCompressor::precheck_enabled();
+
+    // The chunks are compressed in parallel by windows with the idle workers, and they are sent in order. The next
+    // window is compressed in the background while the chunks of the current one are sent.
+    // The chunks that fail the pre-check, or that do not shrink with the dictionary, are sent raw.
+    const uint64_t max_chunk = nfi_chunk_size();
+    const uint64_t comp_bound = LZ4_COMPRESSBOUND(max_chunk);
+    struct compressed_chunk {
+        int size;
+        bool skipped;
+        uint64_t checksum;
+        std::chrono::microseconds time;
+    };
+    struct compress_window {
+        std::array<compressed_chunk, COMPRESS_WINDOW> chunks;
+        std::unique_ptr<char[]> data;
+        uint64_t count = 0;
+        background_task task;
+    };
+    const bool checksum = xpn_env::get_instance().xpn_checksum != 0;
+    auto compress_chunks = [&](compress_window &win, uint64_t first) {
+        parallel_for(xpn_api::get_instance().m_worker.get(), win.count, [&](size_t i) {
+            const char *src = uncompressed_buffer + first + i * max_chunk;
+            uint64_t src_size = std::min(uncompressed_size - first - i * max_chunk, max_chunk);
+            auto &chunk = win.chunks[i];
+            auto com_t1 = std::chrono::high_resolution_clock::now();
+            chunk.skipped = precheck && !AdaptiveCompressor::is_compressible(src, src_size);
+            if (chunk.skipped) {
+                chunk.size = 0;
+            } else if (net_dict) {
+                chunk.size = file.m_part.m_dictionary->compress(file.m_part.m_net_codec, src,
+                                                                win.data.get() + i * comp_bound, src_size, comp_bound);
+                chunk.skipped = chunk.size <= 0 || (uint64_t)chunk.size >= src_size;
+                if (chunk.skipped) chunk.size = 0;
+            } else {
+                chunk.size = file.m_part.m_net_codec.compress(src, win.data.get() + i * comp_bound, src_size, comp_bound);
+            }
+            auto com_t2 = std::chrono::high_resolution_clock::now();
+            chunk.time = std::chrono::duration_cast<std::chrono::microseconds>(com_t2 - com_t1);
+            chunk.checksum = checksum ? xpn_checksum(src, src_size) : 0;
+        });
+    };
+    // Declared after what the background compressions use, so they are waited before it is destroyed
+    std::array<compress_window, PIPELINE_WINDOWS> windows;
+    compress_window *window = nullptr;
+    uint64_t window_pos = 0, window_count = 0, window_idx = 0;
+    // Bytes of the buffer given to the windows already compressed or in the background
+    uint64_t window_end = 0;
+    auto start_window = [&](compress_window &win) {
+        uint64_t first = window_end;
+        win.count = std::min((uncompressed_size - first + max_chunk - 1) / max_chunk, COMPRESS_WINDOW);
+        window_end = std::min(uncompressed_size, first + win.count * max_chunk);
+        if (win.count == 0) return;
+        if (!win.data) win.data = std::make_unique_for_overwrite<char[]>(win.count * comp_bound);
+        win.task.start(xpn_api::get_instance().m_worker.get(), [&compress_chunks, &win, first]() { compress_chunks(win, first); });
+    };
 
     debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] >> Begin V1");
 
     do {
-        uint64_t chunk_size = must_compress ? std::min(remaining, (uint64_t)MAX_BUFFER_SIZE) : remaining;
+        uint64_t chunk_size = must_compress ? std::min(remaining, max_chunk) : remaining;
         st_xpn_server_rw msg{};
         st_xpn_server_rw_req req{};
-        char compressed_data[LZ4_COMPRESSBOUND(MAX_BUFFER_SIZE)];
+        char *compressed_data = nullptr;
         int compressed_data_size = 0;
+        uint64_t data_checksum = 0;
+        std::chrono::microseconds com_time{0};
 
-        std::chrono::time_point<std::chrono::high_resolution_clock> com_t1, com_t2, net_t1, net_t2;
+        std::chrono::time_point<std::chrono::high_resolution_clock> net_t1, net_t2;
         if (xpn_compression != 0) net_t1 = std::chrono::high_resolution_clock::now();
 
         if (must_compress) {
-            if (xpn_compression != 0) com_t1 = std::chrono::high_resolution_clock::now();
-            compressed_data_size = LZ4_compress_fast(uncompressed_buffer + (uncompressed_size - remaining), 
-                                                   compressed_data, chunk_size, sizeof(compressed_data), 10);
-            if (compressed_data_size < 0) {
-                debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] ERROR: LZ4_compress_fast fails");
+            if (window_pos == window_count) {
+                if (window == nullptr) start_window(windows[0]);
+                window = &windows[window_idx % PIPELINE_WINDOWS];
+                window->task.wait();
+                window_count = window->count;
+                window_pos = 0;
+                window_idx++;
+                // The window sent before is free, it takes the chunks after this one
+                start_window(windows[window_idx % PIPELINE_WINDOWS]);
+            }
+            compressed_data = window->data.get() + window_pos * comp_bound;
+            compressed_data_size = window->chunks[window_pos].size;
+            data_checksum = window->chunks[window_pos].checksum;
+            com_time = window->chunks[window_pos].time;
+            if (window->chunks[window_pos].skipped) {
+                m_write_compressor.update_skip(chunk_size, com_time);
+            } else if (compressed_data_size <= 0) {
+                debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] ERROR: compress fails");
                 return -1;
             }
-            if (xpn_compression != 0) com_t2 = std::chrono::high_resolution_clock::now();
+            window_pos++;
+        } else if (checksum) {
+            data_checksum = xpn_checksum(uncompressed_buffer + (uncompressed_size - remaining), chunk_size);
         }
 
-        uint32_t length = concatenate_path(msg.path.path, m_path, file.m_path);
-        msg.path.size = length;
+        // The requests by handle go without the path
+        msg.handle = nfi_handle(fh);
+        msg.path.size = msg.handle.valid() ? 0 : concatenate_path(msg.path.path, m_path, file.m_path);
         msg.offset = current_offset;
         msg.size = chunk_size;
         msg.uncompressed_size = chunk_size;
@@ -435,24 +717,33 @@ int64_t nfi_xpn_server::nfi_write_v1(const xpn_file &file, const xpn_fh &fh, con
         msg.xpn_compression = xpn_compression;
         msg.bsize = file.m_part.m_block_size;
         msg.disk_compress = file.m_part.m_compressed;
+        msg.net_codec = file.m_part.m_net_codec;
+        msg.disk_codec = file.m_part.m_disk_codec;
+        msg.dict_id = dict_id;
+        msg.net_dict = net_dict && compressed_data_size > 0 ? 1 : 0;
+        msg.checksum = xpn_env::get_instance().xpn_checksum;
+        msg.data_checksum = data_checksum;
 
         debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] chunk(" 
                    << msg.path.path << ", " << current_offset << ", " << chunk_size << ")");
 
 
-        if (nfi_write_operation(xpn_server_ops::WRITE_FILE, msg) < 0) {
-            debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] ERROR: nfi_write_operation fails");
-            return -1;
+        // The server reads the raw payload from the buffer, only the operation is sent
+        std::shared_ptr<void> rdma_region;
+        if (compressed_data_size == 0 && nfi_use_rdma(chunk_size)) {
+            rdma_region = comm()->rdma_register(uncompressed_buffer + (uncompressed_size - remaining), chunk_size, msg.rdma);
         }
 
         int ret_write;
         if (compressed_data_size > 0) {
-            ret_write = m_comm->write_data(compressed_data, compressed_data_size);
+            ret_write = nfi_write_operation_data(xpn_server_ops::WRITE_FILE, msg, compressed_data, compressed_data_size);
+        } else if (rdma_region) {
+            ret_write = nfi_write_operation(xpn_server_ops::WRITE_FILE, msg);
         } else {
-            ret_write = m_comm->write_data(uncompressed_buffer + (uncompressed_size - remaining), chunk_size);
+            ret_write = nfi_write_operation_data(xpn_server_ops::WRITE_FILE, msg, uncompressed_buffer + (uncompressed_size - remaining), chunk_size);
         }
 
-        if (ret_write < 0 || m_comm->read_data(&req, sizeof(req)) < 0) {
+        if (ret_write < 0 || comm()->read_data(&req, sizeof(req)) < 0) {
             m_error = ERROR_COMM;
             debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] ERROR: comm error");
             return -1;
@@ -464,8 +755,7 @@ int64_t nfi_xpn_server::nfi_write_v1(const xpn_file &file, const xpn_fh &fh, con
                 m_write_compressor.update_metrics_comp(
                     chunk_size, compressed_data_size, req.num_clients,
                     std::chrono::duration_cast<std::chrono::microseconds>(net_t2 - net_t1),
-                    std::chrono::microseconds(req.rw_time_us),
-                    std::chrono::duration_cast<std::chrono::microseconds>(com_t2 - com_t1),
+                    std::chrono::microseconds(req.rw_time_us), com_time,
                     std::chrono::microseconds(req.compress_time_us));
             } else {
                 m_write_compressor.update_metrics(
@@ -474,6 +764,13 @@ int64_t nfi_xpn_server::nfi_write_v1(const xpn_file &file, const xpn_fh &fh, con
             }
         }
 
+        if (req.size < 0 && rdma_region) {
+            // The chunk is sent again in messages, and so are the next ones
+            debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] ERROR: one-sided write fails, continue without it");
+            m_rdma_enabled = false;
+            if (must_compress) window_pos--;
+            continue;
+        }
         if (req.size < 0) {
             debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] ERROR: server returned error size");
             if (req.status.ret < 0) errno = req.status.server_errno;
@@ -486,10 +783,7 @@ int64_t nfi_xpn_server::nfi_write_v1(const xpn_file &file, const xpn_fh &fh, con
 
     } while (remaining > 0);
 
-    if (!xpn_env::get_instance().xpn_connect) {
-        m_control_comm_connectionless->disconnect(m_comm);
-        m_comm = nullptr;
-    }
+    scope.done();
 
     return total_written;
 }
@@ -497,26 +791,26 @@ int64_t nfi_xpn_server::nfi_write_v1(const xpn_file &file, const xpn_fh &fh, con
 int64_t nfi_xpn_server::nfi_write_v2(const xpn_file &file, const xpn_fh &fh, const char *uncompressed_buffer, int64_t offset, uint64_t uncompressed_size)
 {
     if (uncompressed_size == 0) return 0;
+    uint32_t dict_id = nfi_register_dict(file.m_part.m_dictionary.get());
     
-    std::optional<std::unique_lock<std::mutex>> lock = std::nullopt;
-    if (!xpn_env::get_instance().xpn_connect && m_comm == nullptr) {
-        m_comm = m_control_comm_connectionless->connect(m_server, m_connectionless_port);
-    } else if (m_comm->m_type == server_type::SCK) {
-        auto sck_comm = static_cast<nfi_sck_server_comm*>(m_comm.get());
-        lock = std::unique_lock<std::mutex>(sck_comm->m_mutex);
-        debug_info("lock sck comm mutex");
+    comm_scope scope(*this, true);
+    if (!scope) {
+        m_error = ERROR_COMM;
+        return -1;
     }
 
     char xpn_compression = xpn_env::get_instance().xpn_net_compression;
     uint64_t remaining = uncompressed_size;
     int64_t current_offset = offset;
     int64_t total_written = 0;
-    bool must_compress = m_write_compressor.should_compress(uncompressed_size);
+    bool must_compress = m_write_compressor.should_compress(uncompressed_size, uncompressed_buffer);
+    bool precheck = must_compress && AdaptiveCompressor::precheck_enabled();
 
     debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] >> Begin V2");
 
     do {
-        uint64_t chunk_size = must_compress ? std::min(remaining, (uint64_t)MAX_BUFFER_SIZE) : remaining;
+        // The payload travels inside the message, it has room for a chunk
+        uint64_t chunk_size = std::min(remaining, (uint64_t)MAX_BUFFER_SIZE);
         
         xpn_server_msg message;
         st_xpn_server_write_v2 *msg = reinterpret_cast<st_xpn_server_write_v2*>(message.msg_buffer);
@@ -529,14 +823,20 @@ int64_t nfi_xpn_server::nfi_write_v2(const xpn_file &file, const xpn_fh &fh, con
 
         if (must_compress) {
             if (xpn_compression != 0) com_t1 = std::chrono::high_resolution_clock::now();
-            compressed_data_size = LZ4_compress_fast(uncompressed_buffer + (uncompressed_size - remaining), 
-                                                    compressed_data, chunk_size, sizeof(compressed_data), 10);
-            if (compressed_data_size < 0) return -1;
+            const char *src = uncompressed_buffer + (uncompressed_size - remaining);
+            if (precheck && !AdaptiveCompressor::is_compressible(src, chunk_size)) {
+                m_write_compressor.update_skip(
+                    chunk_size, std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::high_resolution_clock::now() - com_t1));
+            } else {
+                compressed_data_size = file.m_part.m_net_codec.compress(src, compressed_data, chunk_size, sizeof(compressed_data));
+                if (compressed_data_size < 0) return -1;
+            }
             if (xpn_compression != 0) com_t2 = std::chrono::high_resolution_clock::now();
         }
 
-        uint32_t length = concatenate_path(msg->buff.path(), m_path, file.m_path);
-        msg->buff.size_path = length;
+        msg->handle = nfi_handle(fh);
+        msg->buff.size_path = msg->handle.valid() ? 0 : concatenate_path(msg->buff.path(), m_path, file.m_path);
         msg->offset = current_offset;
         msg->uncompressed_size = chunk_size;
         msg->compressed_size = compressed_data_size;
@@ -546,22 +846,26 @@ int64_t nfi_xpn_server::nfi_write_v2(const xpn_file &file, const xpn_fh &fh, con
         msg->buff.size_buff = (compressed_data_size > 0) ? compressed_data_size : chunk_size;
         msg->bsize = file.m_part.m_block_size;
         msg->disk_compress = file.m_part.m_compressed;
+        msg->net_codec = file.m_part.m_net_codec;
+        msg->disk_codec = file.m_part.m_disk_codec;
+        msg->dict_id = dict_id;
 
+        // The size of the message counts the payload, so the stream servers read it with the operation
         message.op = static_cast<int>(xpn_server_ops::WRITE_FILE_V2);
-        message.msg_size = msg->get_size_without_buff();
+        message.msg_size = msg->get_size();
         message.tag = (int)(pthread_self() % 32450) + 1;
 
         struct iovec iovs[2] = {
-            { .iov_base = &message, .iov_len = message.get_size() },
+            { .iov_base = &message, .iov_len = message.get_header_size() + msg->get_size_without_buff() },
             { .iov_base = (compressed_data_size > 0) ? (void*)compressed_data : (void*)(uncompressed_buffer + (uncompressed_size - remaining)), 
               .iov_len = (compressed_data_size > 0) ? (size_t)compressed_data_size : (size_t)chunk_size }
         };
 
-        if (m_comm->writev_data(iovs, 2, 0) < 0) {
+        if (comm()->writev_data(iovs, 2, 0) < 0) {
           m_error = ERROR_COMM;
           return -1;
         }
-        if (m_comm->read_data(&req, sizeof(req)) < 0) {
+        if (comm()->read_data(&req, sizeof(req)) < 0) {
           m_error = ERROR_COMM;
           return -1;
         }
@@ -593,28 +897,345 @@ int64_t nfi_xpn_server::nfi_write_v2(const xpn_file &file, const xpn_fh &fh, con
 
     } while (remaining > 0);
 
-    if (!xpn_env::get_instance().xpn_connect) {
-        m_control_comm_connectionless->disconnect(m_comm);
-        m_comm = nullptr;
-    }
+    scope.done();
 
     return total_written;
 }
 
-int64_t nfi_xpn_server::nfi_write(const xpn_file &file, const xpn_fh &fh, const char *uncompressed_buffer, int64_t offset, uint64_t uncompressed_size)
+int64_t nfi_xpn_server::nfi_write_zero(const xpn_file &file, const xpn_fh &fh, int64_t offset, uint64_t size)
 {
-    int64_t ret;
+    st_xpn_server_rw msg{};
+    st_xpn_server_rw_req req{};
 
-    if (xpn_env::get_instance().xpn_rw_v2 == 0 || m_protocol_type != nfi_server::protocol_t::fabric) {
-        ret = nfi_write_v1(file, fh, uncompressed_buffer, offset, uncompressed_size);
-    } else {
-        ret = nfi_write_v2(file, fh, uncompressed_buffer, offset, uncompressed_size);
+    debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write_zero] >> Begin");
+
+    msg.handle = nfi_handle(fh);
+    msg.path.size = msg.handle.valid() ? 0 : concatenate_path(msg.path.path, m_path, file.m_path);
+    msg.offset = offset;
+    msg.size = size;
+    msg.uncompressed_size = size;
+    msg.fd = fh.as.file.fd;
+    msg.xpn_session = xpn_env::get_instance().xpn_session_file;
+    msg.bsize = file.m_part.m_block_size;
+    msg.disk_compress = file.m_part.m_compressed;
+    msg.disk_codec = file.m_part.m_disk_codec;
+    // The partial blocks of the range are recompressed, with the dictionary when they are small
+    msg.dict_id = nfi_register_dict(file.m_part.m_dictionary.get());
+    msg.checksum = xpn_env::get_instance().xpn_checksum;
+
+    if (nfi_do_request(xpn_server_ops::WRITE_ZERO_FILE, msg, req) < 0) {
+        debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write_zero] ERROR: nfi_do_request fails");
+        return -1;
+    }
+    if (req.size < 0) {
+        debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write_zero] ERROR: server returned error size");
+        if (req.status.ret < 0) errno = req.status.server_errno;
+        return -1;
+    }
+
+    debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write_zero] write_zero(" << offset << ", " << size << ")=" << req.size);
+    return req.size;
+}
+
+int64_t nfi_xpn_server::nfi_write_data(const xpn_file &file, const xpn_fh &fh, const char *buffer, int64_t offset, uint64_t size)
+{
+    return nfi_striped(offset, size, file.m_part.m_compressed ? file.m_part.m_block_size : STRIPE_ALIGN, [&](int64_t stripe_offset, uint64_t pos, uint64_t stripe_size) {
+        if (!nfi_use_rw_v2()) {
+            return nfi_write_v1(file, fh, buffer + pos, stripe_offset, stripe_size);
+        }
+        return nfi_write_v2(file, fh, buffer + pos, stripe_offset, stripe_size);
+    });
+}
+
+int64_t nfi_xpn_server::nfi_striped(int64_t offset, uint64_t size, uint64_t align, const std::function<int64_t(int64_t, uint64_t, uint64_t)> &transfer)
+{
+    init_comm_once();
+    align = std::max(align, STRIPE_ALIGN);
+    uint64_t stripe_size = std::max<uint64_t>(xpn_env::get_instance().xpn_stripe_size, align);
+    uint64_t stripes = std::min<uint64_t>(m_num_connections, size / stripe_size);
+    // The adaptive compression learns from the requests one after another, the compressed transfers are already
+    // (de)compressed in parallel by windows
+    if (stripes <= 1 || !m_stripe_workers || xpn_env::get_instance().xpn_net_compression != 0) {
+        return transfer(offset, 0, size);
+    }
+
+    // The stripes end in aligned offsets after the header of the file, so the blocks of the compressed files are not
+    // split
+    const int64_t base = offset >= xpn_metadata::HEADER_SIZE ? xpn_metadata::HEADER_SIZE : 0;
+    std::vector<uint64_t> ends;
+    ends.reserve(stripes);
+    for (uint64_t i = 1; i < stripes; i++) {
+        uint64_t end = (offset - base + i * (size / stripes)) / align * align + base - offset;
+        if (end > (ends.empty() ? 0 : ends.back()) && end < size) {
+            ends.emplace_back(end);
+        }
+    }
+    ends.emplace_back(size);
+    debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_striped] (" << offset << ", " << size << ") in " << ends.size() << " stripes");
+
+    struct stripe_result {
+        int64_t ret = 0;
+        int error = 0;
+    };
+    std::vector<stripe_result> results(ends.size());
+    parallel_for(m_stripe_workers.get(), ends.size(), [&](size_t i) {
+        uint64_t pos = i == 0 ? 0 : ends[i - 1];
+        results[i].ret = transfer(offset + pos, pos, ends[i] - pos);
+        results[i].error = errno;
+    });
+
+    for (auto &result : results) {
+        if (result.ret < 0) {
+            errno = result.error;
+            return -1;
+        }
     }
+    // A short stripe ends the transfer, as the end of the file in the reads
+    int64_t total = 0;
+    for (size_t i = 0; i < ends.size(); i++) {
+        total += results[i].ret;
+        if (static_cast<uint64_t>(results[i].ret) < ends[i] - (i == 0 ? 0 : ends[i - 1])) break;
+    }
+    return total;
+}
+
+int nfi_xpn_server::nfi_dedup(const xpn_file &file, const xpn_fh &fh, const char *buffer, int64_t offset, uint32_t count, uint64_t &found)
+{
+    st_xpn_server_dedup msg{};
+    st_xpn_server_dedup_req req{};
+
+    debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_dedup] >> Begin");
+
+    uint32_t length = concatenate_path(msg.path.path, m_path, file.m_path);
+    msg.path.size = length;
+    msg.offset = offset;
+    msg.bsize = DEDUP_BLOCK_SIZE;
+    msg.count = count;
+    msg.fd = fh.as.file.fd;
+    msg.xpn_session = xpn_env::get_instance().xpn_session_file;
+    msg.disk_compress = file.m_part.m_compressed;
+    for (uint32_t i = 0; i < count; i++) {
+        msg.fingerprints[i] = xpn_fingerprint::of(buffer + i * DEDUP_BLOCK_SIZE, DEDUP_BLOCK_SIZE);
+    }
+
+    if (nfi_do_request(xpn_server_ops::WRITE_DEDUP_FILE, msg, req) < 0) {
+        debug_error("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_dedup] ERROR: nfi_do_request fails");
+        return -1;
+    }
+    if (req.enabled == 0) {
+        debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_dedup] the server has not deduplication");
+        m_dedup_enabled = false;
+    }
+    if (req.status.ret < 0) {
+        errno = req.status.server_errno;
+        return -1;
+    }
+    found = req.found;
+
+    debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_dedup] dedup(" << offset << ", " << count << ")=" << std::hex << found << std::dec);
+    return 0;
+}
+
+int64_t nfi_xpn_server::nfi_write_dedup(const xpn_file &file, const xpn_fh &fh, const char *buffer, int64_t offset, uint64_t size)
+{
+    // The whole blocks of the range, aligned like the ones of the servers
+    const int64_t header = xpn_metadata::HEADER_SIZE;
+    const int64_t end = offset + size;
+    int64_t first = header + (std::max(offset, header) - header + DEDUP_BLOCK_SIZE - 1) / DEDUP_BLOCK_SIZE * DEDUP_BLOCK_SIZE;
+    int64_t last = end > header ? header + (end - header) / DEDUP_BLOCK_SIZE * DEDUP_BLOCK_SIZE : header;
+    if (first >= last) {
+        return nfi_write_data(file, fh, buffer, offset, size);
+    }
+
+    int64_t ret = 0;
+    if (first > offset) {
+        ret = nfi_write_data(file, fh, buffer, offset, first - offset);
+        if (ret < 0) return ret;
+    }
+    for (int64_t batch = first; batch < last;) {
+        uint32_t count = std::min<int64_t>((last - batch) / DEDUP_BLOCK_SIZE, st_xpn_server_dedup::MAX_BLOCKS);
+        uint64_t found = 0;
+        if (m_dedup_enabled && nfi_dedup(file, fh, buffer + (batch - offset), batch, count, found) < 0) {
+            return -1;
+        }
+        // The runs of blocks not found are written as usual
+        for (uint32_t i = 0; i < count;) {
+            if (found & (1ULL << i)) {
+                ret += DEDUP_BLOCK_SIZE;
+                i++;
+                continue;
+            }
+            uint32_t run = 1;
+            while (i + run < count && !(found & (1ULL << (i + run)))) run++;
+            int64_t run_offset = batch + (int64_t)i * DEDUP_BLOCK_SIZE;
+            int64_t res = nfi_write_data(file, fh, buffer + (run_offset - offset), run_offset, run * DEDUP_BLOCK_SIZE);
+            if (res < 0) return res;
+            ret += res;
+            i += run;
+        }
+        batch += (int64_t)count * DEDUP_BLOCK_SIZE;
+    }
+    if (end > last) {
+        int64_t res = nfi_write_data(file, fh, buffer + (last - offset), last, end - last);
+        if (res < 0) return res;
+        ret += res;
+    }
+    return ret;
+}
+
+// The first run of whole aligned units of zeros from pos, it is empty at the end of the buffer when there is none
+static std::pair<uint64_t, uint64_t> find_zero_run(const char *buffer, int64_t offset, uint64_t pos, uint64_t size, uint64_t unit)
+{
+    uint64_t zero_start = size, zero_end = size;
+    while (pos < size) {
+        uint64_t unit_end = std::min(size, ((offset + pos) / unit + 1) * unit - offset);
+        if (unit_end - pos == unit && xpn_is_zero(buffer + pos, unit)) {
+            if (zero_start == size) zero_start = pos;
+            zero_end = unit_end;
+        } else if (zero_start != size) {
+            break;
+        }
+        pos = unit_end;
+    }
+    return {zero_start, zero_end};
+}
+
+std::shared_ptr<short_circuit::file> nfi_xpn_server::nfi_local_file(const xpn_file &file, bool write)
+{
+    // The compressed files store other bytes than the ones of the blocks
+    if (!m_short_circuit_enabled || file.m_part.m_compressed) {
+        return nullptr;
+    }
+
+    st_xpn_server_path msg{};
+    msg.path.size = concatenate_path(msg.path.path, m_path, file.m_path);
+    std::string_view path(msg.path.path, msg.path.size - 1);
+    if (auto local = m_short_circuit.find(path, write)) {
+        return local->fd() >= 0 ? local : nullptr;
+    }
+
+    // The lease is counted from before the request and ends a tenth earlier, so the direct accesses started in it
+    // end before the one of the server, that the removes and renames of the path wait
+    auto now = short_circuit::clock::now();
+    st_xpn_server_lease_req req{};
+    if (nfi_do_request(xpn_server_ops::LEASE_FILE, msg, req) < 0 || req.status.ret < 0) {
+        debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_local_file] lease of '" << path << "' fails");
+        m_short_circuit.forget(path);
+        return nullptr;
+    }
+    if (req.duration_ms == 0) {
+        debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_local_file] the server does not grant leases");
+        m_short_circuit_enabled = false;
+        m_short_circuit.forget(path);
+        return nullptr;
+    }
+    auto expiry = now + std::chrono::milliseconds(req.duration_ms) * 9 / 10;
+    auto local = m_short_circuit.renew(path, write, req.generation, expiry);
+    if (local->fd() < 0) {
+        // Only this file goes through the server, unless the storage of the server is not reachable from this client
+        debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_local_file] cannot open '" << path << "' directly");
+        if (!short_circuit::reachable(m_path)) {
+            debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_local_file] the storage '" << m_path << "' is not reachable");
+            m_short_circuit_enabled = false;
+        }
+        return nullptr;
+    }
+    return local;
+}
+
+int64_t nfi_xpn_server::nfi_write_local(short_circuit::file &local, const char *buffer, int64_t offset, uint64_t size)
+{
+    // Like in the disk of the server, the runs of zeros are holes of the file. The holes keep the size, so the last
+    // byte of the write is always written to extend the file, a truncate could shrink it under a concurrent write
+    const bool sparse = xpn_env::get_instance().xpn_sparse != 0 && size >= SPARSE_UNIT;
+    uint64_t pos = 0;
+    do {
+        auto [zero_start, zero_end] = sparse ? find_zero_run(buffer, offset, pos, size, SPARSE_UNIT)
+                                             : std::pair<uint64_t, uint64_t>{size, size};
+        if (zero_start > pos && filesystem::pwrite(local.fd(), buffer + pos, zero_start - pos, offset + pos) < 0) {
+            return -1;
+        }
+        uint64_t hole_end = zero_end > zero_start && zero_end == size ? zero_end - 1 : zero_end;
+        if (hole_end <= zero_start || filesystem::punch_hole(local.fd(), hole_end - zero_start, offset + zero_start) < 0) {
+            hole_end = zero_start;
+        }
+        if (zero_end > hole_end && filesystem::pwrite(local.fd(), buffer + hole_end, zero_end - hole_end, offset + hole_end) < 0) {
+            return -1;
+        }
+        pos = zero_end;
+    } while (pos < size);
+
+    if (xpn_env::get_instance().xpn_session_file == 1) {
+        PROXY(fsync)(local.fd());
+    }
+    debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] local write(" << local.fd() << ", " << offset << ", " << size << ")=" << size);
+    return size;
+}
+
+int64_t nfi_xpn_server::nfi_write(const xpn_file &file, const xpn_fh &fh, const char *uncompressed_buffer, int64_t offset, uint64_t uncompressed_size)
+{
+    if (auto local = nfi_local_file(file, true)) {
+        return nfi_write_local(*local, uncompressed_buffer, offset, uncompressed_size);
+    }
+
+    int64_t ret = 0;
+    uint64_t pos = 0;
+    bool by_path = false;
+    const bool sparse = xpn_env::get_instance().xpn_sparse != 0 && uncompressed_size >= SPARSE_UNIT;
+    // The compressed files store other bytes than the ones of the blocks, they are not deduplicated
+    const bool dedup = xpn_env::get_instance().xpn_dedup != 0 && m_dedup_enabled && !file.m_part.m_compressed &&
+                       uncompressed_size >= DEDUP_BLOCK_SIZE;
+
+    // The runs of zeros are sent as zero ranges without data, the data between them as usual
+    do {
+        auto [zero_start, zero_end] = sparse ? find_zero_run(uncompressed_buffer, offset, pos, uncompressed_size, SPARSE_UNIT)
+                                             : std::pair<uint64_t, uint64_t>{uncompressed_size, uncompressed_size};
+        int64_t res = 0;
+        if (zero_start > pos) {
+            if (dedup) {
+                res = nfi_write_dedup(file, fh, uncompressed_buffer + pos, offset + pos, zero_start - pos);
+            } else {
+                res = nfi_write_data(file, fh, uncompressed_buffer + pos, offset + pos, zero_start - pos);
+            }
+        }
+        if (res >= 0 && zero_end > zero_start) {
+            int64_t zero_res = nfi_write_zero(file, fh, offset + zero_start, zero_end - zero_start);
+            res = zero_res < 0 ? zero_res : res + zero_res;
+        }
+        if (res < 0 && errno == ESTALE && !by_path && nfi_stale_handle(fh)) {
+            // The server has closed the file of the handle, the writes of the range are repeated by path
+            by_path = true;
+            continue;
+        }
+        if (res < 0) {
+            ret = res;
+            break;
+        }
+        ret += res;
+        pos = zero_end;
+    } while (pos < uncompressed_size);
 
     debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_write] >> End");
     return ret;
 }
 
+xpn_server_handle nfi_xpn_server::nfi_handle(const xpn_fh &fh)
+{
+    if (!fh.is_file() || fh.as.file.handle_generation == 0) return {};
+    std::unique_lock lock(m_stale_mutex);
+    if (m_stale_handles.count(fh.as.file.handle_generation) != 0) return {};
+    return {fh.as.file.handle_id, fh.as.file.handle_epoch, fh.as.file.handle_generation};
+}
+
+bool nfi_xpn_server::nfi_stale_handle(const xpn_fh &fh)
+{
+    if (!fh.is_file() || fh.as.file.handle_generation == 0) return false;
+    debug_info("[SERV_ID=" << m_server << "] [NFI_XPN] [nfi_xpn_server_stale_handle] handle " << fh.as.file.handle_id << " is stale");
+    std::unique_lock lock(m_stale_mutex);
+    m_stale_handles.insert(fh.as.file.handle_generation);
+    return true;
+}
+
 int nfi_xpn_server::nfi_remove (std::string_view path, bool is_async)
 {
   int ret;
@@ -627,6 +1248,7 @@ int nfi_xpn_server::nfi_remove (std::string_view path, bool is_async)
   msg.path.size = length;
 
   debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_remove] nfi_xpn_server_remove("<<msg.path.path<<", "<<is_async<<")");
+  m_short_circuit.forget(msg.path.path);
 
   if (is_async)
   {
@@ -634,7 +1256,12 @@ int nfi_xpn_server::nfi_remove (std::string_view path, bool is_async)
   }
   else
   {
-    ret = nfi_do_request(xpn_server_ops::RM_FILE, msg, req);
+    // The server does not remove it while a lease of the path to a client of its node has not ended
+    for (int retry_ms = 1;
+         nfi_do_request(xpn_server_ops::RM_FILE, msg, req) >= 0 && req.ret < 0 && req.server_errno == EAGAIN;
+         retry_ms = std::min(retry_ms * 2, LEASE_RETRY_MAX_MS)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(retry_ms));
+    }
     if (req.ret < 0)
       errno = req.server_errno;
     ret = req.ret;
@@ -660,8 +1287,15 @@ int nfi_xpn_server::nfi_rename (std::string_view path, std::string_view new_path
   msg.paths.size2 = length;
 
   debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_rename] nfi_xpn_server_rename("<<msg.paths.path1()<<", "<<msg.paths.path2()<<")");
-
-  ret = nfi_do_request(xpn_server_ops::RENAME_FILE, msg, req);
+  m_short_circuit.forget(msg.paths.path1());
+  m_short_circuit.forget(msg.paths.path2());
+
+  // The server does not rename while a lease of any of the paths to a client of its node has not ended
+  for (int retry_ms = 1;
+       (ret = nfi_do_request(xpn_server_ops::RENAME_FILE, msg, req)) >= 0 && req.ret < 0 && req.server_errno == EAGAIN;
+       retry_ms = std::min(retry_ms * 2, LEASE_RETRY_MAX_MS)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(retry_ms));
+  }
   if (req.ret < 0){
     errno = req.server_errno;
     ret = req.ret;
@@ -939,6 +1573,93 @@ int nfi_xpn_server::nfi_read_mdata (std::string_view path, xpn_metadata &mdata)
   return ret;
 }
 
+int nfi_xpn_server::nfi_open_mdata (std::string_view path, int flags, mode_t mode, xpn_fh &fho, xpn_metadata &mdata)
+{
+  int ret;
+  st_xpn_server_path_flags msg{};
+  st_xpn_server_open_mdata_req req{};
+  st_xpn_server_status &status = req.open.status;
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open_mdata] >> Begin");
+
+  uint32_t length = concatenate_path(msg.path.path, m_path, path);
+  msg.path.size = length;
+  msg.flags = flags;
+  msg.mode = mode;
+  msg.xpn_session = xpn_env::get_instance().xpn_session_file;
+  msg.want_handle = msg.xpn_session == 0 && xpn_env::get_instance().xpn_handles != 0 &&
+                    m_protocol_type != protocol_t::mqtt ? 1 : 0;
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open_mdata] nfi_xpn_server_open_mdata("<<msg.path.path<<", "<<flags<<", "<<mode<<")");
+
+  ret = nfi_do_request(xpn_server_ops::OPEN_WITH_MDATA, msg, req);
+  if (ret < 0){
+    return -1;
+  }
+  memcpy(&mdata.m_data, &req.mdata.mdata, sizeof(req.mdata.mdata));
+  if (req.mdata.status.ret < 0){
+    errno = req.mdata.status.server_errno;
+    debug_error("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open_mdata] ERROR: remote read_mdata fails for '"<<msg.path.path<<"'");
+    return -1;
+  }
+  if (status.ret < 0){
+    errno = status.server_errno;
+    debug_error("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open_mdata] ERROR: remote open fails to open '"<<msg.path.path<<"'");
+    return -1;
+  }
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open_mdata] nfi_xpn_server_open_mdata("<<msg.path.path<<")="<<status.ret);
+
+  // Like close-to-open, the first direct access after the open renews the lease
+  m_short_circuit.expire(msg.path.path);
+
+  fho.type = xpn_fh::type_t::File;
+  fho.as.file.fd = status.ret;
+  fho.as.file.handle_id = req.open.handle.id;
+  fho.as.file.handle_epoch = req.open.handle.epoch;
+  fho.as.file.handle_generation = req.open.handle.generation;
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_open_mdata] >> End");
+
+  return 0;
+}
+
+int nfi_xpn_server::nfi_getattr_mdata (std::string_view path, xpn_metadata &mdata, struct ::stat &st)
+{
+  int ret;
+  st_xpn_server_path msg{};
+  st_xpn_server_getattr_mdata_req req{};
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_getattr_mdata] >> Begin");
+
+  uint32_t length = concatenate_path(msg.path.path, m_path, path);
+  msg.path.size = length;
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_getattr_mdata] nfi_xpn_server_getattr_mdata("<<msg.path.path<<")");
+
+  ret = nfi_do_request(xpn_server_ops::GETATTR_WITH_MDATA, msg, req);
+  if (ret < 0){
+    return ret;
+  }
+  memcpy(&mdata.m_data, &req.mdata.mdata, sizeof(req.mdata.mdata));
+  if (req.mdata.status.ret < 0){
+    errno = req.mdata.status.server_errno;
+    return req.mdata.status.ret;
+  }
+
+  st = req.attr.attr.to_stat();
+
+  if (req.attr.status_req.ret < 0){
+    errno = req.attr.status_req.server_errno;
+    ret = req.attr.status_req.ret;
+  }
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_xpn_server_getattr_mdata] nfi_xpn_server_getattr_mdata("<<msg.path.path<<")="<<ret);
+
+  debug_info("[NFI_XPN] [nfi_xpn_server_getattr_mdata] >> End");
+
+  return ret;
+}
+
 int nfi_xpn_server::nfi_write_mdata (std::string_view path, const xpn_fh &fh, const xpn_metadata::data &mdata, bool only_file_size)
 {
   int ret;
@@ -1049,6 +1770,39 @@ int nfi_xpn_server::nfi_checkpoint (const char *path)
   return ret;
 }
 
+uint32_t nfi_xpn_server::nfi_register_dict(const xpn_dictionary *dict)
+{
+  if (dict == nullptr) return 0;
+
+  std::unique_lock lock(m_dict_mutex);
+  if (m_dict_registered.contains(dict->id())) return dict->id();
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_register_dict] >> Begin");
+
+  auto msg = std::make_unique<st_xpn_server_dict>();
+  msg->id = dict->id();
+  msg->size = dict->size();
+  std::memcpy(msg->data, dict->data(), dict->size());
+  st_xpn_server_status status{};
+
+  int ret = nfi_do_request(xpn_server_ops::REGISTER_DICT, *msg, status);
+  if (ret < 0 || status.ret < 0) {
+    debug_error("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_register_dict] ERROR: register dictionary "<<std::hex<<dict->id()<<std::dec<<" fails, continue without it");
+    return 0;
+  }
+  m_dict_registered.emplace(dict->id());
+
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_register_dict] nfi_register_dict("<<std::hex<<dict->id()<<std::dec<<", "<<dict->size()<<")");
+  debug_info("[SERV_ID="<<m_server<<"] [NFI_XPN] [nfi_register_dict] >> End");
+  return dict->id();
+}
+
+bool nfi_xpn_server::use_dict(uint32_t dict_id, uint64_t size)
+{
+  auto xpn_compression = xpn_env::get_instance().xpn_net_compression;
+  return dict_id != 0 && size <= xpn_dictionary::SMALL_BLOCK_SIZE && xpn_compression != 0 && xpn_compression != 3;
+}
+
 int nfi_xpn_server::nfi_response() {
   
   int ret;
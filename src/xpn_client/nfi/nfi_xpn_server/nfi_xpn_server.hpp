@@ -21,7 +21,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
 #include "adaptative_compressor.hpp"
+#include "short_circuit.hpp"
+#include "base_cpp/workers.hpp"
+#include "base_cpp/xpn_dictionary.hpp"
 #include "nfi/nfi_server.hpp"
 
 namespace XPN
@@ -40,7 +48,13 @@ namespace XPN
                              num_servers),
            m_write_compressor(AdaptiveCompressor::type_t::Write,
                               "Write compressor " + std::string(m_server) + ":" + std::to_string(m_server_port),
-                              num_servers) {}
+                              num_servers) {
+         m_short_circuit_enabled = xpn_env::get_instance().xpn_short_circuit != 0 &&
+                                   m_protocol_type != protocol_t::mqtt && is_local_server(m_server);
+         if (xpn_env::get_instance().xpn_connections > 1) {
+             m_stripe_workers = workers::Create(workers_mode::thread_on_demand);
+         }
+     }
 
     public:
         // Operations 
@@ -53,6 +67,9 @@ namespace XPN
         int64_t nfi_write   (const xpn_file& file, const xpn_fh &fh, const char *buffer, int64_t offset, uint64_t size) override;
         int64_t nfi_write_v1(const xpn_file& file, const xpn_fh &fh, const char *buffer, int64_t offset, uint64_t size);
         int64_t nfi_write_v2(const xpn_file& file, const xpn_fh &fh, const char *buffer, int64_t offset, uint64_t size);
+        int64_t nfi_write_zero(const xpn_file& file, const xpn_fh &fh, int64_t offset, uint64_t size);
+        // Write the whole blocks that the server has not, by their fingerprints, and the rest of the range
+        int64_t nfi_write_dedup(const xpn_file& file, const xpn_fh &fh, const char *buffer, int64_t offset, uint64_t size);
         int nfi_remove      (std::string_view path, bool is_async) override;
         int nfi_rename      (std::string_view path, std::string_view new_path) override;
         int nfi_getattr     (std::string_view path, struct ::stat &st) override;
@@ -65,12 +82,76 @@ namespace XPN
         int nfi_statvfs     (std::string_view path, struct ::statvfs &inf) override;
         int nfi_read_mdata  (std::string_view path, xpn_metadata &mdata) override;
         int nfi_write_mdata (std::string_view path, const xpn_fh &fh, const xpn_metadata::data &mdata, bool only_file_size) override;
+        int nfi_open_mdata    (std::string_view path, int flags, mode_t mode, xpn_fh &fho, xpn_metadata &mdata) override;
+        int nfi_getattr_mdata (std::string_view path, xpn_metadata &mdata, struct ::stat &st) override;
         int nfi_flush       (const char *path) override;
         int nfi_preload     (const char *path) override;
         int nfi_checkpoint  (const char *path) override;
         int nfi_response    () override;
     private:
+        // Send the dictionary to the server the first time it is used, return its id or 0 to go without it
+        uint32_t nfi_register_dict(const xpn_dictionary *dict);
+        // The small requests of the partitions with dictionary are compressed with it, out of the adaptive model
+        static bool use_dict(uint32_t dict_id, uint64_t size);
+        int64_t nfi_write_data(const xpn_file& file, const xpn_fh &fh, const char *buffer, int64_t offset, uint64_t size);
+        // Split a transfer in ranges that end in offsets multiple of align after the header and are sent at the same time by the
+        // connections of the server, transfer(offset, pos, size) sends the range at pos of the buffer. It returns the
+        // bytes up to the first short range, or -1 with the errno of a range that fails
+        int64_t nfi_striped(int64_t offset, uint64_t size, uint64_t align, const std::function<int64_t(int64_t, uint64_t, uint64_t)> &transfer);
+        // The V2 reads and writes are enabled by XPN_RW_V2 in the transports that implement them
+        bool nfi_use_rw_v2() const;
+        // Receive the data of a read that the server sends by chunks, it returns the bytes received
+        int64_t nfi_read_stream(char *buffer, uint64_t size, uint64_t chunk_size);
+        // Bytes of the chunks of the compressed reads and writes in the transport of the server
+        uint64_t nfi_chunk_size() const;
+        // The raw chunks of at least XPN_RDMA_MIN_SIZE are moved by the server from or to the registered buffer
+        bool nfi_use_rdma(uint64_t size) const;
+        // Receive the reply of a READ_FILE_V2 and its data in a buffer of size bytes, it returns the bytes received
+        int64_t nfi_read_reply_v2(st_xpn_server_read_v2_req &req, char *data, uint64_t size, bool compressed);
+        // Ask the server to reference the consecutive blocks it already has, found has a bit per block referenced
+        int nfi_dedup(const xpn_file& file, const xpn_fh &fh, const char *buffer, int64_t offset, uint32_t count, uint64_t &found);
+        // The backing file of a server of the same node with a lease, nullptr to go through the server
+        std::shared_ptr<short_circuit::file> nfi_local_file(const xpn_file& file, bool write);
+        int64_t nfi_write_local(short_circuit::file &local, const char *buffer, int64_t offset, uint64_t size);
+        // The handle of the file in the server, an invalid one when the requests go by path
+        xpn_server_handle nfi_handle(const xpn_fh &fh);
+        // The server replied that the handle is stale, return true when the file had one and the request can be
+        // repeated by path
+        bool nfi_stale_handle(const xpn_fh &fh);
+
+        // Chunks compressed or decompressed together in parallel, it bounds the memory of a request
+        static constexpr uint64_t COMPRESS_WINDOW = 8;
+        // Bounds of the chunk sizes of the transports
+        static constexpr int64_t MIN_CHUNK_SIZE = 4 * 1024;
+        static constexpr int64_t MAX_CHUNK_SIZE = 64 * 1024 * 1024;
+        // Windows of a request, one is sent or received while the other is compressed or decompressed
+        static constexpr uint64_t PIPELINE_WINDOWS = 2;
+        // Aligned units of the writes that are sent as zero ranges when all their bytes are zero
+        static constexpr uint64_t SPARSE_UNIT = 64 * 1024;
+        // Blocks of the deduplication of the servers, aligned after the header of the files
+        static constexpr uint64_t DEDUP_BLOCK_SIZE = 512 * 1024;
+        // Cleared when the server replies that it has not the deduplication
+        std::atomic_bool m_dedup_enabled = true;
+        // Cleared when a one-sided transfer fails, the chunk is repeated in messages
+        std::atomic_bool m_rdma_enabled = true;
+        // Cleared when the server does not grant the leases of the direct access or its storage is not reachable
+        std::atomic_bool m_short_circuit_enabled = false;
+        short_circuit m_short_circuit;
+        // Longest wait between the repetitions of a remove or rename while the server has a lease of the path
+        static constexpr int LEASE_RETRY_MAX_MS = 64;
+        // The threads of the stripes, only with XPN_CONNECTIONS
+        std::unique_ptr<workers> m_stripe_workers;
+        // Alignment of the ranges of the striped transfers
+        static constexpr uint64_t STRIPE_ALIGN = 4096;
+
         AdaptiveCompressor m_read_compressor;
         AdaptiveCompressor m_write_compressor;
+
+        std::mutex m_dict_mutex;
+        std::unordered_set<uint32_t> m_dict_registered;
+
+        // The generations of the handles that the server no longer knows, until the file is closed
+        std::mutex m_stale_mutex;
+        std::unordered_set<uint64_t> m_stale_handles;
     };
 } // namespace XPN
\ No newline at end of file
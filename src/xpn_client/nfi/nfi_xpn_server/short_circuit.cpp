@@ -0,0 +1,112 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "short_circuit.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "base_cpp/debug.hpp"
+#include "base_cpp/proxy.hpp"
+
+namespace XPN {
+
+short_circuit::file::~file() {
+    if (m_fd >= 0) PROXY(close)(m_fd);
+}
+
+std::shared_ptr<short_circuit::file> short_circuit::find(std::string_view path, bool write) {
+    std::unique_lock lock(m_mutex);
+    auto it = m_files.find(path);
+    if (it == m_files.end()) {
+        return nullptr;
+    }
+    auto &local = it->second;
+    if (!local->leased(clock::now()) || (write && !local->writable())) {
+        return nullptr;
+    }
+    return local;
+}
+
+std::shared_ptr<short_circuit::file> short_circuit::renew(std::string_view path, bool write, uint64_t generation,
+                                                          clock::time_point expiry) {
+    std::unique_lock lock(m_mutex);
+    auto it = m_files.find(path);
+    if (it != m_files.end()) {
+        auto &local = it->second;
+        if (local->fd() >= 0 && local->generation() == generation && (!write || local->writable())) {
+            local->renew(expiry);
+            return local;
+        }
+        m_files.erase(it);
+    }
+
+    std::string file_path(path);
+    bool writable = true;
+    int fd = PROXY(open)(file_path.c_str(), O_RDWR);
+    if (fd < 0 && !write) {
+        writable = false;
+        fd = PROXY(open)(file_path.c_str(), O_RDONLY);
+    }
+    if (fd < 0) {
+        // The reads and the writes of the file go through the server until the lease ends
+        debug_info("[SHORT_CIRCUIT] [renew] cannot open '" << file_path << "' " << strerror(errno));
+        writable = true;
+    }
+
+    // The files out of their lease are the first closed, the ones in use are closed when their accesses end
+    if (m_files.size() >= MAX_FILES) {
+        auto now = clock::now();
+        std::erase_if(m_files, [now](const auto &item) { return !item.second->leased(now); });
+        if (m_files.size() >= MAX_FILES) {
+            m_files.clear();
+        }
+    }
+    auto local = std::make_shared<file>(fd, writable, generation);
+    local->renew(expiry);
+    m_files.emplace(std::move(file_path), local);
+    debug_info("[SHORT_CIRCUIT] [renew] open '" << path << "' fd " << fd << " generation " << generation);
+    return local;
+}
+
+bool short_circuit::reachable(std::string_view dir) {
+    return PROXY(access)(std::string(dir).c_str(), R_OK | X_OK) == 0;
+}
+
+void short_circuit::expire(std::string_view path) {
+    std::unique_lock lock(m_mutex);
+    auto it = m_files.find(path);
+    if (it != m_files.end()) {
+        it->second->expire();
+    }
+}
+
+void short_circuit::forget(std::string_view path) {
+    std::unique_lock lock(m_mutex);
+    auto it = m_files.find(path);
+    if (it != m_files.end()) {
+        m_files.erase(it);
+    }
+}
+
+}  // namespace XPN
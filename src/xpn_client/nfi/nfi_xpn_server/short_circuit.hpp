@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "base_cpp/str_unordered_map.hpp"
+
+namespace XPN {
+
+// Descriptors of the backing files of a server of the same node, the reads and writes of the files go directly to
+// them while the server grants a lease of the path
+class short_circuit {
+   public:
+    using clock = std::chrono::steady_clock;
+
+    class file {
+       public:
+        file(int fd, bool writable, uint64_t generation) : m_fd(fd), m_writable(writable), m_generation(generation) {}
+        ~file();
+        file(const file &) = delete;
+        file &operator=(const file &) = delete;
+
+        int fd() const { return m_fd; }
+        bool writable() const { return m_writable; }
+        uint64_t generation() const { return m_generation; }
+        bool leased(clock::time_point now) const { return now.time_since_epoch().count() < m_expiry.load(); }
+        void renew(clock::time_point expiry) { m_expiry = expiry.time_since_epoch().count(); }
+        void expire() { m_expiry = 0; }
+
+       private:
+        const int m_fd;
+        const bool m_writable;
+        const uint64_t m_generation;
+        std::atomic<clock::rep> m_expiry = 0;
+    };
+
+    // The file of the path while its lease is valid, nullptr when the lease has to be asked to the server
+    std::shared_ptr<file> find(std::string_view path, bool write);
+    // The descriptor is kept when the generation of the lease has not changed, otherwise the file is opened again.
+    // When the client cannot open it the file has no descriptor, fd -1, until the lease ends
+    std::shared_ptr<file> renew(std::string_view path, bool write, uint64_t generation, clock::time_point expiry);
+    // The directory of the storage of the server can be accessed by the client
+    static bool reachable(std::string_view dir);
+    // The next access asks again for the lease
+    void expire(std::string_view path);
+    // The descriptor is closed when the last access that is using it ends
+    void forget(std::string_view path);
+
+   private:
+    static constexpr size_t MAX_FILES = 256;
+
+    std::mutex m_mutex;
+    str_unordered_map<std::string, std::shared_ptr<file>> m_files;
+};
+
+}  // namespace XPN
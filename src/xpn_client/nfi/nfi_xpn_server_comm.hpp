@@ -42,10 +42,19 @@ namespace XPN
     public:
         virtual ~nfi_xpn_server_comm() = default;
         virtual int64_t write_operation(xpn_server_msg& msg) = 0;
+        // The operation followed by its payload, the stream transports send both in one go
+        virtual int64_t write_operation_data(xpn_server_msg& msg, const void *data, int64_t size) {
+            if (write_operation(msg) < 0) return -1;
+            return write_data(data, size);
+        }
         virtual int64_t read_data(void *data, int64_t size, int64_t tag = -1) = 0;
         virtual int64_t write_data(const void *data, int64_t size, int64_t tag = -1) = 0;
         virtual int64_t readv_data(const iovec *iov, int64_t count, int64_t tag = -1) = 0;
         virtual int64_t writev_data(const iovec *iov, int64_t count, int64_t tag = -1) = 0;
+        // Register a buffer for the one-sided transfers of the server, the registration lasts while the result is
+        // kept. nullptr when the transport has not them
+        virtual std::shared_ptr<void> rdma_register([[maybe_unused]] const void *data, [[maybe_unused]] uint64_t size,
+                                                    [[maybe_unused]] xpn_server_rdma &rdma) { return nullptr; }
 
         server_type m_type;
     };
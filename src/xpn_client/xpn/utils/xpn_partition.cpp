@@ -20,6 +20,10 @@
  */
 
 #include "xpn/xpn_partition.hpp"
+
+#include <atomic>
+#include <thread>
+
 #include "base_cpp/ns.hpp"
 #include "base_cpp/debug.hpp"
 #include "nfi/nfi_server.hpp"
@@ -43,10 +47,48 @@ namespace XPN
                 m_local_serv = index;
             }
 
-            debug_info("server->m_protocol "<<server->m_protocol);
-            if (server->m_protocol_type != nfi_server::protocol_t::file) {
-                res = server->init_comm();
+            XPN_DEBUG_END;
+            return res;
+        }
+
+        int xpn_partition::connect_servers(int max_parallel, bool lazy)
+        {
+            XPN_DEBUG_BEGIN;
+            int res = 0;
+            std::vector<nfi_server*> to_connect;
+            for (auto &server : m_data_serv) {
+                debug_info("server->m_protocol "<<server->m_protocol);
+                if (server->m_protocol_type == nfi_server::protocol_t::file) {
+                    continue;
+                }
+                if (!server->can_connect_async()) {
+                    // Connected here one after another, the mpi and fabric ones are not thread safe to connect
+                    if (server->init_comm_once() < 0) res = -1;
+                    continue;
+                }
+                if (!lazy) {
+                    to_connect.emplace_back(server.get());
+                }
+            }
+
+            // Each thread connects the next server, an unreachable one only delays its thread
+            std::atomic_size_t next = 0;
+            std::atomic_int error = 0;
+            auto connect = [&]() {
+                for (size_t i = next++; i < to_connect.size(); i = next++) {
+                    if (to_connect[i]->init_comm_once() < 0) error = -1;
+                }
+            };
+            size_t num_threads = std::min<size_t>(to_connect.size(), std::max(max_parallel, 1));
+            std::vector<std::thread> threads;
+            for (size_t t = 1; t < num_threads; t++) {
+                threads.emplace_back(connect);
+            }
+            connect();
+            for (auto &thread : threads) {
+                thread.join();
             }
+            if (error < 0) res = -1;
 
             XPN_DEBUG_END;
             return res;
@@ -71,7 +71,10 @@ namespace XPN
         file->m_flags = flags;
         file->m_mode = mode;
 
-        if ((O_DIRECTORY != (flags & O_DIRECTORY))) {
+        // The plain opens read the metadata header in the same request that opens the file in the master
+        bool with_mdata = O_DIRECTORY != (flags & O_DIRECTORY) && O_CREAT != (flags & O_CREAT) && O_TRUNC != (flags & O_TRUNC);
+
+        if ((O_DIRECTORY != (flags & O_DIRECTORY)) && !with_mdata) {
             res = read_metadata(file->m_mdata);
             if (res < 0 && O_CREAT != (flags & O_CREAT)){
                 XPN_DEBUG_END_CUSTOM(path<<", "<<format_open_flags(flags)<<", "<<format_open_mode(mode));
@@ -142,10 +145,16 @@ namespace XPN
             }
         }else{
             int master_file = file->m_mdata.master_file();
+            if (with_mdata && master_file < 0) {
+                XPN_DEBUG_END_CUSTOM(path<<", "<<format_open_flags(flags)<<", "<<format_open_mode(mode));
+                return master_file;
+            }
             // Retry when replication is enabled
             while (master_file >= 0) {
                 if ((O_DIRECTORY == (flags & O_DIRECTORY))){
                     res = file->m_part.m_data_serv[master_file]->nfi_opendir(file->m_path, file->m_data_vfh[master_file]);
+                }else if (with_mdata){
+                    res = file->m_part.m_data_serv[master_file]->nfi_open_mdata(file->m_path, flags, mode, file->m_data_vfh[master_file], file->m_mdata);
                 }else{
                     res = file->m_part.m_data_serv[master_file]->nfi_open(file->m_path, flags, mode, file->m_data_vfh[master_file]);
                 }
@@ -159,6 +168,11 @@ namespace XPN
                 }
                 break;
             }
+
+            if (with_mdata && !file->m_mdata.m_data.is_valid()){
+                XPN_DEBUG("Fill metadata because is invalid");
+                file->m_mdata.m_data.fill(file->m_mdata);
+            }
         }
 
         
@@ -74,12 +74,6 @@ namespace XPN
         XPN_DEBUG_BEGIN_CUSTOM(file.m_path);
         int res = 0;
 
-        if (read_metadata(file.m_mdata) < 0){
-            res = -1;
-            XPN_DEBUG_END_CUSTOM(file.m_path);
-            return res;
-        }
-        
         int master = file.m_mdata.master_file();
         if (master < 0) {
             res = master;
@@ -87,8 +81,9 @@ namespace XPN
             return res;
         }
 
+        // The metadata header and the attributes come from the master in one request
         while (master >= 0) {
-            res = file.m_part.m_data_serv[master]->nfi_getattr(file.m_path, *sb);
+            res = file.m_part.m_data_serv[master]->nfi_getattr_mdata(file.m_path, file.m_mdata, *sb);
             XPN_DEBUG("Stat from serv "<<master<<" res "<<res);
             if (res < 0 && file.m_part.m_data_serv[master]->m_error < 0) {
                 master = file.m_mdata.master_file();
@@ -97,6 +92,10 @@ namespace XPN
             }
             break;
         }
+        if (res < 0) {
+            XPN_DEBUG_END_CUSTOM(file.m_path);
+            return res;
+        }
 
         // Update file_size
         if (S_ISREG(sb->st_mode)){
@@ -68,10 +68,21 @@ int xpn_api::init() {
             std::raise(SIGTERM);
         }
         auto &xpn_part = key->second;
+        xpn_part.m_net_codec = part.net_codec;
+        xpn_part.m_disk_codec = part.disk_codec;
+        if (!part.dictionary.empty()) {
+            xpn_part.m_dictionary = xpn_dictionary::load_file(part.dictionary);
+            if (!xpn_part.m_dictionary) {
+                std::cerr << "Error: cannot read the dictionary '" << part.dictionary << "'" << std::endl;
+                std::raise(SIGTERM);
+            }
+        }
         int server_with_error = 0;
         for (const auto &srv_url : part.server_urls) {
             res = xpn_part.init_server(srv_url, part.server_urls.size());
         }
+        res = xpn_part.connect_servers(xpn_env::get_instance().xpn_connect_parallel,
+                                       xpn_env::get_instance().xpn_connect_lazy);
 
         for (const auto &srv : xpn_part.m_data_serv) {
             if (srv->m_error < 0) {
@@ -46,6 +46,10 @@ struct xpn_fh {
         } dir;
         struct FileData {
             int fd;           // file_descriptor in the server when XPN_SESSION_FILE set
+            // handle of the file in the server when XPN_HANDLES set, a generation of 0 when it has not granted one
+            uint32_t handle_id;
+            uint32_t handle_epoch;
+            uint64_t handle_generation;
         } file;
     } as;
 
@@ -25,6 +25,7 @@
 #include <vector>
 
 #include "base_cpp/xpn_conf.hpp"
+#include "base_cpp/xpn_dictionary.hpp"
 #include "nfi/nfi_server.hpp"
 
 namespace XPN {
@@ -45,12 +46,17 @@ class xpn_partition {
     // Delete move assignment operator
     xpn_partition& operator=(xpn_partition&&) = delete;
     int init_server(std::string_view url, uint32_t num_servers);
+    // Connect the servers up to max_parallel at the same time, with lazy the socket ones connect in their first request
+    int connect_servers(int max_parallel, bool lazy);
 
    public:
     GrowFixedString<32> m_name;                                             // name of partition
     int m_replication_level = XPN_CONF::DEFAULT_REPLICATION_LEVEL;  // replication_level of files :0, 1, 2,...
     uint64_t m_block_size = XPN_CONF::DEFAULT_BLOCKSIZE;            // size of distribution used
     bool m_compressed = XPN_CONF::DEFAULT_COMPRESSED;              // if the data is save compressed in disk
+    xpn_codec m_net_codec = {};                                     // codec of the data compressed on the wire
+    xpn_codec m_disk_codec = {};                                    // codec of the data compressed in disk
+    std::shared_ptr<const xpn_dictionary> m_dictionary;             // dictionary of the small blocks, can be null
 
     std::vector<std::unique_ptr<nfi_server>> m_data_serv;           // list of data servers in the partition
 
@@ -174,6 +174,76 @@ namespace XPN
             xpn_server_ops m_op = xpn_server_ops::size;
         };
 
+        struct queue_stats : public stats{
+            queue_stats() = default;
+            queue_stats(const queue_stats& other) : stats(other) {
+                m_depth = other.m_depth.load();
+                m_max_depth = other.m_max_depth.load();
+                m_op_class = other.m_op_class;
+            }
+
+            queue_stats& operator=(const queue_stats& other) {
+                if (this != &other) {
+                    m_utime = other.m_utime.load();
+                    m_count = other.m_count.load();
+                    m_depth = other.m_depth.load();
+                    m_max_depth = other.m_max_depth.load();
+                    m_op_class = other.m_op_class;
+                }
+                return *this;
+            }
+
+            uint64_t get_depth() {return m_depth;}
+            uint64_t get_max_depth() {return m_max_depth;}
+
+            void enqueue() {
+                uint64_t depth = ++m_depth;
+                uint64_t max_depth = m_max_depth;
+                while (depth > max_depth && !m_max_depth.compare_exchange_weak(max_depth, depth)) {}
+            }
+            void dequeue(uint64_t wait_utime) {
+                m_depth--;
+                add_value();
+                add_time(wait_utime);
+            }
+
+            // The depths are gauges, so they are not subtracted
+            queue_stats operator-(const queue_stats& other) const {
+                queue_stats out;
+                out.m_utime = m_utime - other.m_utime;
+                out.m_count = m_count - other.m_count;
+                out.m_depth = m_depth.load();
+                out.m_max_depth = m_max_depth.load();
+                out.m_op_class = m_op_class;
+                return out;
+            }
+
+            queue_stats operator+(const queue_stats& other) const {
+                queue_stats out;
+                out.m_utime = m_utime + other.m_utime;
+                out.m_count = m_count + other.m_count;
+                out.m_depth = m_depth + other.m_depth;
+                out.m_max_depth = std::max(m_max_depth.load(), other.m_max_depth.load());
+                out.m_op_class = m_op_class;
+                return out;
+            }
+
+            std::string to_string(){
+                std::stringstream out;
+                out << std::setw(10) << xpn_server_op_class_name(m_op_class);
+                out << " | Depth | "<<                                       std::setw(10) << get_depth()                           << " reqs";
+                out << " | " <<                                              std::setw(10) << get_max_depth()                       << " max";
+                out << " | Wait | " <<                                       std::setw(10) << get_count()                           << " count";
+                out << " | " <<        std::fixed << std::setprecision(2) << std::setw(10) << get_avg_utime()                       << " usec avg";
+                out << " | ";
+                return out.str();
+            }
+            xpn_server_op_class m_op_class = xpn_server_op_class::size;
+        private:
+            std::atomic_uint64_t m_depth = 0;
+            std::atomic_uint64_t m_max_depth = 0;
+        };
+
 
     public:
         xpn_stats()
@@ -182,6 +252,10 @@ namespace XPN
             {
                 m_ops_stats[i].m_op = static_cast<xpn_server_ops>(i);
             }
+            for (uint64_t i = 0; i < m_queue_stats.size(); i++)
+            {
+                m_queue_stats[i].m_op_class = static_cast<xpn_server_op_class>(i);
+            }
         }
 
     public:
@@ -194,6 +268,12 @@ namespace XPN
 
         std::array<op_stats, static_cast<uint64_t>(xpn_server_ops::size)> m_ops_stats;
 
+        // Request queue of the server scheduler
+        std::array<queue_stats, static_cast<uint64_t>(xpn_server_op_class::size)> m_queue_stats;
+
+        // Memory and disk residency of the file data, the bytes are gauges
+        filesystem_residency m_residency;
+
         template<typename stat_type>
         class scope_stat
         {
@@ -234,6 +314,13 @@ namespace XPN
             {
                 out.m_ops_stats[i] = m_ops_stats[i] - other.m_ops_stats[i]; 
             }
+            for (uint64_t i = 0; i < m_queue_stats.size(); i++)
+            {
+                out.m_queue_stats[i] = m_queue_stats[i] - other.m_queue_stats[i]; 
+            }
+            out.m_residency = m_residency;
+            out.m_residency.evictions = m_residency.evictions - other.m_residency.evictions;
+            out.m_residency.promotions = m_residency.promotions - other.m_residency.promotions;
             return out;
         }
         
@@ -250,6 +337,14 @@ namespace XPN
             {
                 out.m_ops_stats[i] = m_ops_stats[i] + other.m_ops_stats[i]; 
             }
+            for (uint64_t i = 0; i < m_queue_stats.size(); i++)
+            {
+                out.m_queue_stats[i] = m_queue_stats[i] + other.m_queue_stats[i]; 
+            }
+            out.m_residency.memory_bytes = m_residency.memory_bytes + other.m_residency.memory_bytes;
+            out.m_residency.disk_bytes = m_residency.disk_bytes + other.m_residency.disk_bytes;
+            out.m_residency.evictions = m_residency.evictions + other.m_residency.evictions;
+            out.m_residency.promotions = m_residency.promotions + other.m_residency.promotions;
             return out;
         }
 
@@ -288,6 +383,26 @@ namespace XPN
             return out.str();
         }
 
+        std::string to_string_queue(){
+            std::stringstream out;
+            for (auto &queue : m_queue_stats)
+            {
+                out << "QUEUE: " << queue.to_string() << std::endl;
+            }
+            return out.str();
+        }
+
+        std::string to_string_residency(){
+            std::stringstream out;
+            out << "Memory      | " << std::fixed << std::setprecision(2) << std::setw(10) << static_cast<double>(m_residency.memory_bytes) / 1024 / 1024 << " mb";
+            out << " | " <<                                                     std::setw(10) << m_residency.promotions.load()                                  << " promotions";
+            out << " | " << std::endl;
+            out << "Disk        | " << std::fixed << std::setprecision(2) << std::setw(10) << static_cast<double>(m_residency.disk_bytes) / 1024 / 1024 << " mb";
+            out << " | " <<                                                     std::setw(10) << m_residency.evictions.load()                                   << " evictions";
+            out << " | ";
+            return out.str();
+        }
+
         std::string to_csv_header(){
             std::stringstream out;
             out << "Timestamp" << ";";
@@ -302,6 +417,13 @@ namespace XPN
             {
                 out << "OP " << xpn_server_ops_name(op.m_op) << " (ops/sec);";
             }
+            for (auto &queue : m_queue_stats)
+            {
+                out << "QUEUE " << xpn_server_op_class_name(queue.m_op_class) << " depth;";
+                out << "QUEUE " << xpn_server_op_class_name(queue.m_op_class) << " wait (usec);";
+            }
+            out << "Memory resident (mb);";
+            out << "Disk resident (mb);";
 
             out << std::endl;
             return out.str();
@@ -327,6 +449,13 @@ namespace XPN
             {
                 out_data << op.get_ops_sec() << ";";
             }
+            for (auto &queue : m_queue_stats)
+            {
+                out_data << queue.get_depth() << ";";
+                out_data << queue.get_avg_utime() << ";";
+            }
+            out_data << m_residency.memory_bytes / 1024 / 1024 << ";";
+            out_data << m_residency.disk_bytes / 1024 / 1024 << ";";
 
             std::string replace_point = out_data.str();
             std::replace(replace_point.begin(), replace_point.end(), '.', ',');
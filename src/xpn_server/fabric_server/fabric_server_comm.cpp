@@ -361,4 +361,62 @@ int64_t fabric_server_comm::writev_data ( const iovec *iov, int64_t count, int r
   return ret;
 }
 
+static lfi_mr_key fabric_rdma_key ( const xpn_server_rdma &rdma )
+{
+  lfi_mr_key key{};
+  key.shm_key  = rdma.shm_key;
+  key.peer_key = rdma.peer_key;
+  return key;
+}
+
+int64_t fabric_server_comm::rdma_get ( void *data, int64_t size, int rank_client_id, const xpn_server_rdma &rdma )
+{
+  XPN_PROFILE_FUNCTION_ARGS(size);
+  int64_t ret = 0;
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_get] >> Begin");
+
+  if (size <= 0) {
+    return size;
+  }
+
+  // Read the payload from the buffer of the client
+  ret = lfi_get(rank_client_id, data, size, rdma.addr, fabric_rdma_key(rdma));
+  if (ret < 0) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_get] ERROR: lfi_get fails "<<lfi_strerror(ret));
+    errno = EIO;
+    return -1;
+  }
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_get] get (RANK "<<rank_client_id<<", ADDR "<<rdma.addr<<") = "<<ret);
+  debug_info("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_get] << End");
+
+  return size;
+}
+
+int64_t fabric_server_comm::rdma_put ( const void *data, int64_t size, int rank_client_id, const xpn_server_rdma &rdma )
+{
+  XPN_PROFILE_FUNCTION_ARGS(size);
+  int64_t ret = 0;
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_put] >> Begin");
+
+  if (size <= 0) {
+    return size;
+  }
+
+  // Write the data in the buffer of the client
+  ret = lfi_put(rank_client_id, data, size, rdma.addr, fabric_rdma_key(rdma));
+  if (ret < 0) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_put] ERROR: lfi_put fails "<<lfi_strerror(ret));
+    errno = EIO;
+    return -1;
+  }
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_put] put (RANK "<<rank_client_id<<", ADDR "<<rdma.addr<<") = "<<ret);
+  debug_info("[Server="<<ns::get_host_name()<<"] [FABRIC_SERVER_COMM] [fabric_server_comm_rdma_put] << End");
+
+  return size;
+}
+
 } // namespace XPN
\ No newline at end of file
@@ -41,6 +41,8 @@ namespace XPN
     int64_t write_data(const void *data, int64_t size, int rank_client_id, int tag_client_id) override;
     int64_t readv_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) override;
     int64_t writev_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) override;
+    int64_t rdma_get(void *data, int64_t size, int rank_client_id, const xpn_server_rdma &rdma) override;
+    int64_t rdma_put(const void *data, int64_t size, int rank_client_id, const xpn_server_rdma &rdma) override;
 
     int64_t get_rank() override { return m_comm; }
     int64_t get_size() override { return 1; }
@@ -21,15 +21,19 @@
 
 #include "xpn_server_filesystem.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 
+#include "xpn_server_filesystem_dedup.hpp"
 #include "xpn_server_filesystem_disk.hpp"
 #include "xpn_server_filesystem_memory.hpp"
 #include "xpn_server_filesystem_xpn.hpp"
 
 namespace XPN {
 
-std::unique_ptr<xpn_server_filesystem> xpn_server_filesystem::Create(filesystem_mode mode) {
+std::unique_ptr<xpn_server_filesystem> xpn_server_filesystem::Create(filesystem_mode mode, const filesystem_options &options) {
     std::unique_ptr<xpn_server_filesystem> ret = nullptr;
     switch (mode) {
         case filesystem_mode::disk: {
@@ -41,15 +45,58 @@ std::unique_ptr<xpn_server_filesystem> xpn_server_filesystem::Create(filesystem_
             break;
         }
         case filesystem_mode::memory: {
-            ret = std::make_unique<xpn_server_filesystem_memory>();
+            ret = std::make_unique<xpn_server_filesystem_memory>(options);
             break;
         }
+        case filesystem_mode::dedup:
+            break;
     }
     if (ret) {
         ret->m_mode = mode;
+        if (!options.dedup_dir.empty()) {
+            ret = std::make_unique<xpn_server_filesystem_dedup>(std::move(ret), options.dedup_dir);
+            ret->m_mode = filesystem_mode::dedup;
+        }
     } else {
         std::cerr << "Error: filesystem mode '" << static_cast<int>(mode) << "' is not defined." << std::endl;
     }
     return ret;
 }
-}  // namespace XPN
\ No newline at end of file
+
+int64_t xpn_server_filesystem::pwritev(int fd, const struct iovec *iov, int iovcnt, int64_t offset) {
+    if (iovcnt == 1) {
+        return pwrite(fd, iov[0].iov_base, iov[0].iov_len, offset);
+    }
+    uint64_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(len);
+    uint64_t pos = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        std::memcpy(buffer.get() + pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    return pwrite(fd, buffer.get(), len, offset);
+}
+
+int64_t xpn_server_filesystem::write_zeros(int fd, uint64_t len, int64_t offset) {
+    static constexpr uint64_t ZEROS_SIZE = 1024 * 1024;
+    static const std::unique_ptr<char[]> zeros = std::make_unique<char[]>(ZEROS_SIZE);
+    uint64_t written = 0;
+    while (written < len) {
+        int64_t ret = pwrite(fd, zeros.get(), std::min(len - written, ZEROS_SIZE), offset + written);
+        if (ret <= 0) {
+            return written > 0 ? (int64_t)written : ret;
+        }
+        written += ret;
+    }
+    return written;
+}
+
+int xpn_server_filesystem::punch_hole([[maybe_unused]] int fd, [[maybe_unused]] uint64_t len,
+                                      [[maybe_unused]] int64_t offset) {
+    errno = EOPNOTSUPP;
+    return -1;
+}
+}  // namespace XPN
@@ -24,21 +24,56 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/uio.h>
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <ostream>
+#include <string>
 
 namespace XPN {
 enum class filesystem_mode {
     disk = 0,
     xpn = 1,
     memory = 2,
+    // Wrapper of the other modes when the deduplication is enabled
+    dedup = 3,
+};
+
+// Where the file data lives, the memory mode moves the cold blocks to disk when it is over its budget
+struct filesystem_residency {
+    std::atomic_uint64_t memory_bytes = 0;
+    std::atomic_uint64_t disk_bytes = 0;
+    std::atomic_uint64_t evictions = 0;
+    std::atomic_uint64_t promotions = 0;
+
+    filesystem_residency() = default;
+    filesystem_residency(const filesystem_residency &other) { *this = other; }
+    filesystem_residency &operator=(const filesystem_residency &other) {
+        if (this != &other) {
+            memory_bytes = other.memory_bytes.load();
+            disk_bytes = other.disk_bytes.load();
+            evictions = other.evictions.load();
+            promotions = other.promotions.load();
+        }
+        return *this;
+    }
+};
+
+struct filesystem_options {
+    // Memory mode: bytes of RAM for the file blocks (0 is unlimited) and directory of the spill file
+    uint64_t memory_budget = 0;
+    std::string memory_spill_dir = "/tmp";
+    // Counters updated by the filesystem, nullptr to use its own
+    filesystem_residency *residency = nullptr;
+    // Directory of the block store of the deduplication, empty to disable it
+    std::string dedup_dir;
 };
 
 class xpn_server_filesystem {
    public:
-    static std::unique_ptr<xpn_server_filesystem> Create(filesystem_mode mode);
+    static std::unique_ptr<xpn_server_filesystem> Create(filesystem_mode mode, const filesystem_options &options = {});
     filesystem_mode m_mode;
 
    public:
@@ -69,6 +104,13 @@ class xpn_server_filesystem {
 
     virtual int64_t pwrite(int fd, const void *data, uint64_t len, int64_t offset) = 0;
     virtual int64_t pread(int fd, void *data, uint64_t len, int64_t offset) = 0;
+    // By default gather the buffers and do one pwrite, the backends with vectored io override it
+    virtual int64_t pwritev(int fd, const struct iovec *iov, int iovcnt, int64_t offset);
+    // The range reads as zeros after it. By default the zeros are written, the backends that can free the space
+    // of the range override it
+    virtual int64_t write_zeros(int fd, uint64_t len, int64_t offset);
+    // Free the space of the range keeping the size of the file, -1 with EOPNOTSUPP when the backend cannot do it
+    virtual int punch_hole(int fd, uint64_t len, int64_t offset);
 
     virtual int mkdir(const char *path, uint32_t mode) = 0;
     virtual ::DIR *opendir(const char *path) = 0;
@@ -0,0 +1,356 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "xpn_server_filesystem_dedup.hpp"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cstring>
+#include <shared_mutex>
+
+#include "base_cpp/debug.hpp"
+
+namespace XPN {
+
+namespace {
+// Scratch buffer of the thread for the blocks that are partially written
+thread_local std::unique_ptr<char[]> t_block_scratch;
+
+char *block_scratch() {
+    if (!t_block_scratch) {
+        t_block_scratch = std::make_unique_for_overwrite<char[]>(xpn_server_filesystem_dedup::BLOCK_SIZE);
+    }
+    return t_block_scratch.get();
+}
+}  // namespace
+
+dedup_block_store::dedup_block_store(xpn_server_filesystem *backend, std::string directory)
+    : m_backend(backend), m_directory(std::move(directory)) {
+    while (m_directory.size() > 1 && m_directory.back() == '/') m_directory.pop_back();
+    if (mkdirs(m_directory) < 0) {
+        print_error("Cannot create the directory of the deduplication '" << m_directory << "'");
+    }
+}
+
+std::string dedup_block_store::path(const xpn_fingerprint &fingerprint) const {
+    std::string name = fingerprint.str();
+    return m_directory + "/" + name.substr(0, 2) + "/" + name;
+}
+
+int dedup_block_store::mkdirs(const std::string &path) {
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        if (m_backend->mkdir(path.substr(0, pos).c_str(), 0755) < 0 && errno != EEXIST) return -1;
+    }
+    if (m_backend->mkdir(path.c_str(), 0755) < 0 && errno != EEXIST) return -1;
+    return 0;
+}
+
+int dedup_block_store::ref(const xpn_fingerprint &fingerprint, const char *data, uint32_t size) {
+    std::unique_lock lock(m_stripes[fingerprint.low % STRIPES].mtx);
+    std::string file = path(fingerprint);
+
+    int fd = m_backend->open(file.c_str(), O_RDWR);
+    if (fd >= 0) {
+        block_header header = {};
+        int64_t res = m_backend->pread(fd, &header, sizeof(header), 0);
+        // The same fingerprint with other size is a corrupted block or a collision, it is not shared
+        if (res == sizeof(header) && header.size == size) {
+            header.refs++;
+            res = m_backend->pwrite(fd, &header, sizeof(header), 0);
+        } else {
+            errno = EIO;
+            res = -1;
+        }
+        m_backend->close(fd);
+        debug_info("Ref block " << file << " = " << res);
+        return res == sizeof(header) ? 1 : -1;
+    }
+    if (errno != ENOENT) return -1;
+    if (data == nullptr) return 0;
+
+    fd = m_backend->open(file.c_str(), O_CREAT | O_WRONLY | O_EXCL, 0644);
+    if (fd < 0 && errno == ENOENT) {
+        m_backend->mkdir(file.substr(0, file.rfind('/')).c_str(), 0755);
+        fd = m_backend->open(file.c_str(), O_CREAT | O_WRONLY | O_EXCL, 0644);
+    }
+    if (fd < 0) return -1;
+
+    block_header header = {1, size, 0};
+    struct iovec iov[2] = {{&header, sizeof(header)}, {const_cast<char *>(data), size}};
+    int64_t res = m_backend->pwritev(fd, iov, 2, 0);
+    m_backend->close(fd);
+    if (res != (int64_t)(sizeof(header) + size)) {
+        m_backend->unlink(file.c_str());
+        return -1;
+    }
+    debug_info("Store block " << file << " of " << size);
+    return 1;
+}
+
+int dedup_block_store::unref(const xpn_fingerprint &fingerprint) {
+    std::unique_lock lock(m_stripes[fingerprint.low % STRIPES].mtx);
+    std::string file = path(fingerprint);
+
+    int fd = m_backend->open(file.c_str(), O_RDWR);
+    if (fd < 0) return -1;
+    block_header header = {};
+    int64_t res = m_backend->pread(fd, &header, sizeof(header), 0);
+    if (res == sizeof(header) && header.refs > 1) {
+        header.refs--;
+        res = m_backend->pwrite(fd, &header, sizeof(header), 0);
+        m_backend->close(fd);
+        return res == sizeof(header) ? 0 : -1;
+    }
+    m_backend->close(fd);
+    debug_info("Remove block " << file);
+    return m_backend->unlink(file.c_str());
+}
+
+int64_t dedup_block_store::read(const xpn_fingerprint &fingerprint, void *data, uint64_t len, int64_t offset) {
+    // The blocks are immutable, only the reference count changes
+    std::string file = path(fingerprint);
+    int fd = m_backend->open(file.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+    int64_t res = m_backend->pread(fd, data, len, sizeof(block_header) + offset);
+    m_backend->close(fd);
+    return res;
+}
+
+int64_t xpn_server_filesystem_dedup::pread(int fd, void *buf, uint64_t len, int64_t offset) {
+    debug_info(" >> BEGIN (" << fd << ", " << buf << ", " << len << ", " << offset << ")");
+    char *out_ptr = static_cast<char *>(buf);
+    uint64_t total_read = 0;
+
+    if (offset < RAW_HEADER_SIZE) {
+        uint64_t to_read_raw = std::min(len, (uint64_t)RAW_HEADER_SIZE - offset);
+        int64_t res = m_backend->pread(fd, out_ptr, to_read_raw, offset);
+        if (res <= 0 || (uint64_t)res >= len) {
+            debug_info(" << HEADER END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << res);
+            return res;
+        }
+        total_read += res;
+    }
+
+    UniqueFile file = get_unique_file(fd);
+    int64_t table_end = -1;
+    while (total_read < len) {
+        int64_t current = offset + total_read;
+        int64_t block_id = (current - RAW_HEADER_SIZE) / BLOCK_SIZE;
+        uint32_t block_off = (current - RAW_HEADER_SIZE) % BLOCK_SIZE;
+
+        std::shared_lock lock(m_locks.get(file, block_id));
+        BlockRef ref = {};
+        int64_t res = m_backend->pread(fd, &ref, REF_SIZE, ref_offset(block_id));
+        if (res < 0) return total_read > 0 ? total_read : res;
+
+        if (ref.size == 0) {
+            // A block not written before the last one of the file reads as zeros
+            if (table_end < 0) {
+                struct ::stat st;
+                table_end = m_backend->fstat(fd, &st) == 0 ? st.st_size : 0;
+            }
+            if (ref_offset(block_id + 1) >= table_end) break;
+            uint32_t to_zero = std::min((uint64_t)(BLOCK_SIZE - block_off), len - total_read);
+            std::memset(out_ptr + total_read, 0, to_zero);
+            total_read += to_zero;
+            continue;
+        }
+        if (block_off >= ref.size) break;
+
+        uint32_t to_read = std::min((uint64_t)(ref.size - block_off), len - total_read);
+        res = m_store.read(ref.fingerprint, out_ptr + total_read, to_read, block_off);
+        if (res < 0) {
+            debug_error("Cannot read the block " << ref.fingerprint.str() << " of the store");
+            return total_read > 0 ? total_read : res;
+        }
+        total_read += res;
+        if (res < to_read || ref.size < BLOCK_SIZE) break;
+    }
+    debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << total_read);
+    return total_read;
+}
+
+int64_t xpn_server_filesystem_dedup::pwrite(int fd, const void *buf, uint64_t len, int64_t offset) {
+    debug_info(" >> BEGIN (" << fd << ", " << buf << ", " << len << ", " << offset << ")");
+    const char *in_ptr = static_cast<const char *>(buf);
+    uint64_t total_written = 0;
+
+    if (offset < RAW_HEADER_SIZE) {
+        uint64_t to_write_raw = std::min(len, (uint64_t)RAW_HEADER_SIZE - offset);
+        int64_t res = m_backend->pwrite(fd, in_ptr, to_write_raw, offset);
+        if (res <= 0 || (uint64_t)res >= len) {
+            debug_info(" << HEADER END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << res);
+            return res;
+        }
+        total_written += res;
+    }
+
+    UniqueFile file = get_unique_file(fd);
+    while (total_written < len) {
+        int64_t current = offset + total_written;
+        uint32_t block_off = (current - RAW_HEADER_SIZE) % BLOCK_SIZE;
+        uint32_t to_write = std::min((uint64_t)(BLOCK_SIZE - block_off), len - total_written);
+        int64_t res = pwrite_block(fd, file, in_ptr + total_written, to_write, current);
+        if (res < 0) return total_written > 0 ? total_written : res;
+        total_written += res;
+    }
+    debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << total_written);
+    return total_written;
+}
+
+int64_t xpn_server_filesystem_dedup::pwrite_block(int fd, const UniqueFile &file, const char *data, uint32_t len,
+                                                  int64_t offset) {
+    int64_t block_id = (offset - RAW_HEADER_SIZE) / BLOCK_SIZE;
+    uint32_t block_off = (offset - RAW_HEADER_SIZE) % BLOCK_SIZE;
+
+    std::unique_lock lock(m_locks.get(file, block_id));
+    BlockRef old_ref = {};
+    if (m_backend->pread(fd, &old_ref, REF_SIZE, ref_offset(block_id)) < 0) return -1;
+
+    // Read, modify and write of the blocks partially written
+    const char *block = data;
+    uint32_t size = len;
+    if (block_off != 0 || len < old_ref.size) {
+        char *scratch = block_scratch();
+        uint32_t old_size = old_ref.size;
+        if (old_size > 0 && m_store.read(old_ref.fingerprint, scratch, old_size, 0) != old_size) {
+            debug_error("Cannot read the block " << old_ref.fingerprint.str() << " of the store");
+            errno = EIO;
+            return -1;
+        }
+        if (old_size < block_off) std::memset(scratch + old_size, 0, block_off - old_size);
+        std::memcpy(scratch + block_off, data, len);
+        block = scratch;
+        size = std::max(old_size, block_off + len);
+    }
+
+    BlockRef new_ref = {xpn_fingerprint::of(block, size), size, 0};
+    if (new_ref.fingerprint == old_ref.fingerprint && new_ref.size == old_ref.size) return len;
+    if (m_store.ref(new_ref.fingerprint, block, size) < 0) return -1;
+    if (set_ref(fd, block_id, old_ref, new_ref) < 0) return -1;
+    return len;
+}
+
+int xpn_server_filesystem_dedup::set_ref(int fd, int64_t block_id, const BlockRef &old_ref, const BlockRef &new_ref) {
+    // The old block is released after the file points to the new one
+    if (m_backend->pwrite(fd, &new_ref, REF_SIZE, ref_offset(block_id)) != REF_SIZE) {
+        m_store.unref(new_ref.fingerprint);
+        return -1;
+    }
+    if (old_ref.size > 0) m_store.unref(old_ref.fingerprint);
+    return 0;
+}
+
+int xpn_server_filesystem_dedup::reference_block(int fd, const xpn_fingerprint &fingerprint, uint32_t size,
+                                                 int64_t offset) {
+    if (offset < RAW_HEADER_SIZE || (offset - RAW_HEADER_SIZE) % BLOCK_SIZE != 0 || size != BLOCK_SIZE) return 0;
+    int64_t block_id = (offset - RAW_HEADER_SIZE) / BLOCK_SIZE;
+
+    std::unique_lock lock(m_locks.get(get_unique_file(fd), block_id));
+    BlockRef old_ref = {};
+    if (m_backend->pread(fd, &old_ref, REF_SIZE, ref_offset(block_id)) < 0) return -1;
+    BlockRef new_ref = {fingerprint, size, 0};
+    if (new_ref.fingerprint == old_ref.fingerprint && new_ref.size == old_ref.size) return 1;
+
+    int ret = m_store.ref(fingerprint, nullptr, size);
+    if (ret <= 0) return ret;
+    if (set_ref(fd, block_id, old_ref, new_ref) < 0) return -1;
+    return 1;
+}
+
+void xpn_server_filesystem_dedup::release(int fd) {
+    struct ::stat st;
+    if (m_backend->fstat(fd, &st) < 0 || st.st_size <= RAW_HEADER_SIZE) return;
+    int64_t num_blocks = (st.st_size - RAW_HEADER_SIZE) / REF_SIZE;
+    UniqueFile file = get_unique_file(fd);
+    const BlockRef empty_ref = {};
+    for (int64_t block_id = 0; block_id < num_blocks; block_id++) {
+        std::unique_lock lock(m_locks.get(file, block_id));
+        BlockRef ref = {};
+        if (m_backend->pread(fd, &ref, REF_SIZE, ref_offset(block_id)) != REF_SIZE || ref.size == 0) continue;
+        // The entry is cleared so the block is not released twice if the file is kept
+        m_backend->pwrite(fd, &empty_ref, REF_SIZE, ref_offset(block_id));
+        m_store.unref(ref.fingerprint);
+    }
+}
+
+void xpn_server_filesystem_dedup::release(const char *path) {
+    int fd = m_backend->open(path, O_RDWR);
+    if (fd < 0) return;
+    release(fd);
+    m_backend->close(fd);
+}
+
+int xpn_server_filesystem_dedup::creat(const char *path, uint32_t mode) {
+    release(path);
+    // The table of the blocks is read in the writes
+    return m_backend->open(path, O_CREAT | O_RDWR | O_TRUNC, mode);
+}
+
+// The partial writes read the table and the block, so the write only opens have to be read write
+static inline int rmw_flags(int flags) {
+    if ((flags & O_ACCMODE) == O_WRONLY) return (flags & ~O_ACCMODE) | O_RDWR;
+    return flags;
+}
+
+int xpn_server_filesystem_dedup::open(const char *path, int flags) {
+    if (flags & O_TRUNC) release(path);
+    return m_backend->open(path, rmw_flags(flags));
+}
+int xpn_server_filesystem_dedup::open(const char *path, int flags, uint32_t mode) {
+    if (flags & O_TRUNC) release(path);
+    return m_backend->open(path, rmw_flags(flags), mode);
+}
+
+int xpn_server_filesystem_dedup::close(int fd) { return m_backend->close(fd); }
+int xpn_server_filesystem_dedup::fsync(int fd) { return m_backend->fsync(fd); }
+
+int xpn_server_filesystem_dedup::unlink(const char *path) {
+    release(path);
+    return m_backend->unlink(path);
+}
+
+int xpn_server_filesystem_dedup::rename(const char *oldPath, const char *newPath) {
+    // The replaced file releases its blocks after the rename
+    int fd = std::strcmp(oldPath, newPath) != 0 ? m_backend->open(newPath, O_RDWR) : -1;
+    int ret = m_backend->rename(oldPath, newPath);
+    if (fd >= 0) {
+        if (ret == 0) release(fd);
+        m_backend->close(fd);
+    }
+    return ret;
+}
+
+int xpn_server_filesystem_dedup::stat(const char *path, struct ::stat *st) { return m_backend->stat(path, st); }
+int xpn_server_filesystem_dedup::fstat(int fd, struct ::stat *st) { return m_backend->fstat(fd, st); }
+
+int xpn_server_filesystem_dedup::mkdir(const char *path, uint32_t mode) { return m_backend->mkdir(path, mode); }
+::DIR *xpn_server_filesystem_dedup::opendir(const char *path) { return m_backend->opendir(path); }
+int xpn_server_filesystem_dedup::closedir(::DIR *dir) { return m_backend->closedir(dir); }
+int xpn_server_filesystem_dedup::rmdir(const char *path) { return m_backend->rmdir(path); }
+struct ::dirent *xpn_server_filesystem_dedup::readdir(::DIR *dir) { return m_backend->readdir(dir); }
+int64_t xpn_server_filesystem_dedup::telldir(::DIR *dir) { return m_backend->telldir(dir); }
+void xpn_server_filesystem_dedup::seekdir(::DIR *dir, int64_t pos) { m_backend->seekdir(dir, pos); }
+int xpn_server_filesystem_dedup::statvfs(const char *path, struct ::statvfs *buff) {
+    return m_backend->statvfs(path, buff);
+}
+}  // namespace XPN
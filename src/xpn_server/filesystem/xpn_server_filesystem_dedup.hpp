@@ -0,0 +1,126 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "base_cpp/xpn_checksum.hpp"
+#include "xpn_server_filesystem.hpp"
+#include "xpn_server_filesystem_lz4.hpp"
+
+namespace XPN {
+// Content addressed store of the deduplicated blocks. Each block is a file named by its fingerprint, with the count of
+// the references of the files to it before the data.
+class dedup_block_store {
+   public:
+    dedup_block_store(xpn_server_filesystem *backend, std::string directory);
+
+    // Add a reference to the block, it is stored when it is new and the data is given.
+    // 1 when the reference is added, 0 when the block is not in the store and there is no data, -1 on error
+    int ref(const xpn_fingerprint &fingerprint, const char *data, uint32_t size);
+    // Remove a reference, the block is deleted with the last one
+    int unref(const xpn_fingerprint &fingerprint);
+    int64_t read(const xpn_fingerprint &fingerprint, void *data, uint64_t len, int64_t offset);
+
+   private:
+    struct block_header {
+        uint64_t refs;
+        uint32_t size;
+        uint32_t reserved;
+    };
+    static constexpr size_t STRIPES = 1024;
+
+    xpn_server_filesystem *m_backend;
+    std::string m_directory;
+    // The reference counts of a block are updated with its stripe locked
+    struct alignas(64) stripe {
+        std::mutex mtx;
+    };
+    std::array<stripe, STRIPES> m_stripes;
+
+    // <directory>/<2 first hex digits>/<fingerprint>
+    std::string path(const xpn_fingerprint &fingerprint) const;
+    int mkdirs(const std::string &path);
+};
+
+// The files are stored as a list of references to the blocks of the store, so the blocks with the same content of
+// all the files are stored once. The raw header of the files is kept as it is, followed by one BlockRef per block.
+class xpn_server_filesystem_dedup : public xpn_server_filesystem {
+   public:
+    static constexpr uint32_t BLOCK_SIZE = 512 * 1024;
+
+    xpn_server_filesystem_dedup(std::unique_ptr<xpn_server_filesystem> backend, const std::string &directory)
+        : m_backend(std::move(backend)), m_store(m_backend.get(), directory) {}
+
+    int creat(const char *path, uint32_t mode) override;
+    int open(const char *path, int flags) override;
+    int open(const char *path, int flags, uint32_t mode) override;
+    int close(int fd) override;
+    int fsync(int fd) override;
+    int unlink(const char *path) override;
+    int rename(const char *oldPath, const char *newPath) override;
+    int stat(const char *path, struct ::stat *st) override;
+    int fstat(int fd, struct ::stat *st) override;
+
+    int64_t pwrite(int fd, const void *data, uint64_t len, int64_t offset) override;
+    int64_t pread(int fd, void *data, uint64_t len, int64_t offset) override;
+
+    // Reference the block of the offset to the block of the store with that fingerprint, without its data.
+    // 1 when it is referenced, 0 when the store has not the block or the range is not a whole block, -1 on error
+    int reference_block(int fd, const xpn_fingerprint &fingerprint, uint32_t size, int64_t offset);
+
+    int mkdir(const char *path, uint32_t mode) override;
+    ::DIR *opendir(const char *path) override;
+    int closedir(::DIR *dir) override;
+    int rmdir(const char *path) override;
+    struct ::dirent *readdir(::DIR *dir) override;
+    int64_t telldir(::DIR *dir) override;
+    void seekdir(::DIR *dir, int64_t pos) override;
+
+    int statvfs(const char *path, struct ::statvfs *buff) override;
+
+   private:
+    struct BlockRef {
+        xpn_fingerprint fingerprint;
+        uint32_t size;  // 0 when the block is not written
+        uint32_t reserved;
+    };
+    static constexpr uint32_t RAW_HEADER_SIZE = 8192;
+    static constexpr uint32_t REF_SIZE = sizeof(BlockRef);
+
+    std::unique_ptr<xpn_server_filesystem> m_backend;
+    dedup_block_store m_store;
+    // Its own table, the compressed files lock their blocks in the global one before writing here
+    BlockLockTable m_locks;
+
+    static int64_t ref_offset(int64_t block_id) { return RAW_HEADER_SIZE + block_id * REF_SIZE; }
+    int64_t pwrite_block(int fd, const UniqueFile &file, const char *data, uint32_t len, int64_t offset);
+    // Point the block to new_ref and drop the reference of old_ref, called with the lock of the block
+    int set_ref(int fd, int64_t block_id, const BlockRef &old_ref, const BlockRef &new_ref);
+    // Drop the references of all the blocks of the file
+    void release(int fd);
+    void release(const char *path);
+};
+}  // namespace XPN
@@ -114,6 +114,40 @@ int64_t xpn_server_filesystem_disk::pread(int fd, void *data, uint64_t len, int6
     return ret;
 }
 
+int64_t xpn_server_filesystem_disk::pwritev(int fd, const struct iovec *iov, int iovcnt, int64_t offset) {
+    debug_info(" >> BEGIN");
+    auto ret = filesystem::pwritev(fd, iov, iovcnt, offset);
+    debug_info(" << END");
+    return ret;
+}
+
+int64_t xpn_server_filesystem_disk::write_zeros(int fd, uint64_t len, int64_t offset) {
+    debug_info(" >> BEGIN");
+    // The hole keeps the size, so the file is extended when the zeros go past the end. It is extended writing their
+    // last byte, a truncate could shrink it under a concurrent write past them
+    if (punch_hole(fd, len, offset) < 0) {
+        auto ret = xpn_server_filesystem::write_zeros(fd, len, offset);
+        debug_info(" << END");
+        return ret;
+    }
+    struct ::stat st;
+    const char zero = 0;
+    if (len > 0 && (fstat(fd, &st) < 0 || (st.st_size < offset + (int64_t)len &&
+                                           filesystem::pwrite(fd, &zero, 1, offset + len - 1) != 1))) {
+        debug_info(" << END");
+        return -1;
+    }
+    debug_info(" << END");
+    return len;
+}
+
+int xpn_server_filesystem_disk::punch_hole(int fd, uint64_t len, int64_t offset) {
+    debug_info(" >> BEGIN");
+    auto ret = filesystem::punch_hole(fd, len, offset);
+    debug_info(" << END");
+    return ret;
+}
+
 int xpn_server_filesystem_disk::mkdir(const char *path, uint32_t mode) {
     debug_info(" >> BEGIN");
     auto ret = PROXY(mkdir)(path, mode);
@@ -39,6 +39,9 @@ class xpn_server_filesystem_disk : public xpn_server_filesystem {
 
     int64_t pwrite(int fd, const void *data, uint64_t len, int64_t offset) override;
     int64_t pread(int fd, void *data, uint64_t len, int64_t offset) override;
+    int64_t pwritev(int fd, const struct iovec *iov, int iovcnt, int64_t offset) override;
+    int64_t write_zeros(int fd, uint64_t len, int64_t offset) override;
+    int punch_hole(int fd, uint64_t len, int64_t offset) override;
 
     int mkdir(const char *path, uint32_t mode) override;
     ::DIR *opendir(const char *path) override;
@@ -20,30 +20,116 @@
 // #define DEBUG
 #include "xpn_server_filesystem_lz4.hpp"
 
+#include <fcntl.h>
 #include <sys/uio.h>
 
-#include <optional>
+#include <atomic>
+#include <iostream>
 
 #include "base_cpp/debug.hpp"
-#include "base_cpp/filesystem.hpp"
+#include "base_cpp/parallel_for.hpp"
+#include "base_cpp/xpn_sparse.hpp"
+#include "xpn_server_filesystem_lz4_cache.hpp"
 
 namespace XPN {
 inline int xpn_server_filesystem_lz4::compress(const char *src, char *dst, int srcSize, int dstCapacity) {
-    return LZ4_compress_fast(src, dst, srcSize, dstCapacity, 10);
+    if (auto dict = block_dictionary(srcSize)) {
+        return dict->compress(m_codec, src, dst, srcSize, dstCapacity);
+    }
+    return m_codec.compress(src, dst, srcSize, dstCapacity);
+}
+
+inline int xpn_server_filesystem_lz4::verify(const BlockHeader &header, const char *data, int size) const {
+    if (size < 0 || !m_checksums || header.checksum == 0) return size;
+    if (xpn_checksum(data, size) != header.checksum) {
+        debug_error("Error: checksum mismatch in a block of " << format_bytes(size));
+        errno = EIO;
+        return -1;
+    }
+    return size;
+}
+
+inline int xpn_server_filesystem_lz4::decompress(const BlockHeader &header, const char *src, char *dst,
+                                                 int dstCapacity) {
+    if (header.compressed_size == 0) {
+        if (header.uncompressed_size > (uint32_t)dstCapacity) return -1;
+        std::memset(dst, 0, header.uncompressed_size);
+        return header.uncompressed_size;
+    }
+    if (header.dict_id != 0) {
+        // The dictionary of the block can be other than the current one of the partition
+        auto dict = m_dict && m_dict->id() == header.dict_id ? m_dict : xpn_dictionary::get(header.dict_id);
+        if (!dict) {
+            debug_error("Error: dictionary " << std::hex << header.dict_id << std::dec << " of the block not found");
+            return -1;
+        }
+        return verify(header, dst, dict->decompress(src, dst, header.compressed_size, dstCapacity));
+    }
+    return verify(header, dst, xpn_codec::decompress(header.codec, src, dst, header.compressed_size, dstCapacity));
 }
 
-inline int xpn_server_filesystem_lz4::decompress(const char *src, char *dst, int srcSize, int dstCapacity) {
-    return LZ4_decompress_safe(src, dst, srcSize, dstCapacity);
+inline xpn_server_filesystem_lz4::BlockHeader xpn_server_filesystem_lz4::make_header(
+    uint32_t compressed_size, uint32_t uncompressed_size, const char *uncompressed) const {
+    auto dict = block_dictionary(uncompressed_size);
+    uint64_t checksum = m_checksums && uncompressed ? xpn_checksum(uncompressed, uncompressed_size) : 0;
+    BlockHeader header = {};
+    header.compressed_size = compressed_size;
+    header.uncompressed_size = uncompressed_size;
+    header.magic = BlockHeader::MAGIC;
+    header.version = BlockHeader::VERSION;
+    header.codec = m_codec.type;
+    header.level = m_codec.level;
+    header.dict_id = dict ? dict->id() : 0;
+    header.checksum = checksum;
+    return header;
 }
 
+int64_t xpn_server_filesystem_lz4::read_header(const char *slot, int64_t len, BlockHeader &header) const {
+    // The blocks that cannot be read are reported once, the requests fail with EIO
+    static std::atomic_bool reported = false;
+    int64_t data_off = BlockHeader::parse(slot, std::max<int64_t>(len, 0), header);
+    const char *error = nullptr;
+    if (data_off < 0) {
+        error = "a block of an unknown version of the compressed layout";
+    } else if (data_off == BlockHeader::LEGACY_SIZE && header.uncompressed_size != 0 &&
+               (!m_legacy_slots || header.uncompressed_size > LOGICAL_BLOCK_SIZE ||
+                header.compressed_size > PHYSICAL_BLOCK_SIZE - BlockHeader::LEGACY_SIZE)) {
+        error = "a block of the old compressed layout that cannot be read with this block size";
+    }
+    if (error) {
+        if (!reported.exchange(true)) {
+            std::cerr << "Error: the compressed files have " << error << std::endl;
+        }
+        debug_error("Error: " << error);
+        errno = EIO;
+        return -1;
+    }
+    return data_off;
+}
+
+namespace {
+// Scratch buffers of the thread, they only grow, so the workers reuse them between requests
+struct scratch_buffer {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+
+    char *get(size_t len) {
+        if (len > size) {
+            data = std::make_unique_for_overwrite<char[]>(len);
+            size = len;
+        }
+        return data.get();
+    }
+};
+thread_local scratch_buffer t_comp_scratch;
+thread_local scratch_buffer t_uncomp_scratch;
+}  // namespace
+
 int64_t xpn_server_filesystem_lz4::pread(int fd, void *buf, uint64_t len, int64_t offset) {
     debug_info(" >> BEGIN (" << fd << ", " << buf << ", " << len << ", " << offset << ")");
     uint8_t *out_ptr = static_cast<uint8_t *>(buf);
     uint64_t total_read = 0;
 
-    std::unique_ptr<char[]> uncomp_scratch;
-    auto comp_scratch = std::make_unique_for_overwrite<char[]>(MAX_COMP_SIZE);
-
     if (offset < RAW_HEADER_SIZE) {
         uint64_t to_read_raw = std::min(len, (uint64_t)RAW_HEADER_SIZE - offset);
         int64_t res = m_backend->pread(fd, out_ptr, to_read_raw, offset);
@@ -58,52 +144,151 @@ int64_t xpn_server_filesystem_lz4::pread(int fd, void *buf, uint64_t len, int64_
         }
     }
 
-    while (total_read < len) {
+    auto &cache = LZ4BlockCache::get_instance();
+    auto &lock_table = BlockLockTable::get_instance();
+    UniqueFile file = get_unique_file(fd);
+    const uint64_t max_run = std::max<uint64_t>(1, READ_RUN_BYTES / PHYSICAL_BLOCK_SIZE);
+
+    bool eof = false;
+    while (total_read < len && !eof) {
         int64_t current_logical = offset + total_read;
-        int64_t phys_pos = get_physical_offset(current_logical);
+        int64_t block_id = (current_logical - RAW_HEADER_SIZE) / LOGICAL_BLOCK_SIZE;
         uint32_t block_internal_off = (current_logical - RAW_HEADER_SIZE) % LOGICAL_BLOCK_SIZE;
 
-        BlockHeader header;
-        if (m_backend->pread(fd, &header, META_SIZE, phys_pos) != META_SIZE) break;
+        if (auto block = cache.get(file, LOGICAL_BLOCK_SIZE, block_id)) {
+            if (block_internal_off >= block->size) break;
+            uint32_t to_read_now = std::min((uint64_t)(block->size - block_internal_off), len - total_read);
+            std::memcpy(out_ptr + total_read, block->data.get() + block_internal_off, to_read_now);
+            debug_info("Cache hit block " << block_id << " memcpy " << format_bytes(to_read_now));
+            total_read += to_read_now;
+            if (block->size < LOGICAL_BLOCK_SIZE) break;
+            continue;
+        }
 
-        if (m_backend->pread(fd, comp_scratch.get(), header.compressed_size, phys_pos + META_SIZE) !=
-            (int64_t)header.compressed_size)
-            break;
+        // The physical blocks are contiguous, so the blocks left of the request are read with one I/O up to the
+        // next cached one
+        uint64_t run = std::min(max_run, (block_internal_off + (len - total_read) + LOGICAL_BLOCK_SIZE - 1) /
+                                             LOGICAL_BLOCK_SIZE);
+        for (uint64_t i = 1; i < run; i++) {
+            if (cache.get(file, LOGICAL_BLOCK_SIZE, block_id + i)) {
+                run = i;
+                break;
+            }
+        }
 
-        uint32_t avail_in_block = header.uncompressed_size - block_internal_off;
-        uint32_t to_read_now = std::min((uint32_t)(len - total_read), avail_in_block);
+        // Lock the stripes in order, the blocks cannot be partially rewritten between the read and the cache fill. The
+        // full block writes can, the generations of the blocks say if the run has to be read again
+        std::vector<std::shared_mutex *> stripes;
+        stripes.reserve(run);
+        for (uint64_t i = 0; i < run; i++) {
+            stripes.emplace_back(&lock_table.get(file, block_id + i));
+        }
+        std::sort(stripes.begin(), stripes.end());
+        stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+        std::vector<std::shared_lock<std::shared_mutex>> block_locks;
+        block_locks.reserve(stripes.size());
+        for (auto stripe : stripes) {
+            block_locks.emplace_back(*stripe);
+        }
+        std::vector<uint64_t> generations(run);
+        for (uint64_t i = 0; i < run; i++) {
+            generations[i] = lock_table.generation(file, block_id + i);
+        }
+        auto written_while_read = [&]() {
+            for (uint64_t i = 0; i < run; i++) {
+                if (lock_table.generation(file, block_id + i) != generations[i]) return true;
+            }
+            return false;
+        };
 
-        if (block_internal_off == 0 && to_read_now == LOGICAL_BLOCK_SIZE) {
-            int decomp_res = decompress(comp_scratch.get(), reinterpret_cast<char *>(out_ptr + total_read),
-                                        header.compressed_size, LOGICAL_BLOCK_SIZE);
-            if (decomp_res < 0) {
+        char *comp_scratch = t_comp_scratch.get(run * PHYSICAL_BLOCK_SIZE);
+        int64_t res = m_backend->pread(fd, comp_scratch, run * PHYSICAL_BLOCK_SIZE, get_physical_offset(current_logical));
+        if (res < 0) {
+            debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << res);
+            return total_read > 0 ? (int64_t)total_read : res;
+        }
+
+        // The headers say how much of each block is read and where it goes, then they are decompressed in parallel
+        struct block_read {
+            const char *slot;
+            int64_t data_off;
+            BlockHeader header;
+            uint32_t internal_off;
+            uint32_t to_read;
+            char *out;
+        };
+        std::vector<block_read> blocks;
+        blocks.reserve(run);
+        uint64_t run_read = 0;
+        for (uint64_t i = 0; i < run; i++) {
+            block_read block;
+            block.slot = comp_scratch + i * PHYSICAL_BLOCK_SIZE;
+            int64_t slot_len = std::min<int64_t>(res - (int64_t)(i * PHYSICAL_BLOCK_SIZE), PHYSICAL_BLOCK_SIZE);
+            if (slot_len <= 0) {
+                eof = true;
+                break;
+            }
+            block.data_off = read_header(block.slot, slot_len, block.header);
+            if (block.data_off < 0) {
+                // A header torn by a full block write is read again
+                if (written_while_read()) break;
                 debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << -1);
                 return -1;
             }
-            debug_info("Decompress from " << format_bytes(header.compressed_size) << " to "
-                                          << format_bytes(LOGICAL_BLOCK_SIZE) << " ratio "
-                                          << ((double)header.compressed_size / LOGICAL_BLOCK_SIZE));
-        } else {
-            if (!uncomp_scratch) uncomp_scratch = std::make_unique_for_overwrite<char[]>(LOGICAL_BLOCK_SIZE);
+            if (block.header.uncompressed_size == 0 || block_internal_off >= block.header.uncompressed_size ||
+                block.header.compressed_size > slot_len - block.data_off) {
+                eof = true;
+                break;
+            }
+            block.internal_off = block_internal_off;
+            block.to_read = std::min((uint64_t)(block.header.uncompressed_size - block_internal_off),
+                                     len - total_read - run_read);
+            block.out = reinterpret_cast<char *>(out_ptr + total_read + run_read);
+            blocks.emplace_back(block);
+
+            run_read += block.to_read;
+            block_internal_off = 0;
+            if (block.header.uncompressed_size < LOGICAL_BLOCK_SIZE) {
+                eof = true;
+                break;
+            }
+        }
 
-            int decomp_res =
-                decompress(comp_scratch.get(), uncomp_scratch.get(), header.compressed_size, LOGICAL_BLOCK_SIZE);
-            debug_info("Decompress from " << format_bytes(header.compressed_size) << " to "
-                                          << format_bytes(LOGICAL_BLOCK_SIZE) << " ratio "
-                                          << ((double)header.compressed_size / LOGICAL_BLOCK_SIZE));
+        std::atomic_bool decomp_error = false;
+        parallel_for(m_workers, blocks.size(), [&](size_t i) {
+            auto &block = blocks[i];
+            // The whole block goes directly to the user buffer, only the partial ones need the scratch
+            bool direct = block.internal_off == 0 && block.to_read == block.header.uncompressed_size;
+            char *uncomp = direct ? block.out : t_uncomp_scratch.get(LOGICAL_BLOCK_SIZE);
+
+            int decomp_res = decompress(block.header, block.slot + block.data_off, uncomp,
+                                        direct ? block.header.uncompressed_size : LOGICAL_BLOCK_SIZE);
+            debug_info("Decompress from " << format_bytes(block.header.compressed_size) << " to "
+                                          << format_bytes(block.header.uncompressed_size) << " ratio "
+                                          << ((double)block.header.compressed_size / block.header.uncompressed_size));
             if (decomp_res < 0) {
-                debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << -1);
-                return -1;
+                decomp_error = true;
+                return;
             }
-
-            std::memcpy(out_ptr + total_read, uncomp_scratch.get() + block_internal_off, to_read_now);
-
-            debug_info("memcpy " << format_bytes(to_read_now));
+            if (!direct) {
+                std::memcpy(block.out, uncomp + block.internal_off, block.to_read);
+                debug_info("memcpy " << format_bytes(block.to_read));
+            }
+            cache.put(file, LOGICAL_BLOCK_SIZE, block_id + i, uncomp, block.header.uncompressed_size,
+                      lock_table.generation(file, block_id + i), generations[i]);
+        });
+        if (written_while_read()) {
+            debug_info("Blocks from " << block_id << " written while read, read again");
+            eof = false;
+            continue;
         }
-
-        total_read += to_read_now;
-
-        if (header.uncompressed_size < LOGICAL_BLOCK_SIZE) break;
+        if (decomp_error) {
+            // Corrupted block or wrong checksum, the errno of the workers is not the one of this thread
+            errno = EIO;
+            debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << -1);
+            return -1;
+        }
+        total_read += run_read;
     }
     debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << total_read);
     return total_read;
@@ -114,10 +299,6 @@ int64_t xpn_server_filesystem_lz4::pwrite(int fd, const void *buf, uint64_t len,
     const uint8_t *in_ptr = static_cast<const uint8_t *>(buf);
     uint64_t total_written = 0;
 
-    // Function-local buffers to ensure thread isolation
-    auto uncomp_scratch = std::make_unique_for_overwrite<char[]>(LOGICAL_BLOCK_SIZE);
-    auto comp_scratch = std::make_unique_for_overwrite<char[]>(MAX_COMP_SIZE);
-
     if (offset < RAW_HEADER_SIZE) {
         uint64_t to_write_raw = std::min(len, (uint64_t)RAW_HEADER_SIZE - offset);
         int64_t res = m_backend->pwrite(fd, in_ptr, to_write_raw, offset);
@@ -132,72 +313,196 @@ int64_t xpn_server_filesystem_lz4::pwrite(int fd, const void *buf, uint64_t len,
         }
     }
 
-    while (total_written < len) {
-        int64_t current_logical = offset + total_written;
-        int64_t block_id = (current_logical - RAW_HEADER_SIZE) / LOGICAL_BLOCK_SIZE;
-        int64_t phys_pos = get_physical_offset(current_logical);
-        uint32_t block_off = (current_logical - RAW_HEADER_SIZE) % LOGICAL_BLOCK_SIZE;
-        uint32_t to_write = std::min((uint32_t)(len - total_written), LOGICAL_BLOCK_SIZE - block_off);
+    UniqueFile file = get_unique_file(fd);
+    uint64_t remaining = len - total_written;
+    int64_t first_logical = offset + total_written;
+    uint32_t first_off = (first_logical - RAW_HEADER_SIZE) % LOGICAL_BLOCK_SIZE;
+    uint64_t num_blocks = (first_off + remaining + LOGICAL_BLOCK_SIZE - 1) / LOGICAL_BLOCK_SIZE;
+
+    // The blocks are independent, each one is compressed and written to its own slot by one task
+    std::vector<int64_t> results(num_blocks);
+    parallel_for(m_workers, num_blocks, [&](size_t i) {
+        uint64_t start = i == 0 ? 0 : (uint64_t)(LOGICAL_BLOCK_SIZE - first_off) + (i - 1) * LOGICAL_BLOCK_SIZE;
+        uint32_t block_off = i == 0 ? first_off : 0;
+        uint32_t to_write = std::min((uint64_t)(LOGICAL_BLOCK_SIZE - block_off), remaining - start);
+        results[i] = pwrite_block(fd, file, in_ptr + total_written + start, to_write, first_logical + start);
+    });
+
+    // Only the blocks before the first error count as written
+    int64_t written = total_written;
+    for (auto result : results) {
+        if (result < 0) {
+            if (written == 0) written = result;
+            break;
+        }
+        written += result;
+    }
+    debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << written);
+    return written;
+}
 
-        const char *source_ptr = nullptr;
-        uint32_t current_uncomp_sz = 0;
-        std::optional<unique_block_lock> block_lock;
+int64_t xpn_server_filesystem_lz4::pwrite_block(int fd, const UniqueFile &file, const uint8_t *in_ptr,
+                                                uint32_t to_write, int64_t logical_offset) {
+    debug_info(" >> BEGIN (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", " << logical_offset << ")");
+    auto &cache = LZ4BlockCache::get_instance();
+    int64_t block_id = (logical_offset - RAW_HEADER_SIZE) / LOGICAL_BLOCK_SIZE;
+    int64_t phys_pos = get_physical_offset(logical_offset);
+    uint32_t block_off = (logical_offset - RAW_HEADER_SIZE) % LOGICAL_BLOCK_SIZE;
+    bool full_block = block_off == 0 && to_write == LOGICAL_BLOCK_SIZE;
+    // The header goes just before the compressed data, so the block is written with one I/O
+    char *comp_scratch = t_comp_scratch.get(PHYSICAL_BLOCK_SIZE);
+
+    const char *source_ptr = nullptr;
+    uint32_t current_uncomp_sz = 0;
+    // The full blocks with data do not read the slot and write it with one pwrite, they only lock it shared
+    auto &lock_table = BlockLockTable::get_instance();
+    bool zero_block = full_block && xpn_is_zero(in_ptr, LOGICAL_BLOCK_SIZE);
+    bool shared = full_block && !zero_block;
+    std::shared_lock shared_lock(lock_table.get(file, block_id), std::defer_lock);
+    std::unique_lock block_lock(lock_table.get(file, block_id), std::defer_lock);
+    if (shared) {
+        shared_lock.lock();
+    } else {
+        block_lock.lock();
+    }
 
-        if (block_off == 0 && to_write == LOGICAL_BLOCK_SIZE) {
-            source_ptr = reinterpret_cast<const char *>(in_ptr + total_written);
-            current_uncomp_sz = LOGICAL_BLOCK_SIZE;
+    if (full_block) {
+        source_ptr = reinterpret_cast<const char *>(in_ptr);
+        current_uncomp_sz = LOGICAL_BLOCK_SIZE;
+    } else {
+        // Read-Modify-Write (RMW), from the cache when the block is there
+        char *uncomp_scratch = t_uncomp_scratch.get(LOGICAL_BLOCK_SIZE);
+        if (auto block = cache.get(file, LOGICAL_BLOCK_SIZE, block_id)) {
+            std::memcpy(uncomp_scratch, block->data.get(), block->size);
+            current_uncomp_sz = block->size;
+            debug_info("Cache hit Read-Modify-Write block " << block_id);
         } else {
-            block_lock.emplace(this, fd, block_id);
-            if (!uncomp_scratch) uncomp_scratch = std::make_unique_for_overwrite<char[]>(LOGICAL_BLOCK_SIZE);
-
-            // Read-Modify-Write (RMW)
+            int64_t res = m_backend->pread(fd, comp_scratch, PHYSICAL_BLOCK_SIZE, phys_pos);
+            if (res < 0) {
+                debug_info(" << END (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", " << logical_offset
+                                       << ") = " << res);
+                return res;
+            }
             BlockHeader old_h;
-            if (m_backend->pread(fd, &old_h, META_SIZE, phys_pos) == META_SIZE) {
-                m_backend->pread(fd, comp_scratch.get(), old_h.compressed_size, phys_pos + META_SIZE);
-                decompress(comp_scratch.get(), uncomp_scratch.get(), old_h.compressed_size, LOGICAL_BLOCK_SIZE);
+            int64_t data_off = read_header(comp_scratch, res, old_h);
+            if (data_off < 0) {
+                debug_info(" << END (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", " << logical_offset
+                                       << ") = " << -1);
+                return -1;
+            }
+            if (old_h.uncompressed_size != 0) {
+                if (old_h.compressed_size > res - data_off ||
+                    decompress(old_h, comp_scratch + data_off, uncomp_scratch, LOGICAL_BLOCK_SIZE) < 0) {
+                    debug_info(" << END (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", "
+                                           << logical_offset << ") = " << -1);
+                    return -1;
+                }
                 current_uncomp_sz = old_h.uncompressed_size;
                 debug_info("Decompress Read-Modify-Write from "
-                           << format_bytes(old_h.compressed_size) << " to " << format_bytes(LOGICAL_BLOCK_SIZE)
-                           << " ratio " << ((double)LOGICAL_BLOCK_SIZE / old_h.compressed_size));
+                           << format_bytes(old_h.compressed_size) << " to " << format_bytes(current_uncomp_sz)
+                           << " ratio " << ((double)current_uncomp_sz / old_h.compressed_size));
             }
+        }
+
+        // The gap before the new data is a hole
+        if (current_uncomp_sz < block_off) {
+            std::memset(uncomp_scratch + current_uncomp_sz, 0, block_off - current_uncomp_sz);
+        }
+        std::memcpy(uncomp_scratch + block_off, in_ptr, to_write);
+        debug_info("memcpy " << format_bytes(to_write));
+        current_uncomp_sz = std::max(current_uncomp_sz, block_off + to_write);
+        source_ptr = uncomp_scratch;
+        zero_block = xpn_is_zero(source_ptr, current_uncomp_sz);
+    }
 
-            std::memcpy(uncomp_scratch.get() + block_off, in_ptr + total_written, to_write);
-            debug_info("memcpy " << format_bytes(to_write));
-            current_uncomp_sz = std::max(current_uncomp_sz, block_off + to_write);
-            source_ptr = uncomp_scratch.get();
+    if (zero_block) {
+        auto ret = pwrite_zero_block(fd, phys_pos, current_uncomp_sz);
+        if (ret < 0) {
+            debug_info(" << END (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", " << logical_offset
+                                   << ") = " << ret);
+            return ret;
         }
+        cache.erase(file, LOGICAL_BLOCK_SIZE, block_id);
+        debug_info(" << END zero block (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", "
+                                          << logical_offset << ") = " << to_write);
+        return to_write;
+    }
 
-        int c_size = compress(source_ptr, comp_scratch.get(), current_uncomp_sz, MAX_COMP_SIZE);
-        debug_info("Compress from " << format_bytes(current_uncomp_sz) << " to " << format_bytes(c_size) << " ratio "
-                                    << ((double)c_size / current_uncomp_sz));
+    int c_size = compress(source_ptr, comp_scratch + META_SIZE, current_uncomp_sz, MAX_COMP_SIZE);
+    if (c_size <= 0) {
+        debug_info(" << END (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", " << logical_offset
+                               << ") = " << -1);
+        return -1;
+    }
+    debug_info("Compress from " << format_bytes(current_uncomp_sz) << " to " << format_bytes(c_size) << " ratio "
+                                << ((double)c_size / current_uncomp_sz));
+
+    BlockHeader new_h = make_header(c_size, current_uncomp_sz, source_ptr);
+    std::memcpy(comp_scratch, &new_h, META_SIZE);
+    // The reads that overlap the write of a shared locked block see the generation changed
+    if (shared) lock_table.generation(file, block_id)++;
+    auto ret = m_backend->pwrite(fd, comp_scratch, META_SIZE + c_size, phys_pos);
+    if (shared) lock_table.generation(file, block_id)++;
+    if (ret < 0) {
+        debug_info(" << END (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", " << logical_offset
+                               << ") = " << ret);
+        return ret;
+    }
 
-        BlockHeader new_h = {(uint32_t)c_size, current_uncomp_sz};
+    // The full blocks are not cached, a stream of writes would only evict the blocks being modified
+    if (full_block) {
+        cache.erase(file, LOGICAL_BLOCK_SIZE, block_id);
+    } else {
+        cache.put(file, LOGICAL_BLOCK_SIZE, block_id, source_ptr, current_uncomp_sz);
+    }
 
-        if (m_backend->m_mode == filesystem_mode::disk) {
-            struct iovec iov[2] = {{.iov_base = &new_h, .iov_len = META_SIZE},
-                                   {.iov_base = comp_scratch.get(), .iov_len = (uint32_t)c_size}};
-            auto ret = filesystem::pwritev(fd, iov, 2, phys_pos);
-            if (ret < 0) {
-                debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << ret);
-                return ret;
-            }
+    debug_info(" << END (" << fd << ", " << (void *)in_ptr << ", " << to_write << ", " << logical_offset << ") = "
+                           << to_write);
+    return to_write;
+}
+
+int64_t xpn_server_filesystem_lz4::pwrite_zero_block(int fd, int64_t phys_pos, uint32_t uncompressed_size) {
+    BlockHeader header = make_header(0, uncompressed_size, nullptr);
+    header.dict_id = 0;
+    auto ret = m_backend->pwrite(fd, &header, META_SIZE, phys_pos);
+    if (ret < 0) return ret;
+    // The slots are aligned, so all the slot but the page of the header can be freed, the backends that cannot do
+    // it keep the old data, that is not read anymore
+    m_backend->punch_hole(fd, PHYSICAL_BLOCK_SIZE - ALIGNMENT, phys_pos + ALIGNMENT);
+    debug_info("Zero block of " << format_bytes(uncompressed_size) << " in " << phys_pos);
+    return uncompressed_size;
+}
+
+int64_t xpn_server_filesystem_lz4::write_zeros(int fd, uint64_t len, int64_t offset) {
+    debug_info(" >> BEGIN (" << fd << ", " << len << ", " << offset << ")");
+    auto &cache = LZ4BlockCache::get_instance();
+    UniqueFile file = get_unique_file(fd);
+    uint64_t total = 0;
+    // The whole blocks only write their header, the raw header and the partial blocks go by pwrite
+    while (total < len) {
+        int64_t current = offset + total;
+        uint64_t remaining = len - total;
+        int64_t ret;
+        if (current >= RAW_HEADER_SIZE && (current - RAW_HEADER_SIZE) % LOGICAL_BLOCK_SIZE == 0 &&
+            remaining >= LOGICAL_BLOCK_SIZE) {
+            int64_t block_id = (current - RAW_HEADER_SIZE) / LOGICAL_BLOCK_SIZE;
+            std::unique_lock block_lock(BlockLockTable::get_instance().get(file, block_id));
+            ret = pwrite_zero_block(fd, get_physical_offset(current), LOGICAL_BLOCK_SIZE);
+            cache.erase(file, LOGICAL_BLOCK_SIZE, block_id);
         } else {
-            auto ret = m_backend->pwrite(fd, &new_h, META_SIZE, phys_pos);
-            if (ret < 0) {
-                debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << ret);
-                return ret;
-            }
-            ret = m_backend->pwrite(fd, comp_scratch.get(), c_size, phys_pos + META_SIZE);
-            if (ret < 0) {
-                debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << ret);
-                return ret;
-            }
+            uint64_t to_next = current < RAW_HEADER_SIZE
+                                   ? RAW_HEADER_SIZE - current
+                                   : LOGICAL_BLOCK_SIZE - (current - RAW_HEADER_SIZE) % LOGICAL_BLOCK_SIZE;
+            ret = xpn_server_filesystem::write_zeros(fd, std::min(remaining, to_next), current);
         }
-
-        total_written += to_write;
+        if (ret <= 0) {
+            debug_info(" << END (" << fd << ", " << len << ", " << offset << ") = " << ret);
+            return total > 0 ? (int64_t)total : ret;
+        }
+        total += ret;
     }
-    debug_info(" << END (" << fd << ", " << buf << ", " << len << ", " << offset << ") = " << total_written);
-    return total_written;
+    debug_info(" << END (" << fd << ", " << len << ", " << offset << ") = " << total);
+    return total;
 }
 
 bool xpn_server_filesystem_lz4::is_aligned_for_direct_io(int64_t offset, uint64_t uncompressed_size) const {
@@ -214,7 +519,8 @@ bool xpn_server_filesystem_lz4::is_aligned_for_direct_io(int64_t offset, uint64_
 }
 
 int64_t xpn_server_filesystem_lz4::pread_compressed_block(int fd, void *comp_buf, int64_t offset, uint32_t &comp_size,
-                                                          uint32_t &uncomp_size) {
+                                                          uint32_t &uncomp_size, uint32_t &dict_id,
+                                                          uint64_t &checksum) {
     debug_info(" >> BEGIN (" << fd << ", " << comp_buf << ", " << offset << ")");
     BlockHeader header;
     // 1. Alignment check: Must be exactly aligned to a logical block
@@ -225,28 +531,55 @@ int64_t xpn_server_filesystem_lz4::pread_compressed_block(int fd, void *comp_buf
     }
 
     int64_t phys_pos = get_physical_offset(offset);
+    // The block can be torn by a full block write, then it goes by the decompression path that reads it again
+    int64_t block_id = (offset - RAW_HEADER_SIZE) / LOGICAL_BLOCK_SIZE;
+    UniqueFile file = get_unique_file(fd);
+    auto &lock_table = BlockLockTable::get_instance();
+    std::shared_lock block_lock(lock_table.get(file, block_id));
+    uint64_t generation = lock_table.generation(file, block_id);
 
     // 2. Read the header (metadata)
-    if (m_backend->pread(fd, &header, META_SIZE, phys_pos) != META_SIZE) {
+    char raw_header[META_SIZE];
+    int64_t header_len = m_backend->pread(fd, raw_header, META_SIZE, phys_pos);
+    int64_t data_off = header_len > 0 ? read_header(raw_header, header_len, header) : -1;
+    if (data_off < 0) {
         debug_info(" << END (" << fd << ", " << comp_buf << ", " << offset << ") = " << -1);
         return -1;
     }
     comp_size = header.compressed_size;
     uncomp_size = header.uncompressed_size;
+    dict_id = header.dict_id;
+    checksum = header.checksum;
+    if (header.dict_id != 0 && (!m_dict || m_dict->id() != header.dict_id)) {
+        debug_info("pread_compressed_block failed: Block compressed with other dictionary.");
+        debug_info(" << END (" << fd << ", " << comp_buf << ", " << offset << ") = " << -1);
+        return -1;
+    }
 
     // If the logical block is empty, return early
     if (header.uncompressed_size == 0) {
         debug_info(" << END (" << fd << ", " << comp_buf << ", " << offset << ") = " << 0);
         return 0;
     }
+    // The blocks of zeros have no compressed data to send, they go by the decompression path
+    if (header.compressed_size == 0) {
+        debug_info("pread_compressed_block failed: Block of zeros.");
+        debug_info(" << END (" << fd << ", " << comp_buf << ", " << offset << ") = " << -1);
+        return -1;
+    }
 
     // 3. Read the compressed data directly into the user's buffer
-    int64_t bytes_read = m_backend->pread(fd, comp_buf, header.compressed_size, phys_pos + META_SIZE);
+    int64_t bytes_read = m_backend->pread(fd, comp_buf, header.compressed_size, phys_pos + data_off);
     if (bytes_read != (int64_t)header.compressed_size) {
         debug_info(" << END readed (" << bytes_read << ") is not compressed_size (" << header.compressed_size << ") ("
                                       << fd << ", " << comp_buf << ", " << offset << ") = " << -1);
         return -1;
     }
+    if (lock_table.generation(file, block_id) != generation) {
+        debug_info("pread_compressed_block failed: Block written while read.");
+        debug_info(" << END (" << fd << ", " << comp_buf << ", " << offset << ") = " << -1);
+        return -1;
+    }
 
     debug_info("Direct read compressed: " << format_bytes(header.compressed_size)
                                           << " (Uncompressed size: " << format_bytes(header.uncompressed_size) << ")");
@@ -257,7 +590,8 @@ int64_t xpn_server_filesystem_lz4::pread_compressed_block(int fd, void *comp_buf
 }
 
 int64_t xpn_server_filesystem_lz4::pwrite_compressed_block(int fd, const void *comp_buf, uint32_t comp_size,
-                                                           uint32_t uncomp_size, int64_t offset) {
+                                                           uint32_t uncomp_size, int64_t offset, uint32_t dict_id,
+                                                           uint64_t checksum) {
     debug_info(" >> BEGIN (" << fd << ", " << comp_buf << ", " << comp_size << ", " << uncomp_size << ", " << offset
                              << ")");
     // 1. Alignment check: Must match the start of a logical block
@@ -277,32 +611,27 @@ int64_t xpn_server_filesystem_lz4::pwrite_compressed_block(int fd, const void *c
     }
 
     int64_t phys_pos = get_physical_offset(offset);
-    BlockHeader new_h = {comp_size, uncomp_size};
-
-    if (m_backend->m_mode == filesystem_mode::disk) {
-        struct iovec iov[2] = {{.iov_base = &new_h, .iov_len = META_SIZE},
-                               {.iov_base = const_cast<void *>(comp_buf), .iov_len = comp_size}};
-        int64_t written = filesystem::pwritev(fd, iov, 2, phys_pos);
-        if (written != (int64_t)(META_SIZE + comp_size)) {
-            debug_info(" << END (" << fd << ", " << comp_buf << ", " << comp_size << ", " << uncomp_size << ", "
-                                   << offset << ") = " << -1);
-            return -1;
-        }
-    } else {
-        // 3. Write the new header
-        if (m_backend->pwrite(fd, &new_h, META_SIZE, phys_pos) != META_SIZE) {
-            debug_info(" << END (" << fd << ", " << comp_buf << ", " << comp_size << ", " << uncomp_size << ", "
-                                   << offset << ") = " << -1);
-            return -1;
-        }
-
-        // 4. Write the already-compressed data directly
-        if (m_backend->pwrite(fd, comp_buf, comp_size, phys_pos + META_SIZE) != comp_size) {
-            debug_info(" << END (" << fd << ", " << comp_buf << ", " << comp_size << ", " << uncomp_size << ", "
-                                   << offset << ") = " << -1);
-            return -1;
-        }
+    BlockHeader new_h = make_header(comp_size, uncomp_size, nullptr);
+    new_h.dict_id = dict_id;
+    new_h.checksum = checksum;
+    int64_t block_id = (offset - RAW_HEADER_SIZE) / LOGICAL_BLOCK_SIZE;
+    UniqueFile file = get_unique_file(fd);
+    // The whole block is written with one pwritev, like the full blocks of pwrite_block it only locks it shared
+    auto &lock_table = BlockLockTable::get_instance();
+    std::shared_lock block_lock(lock_table.get(file, block_id));
+
+    // 3. Write the header and the already-compressed data
+    struct iovec iov[2] = {{.iov_base = &new_h, .iov_len = META_SIZE},
+                           {.iov_base = const_cast<void *>(comp_buf), .iov_len = comp_size}};
+    lock_table.generation(file, block_id)++;
+    int64_t written = m_backend->pwritev(fd, iov, 2, phys_pos);
+    lock_table.generation(file, block_id)++;
+    if (written != (int64_t)(META_SIZE + comp_size)) {
+        debug_info(" << END (" << fd << ", " << comp_buf << ", " << comp_size << ", " << uncomp_size << ", " << offset
+                               << ") = " << -1);
+        return -1;
     }
+    LZ4BlockCache::get_instance().erase(file, LOGICAL_BLOCK_SIZE, block_id);
 
     debug_info("Direct write compressed: " << format_bytes(comp_size)
                                            << " (Uncompressed size: " << format_bytes(uncomp_size) << ")");
@@ -314,15 +643,17 @@ int64_t xpn_server_filesystem_lz4::pwrite_compressed_block(int fd, const void *c
 }
 
 int xpn_server_filesystem_lz4::creat(const char *path, uint32_t mode) { return m_backend->creat(path, mode); }
-int xpn_server_filesystem_lz4::open(const char *path, int flags) { return m_backend->open(path, flags); }
+// The partial writes read the block to recompress it, so the write only opens have to be read write
+static inline int rmw_flags(int flags) {
+    if ((flags & O_ACCMODE) == O_WRONLY) return (flags & ~O_ACCMODE) | O_RDWR;
+    return flags;
+}
+int xpn_server_filesystem_lz4::open(const char *path, int flags) { return m_backend->open(path, rmw_flags(flags)); }
 int xpn_server_filesystem_lz4::open(const char *path, int flags, uint32_t mode) {
-    return m_backend->open(path, flags, mode);
+    return m_backend->open(path, rmw_flags(flags), mode);
 }
 
-int xpn_server_filesystem_lz4::close(int fd) {
-    BlockLockManager::get_instance().close_file(fd);
-    return m_backend->close(fd);
-}
+int xpn_server_filesystem_lz4::close(int fd) { return m_backend->close(fd); }
 
 int xpn_server_filesystem_lz4::fsync(int fd) { return m_backend->fsync(fd); }
 int xpn_server_filesystem_lz4::unlink(const char *path) { return m_backend->unlink(path); }
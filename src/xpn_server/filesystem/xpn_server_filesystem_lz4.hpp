@@ -23,159 +23,86 @@
 #include <lz4.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstring>
 #include <memory>
-#include <mutex>
-#include <tuple>
-#include <unordered_map>
+#include <shared_mutex>
 #include <vector>
 
+#include "base_cpp/workers.hpp"
+#include "base_cpp/xpn_checksum.hpp"
+#include "base_cpp/xpn_codec.hpp"
+#include "base_cpp/xpn_dictionary.hpp"
 #include "xpn_server_filesystem.hpp"
+#include "xpn_server_filesystem_lz4_block.hpp"
 
 namespace XPN {
-struct LockEntry {
-    std::mutex mtx;
-    size_t ref_count = 0;
-};
+// Fixed table of locks for the blocks of the compressed files, hashed by (file, block).
+// The Read-Modify-Write of a partial block and the blocks of zeros, that punch the slot, lock the stripe of the block
+// exclusively, so they see the writes of the block in the same order as the disk and the LZ4BlockCache. The full blocks
+// with data are one pwrite of the slot that reads nothing, they only lock it shared like the reads and change the
+// generation of the stripe before and after the write, the reads that see it changed are retried and not cached.
+class BlockLockTable {
+   public:
+    static constexpr size_t STRIPES = 4096;
 
-struct BlockKey {
-    dev_t dev;
-    ino_t ino;
-    int64_t block_id;
+    static BlockLockTable &get_instance() {
+        static BlockLockTable instance;
+        return instance;
+    }
 
-    bool operator==(const BlockKey &other) const {
-        return dev == other.dev && ino == other.ino && block_id == other.block_id;
+    std::shared_mutex &get(const xpn_server_filesystem::UniqueFile &file, int64_t block_id) {
+        return m_stripes[hash(file.dev, file.ino, block_id) % STRIPES].mtx;
     }
-};
 
-struct BlockKeyHasher {
-    using is_transparent = void;
-    size_t operator()(const BlockKey &k) const { return hash_combine(k.dev, k.ino, k.block_id); }
-    size_t operator()(std::tuple<dev_t, ino_t, int64_t> t) const {
-        return hash_combine(std::get<0>(t), std::get<1>(t), std::get<2>(t));
+    std::atomic_uint64_t &generation(const xpn_server_filesystem::UniqueFile &file, int64_t block_id) {
+        return m_stripes[hash(file.dev, file.ino, block_id) % STRIPES].generation;
     }
-    size_t operator()(dev_t d, ino_t i, int64_t b) const { return hash_combine(d, i, b); }
 
    private:
-    static size_t hash_combine(dev_t d, ino_t i, int64_t b) {
+    static size_t hash(dev_t d, ino_t i, int64_t b) {
         // boost::hash_combine
         auto seed = std::hash<dev_t>{}(d);
         seed ^= std::hash<ino_t>{}(i) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
         seed ^= std::hash<int64_t>{}(b) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
         return seed;
     }
-};
-
-struct BlockKeyEqual {
-    using is_transparent = void;
-    bool operator()(const BlockKey &lhs, const BlockKey &rhs) const { return lhs == rhs; }
-    bool operator()(const BlockKey &lhs, std::tuple<dev_t, ino_t, int64_t> rhs) const {
-        return lhs.dev == std::get<0>(rhs) && lhs.ino == std::get<1>(rhs) && lhs.block_id == std::get<2>(rhs);
-    }
-    bool operator()(std::tuple<dev_t, ino_t, int64_t> lhs, std::tuple<dev_t, ino_t, int64_t> rhs) const {
-        return std::get<0>(lhs) == std::get<0>(rhs) && std::get<1>(lhs) == std::get<1>(rhs) &&
-               std::get<2>(lhs) == std::get<2>(rhs);
-    }
-    bool operator()(std::tuple<dev_t, ino_t, int64_t> lhs, const BlockKey &rhs) const {
-        return rhs.dev == std::get<0>(lhs) && rhs.ino == std::get<1>(lhs) && rhs.block_id == std::get<2>(lhs);
-    }
-};
-
-class BlockLockManager {
-   private:
-    std::mutex m_map_mutex;
-    std::unordered_map<BlockKey, LockEntry, BlockKeyHasher, BlockKeyEqual> m_locks;
-
-   public:
-    std::mutex m_map_files_mutex;
-    std::unordered_map<int, xpn_server_filesystem::UniqueFile> m_files;
-
-   public:
-    static BlockLockManager &get_instance() {
-        static BlockLockManager instance;
-        return instance;
-    }
-
-    std::mutex *acquire(dev_t dev, ino_t ino, int64_t block_id) {
-        std::unique_lock lock(m_map_mutex);
-
-        auto it = m_locks.find(std::make_tuple(dev, ino, block_id));
-        if (it == m_locks.end()) {
-            it = m_locks.try_emplace(BlockKey{dev, ino, block_id}).first;
-        }
-
-        it->second.ref_count++;
-        return &(it->second.mtx);
-    }
-
-    void release(dev_t dev, ino_t ino, int64_t block_id) {
-        std::unique_lock lock(m_map_mutex);
-
-        auto it = m_locks.find(std::make_tuple(dev, ino, block_id));
-        if (it != m_locks.end()) {
-            it->second.ref_count--;
-            if (it->second.ref_count == 0) {
-                m_locks.erase(it);
-            }
-        }
-    }
 
-    void close_file(int fd) {
-        std::unique_lock lock(m_map_files_mutex);
-        m_files.erase(fd);
-    }
-};
-
-class unique_block_lock {
-   private:
-    xpn_server_filesystem::UniqueFile m_file;
-    int64_t m_block_id;
-    std::mutex *m_mtx;
-
-   public:
-    unique_block_lock(xpn_server_filesystem *fs, int fd, int64_t block_id) : m_block_id(block_id) {
-        auto &instance = BlockLockManager::get_instance();
-
-        {
-            std::unique_lock lock(instance.m_map_files_mutex);
-            auto it = instance.m_files.find(fd);
-            if (it == instance.m_files.end()) {
-                m_file = fs->get_unique_file(fd);
-            } else {
-                m_file = (*it).second;
-            }
-        }
-        m_mtx = instance.acquire(m_file.dev, m_file.ino, m_block_id);
-        m_mtx->lock();
-    }
-
-    ~unique_block_lock() {
-        if (m_mtx) {
-            m_mtx->unlock();
-            BlockLockManager::get_instance().release(m_file.dev, m_file.ino, m_block_id);
-        }
-    }
-
-    unique_block_lock(const unique_block_lock &) = delete;
-    unique_block_lock &operator=(const unique_block_lock &) = delete;
+    // One stripe per cache line, so the stripes of different blocks do not share it
+    struct alignas(64) stripe {
+        std::shared_mutex mtx;
+        std::atomic_uint64_t generation = 0;
+    };
+    std::array<stripe, STRIPES> m_stripes;
 };
 
 class xpn_server_filesystem_lz4 : public xpn_server_filesystem {
    private:
     xpn_server_filesystem *m_backend;
+    workers *m_workers;
     const uint32_t LOGICAL_BLOCK_SIZE = 512 * 1024;
+    // Codec of the blocks written, each block records its own so they are read whatever the codec was
+    const xpn_codec m_codec;
+    // Dictionary of the small blocks written, like the tail of the small files, each block records its id
+    const std::shared_ptr<const xpn_dictionary> m_dict;
+    // Compute the checksum of the blocks written and verify the ones decompressed
+    bool m_checksums = false;
 
-    static constexpr uint32_t RAW_HEADER_SIZE = 8192;
-    static constexpr uint32_t META_SIZE = sizeof(uint32_t) * 2;
+    // Header of each physical block, followed by the compressed data
+    using BlockHeader = lz4_block_header;
 
-    uint32_t MAX_COMP_SIZE = LZ4_COMPRESSBOUND(LOGICAL_BLOCK_SIZE);
-    static constexpr uint32_t ALIGNMENT = 4096;
-    uint32_t PHYSICAL_BLOCK_SIZE = (META_SIZE + MAX_COMP_SIZE + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1);
+    static constexpr uint32_t RAW_HEADER_SIZE = lz4_block_header::RAW_HEADER_SIZE;
+    static constexpr uint32_t META_SIZE = lz4_block_header::SIZE;
 
-    struct BlockHeader {
-        uint32_t compressed_size;
-        uint32_t uncompressed_size;
-    };
+    uint32_t MAX_COMP_SIZE = LZ4_COMPRESSBOUND(LOGICAL_BLOCK_SIZE);
+    static constexpr uint32_t ALIGNMENT = lz4_block_header::ALIGNMENT;
+    // Max bytes of contiguous physical blocks fetched by one read
+    static constexpr uint64_t READ_RUN_BYTES = 2 * 1024 * 1024;
+    uint32_t PHYSICAL_BLOCK_SIZE = lz4_block_header::slot_size(LOGICAL_BLOCK_SIZE);
+    // The blocks of the old layout are only read when their slots are where the current ones are
+    bool m_legacy_slots =
+        lz4_block_header::slot_size(LOGICAL_BLOCK_SIZE, lz4_block_header::LEGACY_SIZE) == PHYSICAL_BLOCK_SIZE;
 
     inline int64_t get_physical_offset(int64_t logical_offset) const {
         if (logical_offset < RAW_HEADER_SIZE) return logical_offset;
@@ -183,12 +110,32 @@ class xpn_server_filesystem_lz4 : public xpn_server_filesystem {
         return RAW_HEADER_SIZE + ((relative_offset / LOGICAL_BLOCK_SIZE) * PHYSICAL_BLOCK_SIZE);
     }
 
+    inline const xpn_dictionary *block_dictionary(uint32_t uncompressed_size) const {
+        return m_dict && uncompressed_size <= xpn_dictionary::SMALL_BLOCK_SIZE ? m_dict.get() : nullptr;
+    }
     inline int compress(const char *src, char *dst, int srcSize, int dstCapacity);
-    inline int decompress(const char *src, char *dst, int srcSize, int dstCapacity);
+    // Header of the len bytes read of a slot, the offset of its compressed data or -1 with EIO when it cannot be read
+    int64_t read_header(const char *slot, int64_t len, BlockHeader &header) const;
+    // The size when the checksum of the block is right, or -1
+    inline int verify(const BlockHeader &header, const char *data, int size) const;
+    inline int decompress(const BlockHeader &header, const char *src, char *dst, int dstCapacity);
+    inline BlockHeader make_header(uint32_t compressed_size, uint32_t uncompressed_size, const char *uncompressed) const;
+
+    // Compress and write one block of the request, with a Read-Modify-Write when it is partial
+    int64_t pwrite_block(int fd, const UniqueFile &file, const uint8_t *data, uint32_t len, int64_t logical_offset);
+    // Write the header of a block of zeros and free the rest of its slot, called with the lock of the block
+    int64_t pwrite_zero_block(int fd, int64_t phys_pos, uint32_t uncompressed_size);
 
    public:
-    explicit xpn_server_filesystem_lz4(xpn_server_filesystem *backend, uint32_t block_size)
-        : m_backend(backend), LOGICAL_BLOCK_SIZE(block_size) {}
+    // The blocks of a large request are compressed and decompressed in parallel with the idle threads of workers
+    explicit xpn_server_filesystem_lz4(xpn_server_filesystem *backend, uint32_t block_size, xpn_codec codec = {},
+                                       std::shared_ptr<const xpn_dictionary> dict = nullptr,
+                                       workers *workers = nullptr)
+        : m_backend(backend),
+          m_workers(workers),
+          LOGICAL_BLOCK_SIZE(block_size),
+          m_codec(codec),
+          m_dict(std::move(dict)) {}
 
    public:
     int creat(const char *path, uint32_t mode) override;
@@ -203,11 +150,19 @@ class xpn_server_filesystem_lz4 : public xpn_server_filesystem {
 
     int64_t pwrite(int fd, const void *data, uint64_t len, int64_t offset) override;
     int64_t pread(int fd, void *data, uint64_t len, int64_t offset) override;
+    int64_t write_zeros(int fd, uint64_t len, int64_t offset) override;
 
     bool is_aligned_for_direct_io(int64_t offset, uint64_t uncompressed_size) const;
+    void set_checksums(bool enabled) { m_checksums = enabled; }
+
+    // The block must be compressed with the codec of the filesystem, and with the dictionary dict_id when it is not 0.
+    // checksum is the one of the uncompressed block given by the client, it cannot be verified without decompressing
     int64_t pwrite_compressed_block(int fd, const void *comp_buf, uint32_t comp_size, uint32_t uncomp_size,
-                                    int64_t offset);
-    int64_t pread_compressed_block(int fd, void *comp_buf, int64_t offset, uint32_t &comp_size, uint32_t &uncomp_size);
+                                    int64_t offset, uint32_t dict_id = 0, uint64_t checksum = 0);
+    // dict_id is the dictionary of the block read, the ones with a dictionary other than the one of the filesystem
+    // fail, so they go by the decompression path. checksum is the one stored with the block, the client verifies it
+    int64_t pread_compressed_block(int fd, void *comp_buf, int64_t offset, uint32_t &comp_size, uint32_t &uncomp_size,
+                                   uint32_t &dict_id, uint64_t &checksum);
 
     int mkdir(const char *path, uint32_t mode) override;
     ::DIR *opendir(const char *path) override;
@@ -0,0 +1,79 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <lz4.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "base_cpp/xpn_codec.hpp"
+
+namespace XPN {
+
+// On disk layout of the compressed files: the raw header of the file and then one slot per block, aligned to
+// ALIGNMENT, with the header of the block followed by the compressed data.
+// The blocks written before the header had magic and version only stored the two sizes and were LZ4 without
+// dictionary, they are still read when their slots are of the same size than the current ones.
+struct lz4_block_header {
+    static constexpr uint32_t RAW_HEADER_SIZE = 8192;
+    static constexpr uint32_t ALIGNMENT = 4096;
+    static constexpr uint32_t MAGIC = 0x424e5058;  // "XPNB"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint32_t SIZE = 32;
+    static constexpr uint32_t LEGACY_SIZE = 8;
+
+    uint32_t compressed_size;  // 0 in the blocks of zeros, only the header is stored and the slot is a hole
+    uint32_t uncompressed_size;
+    uint32_t magic;
+    uint8_t version;
+    codec_type codec;
+    uint8_t level;
+    uint8_t reserved0;
+    uint32_t dict_id;  // 0 when the block is compressed without dictionary
+    uint32_t reserved1;
+    uint64_t checksum;  // xpn_checksum of the uncompressed block, 0 without it
+
+    // Size of the slot of the blocks of block_size with a header of header_size
+    static constexpr uint32_t slot_size(uint32_t block_size, uint32_t header_size = SIZE) {
+        return (header_size + LZ4_COMPRESSBOUND(block_size) + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1);
+    }
+
+    // Read the header of the len bytes read of a slot, the empty slots are blocks of size 0. Return the offset of the
+    // compressed data in the slot, LEGACY_SIZE in the blocks of the old layout, or -1 with other version
+    static int64_t parse(const void *slot, uint64_t len, lz4_block_header &header) {
+        header = {};
+        std::memcpy(&header, slot, len < SIZE ? len : SIZE);
+        if (header.magic == MAGIC) {
+            return len >= SIZE && header.version == VERSION ? static_cast<int64_t>(SIZE) : -1;
+        }
+        uint32_t sizes[2] = {};
+        std::memcpy(sizes, slot, len < LEGACY_SIZE ? len : LEGACY_SIZE);
+        header = {};
+        header.compressed_size = sizes[0];
+        header.uncompressed_size = sizes[1];
+        header.codec = codec_type::LZ4;
+        return LEGACY_SIZE;
+    }
+};
+static_assert(sizeof(lz4_block_header) == lz4_block_header::SIZE);
+
+}  // namespace XPN
@@ -0,0 +1,131 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+// #define DEBUG
+#include "xpn_server_filesystem_lz4_cache.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include "base_cpp/debug.hpp"
+
+namespace XPN {
+
+void LZ4BlockCache::configure(uint64_t capacity) {
+    debug_info("Configure LZ4 block cache of " << capacity << " bytes");
+    m_shard_capacity = capacity / SHARDS;
+}
+
+LZ4BlockCache::block_ptr LZ4BlockCache::get(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize,
+                                            int64_t block_id) {
+    if (!enabled() || m_entries == 0) return nullptr;
+    key k{file.dev, file.ino, bsize, block_id};
+    auto &s = get_shard(k);
+    std::unique_lock lock(s.mutex);
+    auto it = s.map.find(k);
+    if (it == s.map.end()) return nullptr;
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    return it->second->block;
+}
+
+void LZ4BlockCache::put(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize, int64_t block_id,
+                        const char *data, uint32_t size) {
+    put(key{file.dev, file.ino, bsize, block_id}, data, size, nullptr, 0);
+}
+
+void LZ4BlockCache::put(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize, int64_t block_id,
+                        const char *data, uint32_t size, const std::atomic_uint64_t &generation, uint64_t expected) {
+    put(key{file.dev, file.ino, bsize, block_id}, data, size, &generation, expected);
+}
+
+void LZ4BlockCache::put(const key &k, const char *data, uint32_t size, const std::atomic_uint64_t *generation,
+                        uint64_t expected) {
+    if (!enabled() || size > m_shard_capacity) return;
+
+    // Copy outside the lock, the blocks are immutable once in the cache
+    auto block = std::make_shared<LZ4CachedBlock>();
+    block->data = std::make_unique_for_overwrite<char[]>(size);
+    block->size = size;
+    std::memcpy(block->data.get(), data, size);
+
+    // The evicted blocks are released after the unlock
+    std::vector<block_ptr> evicted;
+    auto &s = get_shard(k);
+    std::unique_lock lock(s.mutex);
+    // Checked under the lock of the shard, a write that changes the generation after it erases the block after this
+    if (generation && generation->load() != expected) {
+        debug_info("The block " << k.block_id << " was written while it was read, it is not cached");
+        return;
+    }
+    auto it = s.map.find(k);
+    if (it != s.map.end()) {
+        evicted.emplace_back(it->second->block);
+        erase_locked(s, it->second);
+    }
+    while (!s.lru.empty() && s.bytes + size > m_shard_capacity) {
+        evicted.emplace_back(s.lru.back().block);
+        erase_locked(s, std::prev(s.lru.end()));
+    }
+    s.lru.push_front({k, std::move(block)});
+    s.map.emplace(k, s.lru.begin());
+    s.bytes += size;
+    m_entries++;
+}
+
+void LZ4BlockCache::erase(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize, int64_t block_id) {
+    if (!enabled() || m_entries == 0) return;
+    key k{file.dev, file.ino, bsize, block_id};
+    block_ptr evicted;
+    auto &s = get_shard(k);
+    std::unique_lock lock(s.mutex);
+    auto it = s.map.find(k);
+    if (it != s.map.end()) {
+        evicted = it->second->block;
+        erase_locked(s, it->second);
+    }
+}
+
+void LZ4BlockCache::forget(xpn_server_filesystem &fs, const char *path) {
+    if (!enabled() || m_entries == 0) return;
+    struct ::stat st;
+    if (fs.stat(path, &st) < 0 || !S_ISREG(st.st_mode)) return;
+    debug_info("Forget the cached blocks of " << path);
+
+    std::vector<block_ptr> evicted;
+    for (auto &s : m_shards) {
+        std::unique_lock lock(s.mutex);
+        for (auto it = s.lru.begin(); it != s.lru.end();) {
+            auto next = std::next(it);
+            if (it->k.dev == st.st_dev && it->k.ino == st.st_ino) {
+                evicted.emplace_back(it->block);
+                erase_locked(s, it);
+            }
+            it = next;
+        }
+    }
+}
+
+void LZ4BlockCache::erase_locked(shard &s, std::list<entry>::iterator it) {
+    s.bytes -= it->block->size;
+    s.map.erase(it->k);
+    s.lru.erase(it);
+    m_entries--;
+}
+
+}  // namespace XPN
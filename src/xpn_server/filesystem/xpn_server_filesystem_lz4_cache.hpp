@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "xpn_server_filesystem.hpp"
+
+namespace XPN {
+
+// Uncompressed content of a block of a compressed file
+struct LZ4CachedBlock {
+    std::unique_ptr<char[]> data;
+    uint32_t size;
+};
+
+// LRU of the last decompressed blocks of the server, shared by the reads and the Read-Modify-Write of the partial
+// writes. The blocks are identified by (dev, ino, block size, block id), so it must be told when a file is removed or
+// truncated. The callers keep it coherent with the disk holding the lock of the block in BlockLockTable, and the reads
+// that can race with the full block writes, that only lock it shared, put their blocks with its generation.
+class LZ4BlockCache {
+   public:
+    using block_ptr = std::shared_ptr<const LZ4CachedBlock>;
+
+    static LZ4BlockCache &get_instance() {
+        static LZ4BlockCache instance;
+        return instance;
+    }
+
+    // Bytes of uncompressed data to keep, 0 disables the cache
+    void configure(uint64_t capacity);
+    bool enabled() const { return m_shard_capacity != 0; }
+
+    block_ptr get(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize, int64_t block_id);
+    void put(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize, int64_t block_id, const char *data,
+             uint32_t size);
+    // Put the block only if generation is still expected, the writes that do not lock the block exclusively change it
+    // before their erase, so a read that raced with them does not cache the old data
+    void put(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize, int64_t block_id, const char *data,
+             uint32_t size, const std::atomic_uint64_t &generation, uint64_t expected);
+    void erase(const xpn_server_filesystem::UniqueFile &file, uint32_t bsize, int64_t block_id);
+    // Drop all the blocks of the file in path, before it is removed, replaced or truncated
+    void forget(xpn_server_filesystem &fs, const char *path);
+
+   private:
+    static constexpr size_t SHARDS = 16;
+
+    struct key {
+        dev_t dev;
+        ino_t ino;
+        uint32_t bsize;
+        int64_t block_id;
+
+        bool operator==(const key &other) const = default;
+    };
+    struct key_hash {
+        size_t operator()(const key &k) const {
+            // boost::hash_combine
+            auto seed = std::hash<dev_t>{}(k.dev);
+            seed ^= std::hash<ino_t>{}(k.ino) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<uint32_t>{}(k.bsize) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<int64_t>{}(k.block_id) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+    struct entry {
+        key k;
+        block_ptr block;
+    };
+    struct shard {
+        std::mutex mutex;
+        std::list<entry> lru;  // Most recent first
+        std::unordered_map<key, std::list<entry>::iterator, key_hash> map;
+        uint64_t bytes = 0;
+    };
+
+    shard &get_shard(const key &k) { return m_shards[key_hash{}(k) % SHARDS]; }
+    void put(const key &k, const char *data, uint32_t size, const std::atomic_uint64_t *generation, uint64_t expected);
+    void erase_locked(shard &s, std::list<entry>::iterator it);
+
+    uint64_t m_shard_capacity = 0;
+    std::atomic_uint64_t m_entries = 0;
+    std::array<shard, SHARDS> m_shards;
+};
+
+}  // namespace XPN
@@ -104,26 +104,43 @@ void InMemoryDir::remove_child(std::string_view name) {
     }
 }
 
-xpn_server_filesystem_memory::xpn_server_filesystem_memory() { root = std::make_shared<InMemoryDir>("/"); }
+xpn_server_filesystem_memory::xpn_server_filesystem_memory(const filesystem_options &options) : m_tier(options) {
+    root = std::make_shared<InMemoryDir>("/");
+}
 
 xpn_server_filesystem_memory::~xpn_server_filesystem_memory() {}
 
-std::shared_ptr<InMemoryNode> xpn_server_filesystem_memory::resolve_path(std::string_view path,
-                                                                         std::shared_ptr<InMemoryDir> &parent,
-                                                                         std::string &name_out) {
-    debug_info(" >> BEGIN (" << path << ") \n" << *root);
-
-    if (path.empty()) return nullptr;
-
-    std::string_view p(path);
-    if (p.front() == '/') {
-        // Absolute path, start from root
-        while (!p.empty() && p.front() == '/') {
-            p = p.substr(1);
+std::string xpn_server_filesystem_memory::normalize_path(std::string_view path) {
+    // Key of the index, without the leading, trailing and repeated '/'
+    std::string key;
+    key.reserve(path.size());
+    size_t pos = 0;
+    while (pos < path.size()) {
+        while (pos < path.size() && path[pos] == '/') pos++;
+        size_t end = path.find('/', pos);
+        if (end == std::string_view::npos) end = path.size();
+        if (end > pos) {
+            if (!key.empty()) key += '/';
+            key.append(path.substr(pos, end - pos));
         }
+        pos = end;
     }
+    return key;
+}
+
+std::shared_ptr<InMemoryNode> xpn_server_filesystem_memory::lookup(std::string_view key) {
+    if (key.empty()) return root;
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return nullptr;
+    return it->second;
+}
+
+std::shared_ptr<InMemoryNode> xpn_server_filesystem_memory::resolve_path(const std::string &key,
+                                                                         std::shared_ptr<InMemoryDir> &parent,
+                                                                         std::string &name_out) {
+    debug_info(" >> BEGIN (" << key << ")");
 
-    if (p.empty()) {
+    if (key.empty()) {
         // Path was just "/"
         parent = nullptr;
         name_out = "";
@@ -131,58 +148,24 @@ std::shared_ptr<InMemoryNode> xpn_server_filesystem_memory::resolve_path(std::st
         return root;
     }
 
-    if (p.back() == '/') {
-        // Absolute path, start from root
-        while (!p.empty() && p.back() == '/') {
-            p = p.substr(0, p.size() - 1);
-        }
-    }
-
-    std::shared_ptr<InMemoryDir> current = root;
-    size_t pos = 0;
-    std::string token;
-
-    while ((pos = p.find('/')) != std::string::npos) {
-        token = p.substr(0, pos);
-        p = p.substr(pos + 1);
-
-        if (token.empty()) continue;
-
-        std::shared_lock parent_lock(current->node_mutex);
-        auto it = current->children_map.find(token);
-        if (it == current->children_map.end()) {
-            parent = current;
-            name_out = token;
-            debug_info(" << END not fount " << token << " nullptr");
-            return nullptr;
-        }
-
-        auto node = current->children_list[it->second];
-        if (node->type != NodeType::Directory) {
-            name_out = token;
-            debug_info(" << END not directory in path " << token << " nullptr");
-            return nullptr;
-        }
-        current = std::static_pointer_cast<InMemoryDir>(node);
+    size_t pos = key.rfind('/');
+    auto parent_node = pos == std::string::npos ? root : lookup(std::string_view(key).substr(0, pos));
+    if (parent_node && parent_node->type == NodeType::Directory) {
+        parent = std::static_pointer_cast<InMemoryDir>(parent_node);
+    } else {
+        parent = nullptr;
     }
+    name_out = pos == std::string::npos ? key : key.substr(pos + 1);
 
-    parent = current;
-    name_out = p;
-
-    std::shared_lock parent_lock(current->node_mutex);
-    auto it = current->children_map.find(p);
-    if (it != current->children_map.end()) {
-        debug_info(" << END found " << p);
-        return current->children_list[it->second];
-    }
-    debug_info(" << END not in children " << p << " nullptr");
-    return nullptr;
+    auto node = lookup(key);
+    debug_info(" << END " << (node ? "found " : "not found ") << key);
+    return node;
 }
 
 std::shared_ptr<InMemoryNode> xpn_server_filesystem_memory::get_node(std::string_view path) {
-    std::shared_ptr<InMemoryDir> parent;
-    std::string name;
-    return resolve_path(path, parent, name);
+    std::string key = normalize_path(path);
+    std::shared_lock index_lock(m_index_mutex);
+    return lookup(key);
 }
 
 int xpn_server_filesystem_memory::creat(const char *path, uint32_t mode) {
@@ -193,9 +176,7 @@ int xpn_server_filesystem_memory::open(const char *path, int flags) { return ope
 
 int xpn_server_filesystem_memory::open(const char *path, int flags, [[maybe_unused]] uint32_t mode) {
     debug_info(" >> BEGIN (" << path << ", " << format_open_flags(flags) << ", " << format_open_mode(mode) << ")");
-    std::shared_ptr<InMemoryDir> parent;
-    std::string name;
-    auto node = resolve_path(path, parent, name);
+    auto node = get_node(path);
 
     if (node) {
         if (flags & O_CREAT && flags & O_EXCL) {
@@ -203,19 +184,19 @@ int xpn_server_filesystem_memory::open(const char *path, int flags, [[maybe_unus
             debug_info(" << END -1 EEXIST");
             return -1;
         }
-        if (node->type == NodeType::Directory) {
-            errno = EISDIR;
-            debug_info(" << END -1 EISDIR");
+    } else {
+        if (!(flags & O_CREAT)) {
+            errno = ENOENT;
+            debug_info(" << END -1 ENOENT");
             return -1;
         }
-        if (flags & O_TRUNC) {
-            auto file = std::static_pointer_cast<InMemoryFile>(node);
-            std::unique_lock file_lock(file->node_mutex);
-            file->blocks.clear();
-            file->stat_data.st_size = 0;
-        }
-    } else {
-        if (flags & O_CREAT) {
+        // Check again with the index locked, other op could create it meanwhile
+        std::string key = normalize_path(path);
+        std::shared_ptr<InMemoryDir> parent;
+        std::string name;
+        std::unique_lock index_lock(m_index_mutex);
+        node = resolve_path(key, parent, name);
+        if (!node) {
             if (!parent) {
                 errno = ENOENT;
                 debug_info(" << END -1 ENOENT");
@@ -226,14 +207,26 @@ int xpn_server_filesystem_memory::open(const char *path, int flags, [[maybe_unus
                 std::unique_lock parent_lock(parent->node_mutex);
                 parent->add_child(new_file);
             }
+            m_index.emplace(key, new_file);
             debug_info("Created file: " << name << "\n" << *root);
             node = new_file;
-        } else {
-            errno = ENOENT;
-            debug_info(" << END -1 ENOENT");
+        } else if (flags & O_EXCL) {
+            errno = EEXIST;
+            debug_info(" << END -1 EEXIST");
             return -1;
         }
     }
+    if (node->type == NodeType::Directory) {
+        errno = EISDIR;
+        debug_info(" << END -1 EISDIR");
+        return -1;
+    }
+    if (flags & O_TRUNC) {
+        auto file = std::static_pointer_cast<InMemoryFile>(node);
+        std::unique_lock file_lock(file->node_mutex);
+        file->blocks.clear();
+        file->stat_data.st_size = 0;
+    }
 
     int fd = next_fd++;
     OpenFile of;
@@ -279,9 +272,11 @@ int xpn_server_filesystem_memory::fsync([[maybe_unused]] int fd) {
 
 int xpn_server_filesystem_memory::unlink(const char *path) {
     debug_info(" >> BEGIN");
+    std::string key = normalize_path(path);
     std::shared_ptr<InMemoryDir> parent;
     std::string name;
-    auto node = resolve_path(path, parent, name);
+    std::unique_lock index_lock(m_index_mutex);
+    auto node = resolve_path(key, parent, name);
 
     if (!node) {
         errno = ENOENT;
@@ -297,48 +292,36 @@ int xpn_server_filesystem_memory::unlink(const char *path) {
         std::unique_lock parent_lock(parent->node_mutex);
         parent->remove_child(name);
     }
+    m_index.erase(key);
     debug_info(" << END");
     return 0;
 }
 
 int xpn_server_filesystem_memory::rename(const char *oldPath, const char *newPath) {
     debug_info(" >> BEGIN");
+    std::string oldKey = normalize_path(oldPath);
+    std::string newKey = normalize_path(newPath);
     std::shared_ptr<InMemoryDir> oldParent, newParent;
     std::string oldName, newName;
-    auto oldNode = resolve_path(oldPath, oldParent, oldName);
 
-    if (!oldNode) {
+    std::unique_lock index_lock(m_index_mutex);
+    auto oldNode = resolve_path(oldKey, oldParent, oldName);
+    if (!oldNode || !oldParent) {
         errno = ENOENT;
         debug_info(" << END");
         return -1;
     }
-
-    std::string p = newPath;
-    while (!p.empty() && p.front() == '/') p.erase(0, 1);
-
-    std::string p_dir_str;
-    std::string p_name_str;
-    size_t last_slash = p.find_last_of('/');
-    if (last_slash == std::string::npos) {
-        p_dir_str = "";
-        p_name_str = p;
-    } else {
-        p_dir_str = p.substr(0, last_slash);
-        p_name_str = p.substr(last_slash + 1);
+    if (oldKey == newKey) {
+        debug_info(" << END");
+        return 0;
     }
 
-    if (p_dir_str.empty()) {
-        newParent = root;
-    } else {
-        auto node = get_node(p_dir_str);
-        if (!node || node->type != NodeType::Directory) {
-            errno = ENOENT;
-            debug_info(" << END");
-            return -1;
-        }
-        newParent = std::static_pointer_cast<InMemoryDir>(node);
+    resolve_path(newKey, newParent, newName);
+    if (!newParent) {
+        errno = ENOENT;
+        debug_info(" << END");
+        return -1;
     }
-    newName = p_name_str;
     {
         std::unique_lock parent_lock(newParent->node_mutex);
         auto it = newParent->children_map.find(newName);
@@ -365,8 +348,6 @@ int xpn_server_filesystem_memory::rename(const char *oldPath, const char *newPat
             }
             newParent->remove_child(newName);
         }
-        oldNode->name = newName;
-        newParent->add_child(oldNode);
     }
 
     {
@@ -374,6 +355,32 @@ int xpn_server_filesystem_memory::rename(const char *oldPath, const char *newPat
         oldParent->remove_child(oldName);
     }
 
+    {
+        std::unique_lock parent_lock(newParent->node_mutex);
+        oldNode->name = newName;
+        newParent->add_child(oldNode);
+    }
+
+    // Move the node and everything under it to the new keys of the index
+    m_index.erase(newKey);
+    m_index.erase(oldKey);
+    m_index.emplace(newKey, oldNode);
+    if (oldNode->type == NodeType::Directory) {
+        std::string oldPrefix = oldKey + "/";
+        std::vector<std::pair<std::string, std::shared_ptr<InMemoryNode>>> moved;
+        for (auto it = m_index.begin(); it != m_index.end();) {
+            if (it->first.starts_with(oldPrefix)) {
+                moved.emplace_back(newKey + "/" + it->first.substr(oldPrefix.size()), std::move(it->second));
+                it = m_index.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (auto &[key, node] : moved) {
+            m_index.emplace(std::move(key), std::move(node));
+        }
+    }
+
     debug_info(" << END");
     return 0;
 }
@@ -381,11 +388,6 @@ int xpn_server_filesystem_memory::rename(const char *oldPath, const char *newPat
 int xpn_server_filesystem_memory::stat(const char *path, struct ::stat *st) {
     debug_info(" >> BEGIN");
     auto node = get_node(path);
-    if (!node) {
-        std::string p = path;
-        while (!p.empty() && p.front() == '/') p.erase(0, 1);
-        if (p.empty()) node = root;
-    }
 
     if (!node) {
         errno = ENOENT;
@@ -415,72 +417,168 @@ int xpn_server_filesystem_memory::fstat(int fd, struct ::stat *st) {
     return 0;
 }
 
-int64_t xpn_server_filesystem_memory::internal_pwrite(OpenFile &of, const void *data, uint64_t len, uint64_t offset) {
-    debug_info(" >> BEGIN");
-    auto file = of.file;
-    uint64_t current_pos = offset;
-    uint64_t end_pos = current_pos + len;
-
-    bool needs_growth = false;
-    std::shared_lock node_shared_check(file->node_mutex);
-    auto get_required_blocks = [](uint64_t pos) -> size_t {
-        if (pos == 0) return 0;
-        if (pos <= HEADER_SIZE) return 1;
-        return 1 + (pos - HEADER_SIZE + MEM_BLOCK_SIZE - 1) / MEM_BLOCK_SIZE;
-    };
+static size_t get_required_blocks(uint64_t pos) {
+    if (pos == 0) return 0;
+    if (pos <= HEADER_SIZE) return 1;
+    return 1 + (pos - HEADER_SIZE + MEM_BLOCK_SIZE - 1) / MEM_BLOCK_SIZE;
+}
 
+int xpn_server_filesystem_memory::get_blocks(const std::shared_ptr<InMemoryFile> &file, uint64_t offset,
+                                             uint64_t len, bool grow, std::vector<std::shared_ptr<MemoryBlock>> &blocks) {
+    uint64_t end_pos = offset + len;
+    size_t first_block = get_required_blocks(offset + 1) - 1;
     size_t required_blocks = get_required_blocks(end_pos);
-    if (required_blocks > file->blocks.size() || end_pos > (size_t)file->stat_data.st_size) {
-        needs_growth = true;
+
+    size_t current_blocks;
+    bool needs_growth = false;
+    {
+        std::shared_lock node_shared_lock(file->node_mutex);
+        current_blocks = file->blocks.size();
+        needs_growth = grow && (required_blocks > current_blocks || end_pos > (size_t)file->stat_data.st_size);
+        if (!needs_growth) {
+            for (size_t i = first_block; i < std::min(required_blocks, current_blocks); ++i) {
+                blocks.emplace_back(file->blocks[i]);
+            }
+        }
     }
 
     if (needs_growth) {
-        node_shared_check.unlock();
-        {
-            std::unique_lock node_unique_lock(file->node_mutex);
-            if (required_blocks > file->blocks.size()) {
-                size_t old_size = file->blocks.size();
-                file->blocks.resize(required_blocks);
-                for (size_t i = old_size; i < required_blocks; ++i) {
-                    size_t b_size = (i == 0) ? HEADER_SIZE : MEM_BLOCK_SIZE;
-                    file->blocks[i] = std::make_unique_for_overwrite<uint8_t[]>(b_size);
-                    if (i == 0) {
-                        std::memset(file->blocks[i].get(), 0, b_size);
-                    }
+        // Allocate out of the lock, so the growth does not stop the other ops of the file.
+        // The reserve could evict and must be done without locks.
+        std::vector<std::shared_ptr<MemoryBlock>> new_blocks;
+        uint64_t reserved = 0;
+        for (size_t i = current_blocks; i < required_blocks; ++i) {
+            reserved += mem_block_size(i);
+        }
+        m_tier.reserve(reserved);
+        for (size_t i = current_blocks; i < required_blocks; ++i) {
+            size_t b_size = mem_block_size(i);
+            auto &block = new_blocks.emplace_back(std::make_shared<MemoryBlock>(m_tier, b_size));
+            block->data = std::make_unique_for_overwrite<uint8_t[]>(b_size);
+            if (i == 0) {
+                std::memset(block->data.get(), 0, b_size);
+            }
+        }
+
+        std::unique_lock node_unique_lock(file->node_mutex);
+        // Other op could grow or truncate the file meanwhile, the new blocks not used are discarded
+        for (size_t i = file->blocks.size(); i < required_blocks; ++i) {
+            std::shared_ptr<MemoryBlock> block;
+            if (i >= current_blocks) {
+                block = std::move(new_blocks[i - current_blocks]);
+            } else {
+                size_t b_size = mem_block_size(i);
+                block = std::make_shared<MemoryBlock>(m_tier, b_size);
+                block->data = std::make_unique_for_overwrite<uint8_t[]>(b_size);
+                if (i == 0) {
+                    std::memset(block->data.get(), 0, b_size);
                 }
+                m_tier.settle(0, b_size);
             }
-            if (end_pos > (size_t)file->stat_data.st_size) {
-                file->stat_data.st_size = end_pos;
+            if (i > 0) {
+                m_tier.track(block);
             }
+            file->blocks.emplace_back(std::move(block));
+        }
+        if (end_pos > (size_t)file->stat_data.st_size) {
+            file->stat_data.st_size = end_pos;
+        }
+        for (size_t i = first_block; i < required_blocks; ++i) {
+            blocks.emplace_back(file->blocks[i]);
         }
-        node_shared_check.lock();
     }
 
-    const uint8_t *src = static_cast<const uint8_t *>(data);
-    uint64_t remaining = len;
+    if (!m_tier.limited()) {
+        return 0;
+    }
 
-    while (remaining > 0) {
-        size_t block_idx;
-        size_t offset_in_block;
-        size_t b_size;
+    // Promote the evicted blocks, they could change after the count so it is checked again with the lock
+    uint64_t reserved = 0;
+    for (auto &block : blocks) {
+        std::shared_lock block_lock(block->mutex);
+        if (!block->resident()) {
+            reserved += block->size;
+        }
+    }
+    if (reserved == 0) {
+        return 0;
+    }
+    m_tier.reserve(reserved);
+    int ret = 0;
+    uint64_t used = 0;
+    for (auto &block : blocks) {
+        std::unique_lock block_lock(block->mutex);
+        if (block->resident()) continue;
+        if (!m_tier.load(*block)) {
+            ret = -1;
+            break;
+        }
+        used += block->size;
+        m_tier.track(block);
+    }
+    m_tier.settle(reserved, used);
+    return ret;
+}
 
-        if (current_pos < HEADER_SIZE) {
-            block_idx = 0;
-            offset_in_block = current_pos;
-            b_size = HEADER_SIZE;
-        } else {
-            block_idx = 1 + (current_pos - HEADER_SIZE) / MEM_BLOCK_SIZE;
-            offset_in_block = (current_pos - HEADER_SIZE) % MEM_BLOCK_SIZE;
-            b_size = MEM_BLOCK_SIZE;
+int64_t xpn_server_filesystem_memory::internal_pwrite(OpenFile &of, const void *data, uint64_t len, uint64_t offset) {
+    debug_info(" >> BEGIN");
+    auto file = of.file;
+    if (len == 0) {
+        debug_info(" << END 0");
+        return 0;
+    }
+
+    std::vector<std::shared_ptr<MemoryBlock>> blocks;
+    size_t first_block = get_required_blocks(offset + 1) - 1;
+    bool done = false;
+    while (!done) {
+        blocks.clear();
+        if (get_blocks(file, offset, len, true, blocks) < 0) {
+            debug_info(" << END -1");
+            return -1;
         }
 
-        size_t to_copy = std::min((size_t)remaining, b_size - offset_in_block);
+        uint64_t current_pos = offset;
+        const uint8_t *src = static_cast<const uint8_t *>(data);
+        uint64_t remaining = len;
+        done = true;
 
-        std::memcpy(file->blocks[block_idx].get() + offset_in_block, src, to_copy);
+        while (remaining > 0) {
+            size_t block_idx;
+            size_t offset_in_block;
+            size_t b_size;
 
-        src += to_copy;
-        current_pos += to_copy;
-        remaining -= to_copy;
+            if (current_pos < HEADER_SIZE) {
+                block_idx = 0;
+                offset_in_block = current_pos;
+                b_size = HEADER_SIZE;
+            } else {
+                block_idx = 1 + (current_pos - HEADER_SIZE) / MEM_BLOCK_SIZE;
+                offset_in_block = (current_pos - HEADER_SIZE) % MEM_BLOCK_SIZE;
+                b_size = MEM_BLOCK_SIZE;
+            }
+
+            size_t to_copy = std::min((size_t)remaining, b_size - offset_in_block);
+
+            auto &block = blocks[block_idx - first_block];
+            {
+                std::unique_lock block_lock(block->mutex);
+                // Evicted between the promotion and the lock, then try again
+                if (!block->resident()) {
+                    done = false;
+                    break;
+                }
+                block->seq.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                std::memcpy(block->data.get() + offset_in_block, src, to_copy);
+                block->seq.fetch_add(1, std::memory_order_release);
+            }
+            block->referenced.store(true, std::memory_order_relaxed);
+
+            src += to_copy;
+            current_pos += to_copy;
+            remaining -= to_copy;
+        }
     }
 
     debug_info(" << END " << len);
@@ -510,15 +608,51 @@ int64_t xpn_server_filesystem_memory::pwrite(int fd, const void *data, uint64_t
     return res;
 }
 
+bool xpn_server_filesystem_memory::read_block(MemoryBlock &block, void *dst, uint64_t len, uint64_t offset_in_block) {
+    // Without budget the data of a block is never freed while it is referenced,
+    // so it can be read without lock and retried if a write was in the middle
+    if (!m_tier.limited()) {
+        for (int i = 0; i < 3; i++) {
+            uint64_t seq = block.seq.load(std::memory_order_acquire);
+            if (seq & 1) continue;
+            std::memcpy(dst, block.data.get() + offset_in_block, len);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (block.seq.load(std::memory_order_relaxed) == seq) {
+                return true;
+            }
+        }
+    }
+
+    std::shared_lock block_lock(block.mutex);
+    block.referenced.store(true, std::memory_order_relaxed);
+    // A block evicted again after the promotion is read from the spill file
+    if (!block.resident()) {
+        return m_tier.read_spilled(block, dst, len, offset_in_block);
+    }
+    std::memcpy(dst, block.data.get() + offset_in_block, len);
+    return true;
+}
+
 int64_t xpn_server_filesystem_memory::internal_pread(OpenFile &of, void *data, uint64_t len, uint64_t offset) {
     auto file = of.file;
-    std::shared_lock node_lock(file->node_mutex);
-    if (offset >= (size_t)file->stat_data.st_size) {
+    uint64_t file_size;
+    {
+        std::shared_lock node_lock(file->node_mutex);
+        file_size = file->stat_data.st_size;
+    }
+    if (offset >= file_size) {
         debug_info(" << END 0 (EOF)");
         return 0;
     }
 
-    uint64_t to_read = std::min(len, (uint64_t)file->stat_data.st_size - offset);
+    uint64_t to_read = std::min(len, file_size - offset);
+    std::vector<std::shared_ptr<MemoryBlock>> blocks;
+    size_t first_block = get_required_blocks(offset + 1) - 1;
+    if (get_blocks(file, offset, to_read, false, blocks) < 0) {
+        debug_info(" << END -1");
+        return -1;
+    }
+
     uint64_t current_pos = offset;
     uint64_t remaining = to_read;
     uint8_t *dst = static_cast<uint8_t *>(data);
@@ -540,10 +674,13 @@ int64_t xpn_server_filesystem_memory::internal_pread(OpenFile &of, void *data, u
 
         size_t to_copy = std::min((size_t)remaining, b_size - offset_in_block);
 
-        if (block_idx < file->blocks.size()) {
-            std::memcpy(dst, file->blocks[block_idx].get() + offset_in_block, to_copy);
+        if (block_idx - first_block < blocks.size()) {
+            if (!read_block(*blocks[block_idx - first_block], dst, to_copy, offset_in_block)) {
+                debug_info(" << END -1");
+                return -1;
+            }
         } else {
-            std::memset(dst, 0, to_copy);  // Should not happen if size is correct
+            std::memset(dst, 0, to_copy);  // Truncated meanwhile
         }
 
         dst += to_copy;
@@ -580,9 +717,11 @@ int64_t xpn_server_filesystem_memory::pread(int fd, void *data, uint64_t len, in
 
 int xpn_server_filesystem_memory::mkdir(const char *path, [[maybe_unused]] uint32_t mode) {
     debug_info(" >> BEGIN (" << path << ")");
+    std::string key = normalize_path(path);
     std::shared_ptr<InMemoryDir> parent;
     std::string name;
-    auto node = resolve_path(path, parent, name);
+    std::unique_lock index_lock(m_index_mutex);
+    auto node = resolve_path(key, parent, name);
 
     if (node) {
         errno = EEXIST;
@@ -600,6 +739,7 @@ int xpn_server_filesystem_memory::mkdir(const char *path, [[maybe_unused]] uint3
         std::unique_lock parent_lock(parent->node_mutex);
         parent->add_child(new_dir);
     }
+    m_index.emplace(key, new_dir);
     debug_info("Created dir: '" << name << "'\n" << *root);
     debug_info(" << END 0");
     return 0;
@@ -608,9 +748,6 @@ int xpn_server_filesystem_memory::mkdir(const char *path, [[maybe_unused]] uint3
 ::DIR *xpn_server_filesystem_memory::opendir(const char *path) {
     debug_info(" >> BEGIN (" << path << ")");
     auto node = get_node(path);
-    if (!node && (std::string(path) == "/" || std::string(path).empty())) {
-        node = root;
-    }
 
     if (!node || node->type != NodeType::Directory) {
         errno = ENOTDIR;
@@ -641,9 +778,11 @@ int xpn_server_filesystem_memory::closedir(::DIR *dir) {
 
 int xpn_server_filesystem_memory::rmdir(const char *path) {
     debug_info(" >> BEGIN (" << path << ")");
+    std::string key = normalize_path(path);
     std::shared_ptr<InMemoryDir> parent;
     std::string name;
-    auto node = resolve_path(path, parent, name);
+    std::unique_lock index_lock(m_index_mutex);
+    auto node = resolve_path(key, parent, name);
 
     if (!node) {
         errno = ENOENT;
@@ -669,8 +808,11 @@ int xpn_server_filesystem_memory::rmdir(const char *path) {
         debug_info(" << END -1 EBUSY");
         return -1;
     }
-    std::unique_lock parent_lock(parent->node_mutex);
-    parent->remove_child(name);
+    {
+        std::unique_lock parent_lock(parent->node_mutex);
+        parent->remove_child(name);
+    }
+    m_index.erase(key);
     debug_info(" << END 0");
     return 0;
 }
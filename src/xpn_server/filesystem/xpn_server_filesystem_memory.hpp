@@ -29,6 +29,7 @@
 
 #include "base_cpp/str_unordered_map.hpp"
 #include "xpn_server_filesystem.hpp"
+#include "xpn_server_filesystem_memory_tier.hpp"
 
 namespace XPN {
 
@@ -37,11 +38,13 @@ enum class NodeType { File, Directory };
 struct InMemoryNode {
     NodeType type;
     std::string name;
-    struct ::stat stat_data;
-    std::shared_mutex node_mutex;  // Protects blocks vector and stat_data
+    struct ::stat stat_data = {};
+    std::shared_mutex node_mutex;  // Protects the blocks vector, stat_data and the children
 
     InMemoryNode(NodeType t, std::string_view n) : type(t), name(n) {
-        // Initialize stat_data
+        // Initialize stat_data, each node has its own inode number so the files can be told apart by (dev, ino)
+        static std::atomic<ino_t> next_ino = 1;
+        stat_data.st_ino = next_ino++;
         stat_data.st_mode = (t == NodeType::Directory) ? (S_IFDIR | 0777) : (S_IFREG | 0666);
         stat_data.st_nlink = 1;
         stat_data.st_size = 0;
@@ -55,9 +58,12 @@ struct InMemoryNode {
 constexpr size_t HEADER_SIZE = 8192;                // 8 KiB
 constexpr size_t MEM_BLOCK_SIZE = 4 * 1024 * 1024;  // 4 MiB
 
+inline size_t mem_block_size(size_t block_idx) { return block_idx == 0 ? HEADER_SIZE : MEM_BLOCK_SIZE; }
+
 struct InMemoryFile : public InMemoryNode {
-    // Vector of pointers to memory blocks
-    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    // Vector of pointers to memory blocks, the first one (the header) is never evicted.
+    // The ops copy the pointers of their range and work on the blocks with the file unlocked.
+    std::vector<std::shared_ptr<MemoryBlock>> blocks;
 
     InMemoryFile(std::string_view n) : InMemoryNode(NodeType::File, n) {}
 };
@@ -88,7 +94,7 @@ class xpn_server_filesystem_memory : public xpn_server_filesystem {
     };
 
    public:
-    xpn_server_filesystem_memory();
+    xpn_server_filesystem_memory(const filesystem_options &options);
     ~xpn_server_filesystem_memory() override;
 
     int creat(const char *path, uint32_t mode) override;
@@ -118,6 +124,8 @@ class xpn_server_filesystem_memory : public xpn_server_filesystem {
     int statvfs(const char *path, struct ::statvfs *buff) override;
 
    private:
+    // Declared first so it is destroyed after every block
+    MemoryTier m_tier;
     std::shared_ptr<InMemoryDir> root;
     std::shared_mutex open_files_mutex;
 
@@ -125,9 +133,20 @@ class xpn_server_filesystem_memory : public xpn_server_filesystem {
     std::unordered_map<int, OpenFile> open_files;
     std::atomic<int> next_fd{1000};
 
-    std::shared_ptr<InMemoryNode> resolve_path(std::string_view path, std::shared_ptr<InMemoryDir> &parent,
+    // Index from the full path to the node, so the ops do not walk the tree
+    std::shared_mutex m_index_mutex;
+    str_unordered_map<std::string, std::shared_ptr<InMemoryNode>> m_index;
+
+    static std::string normalize_path(std::string_view path);
+    // Called with m_index_mutex locked, parent is nullptr when it does not exist or it is not a directory
+    std::shared_ptr<InMemoryNode> lookup(std::string_view key);
+    std::shared_ptr<InMemoryNode> resolve_path(const std::string &key, std::shared_ptr<InMemoryDir> &parent,
                                                std::string &name_out);
     std::shared_ptr<InMemoryNode> get_node(std::string_view path);
+    // Get the blocks of the range, allocating them up to offset + len when grow is set and promoting the evicted ones
+    int get_blocks(const std::shared_ptr<InMemoryFile> &file, uint64_t offset, uint64_t len, bool grow,
+                   std::vector<std::shared_ptr<MemoryBlock>> &blocks);
+    bool read_block(MemoryBlock &block, void *dst, uint64_t len, uint64_t offset_in_block);
 };
 
 }  // namespace XPN
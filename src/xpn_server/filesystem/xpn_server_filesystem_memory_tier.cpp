@@ -0,0 +1,212 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+// #define DEBUG
+#include "xpn_server_filesystem_memory_tier.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "base_cpp/debug.hpp"
+#include "base_cpp/filesystem.hpp"
+
+namespace XPN {
+
+MemoryBlock::~MemoryBlock() { tier.drop(*this); }
+
+MemoryTier::MemoryTier(const filesystem_options &options)
+    : m_budget(options.memory_budget),
+      m_spill_dir(options.memory_spill_dir),
+      m_residency(options.residency ? options.residency : &m_own_residency) {}
+
+MemoryTier::~MemoryTier() {
+    if (m_spill_fd >= 0) {
+        ::close(m_spill_fd);
+    }
+}
+
+void MemoryTier::reserve(uint64_t bytes) {
+    uint64_t used = (m_residency->memory_bytes += bytes);
+    if (!limited()) return;
+
+    while (used > m_budget) {
+        if (!evict_one()) {
+            // Every resident block is in use, go over the budget instead of failing the op
+            debug_info("Memory over budget " << used << " > " << m_budget << " without blocks to evict");
+            break;
+        }
+        used = m_residency->memory_bytes;
+    }
+}
+
+void MemoryTier::settle(uint64_t reserved, uint64_t used) {
+    if (used > reserved) {
+        m_residency->memory_bytes += used - reserved;
+    } else {
+        m_residency->memory_bytes -= reserved - used;
+    }
+}
+
+void MemoryTier::track(const std::shared_ptr<MemoryBlock> &block) {
+    if (!limited()) return;
+
+    block->referenced = true;
+    std::unique_lock lock(m_clock_mutex);
+    m_clock.emplace_back(block);
+    // The entries of deleted files stay until the hand pass over them, so purge them from time to time
+    if (m_clock.size() >= m_compact_at) {
+        std::erase_if(m_clock, [](const std::weak_ptr<MemoryBlock> &entry) { return entry.expired(); });
+        m_hand = 0;
+        m_compact_at = std::max<size_t>(1024, m_clock.size() * 2);
+    }
+}
+
+void MemoryTier::remove_entry(size_t idx) {
+    if (idx != m_clock.size() - 1) {
+        m_clock[idx] = std::move(m_clock.back());
+    }
+    m_clock.pop_back();
+}
+
+bool MemoryTier::evict_one() {
+    std::unique_lock clock_lock(m_clock_mutex);
+    // Two turns of the hand, the first one could only clear the reference bits
+    size_t steps = m_clock.size() * 2;
+    while (steps-- > 0 && !m_clock.empty()) {
+        if (m_hand >= m_clock.size()) m_hand = 0;
+
+        auto block = m_clock[m_hand].lock();
+        if (!block) {
+            remove_entry(m_hand);
+            continue;
+        }
+        if (block->referenced.exchange(false)) {
+            m_hand++;
+            continue;
+        }
+        // Only try, the owner of the lock could be waiting for the clock
+        std::unique_lock block_lock(block->mutex, std::try_to_lock);
+        if (!block_lock.owns_lock()) {
+            m_hand++;
+            continue;
+        }
+        if (!block->resident()) {
+            remove_entry(m_hand);
+            continue;
+        }
+        if (!spill(*block)) {
+            return false;
+        }
+        remove_entry(m_hand);
+        return true;
+    }
+    return false;
+}
+
+int MemoryTier::get_spill_fd() {
+    // Called with m_spill_mutex locked
+    if (m_spill_fd >= 0) return m_spill_fd;
+
+    std::string path = m_spill_dir + "/xpn_memory_spill_XXXXXX";
+    m_spill_fd = ::mkstemp(path.data());
+    if (m_spill_fd < 0) {
+        print_error("Cannot create the spill file '" << path << "' of the memory filesystem");
+        return -1;
+    }
+    // Only this process use it, so it is removed when the server ends
+    ::unlink(path.c_str());
+    debug_info("Spill file of the memory filesystem in '" << path << "'");
+    return m_spill_fd;
+}
+
+int64_t MemoryTier::alloc_slot(uint64_t size) {
+    std::unique_lock lock(m_spill_mutex);
+    if (get_spill_fd() < 0) return -1;
+    if (!m_free_slots.empty()) {
+        int64_t slot = m_free_slots.back();
+        m_free_slots.pop_back();
+        return slot;
+    }
+    int64_t slot = m_spill_end;
+    m_spill_end += size;
+    return slot;
+}
+
+void MemoryTier::free_slot(int64_t slot, uint64_t size) {
+    std::unique_lock lock(m_spill_mutex);
+    // Give back the disk space, the slot will be filled again when it is reused
+    ::fallocate(m_spill_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, slot, size);
+    m_free_slots.emplace_back(slot);
+}
+
+bool MemoryTier::spill(MemoryBlock &block) {
+    int64_t slot = alloc_slot(block.size);
+    if (slot < 0) return false;
+
+    if (filesystem::pwrite(m_spill_fd, block.data.get(), block.size, slot) != static_cast<int64_t>(block.size)) {
+        print_error("Cannot write the block to the spill file of the memory filesystem");
+        free_slot(slot, block.size);
+        return false;
+    }
+    block.spill_offset = slot;
+    block.data.reset();
+    m_residency->memory_bytes -= block.size;
+    m_residency->disk_bytes += block.size;
+    m_residency->evictions++;
+    debug_info("Evicted block of " << block.size << " to slot " << slot);
+    return true;
+}
+
+bool MemoryTier::load(MemoryBlock &block) {
+    auto data = std::make_unique_for_overwrite<uint8_t[]>(block.size);
+    if (filesystem::pread(m_spill_fd, data.get(), block.size, block.spill_offset) != static_cast<int64_t>(block.size)) {
+        print_error("Cannot read the block from the spill file of the memory filesystem");
+        errno = EIO;
+        return false;
+    }
+    block.data = std::move(data);
+    free_slot(block.spill_offset, block.size);
+    block.spill_offset = -1;
+    m_residency->disk_bytes -= block.size;
+    m_residency->promotions++;
+    return true;
+}
+
+bool MemoryTier::read_spilled(const MemoryBlock &block, void *dst, uint64_t len, uint64_t offset_in_block) {
+    if (filesystem::pread(m_spill_fd, dst, len, block.spill_offset + offset_in_block) != static_cast<int64_t>(len)) {
+        print_error("Cannot read the block from the spill file of the memory filesystem");
+        errno = EIO;
+        return false;
+    }
+    return true;
+}
+
+void MemoryTier::drop(MemoryBlock &block) {
+    if (block.resident()) {
+        m_residency->memory_bytes -= block.size;
+    } else if (block.spill_offset >= 0) {
+        free_slot(block.spill_offset, block.size);
+        m_residency->disk_bytes -= block.size;
+    }
+}
+
+}  // namespace XPN
@@ -0,0 +1,106 @@
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "xpn_server_filesystem.hpp"
+
+namespace XPN {
+
+class MemoryTier;
+
+// Block of a file, the data is in RAM while it is resident and in the spill file when it is evicted.
+// The writers lock it exclusively and the readers go without lock checking the sequence counter,
+// or with the shared lock when the blocks can be evicted.
+struct MemoryBlock {
+    MemoryTier &tier;
+    const uint64_t size;
+    std::unique_ptr<uint8_t[]> data;
+    int64_t spill_offset = -1;             // Slot in the spill file, -1 when it is resident
+    std::atomic_bool referenced = {true};  // Reference bit of the clock
+    std::shared_mutex mutex;               // Protects data and spill_offset
+    std::atomic_uint64_t seq = 0;          // Odd while a write is in progress
+
+    MemoryBlock(MemoryTier &t, uint64_t s) : tier(t), size(s) {}
+    ~MemoryBlock();
+
+    bool resident() const { return static_cast<bool>(data); }
+};
+
+// RAM budget of the memory filesystem. When it is exceeded the cold blocks are evicted
+// with the clock algorithm to a spill file, and they are promoted back on access.
+class MemoryTier {
+   public:
+    MemoryTier(const filesystem_options &options);
+    ~MemoryTier();
+
+    bool limited() const { return m_budget != 0; }
+    filesystem_residency &residency() { return *m_residency; }
+
+    // Account the bytes that are going to be allocated, evicting blocks until they fit in the budget.
+    // It must be called without any block lock held, the eviction locks the victim.
+    void reserve(uint64_t bytes);
+    // Fix the accounting of a reserve with the bytes that were really allocated
+    void settle(uint64_t reserved, uint64_t used);
+
+    // Resident block that can be evicted
+    void track(const std::shared_ptr<MemoryBlock> &block);
+    // Bring back to RAM an evicted block, the block must be locked and the size reserved
+    bool load(MemoryBlock &block);
+    // Read part of an evicted block without promoting it, the block must be locked
+    bool read_spilled(const MemoryBlock &block, void *dst, uint64_t len, uint64_t offset_in_block);
+    // The block is being destroyed
+    void drop(MemoryBlock &block);
+
+   private:
+
+    bool evict_one();
+    bool spill(MemoryBlock &block);
+    void remove_entry(size_t idx);
+    int get_spill_fd();
+    // All the evictable blocks have the same size, so the slots are reused as they are
+    int64_t alloc_slot(uint64_t size);
+    void free_slot(int64_t slot, uint64_t size);
+
+   private:
+    const uint64_t m_budget;
+    const std::string m_spill_dir;
+    filesystem_residency m_own_residency;
+    filesystem_residency *m_residency;
+
+    std::mutex m_clock_mutex;
+    std::vector<std::weak_ptr<MemoryBlock>> m_clock;
+    size_t m_hand = 0;
+    size_t m_compact_at = 1024;
+
+    std::mutex m_spill_mutex;
+    int m_spill_fd = -1;
+    std::vector<int64_t> m_free_slots;
+    int64_t m_spill_end = 0;
+};
+
+}  // namespace XPN
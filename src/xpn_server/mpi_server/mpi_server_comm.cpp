@@ -23,9 +23,204 @@
 #include "base_cpp/socket.hpp"
 #include "base_cpp/ns.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 namespace XPN
 {
 
+mpi_server_progress::mpi_server_progress(bool thread_mode) : m_thread_mode(thread_mode)
+{
+  if (m_thread_mode) {
+    m_thread = std::thread([this]() { run(); });
+  }
+}
+
+mpi_server_progress::~mpi_server_progress()
+{
+  stop();
+}
+
+void mpi_server_progress::stop()
+{
+  {
+    std::unique_lock lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+int mpi_server_progress::wait(MPI_Request &request, MPI_Status &status)
+{
+  if (!m_thread_mode) {
+    return MPI_Wait(&request, &status);
+  }
+  pending item;
+  item.request = request;
+  int ret = submit(item);
+  request = MPI_REQUEST_NULL;
+  status = item.status;
+  return ret;
+}
+
+int mpi_server_progress::probe_recv(void *data, int size, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status &status)
+{
+  if (!m_thread_mode) {
+    MPI_Message message;
+    int count = 0;
+    int ret = MPI_Mprobe(source, tag, comm, &message, &status);
+    if (MPI_SUCCESS != ret) return ret;
+    MPI_Get_count(&status, type, &count);
+    // A bigger message is received anyway to take it out of the queue, and reported truncated
+    ret = MPI_Mrecv(data, size, type, &message, &status);
+    return (MPI_SUCCESS == ret && count > size) ? MPI_ERR_TRUNCATE : ret;
+  }
+  pending item;
+  item.probing = true;
+  item.data = data;
+  item.size = size;
+  item.type = type;
+  item.source = source;
+  item.tag = tag;
+  item.comm = comm;
+  int ret = submit(item);
+  status = item.status;
+  return ret;
+}
+
+int mpi_server_progress::submit(pending &item)
+{
+  {
+    std::unique_lock lock(m_mutex);
+    if (m_stop) {
+      if (item.request != MPI_REQUEST_NULL) {
+        MPI_Cancel(&item.request);
+        MPI_Request_free(&item.request);
+      }
+      return MPI_ERR_OTHER;
+    }
+    m_new.emplace_back(&item);
+  }
+  m_cv.notify_one();
+  item.done.wait(false);
+  return item.ret;
+}
+
+void mpi_server_progress::complete(pending &item, int ret)
+{
+  item.ret = ret;
+  item.done.store(true);
+  item.done.notify_one();
+}
+
+void mpi_server_progress::run()
+{
+  std::vector<pending*> active;
+  std::vector<pending*> waiting;
+  std::vector<MPI_Request> requests;
+  std::vector<int> indices;
+  std::vector<MPI_Status> statuses;
+  int idle = 0;
+
+  while (true)
+  {
+    {
+      std::unique_lock lock(m_mutex);
+      if (active.empty()) {
+        m_cv.wait(lock, [this]() { return m_stop || !m_new.empty(); });
+      }
+      active.insert(active.end(), m_new.begin(), m_new.end());
+      m_new.clear();
+      if (m_stop) break;
+    }
+
+    bool progress = false;
+    waiting.clear();
+    for (auto item : active)
+    {
+      if (item->probing)
+      {
+        // Matched here so that the message cannot be taken by other receive of the same source and tag
+        int flag = 0, count = 0;
+        MPI_Message message;
+        int ret = MPI_Improbe(item->source, item->tag, item->comm, &flag, &message, &item->status);
+        if (MPI_SUCCESS != ret) {
+          complete(*item, ret);
+          progress = true;
+          continue;
+        }
+        if (!flag) {
+          waiting.emplace_back(item);
+          continue;
+        }
+        MPI_Get_count(&item->status, item->type, &count);
+        ret = MPI_Imrecv(item->data, item->size, item->type, &message, &item->request);
+        item->probing = false;
+        progress = true;
+        if (MPI_SUCCESS != ret) {
+          complete(*item, ret);
+          continue;
+        }
+        if (count > item->size) {
+          item->ret = MPI_ERR_TRUNCATE;
+        }
+      }
+      waiting.emplace_back(item);
+    }
+    active.swap(waiting);
+
+    // The probes still unmatched are null requests for MPI_Testsome
+    requests.resize(active.size());
+    for (size_t i = 0; i < active.size(); i++) {
+      requests[i] = active[i]->probing ? MPI_REQUEST_NULL : active[i]->request;
+    }
+    int outcount = 0;
+    indices.resize(requests.size());
+    statuses.resize(requests.size());
+    int ret = requests.empty() ? MPI_SUCCESS : MPI_Testsome(requests.size(), requests.data(), &outcount, indices.data(), statuses.data());
+    if (outcount != MPI_UNDEFINED && outcount > 0)
+    {
+      progress = true;
+      for (int i = 0; i < outcount; i++) {
+        auto item = active[indices[i]];
+        item->status = statuses[i];
+        item->request = MPI_REQUEST_NULL;
+        int item_ret = MPI_ERR_IN_STATUS == ret ? statuses[i].MPI_ERROR : ret;
+        complete(*item, MPI_SUCCESS != item_ret ? item_ret : item->ret);
+        active[indices[i]] = nullptr;
+      }
+      std::erase(active, nullptr);
+    }
+
+    // The probe of the next request of each client is always pending, so without progress the thread spins for a
+    // while and then sleeps with a growing timeout, a new wait ends the sleep
+    if (progress) {
+      idle = 0;
+    } else if (idle < IDLE_SPINS) {
+      idle++;
+      std::this_thread::yield();
+    } else {
+      auto sleep = std::chrono::microseconds(std::min(1 << (idle - IDLE_SPINS), MAX_IDLE_SLEEP_US));
+      idle = std::min(idle + 1, IDLE_SPINS + 10);
+      std::unique_lock lock(m_mutex);
+      m_cv.wait_for(lock, sleep, [this]() { return m_stop || !m_new.empty(); });
+    }
+  }
+
+  // The waits left have no client to complete them
+  for (auto item : active)
+  {
+    if (!item->probing) {
+      MPI_Cancel(&item->request);
+      MPI_Wait(&item->request, MPI_STATUS_IGNORE);
+    }
+    complete(*item, MPI_ERR_OTHER);
+  }
+}
+
 mpi_server_control_comm::mpi_server_control_comm(xpn_server_params &params) : m_thread_mode(params.have_threads())
 {
   XPN_PROFILE_FUNCTION();
@@ -94,6 +289,13 @@ mpi_server_control_comm::mpi_server_control_comm(xpn_server_params &params) : m_
 
   MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
 
+  // The progress thread calls MPI at the same time as the workers
+  claimed = MPI_THREAD_SINGLE;
+  if (m_thread_mode) {
+    MPI_Query_thread(&claimed);
+  }
+  m_progress = std::make_shared<mpi_server_progress>(claimed == MPI_THREAD_MULTIPLE);
+
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_CONTROL_COMM] [mpi_server_control_comm_init] server "<<m_rank<<" available at"<< m_port_name);
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_CONTROL_COMM] [mpi_server_control_comm_init] server "<<m_rank<<" accepting...");
 
@@ -107,6 +309,10 @@ mpi_server_control_comm::~mpi_server_control_comm()
 
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_CONTROL_COMM] [mpi_server_control_comm_destroy] >> Begin");
 
+  if (m_progress) {
+    m_progress->stop();
+  }
+
   // Close port
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_CONTROL_COMM] [mpi_server_control_comm_destroy] Close port");
 
@@ -155,7 +361,7 @@ std::shared_ptr<xpn_server_comm> mpi_server_control_comm::accept ( int socket, b
 
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_CONTROL_COMM] [mpi_server_control_comm_accept] << End");
   
-  return std::make_shared<mpi_server_comm>(comm);
+  return std::make_shared<mpi_server_comm>(comm, m_progress);
 }
 
 void mpi_server_control_comm::disconnect ( std::shared_ptr<xpn_server_comm> comm )
@@ -213,9 +419,10 @@ int64_t mpi_server_comm::read_operation ( xpn_server_msg &msg, int &rank_client_
   // Get message
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_operation] Read operation");
 
-  ret = MPI_Recv(&msg, sizeof(msg), MPI_BYTE, MPI_ANY_SOURCE, 0, m_comm, &status);
+  // Matched with a probe, the operations of the clients are of different sizes
+  ret = m_progress->probe_recv(&msg, sizeof(msg), MPI_BYTE, MPI_ANY_SOURCE, 0, m_comm, status);
   if (MPI_SUCCESS != ret) {
-    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_operation] ERROR: MPI_Recv fails");
+    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_operation] ERROR: MPI_Imrecv fails");
   }
 
   rank_client_id = status.MPI_SOURCE;
@@ -233,6 +440,7 @@ int64_t mpi_server_comm::read_data ( void *data, int64_t size, int rank_client_i
 {
   XPN_PROFILE_FUNCTION_ARGS(size);
   int ret;
+  MPI_Request request;
   MPI_Status status = {};
 
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_data] >> Begin ("<<size<<", "<<rank_client_id<<", "<<tag_client_id<<")");
@@ -249,9 +457,12 @@ int64_t mpi_server_comm::read_data ( void *data, int64_t size, int rank_client_i
   // Get message
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_data] Read data tag "<< tag_client_id);
 
-  ret = MPI_Recv(data, size, MPI_CHAR, rank_client_id, tag_client_id, m_comm, &status);
+  ret = MPI_Irecv(data, size, MPI_CHAR, rank_client_id, tag_client_id, m_comm, &request);
+  if (MPI_SUCCESS == ret) {
+    ret = m_progress->wait(request, status);
+  }
   if (MPI_SUCCESS != ret) {
-    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_data] ERROR: MPI_Recv fails");
+    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_data] ERROR: MPI_Irecv fails");
   }
 
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_read_data] MPI_Recv (MPI SOURCE "<<status.MPI_SOURCE<<", MPI_TAG "<<status.MPI_TAG<<", MPI_ERROR "<<status.MPI_ERROR<<")");
@@ -265,6 +476,8 @@ int64_t mpi_server_comm::write_data ( const void *data, int64_t size, int rank_c
 {
   XPN_PROFILE_FUNCTION_ARGS(size);
   int ret;
+  MPI_Request request;
+  MPI_Status status = {};
 
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_write_data] >> Begin ("<<size<<", "<<rank_client_id<<", "<<tag_client_id<<")");
 
@@ -280,9 +493,12 @@ int64_t mpi_server_comm::write_data ( const void *data, int64_t size, int rank_c
   // Send message
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_write_data] Write data tag "<< tag_client_id);
 
-  ret = MPI_Send(data, size, MPI_CHAR, rank_client_id, tag_client_id, m_comm);
+  ret = MPI_Isend(data, size, MPI_CHAR, rank_client_id, tag_client_id, m_comm, &request);
+  if (MPI_SUCCESS == ret) {
+    ret = m_progress->wait(request, status);
+  }
   if (MPI_SUCCESS != ret) {
-    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_write_data] ERROR: MPI_Send fails");
+    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_write_data] ERROR: MPI_Isend fails");
   }
 
   debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_write_data] << End");
@@ -291,11 +507,91 @@ int64_t mpi_server_comm::write_data ( const void *data, int64_t size, int rank_c
   return size;
 }
 
-int64_t mpi_server_comm::readv_data ( [[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id ) {
-  unreachable("unsupported");
+// Datatype with the absolute addresses of the iovec, to send or receive it as one message from MPI_BOTTOM
+static int mpi_iov_type ( const iovec *iov, int64_t count, MPI_Datatype &type )
+{
+  int lengths[socket::MAX_IOV];
+  MPI_Aint displs[socket::MAX_IOV];
+
+  if (count <= 0 || count > socket::MAX_IOV) {
+    return MPI_ERR_COUNT;
+  }
+  for (int64_t i = 0; i < count; i++) {
+    lengths[i] = static_cast<int>(iov[i].iov_len);
+    MPI_Get_address(iov[i].iov_base, &displs[i]);
+  }
+  int ret = MPI_Type_create_hindexed(count, lengths, displs, MPI_CHAR, &type);
+  if (MPI_SUCCESS == ret) {
+    ret = MPI_Type_commit(&type);
+  }
+  return ret;
 }
 
-int64_t mpi_server_comm::writev_data ( [[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id ) {
-  unreachable("unsupported");
+int64_t mpi_server_comm::readv_data ( const iovec *iov, int64_t count, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  int ret, size = 0;
+  MPI_Status status = {};
+  MPI_Datatype type;
+  MPI_Request request;
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_readv_data] >> Begin ("<<count<<", "<<rank_client_id<<", "<<tag_client_id<<")");
+
+  ret = mpi_iov_type(iov, count, type);
+  if (MPI_SUCCESS != ret) {
+    print("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_readv_data] ERROR: MPI_Type_create_hindexed fails");
+    return -1;
+  }
+
+  ret = MPI_Irecv(MPI_BOTTOM, 1, type, rank_client_id, tag_client_id, m_comm, &request);
+  if (MPI_SUCCESS == ret) {
+    ret = m_progress->wait(request, status);
+  }
+  MPI_Type_free(&type);
+  if (MPI_SUCCESS != ret) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_readv_data] ERROR: MPI_Irecv fails");
+    return -1;
+  }
+  MPI_Get_count(&status, MPI_CHAR, &size);
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_readv_data] << End = "<<size);
+
+  // Return bytes read
+  return size;
+}
+
+int64_t mpi_server_comm::writev_data ( const iovec *iov, int64_t count, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  int ret;
+  int64_t size = 0;
+  MPI_Datatype type;
+  MPI_Request request;
+  MPI_Status status = {};
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_writev_data] >> Begin ("<<count<<", "<<rank_client_id<<", "<<tag_client_id<<")");
+
+  ret = mpi_iov_type(iov, count, type);
+  if (MPI_SUCCESS != ret) {
+    print("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_writev_data] ERROR: MPI_Type_create_hindexed fails");
+    return -1;
+  }
+
+  // The reply and its data in one message
+  ret = MPI_Isend(MPI_BOTTOM, 1, type, rank_client_id, tag_client_id, m_comm, &request);
+  if (MPI_SUCCESS == ret) {
+    ret = m_progress->wait(request, status);
+  }
+  MPI_Type_free(&type);
+  if (MPI_SUCCESS != ret) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_writev_data] ERROR: MPI_Isend fails");
+    return -1;
+  }
+  for (int64_t i = 0; i < count; i++) size += iov[i].iov_len;
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [MPI_SERVER_COMM] [mpi_server_comm_writev_data] << End = "<<size);
+
+  // Return bytes written
+  return size;
 }
 } // namespace XPN
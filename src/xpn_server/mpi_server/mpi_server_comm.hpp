@@ -21,18 +21,70 @@
 #pragma once
 
 #include "mpi.h"
-#include <string>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "xpn_server/xpn_server_comm.hpp"
 
 namespace XPN
 {
-  
+
+  // The requests of all the threads of the server are completed by one progress thread with MPI_Testsome, so the
+  // transfers of the workers overlap instead of each one blocking in MPI. Without threads they are waited in place.
+  class mpi_server_progress
+  {
+  public:
+    mpi_server_progress(bool thread_mode);
+    ~mpi_server_progress();
+
+    // Wait a started request
+    int wait(MPI_Request &request, MPI_Status &status);
+    // Wait a message of source and tag with MPI_Improbe and receive it with MPI_Imrecv, it must fit in size
+    int probe_recv(void *data, int size, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status &status);
+    // Fails the waits still pending, it must be called before MPI_Finalize
+    void stop();
+
+  private:
+    struct pending {
+      MPI_Request request = MPI_REQUEST_NULL;
+      MPI_Status status = {};
+      int ret = MPI_SUCCESS;
+      std::atomic_bool done = false;
+
+      // Until the message is matched
+      bool probing = false;
+      void *data = nullptr;
+      int size = 0;
+      MPI_Datatype type = MPI_BYTE;
+      int source = 0;
+      int tag = 0;
+      MPI_Comm comm = MPI_COMM_NULL;
+    };
+    int submit(pending &item);
+    void run();
+    void complete(pending &item, int ret);
+
+    // Iterations without progress before the thread sleeps, and the longest sleep
+    static constexpr int IDLE_SPINS = 1024;
+    static constexpr int MAX_IDLE_SLEEP_US = 1000;
+
+    bool m_thread_mode;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<pending*> m_new;
+    bool m_stop = false;
+    std::thread m_thread;
+  };
+
   class mpi_server_comm : public xpn_server_comm
   {
   public:
-    mpi_server_comm(MPI_Comm &comm) : m_comm(comm) {
+    mpi_server_comm(MPI_Comm &comm, std::shared_ptr<mpi_server_progress> progress) : m_comm(comm), m_progress(std::move(progress)) {
       // For unique rank
       static int64_t counter = 0;
       server_rank = counter++;
@@ -50,6 +102,7 @@ namespace XPN
     int64_t get_size() override { return m_size; }
    public:
     MPI_Comm m_comm;
+    std::shared_ptr<mpi_server_progress> m_progress;
     int64_t server_rank;
     int m_size;
   };
@@ -70,6 +123,7 @@ namespace XPN
   private:
     int m_rank, m_size;
     bool m_thread_mode;
+    std::shared_ptr<mpi_server_progress> m_progress;
   };
 
 } // namespace XPN
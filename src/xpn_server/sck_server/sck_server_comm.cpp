@@ -89,6 +89,12 @@ sck_server_control_comm::~sck_server_control_comm()
     mqtt_server_comm::mqtt_server_mqtt_destroy(static_cast<mosquitto*>(m_mqtt));
     #endif
   }
+  {
+    std::unique_lock lock(m_shm_mutex);
+    for (auto &&weak_comm : m_shm_comms) {
+      if (auto comm = weak_comm.lock()) comm->m_channel->close();
+    }
+  }
   [[maybe_unused]] int ret = socket::close(m_socket);
   debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_CONTROL_COMM] [sck_server_comm_destroy] close("<<m_socket<<") = "<<ret);
   debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_CONTROL_COMM] [sck_server_comm_destroy] >> End");
@@ -202,6 +208,44 @@ std::shared_ptr<xpn_server_comm> sck_server_control_comm::create ( int rank_clie
   return std::make_shared<sck_server_comm>(rank_client_id);
 }
 
+std::shared_ptr<xpn_server_comm> sck_server_control_comm::upgrade ( int socket, xpn_server_msg &msg )
+{
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_CONTROL_COMM] [sck_server_control_comm_upgrade] >> Begin");
+
+  st_xpn_server_shm_connect &head = *reinterpret_cast<st_xpn_server_shm_connect*>(msg.msg_buffer);
+  head.name[NAME_MAX - 1] = '\0';
+  st_xpn_server_status status{};
+
+  std::unique_ptr<shm_channel> channel = shm_channel::open(head.name, socket);
+  if (!channel || channel->ring_size() != head.ring_size) {
+    status.ret = -1;
+    status.server_errno = channel ? EINVAL : errno;
+    channel.reset();
+    debug_error("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_CONTROL_COMM] [sck_server_control_comm_upgrade] ERROR: cannot open the channel "<<head.name);
+  } else if (epoll_ctl(m_epoll, EPOLL_CTL_DEL, socket, NULL) == -1) {
+    // The requests of the client come by the channel from now
+    status.ret = -1;
+    status.server_errno = errno;
+    channel.reset();
+    debug_error("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_CONTROL_COMM] [sck_server_control_comm_upgrade] Error: epoll_ctl fails "<<strerror(errno));
+  }
+
+  if (socket::send(socket, &status, sizeof(status)) != sizeof(status) || !channel) {
+    rearm(socket);
+    return nullptr;
+  }
+
+  auto comm = std::make_shared<sck_shm_server_comm>(socket, std::move(channel));
+  {
+    std::unique_lock lock(m_shm_mutex);
+    std::erase_if(m_shm_comms, [](auto &weak_comm) { return weak_comm.expired(); });
+    m_shm_comms.emplace_back(comm);
+  }
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_CONTROL_COMM] [sck_server_control_comm_upgrade] client "<<socket<<" moved to "<<head.name);
+  return comm;
+}
+
 int64_t sck_read_operation ( int socket, xpn_server_msg &msg, int &tag_client_id )
 {
   int ret;
@@ -308,6 +352,44 @@ int64_t sck_server_control_comm::read_operation ( std::unique_ptr<xpn_server_msg
   return ret;
 }
 
+int64_t sck_server_control_comm::read_connectionless_operation ( xpn_server_msg &msg, int &rank_client_id, int &tag_client_id, int timeout_ms )
+{
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_control_comm_read_connectionless_operation] >> Begin");
+
+  if (!m_accept_in_epoll) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = m_socket;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_socket, &event) == -1) {
+      debug_error("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_control_comm_read_connectionless_operation] Error: epoll_ctl fails "<<strerror(errno));
+      return 0;
+    }
+    m_accept_in_epoll = true;
+  }
+
+  struct epoll_event event;
+  int nfds = epoll_wait(m_epoll, &event, 1, timeout_ms);
+  if (nfds <= 0) {
+    return 0;
+  }
+
+  if (event.data.fd == m_socket) {
+    // The first operation of the connection comes by the epoll as the next ones
+    auto comm = accept(-1, false);
+    if (comm) {
+      socket::set_keepalive(static_cast<sck_server_comm*>(comm.get())->m_socket, CONNECTIONLESS_KEEPALIVE_S);
+    }
+    return 0;
+  }
+
+  rank_client_id = event.data.fd;
+  auto ret = sck_read_operation(rank_client_id, msg, tag_client_id);
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_control_comm_read_connectionless_operation] << End");
+
+  return ret < 0 ? -1 : 1;
+}
+
 int64_t sck_server_comm::read_operation ( xpn_server_msg &msg, int &rank_client_id, int &tag_client_id )
 {
   rank_client_id = m_socket;
@@ -376,11 +458,103 @@ int64_t sck_server_comm::write_data ( const void *data, int64_t size, [[maybe_un
   return size;
 }
 
-int64_t sck_server_comm::readv_data ( [[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id ) {
-  unreachable("unsupported");
+int64_t sck_server_comm::readv_data ( const iovec *iov, int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id )
+{
+  int64_t ret;
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_comm_readv_data] >> Begin");
+
+  ret = socket::recvv(m_socket, iov, count);
+  if (ret <= 0) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_comm_readv_data] ERROR: readv fails");
+    return -1;
+  }
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_comm_readv_data] << End = "<<ret);
+
+  // Return bytes read
+  return ret;
+}
+
+int64_t sck_server_comm::writev_data ( const iovec *iov, int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id )
+{
+  int64_t ret;
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_comm_writev_data] >> Begin");
+
+  // The reply and its data in one syscall
+  ret = socket::sendv(m_socket, iov, count);
+  if (ret < 0) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_comm_writev_data] ERROR: sendmsg fails");
+    return -1;
+  }
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_server_comm_writev_data] << End = "<<ret);
+
+  // Return bytes written
+  return ret;
+}
+
+int64_t sck_shm_server_comm::read_operation ( xpn_server_msg &msg, int &rank_client_id, int &tag_client_id )
+{
+  rank_client_id = m_socket;
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_shm_server_comm::read_operation] >> Begin");
+
+  // The header says the size of the rest of the msg
+  char *msg_p = reinterpret_cast<char*>(&msg);
+  if (m_channel->recv(msg_p, msg.get_header_size()) < 0 ||
+      m_channel->recv(msg_p + msg.get_header_size(), msg.get_size() - msg.get_header_size()) < 0) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_shm_server_comm::read_operation] Finish comunication");
+    return -2;
+  }
+  tag_client_id = msg.tag;
+
+  debug_info("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_shm_server_comm::read_operation] << End");
+  return 0;
+}
+
+int64_t sck_shm_server_comm::read_data ( void *data, int64_t size, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id )
+{
+  if (size == 0) {
+    return 0;
+  }
+  if (size < 0) {
+    print("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_shm_server_comm_read_data] ERROR: size < 0");
+    return -1;
+  }
+  if (m_channel->recv(data, size) < 0) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_shm_server_comm_read_data] ERROR: read fails");
+  }
+  return size;
+}
+
+int64_t sck_shm_server_comm::write_data ( const void *data, int64_t size, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id )
+{
+  if (size == 0) {
+    return 0;
+  }
+  if (size < 0) {
+    print("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_shm_server_comm_write_data] ERROR: size < 0");
+    return -1;
+  }
+  if (m_channel->send(data, size) < 0) {
+    debug_warning("[Server="<<ns::get_host_name()<<"] [SCK_SERVER_COMM] [sck_shm_server_comm_write_data] ERROR: write fails");
+  }
+  return size;
+}
+
+int64_t sck_shm_server_comm::readv_data ( const iovec *iov, int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id )
+{
+  int64_t total = 0;
+  for (int64_t i = 0; i < count; i++) {
+    if (m_channel->recv(iov[i].iov_base, iov[i].iov_len) < 0) return -1;
+    total += iov[i].iov_len;
+  }
+  return total;
 }
 
-int64_t sck_server_comm::writev_data ( [[maybe_unused]] const iovec *iov, [[maybe_unused]] int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id ) {
-  unreachable("unsupported");
+int64_t sck_shm_server_comm::writev_data ( const iovec *iov, int64_t count, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id )
+{
+  return m_channel->sendv(iov, count);
 }
 } // namespace XPN
\ No newline at end of file
@@ -23,7 +23,10 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "base_cpp/shm_channel.hpp"
 #include "xpn_server/xpn_server_comm.hpp"
 
 namespace XPN
@@ -41,12 +44,29 @@ namespace XPN
     int64_t readv_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) override;
     int64_t writev_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) override;
 
+    bool is_stream() const override { return true; }
+
     int64_t get_rank() override { return m_socket; }
     int64_t get_size() override { return 1; }
   public:
     int m_socket;
   };
   
+  // Connection of a client of the same node moved to a shared memory channel, the socket only tells when it is gone
+  class sck_shm_server_comm : public sck_server_comm
+  {
+  public:
+    sck_shm_server_comm(int socket, std::unique_ptr<shm_channel> channel) : sck_server_comm(socket), m_channel(std::move(channel)) {}
+
+    int64_t read_operation(xpn_server_msg &msg, int &rank_client_id, int &tag_client_id) override;
+    int64_t read_data(void *data, int64_t size, int rank_client_id, int tag_client_id) override;
+    int64_t write_data(const void *data, int64_t size, int rank_client_id, int tag_client_id) override;
+    int64_t readv_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) override;
+    int64_t writev_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) override;
+  public:
+    std::unique_ptr<shm_channel> m_channel;
+  };
+
   class sck_server_control_comm : public xpn_server_control_comm
   {
   public:
@@ -60,9 +80,20 @@ namespace XPN
     int rearm(int rank_client_id) override;
     void disconnect(int rank_client_id) override;
     int64_t read_operation(std::unique_ptr<xpn_server_msg> &msg, int &rank_client_id, int &tag_client_id) override;
+    std::shared_ptr<xpn_server_comm> upgrade(int rank_client_id, xpn_server_msg &msg) override;
+    // The connectionless clients keep their connections between requests: the new connections are accepted and the
+    // operations of the kept ones are read as they come. 1 with an operation, 0 when there is none in timeout_ms and
+    // -1 when the connection of rank_client_id fails
+    int64_t read_connectionless_operation(xpn_server_msg &msg, int &rank_client_id, int &tag_client_id, int timeout_ms);
   private:
     int m_socket;
     int m_epoll;
+    bool m_accept_in_epoll = false;
+    // The kept connections of the clients that are gone without closing them are detected by keepalive
+    static constexpr int CONNECTIONLESS_KEEPALIVE_S = 60;
+    // The channels are closed with the server, their dispatchers wait in them
+    std::mutex m_shm_mutex;
+    std::vector<std::weak_ptr<sck_shm_server_comm>> m_shm_comms;
 
   public:
     void* m_mqtt = nullptr;
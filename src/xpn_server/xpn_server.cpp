@@ -20,8 +20,12 @@
  */
 
 #include <unistd.h>
+#include <sys/resource.h>
+#include <algorithm>
 #include <memory>
 #include <optional>
+#include <random>
+#include <semaphore>
 #include <vector>
 #include <string>
 #include <thread>
@@ -30,7 +34,9 @@
 #include "base_cpp/timer.hpp"
 #include "base_cpp/xpn_env.hpp"
 #include "xpn_server/xpn_server_ops.hpp"
+#include "xpn_server/filesystem/xpn_server_filesystem_lz4_cache.hpp"
 #include "xpn_server_comm.hpp"
+#include "sck_server/sck_server_comm.hpp"
 
 #include "xpn_server.hpp"
 #include <csignal>
@@ -86,7 +92,8 @@ void xpn_server::dispatcher ( std::shared_ptr<xpn_server_comm> comm )
             continue;
         }
         timer timer;
-        m_worker2->launch_no_future([this, timer, comm, msg = std::move(msg), rank_client_id, tag_client_id] () mutable {
+        const xpn_server_msg &msg_ref = *msg;
+        m_scheduler->submit(comm->get_rank(), msg_ref, [this, timer, comm, msg = std::move(msg), rank_client_id, tag_client_id] () mutable {
             std::optional<xpn_stats::scope_stat<xpn_stats::op_stats>> op_stat;
             if (xpn_env::get_instance().xpn_stats) { op_stat.emplace(xpn_stats::scope_stat<xpn_stats::op_stats>(m_stats.m_ops_stats[msg->op], timer)); } 
             do_operation(*comm, *msg, rank_client_id, tag_client_id, timer);
@@ -161,9 +168,27 @@ void xpn_server::one_dispatcher () {
             continue;
         }
 
+        if (type_op == xpn_server_ops::SHM_CONNECT) {
+            debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_one_dispatcher] SHM_CONNECT received");
+
+            std::shared_ptr<xpn_server_comm> comm = m_control_comm->upgrade(rank_client_id, *msg);
+            if (comm) {
+                {
+                    std::unique_lock l(m_clients_mutex);
+                    m_clients[rank_client_id] = comm;
+                }
+                m_worker1->launch_no_future([this, comm]{
+                    this->shm_dispatcher(comm);
+                });
+            }
+            msg_pool.release(std::move(msg));
+            continue;
+        }
+
         timer timer;
         debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_one_dispatcher] Worker launch");
-        m_worker2->launch_no_future([this, timer, msg = std::move(msg), rank_client_id, tag_client_id] () mutable {
+        const xpn_server_msg &msg_ref = *msg;
+        m_scheduler->submit(rank_client_id, msg_ref, [this, timer, msg = std::move(msg), rank_client_id, tag_client_id] () mutable {
             std::optional<xpn_stats::scope_stat<xpn_stats::op_stats>> op_stat;
             if (xpn_env::get_instance().xpn_stats) { op_stat.emplace(xpn_stats::scope_stat<xpn_stats::op_stats>(m_stats.m_ops_stats[msg->op], timer)); }
             xpn_server_comm *comm_ptr = nullptr;
@@ -182,6 +207,65 @@ void xpn_server::one_dispatcher () {
     debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_one_dispatcher] End");
 }
 
+// The sck connections moved to shared memory, one request at a time like the sockets of the epoll
+void xpn_server::shm_dispatcher ( std::shared_ptr<xpn_server_comm> comm )
+{
+    debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_shm_dispatcher] >> Begin");
+    int ret;
+    std::unique_ptr<xpn_server_msg> msg;
+    xpn_server_ops type_op = xpn_server_ops::size;
+    int rank_client_id = 0, tag_client_id = 0;
+    std::binary_semaphore done{0};
+
+    while (true)
+    {
+        msg = msg_pool.acquire();
+        if (msg == nullptr) {
+            debug_error("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_shm_dispatcher] ERROR: new msg allocation");
+            break;
+        }
+
+        ret = comm->read_operation(*msg, rank_client_id, tag_client_id);
+        if (ret < 0) {
+            print("[XPN_SERVER] ERROR: read operation fail, mark client "<<comm->get_rank()<<" as disconnected");
+            m_some_client_had_error = true;
+            msg_pool.release(std::move(msg));
+            break;
+        }
+
+        type_op = static_cast<xpn_server_ops>(msg->op);
+        debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_shm_dispatcher] OP '"<<xpn_server_ops_name(type_op)<<"'; OP_ID "<< static_cast<int>(type_op)<<" client_rank "<<rank_client_id<<" tag_client "<<tag_client_id);
+
+        if (type_op == xpn_server_ops::DISCONNECT || type_op == xpn_server_ops::FINALIZE) {
+            debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_shm_dispatcher] DISCONNECT received");
+            msg_pool.release(std::move(msg));
+            break;
+        }
+
+        timer timer;
+        const xpn_server_msg &msg_ref = *msg;
+        m_scheduler->submit(rank_client_id, msg_ref, [this, &done, timer, comm, msg = std::move(msg), rank_client_id, tag_client_id] () mutable {
+            std::optional<xpn_stats::scope_stat<xpn_stats::op_stats>> op_stat;
+            if (xpn_env::get_instance().xpn_stats) { op_stat.emplace(xpn_stats::scope_stat<xpn_stats::op_stats>(m_stats.m_ops_stats[msg->op], timer)); }
+            do_operation(*comm, *msg, rank_client_id, tag_client_id, timer);
+            msg_pool.release(std::move(msg));
+            done.release();
+        });
+        // The channel is read by the operation, the next one waits for it
+        done.acquire();
+    }
+
+    {
+        std::unique_lock l(m_clients_mutex);
+        m_clients.erase(comm->get_rank());
+        m_num_clients -= 1;
+        m_clients_cv.notify_all();
+    }
+    m_control_comm->disconnect(comm);
+
+    debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_shm_dispatcher] End");
+}
+
 // This is only used in the sck_server
 void xpn_server::connectionless_dispatcher () {
     
@@ -190,32 +274,34 @@ void xpn_server::connectionless_dispatcher () {
     std::unique_ptr<xpn_server_msg> msg;
     xpn_server_ops type_op = xpn_server_ops::size;
     int rank_client_id = 0, tag_client_id = 0;
+    auto control_comm = static_cast<sck_server_control_comm*>(m_control_comm_connectionless.get());
 
     debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] accept in port "<<m_control_comm_connectionless->m_port_name);
 
     while (!m_disconnect)
     {
         debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] Waiting for operation");
-        msg = msg_pool.acquire();
+        if (msg == nullptr) {
+            msg = msg_pool.acquire();
+        }
         if (msg == nullptr) {
             debug_error("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] ERROR: new msg allocation");
             return;
         }
 
-        std::shared_ptr<xpn_server_comm> comm = m_control_comm_connectionless->accept(-1, false);
+        // The clients keep the connection for their next requests, the wait ends from time to time to see the
+        // disconnect of the server
+        ret = control_comm->read_connectionless_operation(*msg, rank_client_id, tag_client_id, CONNECTIONLESS_WAIT_MS);
         if (m_disconnect) {
             debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] disconnect");
             return;
         }
-        if (!comm) {
-            debug_error("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] ERROR: server_accept");
+        if (ret == 0) {
             continue;
         }
-
-
-        ret = comm->read_operation(*msg, rank_client_id, tag_client_id);
         if (ret < 0) {
-            debug_error("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] ERROR: read operation fail");
+            debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] connection "<<rank_client_id<<" closed");
+            m_control_comm_connectionless->disconnect(rank_client_id);
             continue;
         }
 
@@ -224,17 +310,21 @@ void xpn_server::connectionless_dispatcher () {
 
         if (type_op == xpn_server_ops::DISCONNECT || type_op == xpn_server_ops::FINALIZE) {
             debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] DISCONNECT received");
+            m_control_comm_connectionless->disconnect(rank_client_id);
             continue;
         }
 
         timer timer;
         debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] Worker launch");
-        m_worker2->launch_no_future([this, comm, timer, msg = std::move(msg), rank_client_id, tag_client_id] () mutable {
+        std::shared_ptr<xpn_server_comm> comm = m_control_comm_connectionless->create(rank_client_id);
+        const xpn_server_msg &msg_ref = *msg;
+        m_scheduler->submit(rank_client_id, msg_ref, [this, comm, timer, msg = std::move(msg), rank_client_id, tag_client_id] () mutable {
             std::optional<xpn_stats::scope_stat<xpn_stats::op_stats>> op_stat;
             if (xpn_env::get_instance().xpn_stats) { op_stat.emplace(xpn_stats::scope_stat<xpn_stats::op_stats>(m_stats.m_ops_stats[msg->op], timer)); }
             do_operation(*comm, *msg, rank_client_id, tag_client_id, timer);
-            m_control_comm_connectionless->disconnect(comm);
             msg_pool.release(std::move(msg));
+            // The next request of the client comes by the same connection
+            m_control_comm_connectionless->rearm(rank_client_id);
         });
         
         debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_connectionless_dispatcher] Worker launched");
@@ -276,6 +366,25 @@ void xpn_server::accept ( int connection_socket )
     }
 }
 
+int xpn_server::grant_connections ( int requested )
+{
+    int granted = std::clamp(requested, 1, m_params.max_connections);
+    struct rlimit limit = {};
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return granted;
+    }
+    int64_t clients = 0;
+    {
+        std::unique_lock l(m_clients_mutex);
+        clients = m_clients.size();
+    }
+    // The extra connections only take the descriptors that the handles and the current clients leave free
+    int64_t free_fds = static_cast<int64_t>(limit.rlim_cur) - RESERVED_FDS - m_params.max_handles - clients;
+    granted = 1 + static_cast<int>(std::clamp<int64_t>(free_fds, 0, granted - 1));
+    debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_grant_connections] requested "<<requested<<" granted "<<granted<<" free fds "<<free_fds);
+    return granted;
+}
+
 void xpn_server::finish ( void )
 {
     // Wait and finalize for all current workers
@@ -288,6 +397,8 @@ void xpn_server::finish ( void )
         m_clients_cv.notify_all();
     }
 
+    // The connectionless dispatcher sees the disconnect when its wait ends
+    m_workerConnectionLess.reset();
     m_control_comm_connectionless.reset();
     m_control_comm.reset();
     debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_finish] comms destroy");
@@ -296,8 +407,8 @@ void xpn_server::finish ( void )
     m_worker1.reset();
     debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_finish] Before worker2 reset");
     m_worker2.reset();
-    debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_finish] Before workerConnectionLess reset");
-    m_workerConnectionLess.reset();
+    m_scheduler.reset();
+    m_workerLeases.reset();
     
     debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_finish] workers destroy");
 }
@@ -311,13 +422,22 @@ xpn_server::xpn_server(int argc, char *argv[]) : m_params(argc, argv)
     if (xpn_env::get_instance().xpn_stats){
         m_window_stats = std::make_unique<xpn_window_stats>(m_stats);
     }
-    m_filesystem = xpn_server_filesystem::Create(m_params.fs_mode);
+    filesystem_options fs_options;
+    fs_options.memory_budget = m_params.memory_budget;
+    fs_options.memory_spill_dir = m_params.memory_spill_dir;
+    fs_options.residency = &m_stats.m_residency;
+    fs_options.dedup_dir = m_params.dedup_dir;
+    m_filesystem = xpn_server_filesystem::Create(m_params.fs_mode, fs_options);
+    LZ4BlockCache::get_instance().configure(m_params.compressed_cache);
+    xpn_dictionary::set_directory(m_params.dict_dir);
     if (!m_filesystem){
         std::cerr << "Error: unexpected error cannot create filesystem interface" << std::endl;
         std::raise(SIGTERM);
     }
 
     m_start_time = std::chrono::high_resolution_clock::now();
+    // Other for each run, so the handles of a previous run are not confused with the new ones
+    m_handle_epoch = std::random_device{}() | 1;
 }
 
 xpn_server::~xpn_server()
@@ -365,6 +485,13 @@ int xpn_server::run()
         debug_error("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_up] ERROR: Workers initialization fails");
         return -1;
     }
+    m_scheduler = std::make_unique<xpn_server_scheduler>(m_params, *m_worker2, m_stats);
+
+    m_workerLeases = workers::Create(workers_mode::thread_on_demand, false);
+    if (m_workerLeases == nullptr) {
+        debug_error("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_up] ERROR: Workers initialization fails");
+        return -1;
+    }
 
     debug_info("[TH_ID="<<std::this_thread::get_id()<<"] [XPN_SERVER] [xpn_server_up] Comm connectionless initialization");
     xpn_server_params connectionless_params{m_params.argc, m_params.argv};
@@ -420,6 +547,17 @@ int xpn_server::run()
                 }
                 } break;
 
+            case socket::xpn_server::CONNECTIONS_CODE: {
+                int requested = 0;
+                ret = socket::recv(connection_socket, &requested, sizeof(requested));
+                if (ret < 0) break;
+                int granted = grant_connections(requested);
+                ret = socket::send(connection_socket, &granted, sizeof(granted));
+                if (ret < 0){
+                    print("[Server="<<ns::get_host_name()<<"] [XPN_SERVER] [xpn_server_up] ERROR: socket send connections fails");
+                }
+                } break;
+
             case socket::xpn_server::STATS_wINDOW_CODE:
                 if (m_window_stats){
                     socket::send(connection_socket, &m_window_stats->get_current_stats(), sizeof(m_stats));
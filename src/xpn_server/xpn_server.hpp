@@ -26,6 +26,7 @@
 #include "xpn_server_params.hpp"
 #include "xpn_server_comm.hpp"
 #include "xpn_server_ops.hpp"
+#include "xpn_server_scheduler.hpp"
 #include "base_cpp/workers.hpp"
 #include "base_cpp/queue_pool.hpp"
 #include "xpn/xpn_stats.hpp"
@@ -43,9 +44,16 @@ namespace XPN
         int print_stats();
 
         void accept(int socket);
+        // Connections granted to a client that asks for requested, bounded by the descriptors left to the server
+        int grant_connections(int requested);
+        // Descriptors kept out of the grants for the files, the epoll and the control sockets
+        static constexpr int64_t RESERVED_FDS = 64;
         void dispatcher(std::shared_ptr<xpn_server_comm> comm);
         void one_dispatcher();
         void connectionless_dispatcher();
+        // The connectionless dispatcher checks the disconnect of the server at least this often
+        static constexpr int CONNECTIONLESS_WAIT_MS = 200;
+        void shm_dispatcher(std::shared_ptr<xpn_server_comm> comm);
         void do_operation(xpn_server_comm &comm, const xpn_server_msg& msg, int rank_client_id, int tag_client_id, timer timer);
         void finish();
 
@@ -55,6 +63,9 @@ namespace XPN
         std::unique_ptr<xpn_server_control_comm> m_control_comm;
         std::unique_ptr<xpn_server_control_comm> m_control_comm_connectionless;
         std::unique_ptr<workers> m_worker1, m_worker2, m_workerConnectionLess;
+        // The async removes that wait a lease, ended after the requests
+        std::unique_ptr<workers> m_workerLeases;
+        std::unique_ptr<xpn_server_scheduler> m_scheduler;
 
         xpn_stats m_stats;
         std::unique_ptr<xpn_window_stats> m_window_stats;
@@ -81,23 +92,108 @@ namespace XPN
         std::mutex m_file_map_md_fq_mutex;
         std::unordered_map<std::string, file_map_md_fq_item> m_file_map_md_fq;
 
+        // op_write coalescing
+        struct pending_write {
+            xpn_server_filesystem *filesystem;
+            int fd;
+            char disk_compress;
+            uint32_t bsize;
+            xpn_codec disk_codec;
+            uint32_t dict_id;
+            const char *data;
+            uint64_t size;
+            int64_t offset;
+
+            int64_t result = 0;
+            int error = 0;
+            bool done = false;
+        };
+        struct file_map_wr_item {
+            std::atomic_uint64_t m_count = 0;
+
+            std::mutex m_queue_mutex = {};
+            std::condition_variable m_queue_cv = {};
+            bool m_writing = false;
+            std::vector<pending_write*> m_in_queue = {};
+        };
+        std::mutex m_file_map_wr_mutex;
+        std::unordered_map<std::string, file_map_wr_item> m_file_map_wr;
+
+        // op_lease: the direct access of the clients of the same node to the backing files
+        struct file_lease {
+            uint64_t generation = 0;
+            std::chrono::steady_clock::time_point expiry = {};
+            uint32_t breaks = 0;  // Removes and renames of the path in progress, no lease is granted meanwhile
+            bool revoked = false; // A remove or rename waits the granted lease to end, it is not renewed
+        };
+        std::mutex m_leases_mutex;
+        std::unordered_map<std::string, file_lease> m_leases;
+        uint64_t m_lease_generation = 0;
+
+        // op_open: the files kept open for the clients that ask for a handle, the least recently used is closed when
+        // the table is full and its handle becomes stale
+        struct file_handle {
+            xpn_server_filesystem *filesystem = nullptr;
+            int fd = -1;
+            std::string path;
+            ~file_handle() { if (fd >= 0) filesystem->close(fd); }
+        };
+        struct handle_slot {
+            std::shared_ptr<file_handle> file;
+            uint64_t generation = 0;
+            uint64_t last_use = 0;
+        };
+        std::mutex m_handles_mutex;
+        std::vector<handle_slot> m_handles;
+        std::vector<uint32_t> m_free_handles;
+        uint64_t m_handle_generation = 0;
+        uint64_t m_handle_clock = 0;
+        uint32_t m_handle_epoch = 0;
+
         std::chrono::time_point<std::chrono::high_resolution_clock> m_start_time;
         bool m_some_client_had_error = false;
 
     public:
         // File operations
         void op_open        ( xpn_server_comm &comm, const st_xpn_server_path_flags   &head, int rank_client_id, int tag_client_id );
+        // Open of op_open and op_open_mdata, the status and the handle in the reply
+        void open_file(const st_xpn_server_path_flags &head, st_xpn_server_open_req &req);
         void op_creat       ( xpn_server_comm &comm, const st_xpn_server_path_flags   &head, int rank_client_id, int tag_client_id );
         void op_read        ( xpn_server_comm &comm, const st_xpn_server_rw           &head, int rank_client_id, int tag_client_id );
         void op_write       ( xpn_server_comm &comm, const st_xpn_server_rw           &head, int rank_client_id, int tag_client_id );
         void op_read_v2     ( xpn_server_comm &comm, const st_xpn_server_read_v2      &head, int rank_client_id, int tag_client_id );
         void op_write_v2    ( xpn_server_comm &comm, const st_xpn_server_write_v2     &head, int rank_client_id, int tag_client_id );
+        // The large raw reads and writes of the stream transports go by chunks of STREAM_CHUNK_SIZE, the writes of
+        // the compressed files by whole blocks, one is read or written in the backend while the other is sent or
+        // received
+        bool use_stream(const xpn_server_comm &comm, const st_xpn_server_rw &head, uint64_t size) const;
+        void stream_read(xpn_server_comm &comm, xpn_server_filesystem &filesystem, int fd, const st_xpn_server_rw &head, st_xpn_server_rw_req &req, int rank_client_id, int tag_client_id);
+        int64_t stream_write(xpn_server_comm &comm, xpn_server_filesystem &filesystem, file_map_wr_item &wr_item, int fd, const st_xpn_server_rw &head, int rank_client_id, int tag_client_id);
+        static constexpr uint64_t STREAM_CHUNK_SIZE = 1024 * 1024;
+        static constexpr uint64_t STREAM_BUFFERS = 2;
+        void op_write_zero  ( xpn_server_comm &comm, const st_xpn_server_rw           &head, int rank_client_id, int tag_client_id );
+        void op_write_dedup ( xpn_server_comm &comm, const st_xpn_server_dedup        &head, int rank_client_id, int tag_client_id );
         void op_close       ( xpn_server_comm &comm, const st_xpn_server_close        &head, int rank_client_id, int tag_client_id );
         void op_rm          ( xpn_server_comm &comm, const st_xpn_server_path         &head, int rank_client_id, int tag_client_id );
         void op_rm_async    ( xpn_server_comm &comm, const st_xpn_server_path         &head, int rank_client_id, int tag_client_id );
         void op_rename      ( xpn_server_comm &comm, const st_xpn_server_rename       &head, int rank_client_id, int tag_client_id );
         void op_setattr     ( xpn_server_comm &comm, const st_xpn_server_setattr      &head, int rank_client_id, int tag_client_id );
         void op_getattr     ( xpn_server_comm &comm, const st_xpn_server_path         &head, int rank_client_id, int tag_client_id );
+        void op_lease       ( xpn_server_comm &comm, const st_xpn_server_path         &head, int rank_client_id, int tag_client_id );
+        // Lease break before the path is removed or replaced: no lease of it is granted until end_lease_break, and
+        // the clients open the file again when they renew it after it. False with the end of the granted lease in
+        // expiry while it lasts, it is not renewed and the remove or rename is done again after it
+        bool break_lease(const char *path, std::chrono::steady_clock::time_point &expiry);
+        void end_lease_break(const char *path);
+        // The async remove of a path with a granted lease, off the workers of the requests until the lease ends
+        void rm_after_lease(std::string path, std::chrono::steady_clock::time_point expiry);
+        // Open the file of a path for the requests by handle, an invalid handle when it cannot be granted
+        xpn_server_handle open_handle(const char *path);
+        // The file of a handle while the request uses it, nullptr when it is stale
+        std::shared_ptr<file_handle> get_handle(const xpn_server_handle &handle);
+        void close_handle(const xpn_server_handle &handle);
+        // The handles of a path that is removed or renamed become stale
+        void close_handles(const char *path);
 
         // Directory operations
         void op_mkdir       ( xpn_server_comm &comm, const st_xpn_server_path_flags   &head, int rank_client_id, int tag_client_id );
@@ -114,12 +210,23 @@ namespace XPN
         void op_read_mdata   ( xpn_server_comm &comm, const st_xpn_server_path        &head, int rank_client_id, int tag_client_id );
         void op_write_mdata  ( xpn_server_comm &comm, const st_xpn_server_write_mdata &head, int rank_client_id, int tag_client_id );
         void op_write_mdata_file_size  ( xpn_server_comm &comm, const st_xpn_server_write_mdata_file_size &head, int rank_client_id, int tag_client_id );
+        // The open and the getattr that return the metadata header with them, in one round trip
+        void op_open_mdata   ( xpn_server_comm &comm, const st_xpn_server_path_flags  &head, int rank_client_id, int tag_client_id );
+        void op_getattr_mdata( xpn_server_comm &comm, const st_xpn_server_path        &head, int rank_client_id, int tag_client_id );
+        // Read of the metadata header of op_read_mdata, op_open_mdata and op_getattr_mdata
+        void read_mdata(const char *path, st_xpn_server_read_mdata_req &req);
         file_map_md_fq_item &get_mdata_queue(const char *path);
         void release_mdata_queue(const char *path, file_map_md_fq_item &item);
+        file_map_wr_item &get_write_queue(const char *path);
+        void release_write_queue(const char *path, file_map_wr_item &item);
+        int64_t coalesced_pwrite(file_map_wr_item &item, pending_write &write);
         
         // Flush preload
         void op_flush        ( xpn_server_comm &comm, const st_xpn_server_flush_preload_ckpt &head, int rank_client_id, int tag_client_id );
         void op_preload      ( xpn_server_comm &comm, const st_xpn_server_flush_preload_ckpt &head, int rank_client_id, int tag_client_id );
         void op_checkpoint   ( xpn_server_comm &comm, const st_xpn_server_flush_preload_ckpt &head, int rank_client_id, int tag_client_id );
+
+        // Compression api
+        void op_register_dict( xpn_server_comm &comm, const st_xpn_server_dict &head, int rank_client_id, int tag_client_id );
     };    
 }
\ No newline at end of file
@@ -22,6 +22,7 @@
 #pragma once
 
   #include <sys/uio.h>
+  #include <cerrno>
   #include "xpn_server_params.hpp"
   #include "xpn_server_ops.hpp"
   #include <memory>
@@ -39,6 +40,12 @@ namespace XPN
     virtual int64_t write_data(const void *data, int64_t size, int rank_client_id, int tag_client_id) = 0;
     virtual int64_t readv_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) = 0;
     virtual int64_t writev_data(const iovec *iov, int64_t count, int rank_client_id, int tag_client_id) = 0;
+    // One-sided transfers from and to the registered buffer of the client, in the transports that have them
+    virtual int64_t rdma_get([[maybe_unused]] void *data, [[maybe_unused]] int64_t size, [[maybe_unused]] int rank_client_id, [[maybe_unused]] const xpn_server_rdma &rdma) { errno = ENOTSUP; return -1; }
+    virtual int64_t rdma_put([[maybe_unused]] const void *data, [[maybe_unused]] int64_t size, [[maybe_unused]] int rank_client_id, [[maybe_unused]] const xpn_server_rdma &rdma) { errno = ENOTSUP; return -1; }
+
+    // The data written at once can be read in pieces of other sizes and the other way round, as in the sockets
+    virtual bool is_stream() const { return false; }
 
     virtual int64_t get_rank() = 0;
     virtual int64_t get_size() = 0;
@@ -58,6 +65,9 @@ namespace XPN
     virtual int rearm(int rank_client_id) = 0;
     virtual void disconnect(int rank_client_id) = 0;
     virtual int64_t read_operation(std::unique_ptr<xpn_server_msg> &msg, int &rank_client_id, int &tag_client_id) = 0;
+    // Move the connection of the client to the transport asked in msg, the reply is sent here.
+    // nullptr when the connection stays in this control comm
+    virtual std::shared_ptr<xpn_server_comm> upgrade([[maybe_unused]] int rank_client_id, [[maybe_unused]] xpn_server_msg &msg) { return nullptr; }
 
     static std::unique_ptr<xpn_server_control_comm> Create(xpn_server_params &params);
   public:
@@ -106,8 +106,13 @@ WorkerResult flush_file_blocks_task(std::unique_ptr<FlushEntry> entry, xpn_parti
         file.map_offset_mdata(off_dst, 0, off_src, serv);
         if (serv == rank) {
             off64_t src_pos = off_src + xpn_metadata::HEADER_SIZE;
+            int64_t bytes_to_send = std::min(block_size, (uint64_t)(file_size - off_dst));
+            // The holes are not copied, the range of the destination is freed in case it had old data
+            if (!filesystem::has_data(fd_src, bytes_to_send, src_pos)) {
+                filesystem::punch_hole(fd_dest, bytes_to_send, off_dst);
+                continue;
+            }
             if (lseek64(fd_dest, off_dst, SEEK_SET) >= 0) {
-                int64_t bytes_to_send = std::min(block_size, (uint64_t)(file_size - off_dst));
                 ssize_t sent = filesystem::sendfile(fd_dest, fd_src, &src_pos, bytes_to_send);
                 if (sent > 0)
                     bytes_copied_local += sent;
@@ -123,6 +128,12 @@ WorkerResult flush_file_blocks_task(std::unique_ptr<FlushEntry> entry, xpn_parti
         }
     }
 
+    // A hole at the end of the file is not written by any rank
+    struct stat st;
+    if (fstat(fd_dest, &st) == 0 && st.st_size < file_size && ftruncate(fd_dest, file_size) < 0) {
+        perror("ftruncate flush");
+    }
+
     close(fd_src);
     close(fd_dest);
 
@@ -332,6 +343,7 @@ WorkerResult preload_file_blocks_task(std::unique_ptr<PreloadEntry> entry, xpn_p
     int64_t offset_src = 0;
     int64_t local_offset;
     int local_server;
+    int64_t local_size = 0;
 
     while (offset_src < static_cast<int64_t>(entry->file_size)) {
         for (int i = 0; i <= dummy_part.m_replication_level+1; i++) {
@@ -341,7 +353,10 @@ WorkerResult preload_file_blocks_task(std::unique_ptr<PreloadEntry> entry, xpn_p
                 off64_t dst_pos = local_offset + xpn_metadata::HEADER_SIZE;
                 int64_t to_copy = std::min(static_cast<int64_t>(dummy_part.m_block_size),
                                            static_cast<int64_t>(entry->file_size - offset_src));
+                local_size = std::max(local_size, dst_pos + to_copy);
 
+                // The holes of the source are left as holes in the server
+                if (!filesystem::has_data(fd_src, to_copy, src_pos)) continue;
                 if (lseek64(fd_dest, dst_pos, SEEK_SET) >= 0) {
                     ssize_t sent = filesystem::sendfile(fd_dest, fd_src, &src_pos, to_copy);
                     if (sent > 0) bytes_copied_local += sent;
@@ -364,6 +379,10 @@ WorkerResult preload_file_blocks_task(std::unique_ptr<PreloadEntry> entry, xpn_p
     if (write_mdata) {
         pwrite64(fd_dest, &file.m_mdata.m_data, sizeof(file.m_mdata.m_data), 0);
     }
+    // The blocks of the rank that are holes at the end are not written
+    if (local_size > 0 && ftruncate(fd_dest, local_size) < 0) {
+        perror("ftruncate preload");
+    }
 
     close(fd_src);
     close(fd_dest);
@@ -20,14 +20,21 @@
  */
 
 #include "base_cpp/debug.hpp"
+#include "base_cpp/parallel_for.hpp"
 #include "xpn_server.hpp"
 #include "base_cpp/timer.hpp"
+#include "base_cpp/xpn_checksum.hpp"
 #include "lz4.h"
+#include "nfi/nfi_xpn_server/adaptative_compressor.hpp"
+#include "xpn_server/filesystem/xpn_server_filesystem_dedup.hpp"
 #include "xpn_server/filesystem/xpn_server_filesystem_lz4.hpp"
+#include "xpn_server/filesystem/xpn_server_filesystem_lz4_cache.hpp"
 #include "xpn_server/xpn_server_ops.hpp"
 #include <stddef.h>
 #include <fcntl.h>
+#include <limits.h>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <iostream>
@@ -35,6 +42,7 @@
 #include <string>
 #include <cstdlib>
 #include <thread>
+#include <tuple>
 
 #ifdef ENABLE_MQTT_SERVER
 #include "mqtt_server/mqtt_server_ops.hpp"
@@ -75,12 +83,18 @@ void xpn_server::do_operation ( xpn_server_comm &comm, const xpn_server_msg& msg
                                                   std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
                                                   if (xpn_env::get_instance().xpn_stats) { io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_total, msg_struct->size, timer)); } 
                                                   break;}
+    case xpn_server_ops::WRITE_ZERO_FILE:        {HANDLE_OPERATION(st_xpn_server_rw,                     op_write_zero);
+                                                  std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
+                                                  if (xpn_env::get_instance().xpn_stats) { io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_total, msg_struct->size, timer)); } 
+                                                  break;}
+    case xpn_server_ops::WRITE_DEDUP_FILE:       {HANDLE_OPERATION(st_xpn_server_dedup,                  op_write_dedup);           break;}
     case xpn_server_ops::CLOSE_FILE:             {HANDLE_OPERATION(st_xpn_server_close,                  op_close);                 break;}
     case xpn_server_ops::RM_FILE:                {HANDLE_OPERATION(st_xpn_server_path,                   op_rm);                    break;}
     case xpn_server_ops::RM_FILE_ASYNC:          {HANDLE_OPERATION(st_xpn_server_path,                   op_rm_async);              break;}
     case xpn_server_ops::RENAME_FILE:            {HANDLE_OPERATION(st_xpn_server_rename,                 op_rename);                break;}
     case xpn_server_ops::GETATTR_FILE:           {HANDLE_OPERATION(st_xpn_server_path,                   op_getattr);               break;}
     case xpn_server_ops::SETATTR_FILE:           {HANDLE_OPERATION(st_xpn_server_setattr,                op_setattr);               break;}
+    case xpn_server_ops::LEASE_FILE:             {HANDLE_OPERATION(st_xpn_server_path,                   op_lease);                 break;}
 
     //Directory API
     case xpn_server_ops::MKDIR_DIR:              {HANDLE_OPERATION(st_xpn_server_path_flags,             op_mkdir);                 break;}
@@ -94,6 +108,8 @@ void xpn_server::do_operation ( xpn_server_comm &comm, const xpn_server_msg& msg
     case xpn_server_ops::READ_MDATA:             {HANDLE_OPERATION(st_xpn_server_path,                   op_read_mdata);            break;}
     case xpn_server_ops::WRITE_MDATA:            {HANDLE_OPERATION(st_xpn_server_write_mdata,            op_write_mdata);           break;}
     case xpn_server_ops::WRITE_MDATA_FILE_SIZE:  {HANDLE_OPERATION(st_xpn_server_write_mdata_file_size,  op_write_mdata_file_size); break;}
+    case xpn_server_ops::OPEN_WITH_MDATA:        {HANDLE_OPERATION(st_xpn_server_path_flags,             op_open_mdata);            break;}
+    case xpn_server_ops::GETATTR_WITH_MDATA:     {HANDLE_OPERATION(st_xpn_server_path,                   op_getattr_mdata);         break;}
 
     case xpn_server_ops::STATVFS_DIR:            {HANDLE_OPERATION(st_xpn_server_path,                   op_statvfs);               break;}
 
@@ -101,6 +117,8 @@ void xpn_server::do_operation ( xpn_server_comm &comm, const xpn_server_msg& msg
     case xpn_server_ops::FLUSH:                  {HANDLE_OPERATION(st_xpn_server_flush_preload_ckpt,     op_flush);                 break;}
     case xpn_server_ops::PRELOAD:                {HANDLE_OPERATION(st_xpn_server_flush_preload_ckpt,     op_preload);               break;}
     case xpn_server_ops::CHECKPOINT:             {HANDLE_OPERATION(st_xpn_server_flush_preload_ckpt,     op_checkpoint);            break;}
+    // Compression
+    case xpn_server_ops::REGISTER_DICT:          {HANDLE_OPERATION(st_xpn_server_dict,                   op_register_dict);         break;}
     //Connection API
     case xpn_server_ops::DISCONNECT: break;
     //Rest operation are unknown
@@ -115,37 +133,49 @@ void xpn_server::do_operation ( xpn_server_comm &comm, const xpn_server_msg& msg
 void xpn_server::op_open ( xpn_server_comm &comm, const st_xpn_server_path_flags &head, int rank_client_id, int tag_client_id )
 {
   XPN_PROFILE_FUNCTION();
-  st_xpn_server_status status{};
+  st_xpn_server_open_req req{};
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open] >> Begin");
 
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open] open("<<head.path.path<<", "<<format_open_flags(head.flags)<<", "<<format_open_mode(head.mode)<<")");
+  open_file(head, req);
+  comm.write_data((char *)&req, sizeof(st_xpn_server_open_req), rank_client_id, tag_client_id);
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open] << End");
+}
+
+void xpn_server::open_file ( const st_xpn_server_path_flags &head, st_xpn_server_open_req &req )
+{
+  st_xpn_server_status &status = req.status;
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_open_file] open("<<head.path.path<<", "<<format_open_flags(head.flags)<<", "<<format_open_mode(head.mode)<<")");
 
   // do open
+  if (head.flags & O_TRUNC) {
+    LZ4BlockCache::get_instance().forget(*m_filesystem, head.path.path);
+  }
   status.ret = m_filesystem->open(head.path.path, head.flags, head.mode);
   status.server_errno = errno;
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open] open("<<head.path.path<<")="<< status.ret);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_open_file] open("<<head.path.path<<")="<< status.ret);
   if (status.ret < 0){
-    comm.write_data((char *)&status, sizeof(st_xpn_server_status), rank_client_id, tag_client_id);
-  }else{
-    if (head.xpn_session == 0){
-      status.ret = m_filesystem->close(status.ret);
-    }
-    status.server_errno = errno;
-
-    if (m_params.srv_type == server_type::MQTT){
-      if (m_control_comm->m_type == server_type::SCK){
-        #if defined(ENABLE_MQTT_SERVER)
-        auto sck_comm = static_cast<sck_server_control_comm*>(m_control_comm.get());
-        mqtt_server_ops::subscribe(static_cast<mosquitto*>(sck_comm->m_mqtt), m_params.mqtt_qos, head.path.path);
-        #endif
-      }
-    }
+    return;
+  }
 
-    comm.write_data((char *)&status, sizeof(st_xpn_server_status), rank_client_id, tag_client_id);
+  if (head.xpn_session == 0){
+    status.ret = m_filesystem->close(status.ret);
+  }
+  status.server_errno = errno;
+  if (head.xpn_session == 0 && head.want_handle == 1 && status.ret >= 0){
+    req.handle = open_handle(head.path.path);
   }
 
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open] << End");
+  if (m_params.srv_type == server_type::MQTT){
+    if (m_control_comm->m_type == server_type::SCK){
+      #if defined(ENABLE_MQTT_SERVER)
+      auto sck_comm = static_cast<sck_server_control_comm*>(m_control_comm.get());
+      mqtt_server_ops::subscribe(static_cast<mosquitto*>(sck_comm->m_mqtt), m_params.mqtt_qos, head.path.path);
+      #endif
+    }
+  }
 }
 
 void xpn_server::op_creat ( xpn_server_comm &comm, const st_xpn_server_path_flags &head, int rank_client_id, int tag_client_id )
@@ -157,6 +187,7 @@ void xpn_server::op_creat ( xpn_server_comm &comm, const st_xpn_server_path_flag
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_creat] creat("<<head.path.path<<")");
 
   // do creat
+  LZ4BlockCache::get_instance().forget(*m_filesystem, head.path.path);
   status.ret = m_filesystem->creat(head.path.path, head.mode);
   status.server_errno = errno;
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_creat] creat("<<head.path.path<<")="<<status.ret);
@@ -187,21 +218,26 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
   XPN_PROFILE_FUNCTION();
   st_xpn_server_rw_req req{};
   bool fast_path_used = false;
+  auto handle = get_handle(head.handle);
+  // The requests by handle have not the path
+  const char *path = handle ? handle->path.c_str() : head.handle.valid() ? "" : head.path.path;
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read] >> Begin");
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read] read("<<head.path.path<<", "<<head.offset<<", "<<head.size<<")");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read] read("<<path<<", "<<head.offset<<", "<<head.size<<")");
 
   std::chrono::time_point<std::chrono::high_resolution_clock> read_t1, read_t2;
   std::chrono::time_point<std::chrono::high_resolution_clock> com_t1, com_t2;
 
   uint64_t buffer_size = head.size;
-  std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(buffer_size);
-  char *buffer_data = buffer.get();
+  std::unique_ptr<char[]> buffer = nullptr;
+  char *buffer_data = nullptr;
   uint64_t compressed_data_size = LZ4_COMPRESSBOUND(head.size);
   std::unique_ptr<char[]> compressed_data = nullptr;
   char *compressed_data_data = nullptr;
 
-  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize);
+  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize, head.disk_codec, xpn_dictionary::get(head.dict_id),
+                                   m_worker2.get());
+  lz4_fs.set_checksums(head.checksum != 0);
   xpn_server_filesystem * filesystem = m_filesystem.get();
   if (head.disk_compress == 1){
     filesystem = &lz4_fs;
@@ -209,21 +245,35 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
 
   // Open file
   int fd;
-  if (head.xpn_session == 1) {
+  if (handle) {
+    fd = handle->fd;
+  } else if (head.handle.valid()) {
+    // The handle was closed or evicted, the client repeats the request by path
+    fd = -1;
+    errno = ESTALE;
+  } else if (head.xpn_session == 1) {
     fd = head.fd;
   } else {
-    fd = filesystem->open(head.path.path, O_RDONLY);
+    fd = filesystem->open(path, O_RDONLY);
   }
   if (fd < 0) {
     req.size = -1;
     req.status.ret = fd;
     req.status.server_errno = errno;
-    debug_error("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_write] Error open " << head.path.path
+    debug_error("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_write] Error open " << path
                            << " " << strerror(errno));
     comm.write_data((char *)&req, sizeof(st_xpn_server_rw_req), rank_client_id, tag_client_id);
     goto cleanup_xpn_server_op_read;
   }
 
+  // The large raw reads are sent while they are read, without a buffer of the whole request
+  if (use_stream(comm, head, head.size)) {
+    stream_read(comm, *filesystem, fd, head, req, rank_client_id, tag_client_id);
+    goto cleanup_xpn_server_op_read;
+  }
+  buffer = std::make_unique_for_overwrite<char[]>(buffer_size);
+  buffer_data = buffer.get();
+
   if (head.compressed_size == 1) {
     debug_info("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_read] Alloc compressed data buffer size "
                           << compressed_data_size << " bytes.");
@@ -233,11 +283,12 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
     // Optimization to read complete block already compressed
     if (head.disk_compress != 0) {
       if (lz4_fs.is_aligned_for_direct_io(head.offset, head.size)) {
-        uint32_t comp_size, uncomp_size;
+        uint32_t comp_size, uncomp_size, block_dict_id;
+        uint64_t block_checksum;
 
         if (head.xpn_compression != 0) read_t1 = std::chrono::high_resolution_clock::now();
-        int64_t uncomp_read =
-            lz4_fs.pread_compressed_block(fd, compressed_data_data, head.offset, comp_size, uncomp_size);
+        int64_t uncomp_read = lz4_fs.pread_compressed_block(fd, compressed_data_data, head.offset, comp_size,
+                                                            uncomp_size, block_dict_id, block_checksum);
         if (head.xpn_compression != 0) read_t2 = std::chrono::high_resolution_clock::now();
 
         if (uncomp_read >= 0) {
@@ -245,6 +296,9 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
             req.size = uncomp_read;
             req.compressed_size = comp_size;
             req.uncompressed_size = uncomp_size;
+            req.dict_id = block_dict_id;
+            // The block goes as it is in disk, the client verifies it with the checksum stored with it
+            if (head.checksum >= 2) req.checksum = block_checksum;
             req.status.ret = 0;
             req.status.server_errno = errno;
             req.compress_time_us = 0;  // Skipped compression!
@@ -287,10 +341,37 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
       comm.write_data((char *)&req, sizeof(st_xpn_server_rw_req), rank_client_id, tag_client_id);
       goto cleanup_xpn_server_op_read;
     }
-    if (head.compressed_size == 1) {
+    if (head.checksum >= 2) req.checksum = xpn_checksum(buffer_data, req.size);
+    // In the adaptive mode the blocks that fail the pre-check are sent raw, the client sees compressed_size 0,
+    // and so does a read after the end of the file, the client does not wait for data when the size is 0
+    bool must_compress = head.compressed_size == 1 && req.size > 0;
+    uint64_t check_us = 0;
+    if (must_compress && head.xpn_compression == 1) {
+      auto check_t1 = std::chrono::high_resolution_clock::now();
+      must_compress = AdaptiveCompressor::is_compressible(buffer_data, req.size);
+      auto check_t2 = std::chrono::high_resolution_clock::now();
+      check_us = std::chrono::duration_cast<std::chrono::microseconds>(check_t2 - check_t1).count();
+    }
+    // The small reads asked with the dictionary are compressed with it, and sent raw when they do not shrink
+    std::shared_ptr<const xpn_dictionary> net_dict;
+    if (must_compress && head.net_dict && req.size <= (int64_t)xpn_dictionary::SMALL_BLOCK_SIZE) {
+      net_dict = xpn_dictionary::get(head.dict_id);
+    }
+    if (must_compress) {
       if (head.xpn_compression != 0) com_t1 = std::chrono::high_resolution_clock::now();
-      req.compressed_size = LZ4_compress_fast(buffer_data, compressed_data_data, buffer_size, compressed_data_size, 10);
+      if (net_dict) {
+        req.compressed_size = net_dict->compress(head.net_codec, buffer_data, compressed_data_data, req.size, compressed_data_size);
+        req.dict_id = net_dict->id();
+      } else {
+        req.compressed_size = head.net_codec.compress(buffer_data, compressed_data_data, req.size, compressed_data_size);
+      }
       if (head.xpn_compression != 0) com_t2 = std::chrono::high_resolution_clock::now();
+      if (net_dict && (req.compressed_size == 0 || req.compressed_size >= (uint64_t)req.size)) {
+        must_compress = false;
+        req.dict_id = 0;
+      }
+    }
+    if (must_compress) {
       debug_info(
           "Compression speed: "
           << ((static_cast<double>(buffer_size) / (1024.0 * 1024.0)) /
@@ -305,7 +386,7 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
       req.status.server_errno = errno;
       req.num_clients = m_num_clients;
       if (head.xpn_compression != 0)
-        req.compress_time_us = std::chrono::duration_cast<std::chrono::microseconds>(com_t2 - com_t1).count();
+        req.compress_time_us = std::chrono::duration_cast<std::chrono::microseconds>(com_t2 - com_t1).count() + check_us;
       if (head.xpn_compression != 0)
         req.rw_time_us = std::chrono::duration_cast<std::chrono::microseconds>(read_t2 - read_t1).count();
       comm.write_data((char *)&req, sizeof(st_xpn_server_rw_req), rank_client_id, tag_client_id);
@@ -322,13 +403,21 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
       req.uncompressed_size = req.size;
       req.status.ret = 0;
       req.status.server_errno = errno;
-      req.compress_time_us = 0;
+      req.compress_time_us = check_us;
       req.num_clients = m_num_clients;
       if (head.xpn_compression != 0)
         req.rw_time_us = std::chrono::duration_cast<std::chrono::microseconds>(read_t2 - read_t1).count();
+      // The data is written in the buffer of the client before the reply that tells it is there
+      bool rdma_used = head.rdma.valid() && req.size > 0;
+      if (rdma_used && comm.rdma_put(buffer_data, req.size, rank_client_id, head.rdma) < 0) {
+        req.size = -1;
+        req.status.ret = -1;
+        req.status.server_errno = errno;
+        debug_error("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_read] Error rdma put of " << format_bytes(req.uncompressed_size));
+      }
       comm.write_data((char *)&req, sizeof(st_xpn_server_rw_req), rank_client_id, tag_client_id);
       debug_info("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_read] op_read: send size " << req.size);
-      {
+      if (!rdma_used) {
         std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
         if (xpn_env::get_instance().xpn_stats) {
             io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_net, req.size));
@@ -340,33 +429,53 @@ void xpn_server::op_read ( xpn_server_comm &comm, const st_xpn_server_rw &head,
   debug_info("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_read] op_read: send data");
 
 cleanup_xpn_server_op_read:
-  if (head.xpn_session == 0) {
+  if (head.xpn_session == 0 && !handle) {
     filesystem->close(fd);
   }
 
-  debug_info("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_read] read(" << head.path.path << ", "
+  debug_info("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_read] read(" << path << ", "
                         << head.offset << ", " << head.size << ")=" << req.size);
   debug_info("[Server=" << serv_name << "] [XPN_SERVER_OPS] [xpn_server_op_read] << End");
 }
 
+// The data received must be the one hashed by the client, the writes that do not match are not done
+static bool verify_checksum(uint64_t checksum, const char *data, uint64_t size)
+{
+  if (checksum == 0 || xpn_checksum(data, size) == checksum) return true;
+  debug_error("[XPN_SERVER_OPS] [verify_checksum] Error: checksum mismatch in a write of "<<format_bytes(size));
+  errno = EIO;
+  return false;
+}
+
 void xpn_server::op_write ( xpn_server_comm &comm, const st_xpn_server_rw &head, int rank_client_id, int tag_client_id )
 {
   XPN_PROFILE_FUNCTION();
   st_xpn_server_rw_req req{};
+  int fd = -1;
   int decompressed_size;
   bool fast_path_used = false;
+  auto handle = get_handle(head.handle);
+  // The requests by handle have not the path
+  const char *path = handle ? handle->path.c_str() : head.handle.valid() ? "" : head.path.path;
+  file_map_wr_item &wr_item = get_write_queue(path);
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] >> Begin");
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] write("<<head.path.path<<", "<<head.offset<<", "<<head.size<<")");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] write("<<path<<", "<<head.offset<<", "<<head.size<<")");
 
   uint64_t compressed_buffer_size = head.compressed_size;
   std::unique_ptr<char[]> compressed_buffer = std::make_unique_for_overwrite<char[]>(compressed_buffer_size);
   char* compressed_buffer_data = compressed_buffer.get();
   uint64_t uncompressed_buffer_size = head.uncompressed_size;
-  std::unique_ptr<char[]> uncompressed_buffer = std::make_unique_for_overwrite<char[]>(uncompressed_buffer_size);
+  bool streamed = use_stream(comm, head, head.uncompressed_size);
+  std::unique_ptr<char[]> uncompressed_buffer = nullptr;
+  if (!streamed) {
+    uncompressed_buffer = std::make_unique_for_overwrite<char[]>(uncompressed_buffer_size);
+  }
   char* uncompressed_buffer_data = uncompressed_buffer.get();
 
-  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize);
+  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize, head.disk_codec, xpn_dictionary::get(head.dict_id),
+                                   m_worker2.get());
+  lz4_fs.set_checksums(head.checksum != 0);
   xpn_server_filesystem *filesystem = m_filesystem.get();
   if (head.disk_compress == 1){
     filesystem = &lz4_fs;
@@ -382,7 +491,17 @@ void xpn_server::op_write ( xpn_server_comm &comm, const st_xpn_server_rw &head,
       int64_t stat_size = head.compressed_size > 0 ? head.compressed_size : head.uncompressed_size;
       io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_read_net, stat_size));
     } 
-    if (head.compressed_size > 0) {
+    if (streamed) {
+      // Received by chunks after the open
+    } else if (head.rdma.valid()) {
+      // The client sent only the operation, the payload is read from its buffer
+      if (comm.rdma_get(uncompressed_buffer_data, head.uncompressed_size, rank_client_id, head.rdma) < 0) {
+        req.size = -1;
+        req.status.ret = -1;
+        debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] Error rdma get of "<<format_bytes(head.uncompressed_size));
+        goto cleanup_xpn_server_op_write;
+      }
+    } else if (head.compressed_size > 0) {
       comm.read_data(compressed_buffer_data, head.compressed_size, rank_client_id, tag_client_id);
     } else {
       comm.read_data(uncompressed_buffer_data, head.uncompressed_size, rank_client_id, tag_client_id);
@@ -390,32 +509,46 @@ void xpn_server::op_write ( xpn_server_comm &comm, const st_xpn_server_rw &head,
   }
 
   //Open file
-  int fd;
-  if (head.xpn_session == 1) {
+  if (handle) {
+    fd = handle->fd;
+  } else if (head.handle.valid()) {
+    // The handle was closed or evicted, the client repeats the request by path
+    fd = -1;
+    errno = ESTALE;
+  } else if (head.xpn_session == 1) {
     fd = head.fd;
-  }else{
-    fd = filesystem->open(head.path.path, O_WRONLY);
+  } else {
+    fd = filesystem->open(path, O_WRONLY);
+  }
+
+  // The large raw writes are written while they are received, without a buffer of the whole request. The payload
+  // is received also when the file cannot be opened, the next operation is after it
+  if (streamed) {
+    req.size = stream_write(comm, *filesystem, wr_item, fd, head, rank_client_id, tag_client_id);
+    req.status.ret = req.size < 0 ? -1 : 0;
+    goto cleanup_xpn_server_op_write;
   }
 
   if (fd < 0) {
     req.size = -1;
     req.status.ret = -1;
-    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] Error open "<<head.path.path<<" "<<strerror(errno));
+    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] Error open "<<path<<" "<<strerror(errno));
     goto cleanup_xpn_server_op_write;
   }
 
   
   if (head.compressed_size > 0) {
-    // Optimization to write complete block already compressed
-    if (head.disk_compress != 0) {
+    // Optimization to write complete block already compressed, when it is in the codec of the disk
+    if (head.disk_compress != 0 && head.net_codec == head.disk_codec) {
       if (lz4_fs.is_aligned_for_direct_io(head.offset, head.uncompressed_size)) {
         std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
         if (xpn_env::get_instance().xpn_stats) io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_disk, head.compressed_size));
 
         if (head.xpn_compression != 0) write_t1 = std::chrono::high_resolution_clock::now();
 
-        int64_t written_logical = lz4_fs.pwrite_compressed_block(fd, compressed_buffer_data, head.compressed_size,
-                                                                  head.uncompressed_size, head.offset);
+        int64_t written_logical =
+            lz4_fs.pwrite_compressed_block(fd, compressed_buffer_data, head.compressed_size, head.uncompressed_size,
+                                           head.offset, head.net_dict ? head.dict_id : 0, head.data_checksum);
         if (head.xpn_compression != 0) write_t2 = std::chrono::high_resolution_clock::now();
 
         if (written_logical >= 0) {
@@ -428,8 +561,16 @@ void xpn_server::op_write ( xpn_server_comm &comm, const st_xpn_server_rw &head,
 
     if (!fast_path_used) {
       if (head.xpn_compression != 0) decom_t1 = std::chrono::high_resolution_clock::now();
-      decompressed_size = LZ4_decompress_safe(compressed_buffer_data, uncompressed_buffer_data, compressed_buffer_size, uncompressed_buffer_size);
+      if (head.net_dict) {
+        auto dict = xpn_dictionary::get(head.dict_id);
+        decompressed_size = dict ? dict->decompress(compressed_buffer_data, uncompressed_buffer_data, compressed_buffer_size, uncompressed_buffer_size) : -1;
+      } else {
+        decompressed_size = xpn_codec::decompress(head.net_codec.type, compressed_buffer_data, uncompressed_buffer_data, compressed_buffer_size, uncompressed_buffer_size);
+      }
       if (head.xpn_compression != 0) decom_t2 = std::chrono::high_resolution_clock::now();
+      if (decompressed_size >= 0 && !verify_checksum(head.data_checksum, uncompressed_buffer_data, uncompressed_buffer_size)) {
+        decompressed_size = -1;
+      }
       if (decompressed_size >= 0) {
         debug_info("Decompression speed: "
                    << ((static_cast<double>(uncompressed_buffer_size) / (1024.0 * 1024.0)) /
@@ -440,18 +581,22 @@ void xpn_server::op_write ( xpn_server_comm &comm, const st_xpn_server_rw &head,
         std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
         if (xpn_env::get_instance().xpn_stats) { io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_disk, uncompressed_buffer_size)); } 
         if (head.xpn_compression != 0) write_t1 = std::chrono::high_resolution_clock::now();
-        req.size = filesystem->pwrite(fd, uncompressed_buffer_data, uncompressed_buffer_size, head.offset);
+        pending_write write{filesystem, fd, head.disk_compress, head.bsize, head.disk_codec, head.dict_id, uncompressed_buffer_data, uncompressed_buffer_size, head.offset};
+        req.size = coalesced_pwrite(wr_item, write);
         if (head.xpn_compression != 0) write_t2 = std::chrono::high_resolution_clock::now();
         // req.size = uncompressed_buffer_size;
       } else {
         req.size = decompressed_size;
       }
     }
+  } else if (!verify_checksum(head.data_checksum, uncompressed_buffer_data, uncompressed_buffer_size)) {
+    req.size = -1;
   } else {
     std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
     if (xpn_env::get_instance().xpn_stats) { io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_disk, uncompressed_buffer_size)); } 
     if (head.xpn_compression != 0) write_t1 = std::chrono::high_resolution_clock::now();
-    req.size = filesystem->pwrite(fd, uncompressed_buffer_data, uncompressed_buffer_size, head.offset);
+    pending_write write{filesystem, fd, head.disk_compress, head.bsize, head.disk_codec, head.dict_id, uncompressed_buffer_data, uncompressed_buffer_size, head.offset};
+    req.size = coalesced_pwrite(wr_item, write);
     if (head.xpn_compression != 0) write_t2 = std::chrono::high_resolution_clock::now();
     // req.size = uncompressed_buffer_size;
   }
@@ -463,6 +608,7 @@ void xpn_server::op_write ( xpn_server_comm &comm, const st_xpn_server_rw &head,
 
   req.status.ret = 0;
 cleanup_xpn_server_op_write:
+  release_write_queue(path, wr_item);
   // if (!fast_path_used) {
   //   print("warning fast_path_used is not used in write off " << head.offset << " size " << head.size);
   // }
@@ -474,22 +620,308 @@ cleanup_xpn_server_op_write:
   
   comm.write_data((char *)&req,sizeof(st_xpn_server_rw_req), rank_client_id, tag_client_id);
 
-  if (head.xpn_session == 1){
+  if (handle) {
+    // The handle keeps the file open until the client closes it
+  } else if (head.xpn_session == 1){
     filesystem->fsync(fd);
   }else{
     filesystem->close(fd);
   }
 
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] write("<<head.path.path<<", "<<head.offset<<", "<<head.size<<")="<< req.size);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] write("<<path<<", "<<head.offset<<", "<<head.size<<")="<< req.size);
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write] << End");
 }
 
+bool xpn_server::use_stream ( const xpn_server_comm &comm, const st_xpn_server_rw &head, uint64_t size ) const
+{
+  // The one-sided, compressed and checksummed transfers need the whole payload at once
+  return comm.is_stream() && !head.rdma.valid() && head.compressed_size == 0 && head.checksum == 0 &&
+         size > STREAM_CHUNK_SIZE;
+}
+
+// The reply goes before the data, the chunks follow each one after its length. The first chunk shorter than
+// STREAM_CHUNK_SIZE, or the one that completes the request, is the last, and a negative length is the errno of a
+// read that fails
+void xpn_server::stream_read ( xpn_server_comm &comm, xpn_server_filesystem &filesystem, int fd, const st_xpn_server_rw &head, st_xpn_server_rw_req &req, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  struct stream_chunk {
+    std::unique_ptr<char[]> data;
+    int64_t size = 0;
+    background_task task;
+  };
+  auto read_chunk = [&](stream_chunk &chunk, uint64_t pos) {
+    uint64_t len = std::min(STREAM_CHUNK_SIZE, head.size - pos);
+    std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
+    if (xpn_env::get_instance().xpn_stats) {
+      io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_read_disk, len));
+    }
+    chunk.size = 0;
+    while (chunk.size < (int64_t)len) {
+      int64_t ret = filesystem.pread(fd, chunk.data.get() + chunk.size, len - chunk.size, head.offset + pos + chunk.size);
+      if (ret < 0) {
+        chunk.size = errno != 0 ? -errno : -EIO;
+        return;
+      }
+      if (ret == 0) break;
+      chunk.size += ret;
+    }
+  };
+  // Declared after what the background reads use, so they are waited before it is destroyed
+  std::array<stream_chunk, STREAM_BUFFERS> chunks;
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_stream_read] >> Begin");
+
+  req.size = head.size;
+  req.compressed_size = 0;
+  req.uncompressed_size = head.size;
+  req.stream_chunk = STREAM_CHUNK_SIZE;
+  req.status.ret = 0;
+  req.status.server_errno = 0;
+  req.num_clients = m_num_clients;
+  if (comm.write_data((char *)&req, sizeof(st_xpn_server_rw_req), rank_client_id, tag_client_id) < 0) {
+    return;
+  }
+
+  for (auto &chunk : chunks) {
+    chunk.data = std::make_unique_for_overwrite<char[]>(std::min(STREAM_CHUNK_SIZE, head.size));
+  }
+  read_chunk(chunks[0], 0);
+  uint64_t pos = 0;
+  for (uint64_t i = 0; ; i++) {
+    stream_chunk &chunk = chunks[i % STREAM_BUFFERS];
+    chunk.task.wait();
+    uint64_t len = std::min(STREAM_CHUNK_SIZE, head.size - pos);
+    bool last = chunk.size < (int64_t)len || pos + len == head.size;
+    if (!last) {
+      // The next chunk is read while this one is sent
+      stream_chunk &next = chunks[(i + 1) % STREAM_BUFFERS];
+      uint64_t next_pos = pos + len;
+      next.task.start(m_worker2.get(), [&read_chunk, &next, next_pos]() { read_chunk(next, next_pos); });
+    }
+    if (chunk.size < 0) {
+      debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_stream_read] Error read "<<strerror(-chunk.size));
+    }
+
+    iovec iov[2] = {{&chunk.size, sizeof(chunk.size)}, {chunk.data.get(), (size_t)std::max<int64_t>(chunk.size, 0)}};
+    std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
+    if (xpn_env::get_instance().xpn_stats) {
+      io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_net, iov[1].iov_len));
+    }
+    if (comm.writev_data(iov, iov[1].iov_len > 0 ? 2 : 1, rank_client_id, tag_client_id) < 0 || last) {
+      break;
+    }
+    pos += len;
+  }
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_stream_read] << End");
+}
+
+// The payload is received by chunks, one is written while the next is received. After an error the rest of the
+// payload is received without writing it
+int64_t xpn_server::stream_write ( xpn_server_comm &comm, xpn_server_filesystem &filesystem, file_map_wr_item &wr_item, int fd, const st_xpn_server_rw &head, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  struct stream_chunk {
+    std::unique_ptr<char[]> data;
+    uint64_t size = 0;
+    int64_t offset = 0;
+    int64_t result = 0;
+    int error = 0;
+    background_task task;
+  };
+  int error = fd < 0 ? errno : 0;
+  int64_t written = 0;
+  auto write_chunk = [&](stream_chunk &chunk) {
+    std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
+    if (xpn_env::get_instance().xpn_stats) {
+      io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_disk, chunk.size));
+    }
+    pending_write write{&filesystem, fd, head.disk_compress, head.bsize, head.disk_codec, head.dict_id, chunk.data.get(), chunk.size, chunk.offset};
+    chunk.result = coalesced_pwrite(wr_item, write);
+    chunk.error = chunk.result < 0 ? errno : 0;
+  };
+  // Account the write of a chunk, the buffer can be received again after it
+  auto finish_chunk = [&](stream_chunk &chunk) {
+    chunk.task.wait();
+    if (chunk.size == 0) return;
+    if (chunk.result < 0 && error == 0) {
+      error = chunk.error;
+    } else if (chunk.result >= 0) {
+      written += chunk.result;
+    }
+    chunk.size = 0;
+  };
+  // Declared after what the background writes use, so they are waited before it is destroyed
+  std::array<stream_chunk, STREAM_BUFFERS> chunks;
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_stream_write] >> Begin");
+
+  // The chunks of the compressed files are of whole blocks and end in them, so the blocks are not read and written
+  // again, only the first and the last of the request can be partial
+  const bool by_blocks = head.disk_compress != 0 && head.bsize > 0;
+  const uint64_t chunk_size = by_blocks ? std::max<uint64_t>(STREAM_CHUNK_SIZE / head.bsize, 1) * head.bsize : STREAM_CHUNK_SIZE;
+  uint64_t pos = 0;
+  for (uint64_t i = 0; pos < head.uncompressed_size; i++) {
+    stream_chunk &chunk = chunks[i % STREAM_BUFFERS];
+    finish_chunk(chunk);
+    int64_t offset = head.offset + pos;
+    int64_t end = offset + chunk_size;
+    if (by_blocks && end > (int64_t)lz4_block_header::RAW_HEADER_SIZE) {
+      // The blocks start after the raw header of the file
+      end = (end - lz4_block_header::RAW_HEADER_SIZE) / head.bsize * head.bsize + lz4_block_header::RAW_HEADER_SIZE;
+    }
+    uint64_t len = std::min<uint64_t>(end - offset, head.uncompressed_size - pos);
+    if (!chunk.data) {
+      chunk.data = std::make_unique_for_overwrite<char[]>(std::min(chunk_size, head.uncompressed_size));
+    }
+    {
+      std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
+      if (xpn_env::get_instance().xpn_stats) {
+        io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_read_net, len));
+      }
+      if (comm.read_data(chunk.data.get(), len, rank_client_id, tag_client_id) < 0) {
+        if (error == 0) error = EIO;
+        break;
+      }
+    }
+    pos += len;
+    if (error != 0) continue;
+    chunk.size = len;
+    chunk.offset = offset;
+    chunk.task.start(m_worker2.get(), [&write_chunk, &chunk]() { write_chunk(chunk); });
+  }
+  for (auto &chunk : chunks) {
+    finish_chunk(chunk);
+  }
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_stream_write] << End "<<written<<" "<<strerror(error));
+
+  if (error != 0) {
+    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_stream_write] Error write "<<strerror(error));
+    errno = error;
+    return -1;
+  }
+  return written;
+}
+
+void xpn_server::op_write_zero ( xpn_server_comm &comm, const st_xpn_server_rw &head, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  st_xpn_server_rw_req req{};
+  auto handle = get_handle(head.handle);
+  // The requests by handle have not the path
+  const char *path = handle ? handle->path.c_str() : head.handle.valid() ? "" : head.path.path;
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_zero] >> Begin");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_zero] write_zero("<<path<<", "<<head.offset<<", "<<head.size<<")");
+
+  // The range has no data, the filesystem punch a hole or marks the blocks as zeros when it can
+  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize, head.disk_codec, xpn_dictionary::get(head.dict_id),
+                                   m_worker2.get());
+  lz4_fs.set_checksums(head.checksum != 0);
+  xpn_server_filesystem *filesystem = m_filesystem.get();
+  if (head.disk_compress == 1){
+    filesystem = &lz4_fs;
+  }
+
+  //Open file
+  int fd;
+  if (handle) {
+    fd = handle->fd;
+  } else if (head.handle.valid()) {
+    // The handle was closed or evicted, the client repeats the request by path
+    fd = -1;
+    errno = ESTALE;
+  } else if (head.xpn_session == 1) {
+    fd = head.fd;
+  } else {
+    fd = filesystem->open(path, O_WRONLY);
+  }
+
+  if (fd < 0) {
+    req.size = -1;
+    req.status.ret = -1;
+    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_zero] Error open "<<path<<" "<<strerror(errno));
+  } else {
+    req.size = filesystem->write_zeros(fd, head.size, head.offset);
+    req.status.ret = req.size < 0 ? -1 : 0;
+  }
+
+  req.status.server_errno = errno;
+  req.num_clients = m_num_clients;
+  comm.write_data((char *)&req,sizeof(st_xpn_server_rw_req), rank_client_id, tag_client_id);
+
+  if (fd >= 0 && !handle) {
+    if (head.xpn_session == 1){
+      filesystem->fsync(fd);
+    }else{
+      filesystem->close(fd);
+    }
+  }
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_zero] write_zero("<<path<<", "<<head.offset<<", "<<head.size<<")="<< req.size);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_zero] << End");
+}
+
+void xpn_server::op_write_dedup ( xpn_server_comm &comm, const st_xpn_server_dedup &head, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  st_xpn_server_dedup_req req{};
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_dedup] >> Begin");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_dedup] write_dedup("<<head.path.path<<", "<<head.offset<<", "<<head.count<<")");
+
+  // The compressed files store other bytes than the ones of the client, and the blocks must be the ones of the store
+  auto *dedup_fs = m_filesystem->m_mode == filesystem_mode::dedup ? static_cast<xpn_server_filesystem_dedup *>(m_filesystem.get()) : nullptr;
+  req.enabled = dedup_fs != nullptr;
+  int fd = -1;
+  if (dedup_fs && head.disk_compress == 0 && head.bsize == xpn_server_filesystem_dedup::BLOCK_SIZE) {
+    if (head.xpn_session == 1) {
+      fd = head.fd;
+    }else{
+      fd = dedup_fs->open(head.path.path, O_WRONLY);
+    }
+    if (fd < 0) {
+      req.status.ret = -1;
+      debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_dedup] Error open "<<head.path.path<<" "<<strerror(errno));
+    }
+  }
+
+  uint32_t count = std::min(head.count, st_xpn_server_dedup::MAX_BLOCKS);
+  for (uint32_t i = 0; fd >= 0 && i < count; i++) {
+    int res = dedup_fs->reference_block(fd, head.fingerprints[i], head.bsize, head.offset + (int64_t)i * head.bsize);
+    if (res < 0) {
+      req.status.ret = -1;
+      break;
+    }
+    if (res > 0) req.found |= 1ULL << i;
+  }
+
+  req.status.server_errno = errno;
+  comm.write_data((char *)&req,sizeof(st_xpn_server_dedup_req), rank_client_id, tag_client_id);
+
+  if (fd >= 0) {
+    if (head.xpn_session == 1){
+      dedup_fs->fsync(fd);
+    }else{
+      dedup_fs->close(fd);
+    }
+  }
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_dedup] write_dedup("<<head.path.path<<", "<<head.offset<<", "<<head.count<<")= found "<<std::hex<<req.found<<std::dec);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_dedup] << End");
+}
+
 void xpn_server::op_read_v2 ( xpn_server_comm &comm, const st_xpn_server_read_v2 &head, int rank_client_id, int tag_client_id )
 {
   XPN_PROFILE_FUNCTION();
+  auto handle = get_handle(head.handle);
+  // The requests by handle have not the path
+  const char *path = handle ? handle->path.c_str() : head.handle.valid() ? "" : head.path.path;
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] >> Begin");
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] read("<<head.path.path<<", "<<head.offset<<", "<<head.size<<")");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] read("<<path<<", "<<head.offset<<", "<<head.size<<")");
   bool fast_path_used = false;
   std::chrono::time_point<std::chrono::high_resolution_clock> read_t1, read_t2;
   st_xpn_server_read_v2_req req{};
@@ -500,7 +932,8 @@ void xpn_server::op_read_v2 ( xpn_server_comm &comm, const st_xpn_server_read_v2
   std::unique_ptr<char[]> compressed_data = nullptr;
   char *compressed_data_data = nullptr;
 
-  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize);
+  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize, head.disk_codec, xpn_dictionary::get(head.dict_id),
+                                   m_worker2.get());
   xpn_server_filesystem * filesystem = m_filesystem.get();
   if (head.disk_compress == 1){
     filesystem = &lz4_fs;
@@ -508,17 +941,23 @@ void xpn_server::op_read_v2 ( xpn_server_comm &comm, const st_xpn_server_read_v2
 
   //Open file
   int fd;
-  if (head.xpn_session == 1){
+  if (handle) {
+    fd = handle->fd;
+  } else if (head.handle.valid()) {
+    // The handle was closed or evicted, the client repeats the request by path
+    fd = -1;
+    errno = ESTALE;
+  } else if (head.xpn_session == 1) {
     fd = head.fd;
-  }else{
-    fd = filesystem->open(head.path.path, O_RDONLY);
+  } else {
+    fd = filesystem->open(path, O_RDONLY);
   }
   if (fd < 0)
   {
     req.size = -1;
     req.status.ret = fd;
     req.status.server_errno = errno;
-    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] Error open "<<head.path.path<<" "<<strerror(errno));
+    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] Error open "<<path<<" "<<strerror(errno));
     comm.write_data(&req, sizeof(req), rank_client_id, tag_client_id);
     goto cleanup_xpn_server_op_read;
   }
@@ -533,14 +972,16 @@ void xpn_server::op_read_v2 ( xpn_server_comm &comm, const st_xpn_server_read_v2
     // Optimization to read complete block already compressed
     if (head.disk_compress != 0) {
       if (lz4_fs.is_aligned_for_direct_io(head.offset, head.size)) {
-        uint32_t comp_size, uncomp_size;
+        uint32_t comp_size, uncomp_size, block_dict_id;
+        uint64_t block_checksum;
 
         if (head.xpn_compression != 0) read_t1 = std::chrono::high_resolution_clock::now();
-        int64_t uncomp_read =
-            lz4_fs.pread_compressed_block(fd, compressed_data_data, head.offset, comp_size, uncomp_size);
+        int64_t uncomp_read = lz4_fs.pread_compressed_block(fd, compressed_data_data, head.offset, comp_size,
+                                                            uncomp_size, block_dict_id, block_checksum);
         if (head.xpn_compression != 0) read_t2 = std::chrono::high_resolution_clock::now();
 
-        if (uncomp_read >= 0) {
+        // The reply of V2 has not dictionary, the blocks compressed with it are decompressed here
+        if (uncomp_read >= 0 && block_dict_id == 0) {
             // Successfully read directly!
             req.size = uncomp_read;
             req.compressed_size = comp_size;
@@ -590,7 +1031,7 @@ void xpn_server::op_read_v2 ( xpn_server_comm &comm, const st_xpn_server_read_v2
       req.size = -1;
       req.status.ret = -1;
       req.status.server_errno = errno;
-      debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] Error pread "<<head.path.path<<" "<<strerror(errno));
+      debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] Error pread "<<path<<" "<<strerror(errno));
       comm.write_data(&req, sizeof(req), rank_client_id, tag_client_id);
       goto cleanup_xpn_server_op_read;
     }
@@ -601,7 +1042,7 @@ void xpn_server::op_read_v2 ( xpn_server_comm &comm, const st_xpn_server_read_v2
       std::unique_ptr<char[]> compressed_data = std::make_unique_for_overwrite<char[]>(compressed_data_size);
       char* compressed_data_data = compressed_data.get();
       if (head.xpn_compression != 0) com_t1 = std::chrono::high_resolution_clock::now();
-      req.compressed_size = LZ4_compress_fast(buffer_data, compressed_data_data, req.size, compressed_data_size, 10);
+      req.compressed_size = head.net_codec.compress(buffer_data, compressed_data_data, req.size, compressed_data_size);
       if (head.xpn_compression != 0) com_t2 = std::chrono::high_resolution_clock::now();
       debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read] compress read "<<format_bytes(req.compressed_size)<<"/"<< format_bytes(buffer_size));
       req.uncompressed_size = req.size;
@@ -650,11 +1091,11 @@ void xpn_server::op_read_v2 ( xpn_server_comm &comm, const st_xpn_server_read_v2
     debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] op_read: send data");
   }
 cleanup_xpn_server_op_read:
-  if (head.xpn_session == 0){
+  if (head.xpn_session == 0 && !handle){
     filesystem->close(fd);
   }
 
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] read("<<head.path.path<<", "<<head.offset<<", "<<head.size<<")="<< req.size);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] read("<<path<<", "<<head.offset<<", "<<head.size<<")="<< req.size);
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_v2] << End");
 }
 
@@ -665,13 +1106,18 @@ void xpn_server::op_write_v2 ( xpn_server_comm &comm, const st_xpn_server_write_
   st_xpn_server_write_v2_req req{};
   int decompressed_size;
   bool fast_path_used = false;
+  auto handle = get_handle(head.handle);
+  // The requests by handle have not the path
+  const char *path = handle ? handle->path.c_str() : head.handle.valid() ? "" : head.buff.path();
+  file_map_wr_item &wr_item = get_write_queue(path);
   std::chrono::time_point<std::chrono::high_resolution_clock> write_t1, write_t2;
   std::chrono::time_point<std::chrono::high_resolution_clock> decom_t1, decom_t2;
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] >> Begin");
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] write("<<head.buff.path()<<", "<<head.offset<<", "<<head.uncompressed_size<<")");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] write("<<path<<", "<<head.offset<<", "<<head.uncompressed_size<<")");
 
-  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize);
+  xpn_server_filesystem_lz4 lz4_fs(m_filesystem.get(), head.bsize, head.disk_codec, xpn_dictionary::get(head.dict_id),
+                                   m_worker2.get());
   xpn_server_filesystem * filesystem = m_filesystem.get();
   if (head.disk_compress == 1){
     filesystem = &lz4_fs;
@@ -679,21 +1125,27 @@ void xpn_server::op_write_v2 ( xpn_server_comm &comm, const st_xpn_server_write_
 
   //Open file
   int fd;
-  if (head.xpn_session == 1) {
+  if (handle) {
+    fd = handle->fd;
+  } else if (head.handle.valid()) {
+    // The handle was closed or evicted, the client repeats the request by path
+    fd = -1;
+    errno = ESTALE;
+  } else if (head.xpn_session == 1) {
     fd = head.fd;
-  }else{
-    fd = filesystem->open(head.buff.path(), O_WRONLY);
+  } else {
+    fd = filesystem->open(path, O_WRONLY);
   }
 
   if (fd < 0) {
     req.size = -1;
     req.status.ret = -1;
-    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] Error open "<<head.buff.path()<<" "<<strerror(errno));
+    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] Error open "<<path<<" "<<strerror(errno));
     goto cleanup_xpn_server_op_write;
   }
   
   if (head.compressed_size > 0) {
-    if (head.disk_compress != 0) {
+    if (head.disk_compress != 0 && head.net_codec == head.disk_codec) {
       if (lz4_fs.is_aligned_for_direct_io(head.offset, head.uncompressed_size)) {
         std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
         if (xpn_env::get_instance().xpn_stats) io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_disk, head.compressed_size));
@@ -716,13 +1168,14 @@ void xpn_server::op_write_v2 ( xpn_server_comm &comm, const st_xpn_server_write_
       std::unique_ptr<char[]> uncompressed_buffer = std::make_unique_for_overwrite<char[]>(uncompressed_buffer_size);
       char* uncompressed_buffer_data = uncompressed_buffer.get();
       if (head.xpn_compression != 0) decom_t1 = std::chrono::high_resolution_clock::now();
-      decompressed_size = LZ4_decompress_safe(head.buff.buffer(), uncompressed_buffer_data, head.buff.size_buff, uncompressed_buffer_size);
+      decompressed_size = xpn_codec::decompress(head.net_codec.type, head.buff.buffer(), uncompressed_buffer_data, head.buff.size_buff, uncompressed_buffer_size);
       if (head.xpn_compression != 0) decom_t2 = std::chrono::high_resolution_clock::now();
       if (decompressed_size >= 0) {
         std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
         if (xpn_env::get_instance().xpn_stats) { io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_disk, uncompressed_buffer_size)); } 
         if (head.xpn_compression != 0) write_t1 = std::chrono::high_resolution_clock::now();
-        req.size = filesystem->pwrite(fd, uncompressed_buffer_data, uncompressed_buffer_size, head.offset);
+        pending_write write{filesystem, fd, head.disk_compress, head.bsize, head.disk_codec, head.dict_id, uncompressed_buffer_data, uncompressed_buffer_size, head.offset};
+        req.size = coalesced_pwrite(wr_item, write);
         if (head.xpn_compression != 0) write_t2 = std::chrono::high_resolution_clock::now();
         // req.size = uncompressed_buffer_size;
       } else {
@@ -733,7 +1186,8 @@ void xpn_server::op_write_v2 ( xpn_server_comm &comm, const st_xpn_server_write_
     std::optional<xpn_stats::scope_stat<xpn_stats::io_stats>> io_stat;
     if (xpn_env::get_instance().xpn_stats) { io_stat.emplace(xpn_stats::scope_stat<xpn_stats::io_stats>(m_stats.m_write_disk, head.buff.size_buff)); } 
       if (head.xpn_compression != 0) write_t1 = std::chrono::high_resolution_clock::now();
-      req.size = filesystem->pwrite(fd, head.buff.buffer(), head.buff.size_buff, head.offset);
+      pending_write write{filesystem, fd, head.disk_compress, head.bsize, head.disk_codec, head.dict_id, head.buff.buffer(), head.buff.size_buff, head.offset};
+      req.size = coalesced_pwrite(wr_item, write);
       if (head.xpn_compression != 0) write_t2 = std::chrono::high_resolution_clock::now();
     // req.size = uncompressed_buffer_size;
   }
@@ -745,19 +1199,22 @@ void xpn_server::op_write_v2 ( xpn_server_comm &comm, const st_xpn_server_write_
 
   req.status.ret = 0;
 cleanup_xpn_server_op_write:
+  release_write_queue(path, wr_item);
   // write to the client the status of the write operation
   req.status.server_errno = errno;
   if (head.xpn_compression != 0) req.decompress_time_us = std::chrono::duration_cast<std::chrono::microseconds>(decom_t2-decom_t1).count();
   if (head.xpn_compression != 0) req.write_time_us = std::chrono::duration_cast<std::chrono::microseconds>(write_t2-write_t1).count();
   comm.write_data((char *)&req,sizeof(req), rank_client_id, tag_client_id);
 
-  if (head.xpn_session == 1){
+  if (handle) {
+    // The handle keeps the file open until the client closes it
+  } else if (head.xpn_session == 1){
     filesystem->fsync(fd);
   }else{
     filesystem->close(fd);
   }
 
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] write("<<head.buff.path()<<", "<<head.offset<<", "<<head.size<<")="<< req.size);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] write("<<path<<", "<<head.offset<<", "<<head.size<<")="<< req.size);
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_write_v2] << End");
 }
 
@@ -769,7 +1226,9 @@ void xpn_server::op_close ( xpn_server_comm &comm, const st_xpn_server_close &he
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_close] >> Begin");
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_close] close("<<head.fd<<")");
 
-  if (head.xpn_session) {
+  if (head.handle.valid()) {
+    close_handle(head.handle);
+  } else if (head.xpn_session) {
     status.ret = m_filesystem->close(head.fd);
     status.server_errno = errno;
   }
@@ -798,9 +1257,18 @@ void xpn_server::op_rm ( xpn_server_comm &comm, const st_xpn_server_path &head,
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rm] >> Begin");
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rm] unlink("<<head.path.path<<")");
 
-  // do rm
-  status.ret = m_filesystem->unlink(head.path.path);
-  status.server_errno = errno;
+  // do rm, the client does it again when a granted lease has not ended
+  std::chrono::steady_clock::time_point expiry;
+  if (!break_lease(head.path.path, expiry)) {
+    status.ret = -1;
+    status.server_errno = EAGAIN;
+  } else {
+    LZ4BlockCache::get_instance().forget(*m_filesystem, head.path.path);
+    close_handles(head.path.path);
+    status.ret = m_filesystem->unlink(head.path.path);
+    status.server_errno = errno;
+    end_lease_break(head.path.path);
+  }
   comm.write_data((char *)&status, sizeof(st_xpn_server_status), rank_client_id, tag_client_id);
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rm] unlink("<<head.path.path<<")="<< status.ret);
@@ -813,8 +1281,16 @@ void xpn_server::op_rm_async ( [[maybe_unused]] xpn_server_comm &comm, const st_
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rm_async] >> Begin");
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rm_async] unlink("<<head.path.path<<")");
 
-  // do rm
-  m_filesystem->unlink(head.path.path);
+  // do rm, there is no reply to do it again, so it waits a granted lease off the workers of the requests
+  std::chrono::steady_clock::time_point expiry;
+  if (!break_lease(head.path.path, expiry)) {
+    rm_after_lease(head.path.path, expiry);
+  } else {
+    LZ4BlockCache::get_instance().forget(*m_filesystem, head.path.path);
+    close_handles(head.path.path);
+    m_filesystem->unlink(head.path.path);
+    end_lease_break(head.path.path);
+  }
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rm_async] unlink("<<head.path.path<<")="<< 0);
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rm_async] << End");
@@ -828,9 +1304,25 @@ void xpn_server::op_rename ( xpn_server_comm &comm, const st_xpn_server_rename &
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rename] >> Begin");
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rename] rename("<<head.paths.path1()<<", "<<head.paths.path2()<<")");
 
-  // do rename
-  status.ret = m_filesystem->rename(head.paths.path1(), head.paths.path2());
-  status.server_errno = errno;
+  // do rename, the file in the destination is replaced, the client does it again when a granted lease of any of
+  // them has not ended
+  std::chrono::steady_clock::time_point expiry;
+  if (!break_lease(head.paths.path1(), expiry)) {
+    status.ret = -1;
+    status.server_errno = EAGAIN;
+  } else if (!break_lease(head.paths.path2(), expiry)) {
+    end_lease_break(head.paths.path1());
+    status.ret = -1;
+    status.server_errno = EAGAIN;
+  } else {
+    LZ4BlockCache::get_instance().forget(*m_filesystem, head.paths.path2());
+    close_handles(head.paths.path1());
+    close_handles(head.paths.path2());
+    status.ret = m_filesystem->rename(head.paths.path1(), head.paths.path2());
+    status.server_errno = errno;
+    end_lease_break(head.paths.path2());
+    end_lease_break(head.paths.path1());
+  }
   comm.write_data((char *)&status, sizeof(st_xpn_server_status), rank_client_id, tag_client_id);
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_rename] rename("<<head.paths.path1()<<", "<<head.paths.path2()<<")="<<status.ret);
@@ -858,6 +1350,180 @@ void xpn_server::op_getattr ( xpn_server_comm &comm, const st_xpn_server_path &h
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_getattr] << End");
 }
 
+void xpn_server::op_lease ( xpn_server_comm &comm, const st_xpn_server_path &head, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  st_xpn_server_lease_req req{};
+  // Entries of the expired leases are only dropped past this size, a client that renews after it opens the file again
+  static constexpr size_t MAX_LEASES = 4096;
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_lease] >> Begin");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_lease] lease("<<head.path.path<<")");
+
+  // Only the disk mode stores the files as they are read, the other modes and the deduplication keep the data
+  // in other places
+  struct ::stat st = {};
+  if (m_params.lease_ms == 0 || m_filesystem->m_mode != filesystem_mode::disk) {
+    req.duration_ms = 0;
+  } else if (m_filesystem->stat(head.path.path, &st) < 0) {
+    req.status.ret = -1;
+    req.status.server_errno = errno;
+  } else {
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock lock(m_leases_mutex);
+    if (m_leases.size() >= MAX_LEASES) {
+      std::erase_if(m_leases, [now](const auto &item){ return item.second.expiry < now && item.second.breaks == 0; });
+    }
+    auto [it, inserted] = m_leases.try_emplace(head.path.path);
+    if (inserted) {
+      it->second.generation = ++m_lease_generation;
+    }
+    if (it->second.breaks > 0 || it->second.revoked) {
+      // The file is being removed or replaced, this access of the client goes through the server
+      req.status.ret = -1;
+      req.status.server_errno = EAGAIN;
+    } else {
+      it->second.expiry = std::max(it->second.expiry, now + std::chrono::milliseconds(m_params.lease_ms));
+      req.generation = it->second.generation;
+      req.duration_ms = m_params.lease_ms;
+    }
+  }
+
+  comm.write_data((char *)&req, sizeof(st_xpn_server_lease_req), rank_client_id, tag_client_id);
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_lease] lease("<<head.path.path<<")="<<req.generation<<" "<<req.duration_ms<<" ms");
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_lease] << End");
+}
+
+bool xpn_server::break_lease(const char *path, std::chrono::steady_clock::time_point &expiry)
+{
+  if (m_params.lease_ms == 0) {
+    return true;
+  }
+  std::unique_lock lock(m_leases_mutex);
+  auto &lease = m_leases[path];
+  // The clients count the lease from before they ask it and end it before, so no direct access of the old file
+  // is left after its expiry
+  expiry = lease.expiry;
+  if (expiry > std::chrono::steady_clock::now()) {
+    debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_break_lease] the lease of "<<path<<" has not ended");
+    lease.revoked = true;
+    return false;
+  }
+  lease.generation = ++m_lease_generation;
+  lease.breaks++;
+  return true;
+}
+
+void xpn_server::rm_after_lease(std::string path, std::chrono::steady_clock::time_point expiry)
+{
+  m_workerLeases->launch_no_future([this, path = std::move(path), expiry]() mutable {
+    do {
+      std::this_thread::sleep_until(expiry);
+    } while (!break_lease(path.c_str(), expiry));
+    LZ4BlockCache::get_instance().forget(*m_filesystem, path.c_str());
+    close_handles(path.c_str());
+    m_filesystem->unlink(path.c_str());
+    end_lease_break(path.c_str());
+  });
+}
+
+void xpn_server::end_lease_break(const char *path)
+{
+  if (m_params.lease_ms == 0) {
+    return;
+  }
+  std::unique_lock lock(m_leases_mutex);
+  auto it = m_leases.find(path);
+  if (it != m_leases.end() && --it->second.breaks == 0) {
+    // The next lease of the path has a new generation
+    m_leases.erase(it);
+  }
+}
+
+xpn_server_handle xpn_server::open_handle(const char *path)
+{
+  xpn_server_handle handle{};
+  std::shared_ptr<file_handle> evicted;
+  if (m_params.max_handles == 0) {
+    return handle;
+  }
+
+  // The handle serves the reads and the writes, the file can only be read when it is not writable
+  auto file = std::make_shared<file_handle>();
+  file->filesystem = m_filesystem.get();
+  file->fd = m_filesystem->open(path, O_RDWR);
+  if (file->fd < 0) {
+    file->fd = m_filesystem->open(path, O_RDONLY);
+  }
+  if (file->fd < 0) {
+    return handle;
+  }
+  file->path = path;
+
+  std::unique_lock lock(m_handles_mutex);
+  if (!m_free_handles.empty()) {
+    handle.id = m_free_handles.back();
+    m_free_handles.pop_back();
+  } else if (m_handles.size() < static_cast<size_t>(m_params.max_handles)) {
+    handle.id = m_handles.size();
+    m_handles.emplace_back();
+  } else {
+    // The requests that use it keep the file open until they finish
+    auto lru = std::min_element(m_handles.begin(), m_handles.end(),
+                                [](const auto &a, const auto &b){ return a.last_use < b.last_use; });
+    handle.id = lru - m_handles.begin();
+    evicted = std::move(lru->file);
+  }
+  handle_slot &slot = m_handles[handle.id];
+  slot.file = std::move(file);
+  slot.generation = ++m_handle_generation;
+  slot.last_use = ++m_handle_clock;
+  handle.epoch = m_handle_epoch;
+  handle.generation = slot.generation;
+  return handle;
+}
+
+std::shared_ptr<xpn_server::file_handle> xpn_server::get_handle(const xpn_server_handle &handle)
+{
+  if (!handle.valid()) {
+    return nullptr;
+  }
+  std::unique_lock lock(m_handles_mutex);
+  if (handle.epoch != m_handle_epoch || handle.id >= m_handles.size() ||
+      m_handles[handle.id].generation != handle.generation) {
+    return nullptr;
+  }
+  m_handles[handle.id].last_use = ++m_handle_clock;
+  return m_handles[handle.id].file;
+}
+
+void xpn_server::close_handle(const xpn_server_handle &handle)
+{
+  std::shared_ptr<file_handle> closed;
+  std::unique_lock lock(m_handles_mutex);
+  if (handle.epoch != m_handle_epoch || handle.id >= m_handles.size() ||
+      m_handles[handle.id].generation != handle.generation) {
+    return;
+  }
+  closed = std::move(m_handles[handle.id].file);
+  m_handles[handle.id].generation = 0;
+  m_free_handles.push_back(handle.id);
+}
+
+void xpn_server::close_handles(const char *path)
+{
+  std::vector<std::shared_ptr<file_handle>> closed;
+  std::unique_lock lock(m_handles_mutex);
+  for (uint32_t id = 0; id < m_handles.size(); id++) {
+    if (m_handles[id].file && m_handles[id].file->path == path) {
+      closed.emplace_back(std::move(m_handles[id].file));
+      m_handles[id].generation = 0;
+      m_free_handles.push_back(id);
+    }
+  }
+}
+
 void xpn_server::op_setattr ( [[maybe_unused]] xpn_server_comm &comm, [[maybe_unused]] const st_xpn_server_setattr &head, [[maybe_unused]] int rank_client_id, [[maybe_unused]] int tag_client_id)
 {
   XPN_PROFILE_FUNCTION();
@@ -1022,26 +1688,36 @@ void xpn_server::op_rmdir_async ( [[maybe_unused]] xpn_server_comm &comm, const
 void xpn_server::op_read_mdata   ( xpn_server_comm &comm, const st_xpn_server_path &head, int rank_client_id, int tag_client_id )
 {
   XPN_PROFILE_FUNCTION();
-  int ret, fd;
   st_xpn_server_read_mdata_req req{};
 
   debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_mdata] >> Begin");
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_mdata] read_mdata("<<head.path.path<<")");
 
-  file_map_md_fq_item& item = get_mdata_queue(head.path.path);
+  read_mdata(head.path.path, req);
+  comm.write_data((char *)&req,sizeof(st_xpn_server_read_mdata_req), rank_client_id, tag_client_id);
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_mdata] << End");
+}
+
+void xpn_server::read_mdata ( const char *path, st_xpn_server_read_mdata_req &req )
+{
+  int ret, fd;
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_read_mdata] read_mdata("<<path<<")");
+
+  file_map_md_fq_item& item = get_mdata_queue(path);
   std::unique_lock lock(item.m_writing_mutex);
 
-  fd = m_filesystem->open(head.path.path, O_RDWR);
+  fd = m_filesystem->open(path, O_RDWR);
   if (fd < 0){
     if (errno == EISDIR){
       // if is directory there are no metadata to read so return 0
       ret = 0;
       req.mdata = {};
-      goto cleanup_xpn_server_op_read_mdata;
+      goto cleanup_xpn_server_read_mdata;
     }
     ret = fd;
-    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_mdata] Error open "<<head.path.path<<" "<<strerror(errno));
-    goto cleanup_xpn_server_op_read_mdata;
+    debug_error("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_read_mdata] Error open "<<path<<" "<<strerror(errno));
+    goto cleanup_xpn_server_read_mdata;
   }
 
   ret = m_filesystem->pread(fd, &req.mdata, sizeof(req.mdata), 0);
@@ -1052,16 +1728,52 @@ void xpn_server::op_read_mdata   ( xpn_server_comm &comm, const st_xpn_server_pa
 
   m_filesystem->close(fd); //TODO: think if necesary check error in close
 
-  cleanup_xpn_server_op_read_mdata:
+  cleanup_xpn_server_read_mdata:
   lock.unlock();
-  release_mdata_queue(head.path.path, item);
+  release_mdata_queue(path, item);
   req.status.ret = ret;
   req.status.server_errno = errno;
 
-  comm.write_data((char *)&req,sizeof(st_xpn_server_read_mdata_req), rank_client_id, tag_client_id);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_read_mdata] read_mdata("<<path<<")="<< req.status.ret);
+}
 
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_mdata] read_mdata("<<head.path.path<<")="<< req.status.ret);
-  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_read_mdata] << End");
+void xpn_server::op_open_mdata ( xpn_server_comm &comm, const st_xpn_server_path_flags &head, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  st_xpn_server_open_mdata_req req{};
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open_mdata] >> Begin");
+
+  // Like the client, the file is not opened when its header cannot be read
+  read_mdata(head.path.path, req.mdata);
+  if (req.mdata.status.ret >= 0){
+    open_file(head, req.open);
+  }
+  comm.write_data((char *)&req, sizeof(st_xpn_server_open_mdata_req), rank_client_id, tag_client_id);
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open_mdata] open_mdata("<<head.path.path<<")="<< req.mdata.status.ret<<" "<<req.open.status.ret);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_open_mdata] << End");
+}
+
+void xpn_server::op_getattr_mdata ( xpn_server_comm &comm, const st_xpn_server_path &head, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  st_xpn_server_getattr_mdata_req req{};
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_getattr_mdata] >> Begin");
+
+  read_mdata(head.path.path, req.mdata);
+  if (req.mdata.status.ret >= 0){
+    struct ::stat st = {};
+    req.attr.status = m_filesystem->stat(head.path.path, &st);
+    req.attr.attr = st_xpn_server_stat{&st};
+    req.attr.status_req.ret = req.attr.status;
+    req.attr.status_req.server_errno = errno;
+  }
+  comm.write_data((char *)&req, sizeof(st_xpn_server_getattr_mdata_req), rank_client_id, tag_client_id);
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_getattr_mdata] getattr_mdata("<<head.path.path<<")="<< req.mdata.status.ret<<" "<<req.attr.status_req.ret);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_getattr_mdata] << End");
 }
 
 void xpn_server::op_write_mdata ( xpn_server_comm &comm, const st_xpn_server_write_mdata &head, int rank_client_id, int tag_client_id )
@@ -1244,6 +1956,106 @@ void xpn_server::release_mdata_queue(const char *path, file_map_md_fq_item &item
   }
 }
 
+xpn_server::file_map_wr_item &xpn_server::get_write_queue(const char *path) {
+  std::unique_lock lock(m_file_map_wr_mutex);
+  auto [it, _] = m_file_map_wr.emplace(std::piecewise_construct, std::forward_as_tuple(path), std::forward_as_tuple());
+  it->second.m_count++;
+  return it->second;
+}
+
+void xpn_server::release_write_queue(const char *path, file_map_wr_item &item) {
+  std::unique_lock lock(m_file_map_wr_mutex);
+  item.m_count--;
+  if (item.m_count == 0) {
+    m_file_map_wr.erase(path);
+  } else {
+    // Wake a leader that could be waiting for this writer
+    std::unique_lock queue_lock(item.m_queue_mutex);
+    item.m_queue_cv.notify_all();
+  }
+}
+
+// Write the batch merging the adjacent writes in one pwritev per run, only the writes to the same descriptor of the
+// same filesystem with the same layout are merged
+static void write_coalesced_batch(std::vector<xpn_server::pending_write*> &batch)
+{
+  std::sort(batch.begin(), batch.end(), [](auto a, auto b){
+    return std::tie(a->filesystem, a->fd, a->offset) < std::tie(b->filesystem, b->fd, b->offset);
+  });
+
+  std::vector<struct iovec> iov;
+  iov.reserve(std::min<size_t>(batch.size(), IOV_MAX));
+  size_t first = 0;
+  while (first < batch.size()) {
+    auto &head = *batch[first];
+    size_t last = first + 1;
+    int64_t run_end = head.offset + head.size;
+    iov.clear();
+    iov.push_back({.iov_base = const_cast<char*>(head.data), .iov_len = head.size});
+    while (last < batch.size() && iov.size() < IOV_MAX) {
+      auto &next = *batch[last];
+      if (next.offset != run_end || next.fd != head.fd || next.filesystem != head.filesystem ||
+          next.disk_compress != head.disk_compress || next.bsize != head.bsize ||
+          next.disk_codec != head.disk_codec || next.dict_id != head.dict_id) {
+        break;
+      }
+      iov.push_back({.iov_base = const_cast<char*>(next.data), .iov_len = next.size});
+      run_end += next.size;
+      last++;
+    }
+
+    debug_info("[XPN_SERVER_OPS] [write_coalesced_batch] pwritev("<<head.fd<<", "<<iov.size()<<" writes, "<<head.offset<<", "<<run_end - head.offset<<")");
+    int64_t ret = head.filesystem->pwritev(head.fd, iov.data(), iov.size(), head.offset);
+    int error = errno;
+    for (size_t i = first; i < last; i++) {
+      auto &write = *batch[i];
+      write.error = error;
+      if (ret < 0) {
+        write.result = ret;
+      } else {
+        // Each write acknowledge the part of the run that cover it
+        int64_t covered = ret - (write.offset - head.offset);
+        write.result = std::clamp<int64_t>(covered, 0, write.size);
+      }
+    }
+    first = last;
+  }
+}
+
+int64_t xpn_server::coalesced_pwrite(file_map_wr_item &item, pending_write &write)
+{
+  if (m_params.write_coalesce_us == 0) {
+    return write.filesystem->pwrite(write.fd, write.data, write.size, write.offset);
+  }
+
+  std::unique_lock lock(item.m_queue_mutex);
+  item.m_in_queue.emplace_back(&write);
+  item.m_queue_cv.notify_all();
+  while (!write.done) {
+    if (!item.m_writing) {
+      item.m_writing = true;
+      // Hold the batch a bounded window while other writers of the file are still receiving their data
+      item.m_queue_cv.wait_for(lock, std::chrono::microseconds(m_params.write_coalesce_us),
+                               [&item](){ return item.m_in_queue.size() >= item.m_count; });
+      std::vector<pending_write*> batch;
+      batch.swap(item.m_in_queue);
+      lock.unlock();
+      write_coalesced_batch(batch);
+      lock.lock();
+      for (auto pending : batch) {
+        pending->done = true;
+      }
+      item.m_writing = false;
+      item.m_queue_cv.notify_all();
+    } else {
+      item.m_queue_cv.wait(lock, [&item, &write](){ return write.done || !item.m_writing; });
+    }
+  }
+
+  errno = write.error;
+  return write.result;
+}
+
 void xpn_server::op_statvfs ( xpn_server_comm &comm, const st_xpn_server_path &head, int rank_client_id, int tag_client_id )
 {
   XPN_PROFILE_FUNCTION();
@@ -1265,4 +2077,25 @@ void xpn_server::op_statvfs ( xpn_server_comm &comm, const st_xpn_server_path &h
 }
 /* ................................................................... */
 
+// Compression API
+void xpn_server::op_register_dict ( xpn_server_comm &comm, const st_xpn_server_dict &head, int rank_client_id, int tag_client_id )
+{
+  XPN_PROFILE_FUNCTION();
+  st_xpn_server_status status{};
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_register_dict] >> Begin");
+
+  // The id is the hash of the content, so a dictionary corrupted on the way is not registered with it
+  auto dict = xpn_dictionary::add(std::string_view(head.data, std::min(head.size, xpn_dictionary::MAX_SIZE)));
+  if (dict->id() != head.id) {
+    status.ret = -1;
+    status.server_errno = EINVAL;
+  }
+
+  comm.write_data(&status, sizeof(status), rank_client_id, tag_client_id);
+
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_register_dict] register_dict("<<std::hex<<head.id<<std::dec<<", "<<head.size<<")="<<status.ret);
+  debug_info("[Server="<<serv_name<<"] [XPN_SERVER_OPS] [xpn_server_op_register_dict] << End");
+}
+
 } // namespace XPN
@@ -28,6 +28,9 @@
 #include <cstdint>
 
 #include "base_cpp/filesystem.hpp"
+#include "base_cpp/xpn_checksum.hpp"
+#include "base_cpp/xpn_codec.hpp"
+#include "base_cpp/xpn_dictionary.hpp"
 #include "lz4.h"
 #include "xpn/xpn_metadata.hpp"
 #include "xpn_server/xpn_server_params.hpp"
@@ -44,12 +47,15 @@ enum class xpn_server_ops {
     WRITE_FILE,
     READ_FILE_V2,
     WRITE_FILE_V2,
+    WRITE_ZERO_FILE,
+    WRITE_DEDUP_FILE,
     CLOSE_FILE,
     RM_FILE,
     RM_FILE_ASYNC,
     RENAME_FILE,
     GETATTR_FILE,
     SETATTR_FILE,
+    LEASE_FILE,
 
     // Directory operations
     MKDIR_DIR,
@@ -66,17 +72,23 @@ enum class xpn_server_ops {
     READ_MDATA,
     WRITE_MDATA,
     WRITE_MDATA_FILE_SIZE,
+    OPEN_WITH_MDATA,
+    GETATTR_WITH_MDATA,
 
     // Connection operatons
     FINALIZE,
     DISCONNECT,
     END,
+    SHM_CONNECT,
 
     // Flush preload
     FLUSH,
     PRELOAD,
     CHECKPOINT,
 
+    // Compression
+    REGISTER_DICT,
+
     // For enum count
     size,
 };
@@ -89,12 +101,15 @@ static const std::array<std::string, static_cast<uint64_t>(xpn_server_ops::size)
     "WRITE_FILE",
     "READ_FILE_V2",
     "WRITE_FILE_V2",
+    "WRITE_ZERO_FILE",
+    "WRITE_DEDUP_FILE",
     "CLOSE_FILE",
     "RM_FILE",
     "RM_FILE_ASYNC",
     "RENAME_FILE",
     "GETATTR_FILE",
     "SETATTR_FILE",
+    "LEASE_FILE",
 
     // Directory operations
     "MKDIR_DIR",
@@ -111,17 +126,23 @@ static const std::array<std::string, static_cast<uint64_t>(xpn_server_ops::size)
     "READ_MDATA",
     "WRITE_MDATA",
     "WRITE_MDATA_FILE_SIZE",
+    "OPEN_WITH_MDATA",
+    "GETATTR_WITH_MDATA",
 
     // Connection operatons
     "FINALIZE",
     "DISCONNECT",
     "END",
+    "SHM_CONNECT",
 
     // Flush preload
     "FLUSH",
     "PRELOAD",
     "CHECKPOINT",
 
+    // Compression
+    "REGISTER_DICT",
+
     // For enum count
     "size",
 };
@@ -130,6 +151,42 @@ static inline const std::string_view xpn_server_ops_name(xpn_server_ops op) {
     return xpn_server_ops_names[static_cast<uint64_t>(op)];
 }
 
+/* Scheduling class of the operations */
+enum class xpn_server_op_class {
+    metadata,
+    data,
+
+    // For enum count
+    size,
+};
+
+static const std::array<std::string, static_cast<uint64_t>(xpn_server_op_class::size) + 1> xpn_server_op_class_names = {
+    "METADATA",
+    "DATA",
+    "size",
+};
+
+static inline const std::string_view xpn_server_op_class_name(xpn_server_op_class op_class) {
+    return xpn_server_op_class_names[static_cast<uint64_t>(op_class)];
+}
+
+static inline xpn_server_op_class xpn_server_op_class_of(xpn_server_ops op) {
+    switch (op) {
+        case xpn_server_ops::READ_FILE:
+        case xpn_server_ops::WRITE_FILE:
+        case xpn_server_ops::READ_FILE_V2:
+        case xpn_server_ops::WRITE_FILE_V2:
+        case xpn_server_ops::WRITE_ZERO_FILE:
+        case xpn_server_ops::WRITE_DEDUP_FILE:
+        case xpn_server_ops::FLUSH:
+        case xpn_server_ops::PRELOAD:
+        case xpn_server_ops::CHECKPOINT:
+            return xpn_server_op_class::data;
+        default:
+            return xpn_server_op_class::metadata;
+    }
+}
+
 /* Message struct */
 struct xpn_server_path {
     uint32_t size;
@@ -170,14 +227,42 @@ struct st_xpn_server_status {
     uint64_t get_size() { return sizeof(*this); }
 };
 
+// File kept open by the server for a client, the requests with it go without the path
+struct xpn_server_handle {
+    uint32_t id;          // Slot in the table of the server
+    uint32_t epoch;       // Run of the server that granted it, the handles of a restarted server are stale
+    uint64_t generation;  // 0 without handle
+
+    bool valid() const { return generation != 0; }
+};
+
+// Buffer of the client registered for one-sided access, the server reads the payload of the write or writes the
+// data of the read there instead of sending it. Only the payloads sent raw use it.
+struct xpn_server_rdma {
+    uint64_t addr;      // 0 without it
+    uint64_t shm_key;   // Keys of the registration for the shared memory and the network providers
+    uint64_t peer_key;
+
+    bool valid() const { return addr != 0; }
+};
+
 struct st_xpn_server_path_flags {
     int32_t flags;
     mode_t mode;
     char xpn_session;
+    char want_handle;  // The open asks for a handle of the file
     xpn_server_path path;
 
     uint64_t get_size() { return offsetof(std::remove_pointer<decltype(this)>::type, path) + path.get_size(); }
 };
+// Reply of the open, with the handle when it is asked and the server grants it
+struct st_xpn_server_open_req {
+    st_xpn_server_status status;
+    xpn_server_handle handle;
+
+    uint64_t get_size() { return sizeof(*this); }
+};
+
 struct st_xpn_server_path {
     xpn_server_path path;
 
@@ -188,6 +273,7 @@ struct st_xpn_server_close {
     int fd;
     uint64_t dir;
     char xpn_session;
+    xpn_server_handle handle;
     xpn_server_path path;
 
     uint64_t get_size() { return offsetof(std::remove_pointer<decltype(this)>::type, path) + path.get_size(); }
@@ -202,6 +288,10 @@ struct st_xpn_server_read_v2 {
     char xpn_compression;
     char disk_compress;
     uint32_t bsize;
+    xpn_codec net_codec;
+    xpn_codec disk_codec;
+    uint32_t dict_id;  // Dictionary of the partition registered in the server, 0 without it
+    xpn_server_handle handle;
     xpn_server_path path;
 
     uint64_t get_size() { return offsetof(std::remove_pointer<decltype(this)>::type, path) + path.get_size(); }
@@ -229,6 +319,10 @@ struct st_xpn_server_write_v2 {
     char xpn_compression;
     char disk_compress;
     uint32_t bsize;
+    xpn_codec net_codec;
+    xpn_codec disk_codec;
+    uint32_t dict_id;  // Dictionary of the partition registered in the server, 0 without it
+    xpn_server_handle handle;
     xpn_server_path_buffer buff;
 
     uint64_t get_size() { return offsetof(std::remove_pointer<decltype(this)>::type, buff) + buff.get_size(); }
@@ -259,7 +353,15 @@ struct st_xpn_server_rw {
     char xpn_compression;
     char disk_compress;
     uint32_t bsize;
+    xpn_codec net_codec;
+    xpn_codec disk_codec;
+    uint32_t dict_id;  // Dictionary of the partition registered in the server, 0 without it
+    char net_dict;     // The small payload of the write, or of the reply of the read, is compressed with dict_id
+    char checksum;           // XPN_CHECKSUM of the client
+    uint64_t data_checksum;  // Checksum of the uncompressed data of the write, 0 without it
     // uint64_t new_file_size;
+    xpn_server_rdma rdma;
+    xpn_server_handle handle;
     xpn_server_path path;
 
     uint64_t get_size() { return offsetof(std::remove_pointer<decltype(this)>::type, path) + path.get_size(); }
@@ -272,11 +374,56 @@ struct st_xpn_server_rw_req {
     uint32_t compress_time_us;
     uint32_t rw_time_us;
     uint32_t num_clients;
+    uint32_t dict_id;   // Dictionary of the compressed payload, 0 without it
+    uint32_t stream_chunk;  // The raw data of the read follows by chunks of this size, 0 when it follows at once
+    uint64_t checksum;  // Checksum of the uncompressed data of the read, 0 without it
+    st_xpn_server_status status;
+
+    uint64_t get_size() { return sizeof(*this); }
+};
+
+// Fingerprints of consecutive whole blocks of a write, the server references the ones it already has
+struct st_xpn_server_dedup {
+    static constexpr uint32_t MAX_BLOCKS = 64;
+
+    int64_t offset;  // Of the first block
+    uint32_t bsize;
+    uint32_t count;
+    int fd;
+    char xpn_session;
+    char disk_compress;
+    xpn_fingerprint fingerprints[MAX_BLOCKS];
+    xpn_server_path path;
+
+    uint64_t get_size() { return offsetof(std::remove_pointer<decltype(this)>::type, path) + path.get_size(); }
+};
+
+struct st_xpn_server_dedup_req {
+    uint64_t found;  // Bit i set when the block i is referenced and its data must not be sent
+    char enabled;    // 0 when the server has not the deduplication
+    st_xpn_server_status status;
+
+    uint64_t get_size() { return sizeof(*this); }
+};
+
+// Lease of the direct access of a client of the same node to the backing file of a path, the generation changes
+// when the file of the path is removed or replaced
+struct st_xpn_server_lease_req {
+    uint64_t generation;
+    uint32_t duration_ms;  // 0 when it is not granted, the files are not stored as they are read
     st_xpn_server_status status;
 
     uint64_t get_size() { return sizeof(*this); }
 };
 
+// Shared memory channel created by a client of the same node, the connection moves to it after the reply
+struct st_xpn_server_shm_connect {
+    uint64_t ring_size;
+    char name[NAME_MAX];
+
+    uint64_t get_size() { return sizeof(*this); }
+};
+
 struct st_xpn_server_rename {
     xpn_server_double_path paths;
 
@@ -420,6 +567,22 @@ struct st_xpn_server_read_mdata_req {
     uint64_t get_size() { return sizeof(*this); }
 };
 
+// Reply of the open that reads the metadata header in the same request, the open is only done when the header is read
+struct st_xpn_server_open_mdata_req {
+    st_xpn_server_read_mdata_req mdata;
+    st_xpn_server_open_req open;
+
+    uint64_t get_size() { return sizeof(*this); }
+};
+
+// Reply of the getattr that reads the metadata header in the same request
+struct st_xpn_server_getattr_mdata_req {
+    st_xpn_server_read_mdata_req mdata;
+    st_xpn_server_attr_req attr;
+
+    uint64_t get_size() { return sizeof(*this); }
+};
+
 struct st_xpn_server_write_mdata {
     xpn_metadata::data mdata;
     xpn_server_path path;
@@ -497,6 +660,14 @@ struct st_xpn_server_flush_preload_ckpt {
     size_t get_size() { return paths.get_size(); }
 };
 
+struct st_xpn_server_dict {
+    uint32_t id;
+    uint32_t size;
+    char data[xpn_dictionary::MAX_SIZE];
+
+    uint64_t get_size() { return offsetof(std::remove_pointer<decltype(this)>::type, data) + size; }
+};
+
 constexpr uint64_t get_xpn_server_max_msg_size() {
     uint64_t size = 0;
     if (size < sizeof(st_xpn_server_status)) size = sizeof(st_xpn_server_status);
@@ -509,7 +680,12 @@ constexpr uint64_t get_xpn_server_max_msg_size() {
     if (size < sizeof(st_xpn_server_write_v2)) size = sizeof(st_xpn_server_write_v2);
     if (size < sizeof(st_xpn_server_write_v2_req)) size = sizeof(st_xpn_server_write_v2_req);
     if (size < sizeof(st_xpn_server_rw_req)) size = sizeof(st_xpn_server_rw_req);
+    if (size < sizeof(st_xpn_server_dedup)) size = sizeof(st_xpn_server_dedup);
+    if (size < sizeof(st_xpn_server_dedup_req)) size = sizeof(st_xpn_server_dedup_req);
     if (size < sizeof(st_xpn_server_rename)) size = sizeof(st_xpn_server_rename);
+    if (size < sizeof(st_xpn_server_lease_req)) size = sizeof(st_xpn_server_lease_req);
+    if (size < sizeof(st_xpn_server_open_req)) size = sizeof(st_xpn_server_open_req);
+    if (size < sizeof(st_xpn_server_shm_connect)) size = sizeof(st_xpn_server_shm_connect);
     if (size < sizeof(st_xpn_server_setattr)) size = sizeof(st_xpn_server_setattr);
     if (size < sizeof(st_xpn_server_attr_req)) size = sizeof(st_xpn_server_attr_req);
     if (size < sizeof(st_xpn_server_readdir)) size = sizeof(st_xpn_server_readdir);
@@ -520,6 +696,7 @@ constexpr uint64_t get_xpn_server_max_msg_size() {
     if (size < sizeof(st_xpn_server_write_mdata_file_size)) size = sizeof(st_xpn_server_write_mdata_file_size);
     if (size < sizeof(st_xpn_server_statvfs_req)) size = sizeof(st_xpn_server_statvfs_req);
     if (size < sizeof(st_xpn_server_flush_preload_ckpt)) size = sizeof(st_xpn_server_flush_preload_ckpt);
+    if (size < sizeof(st_xpn_server_dict)) size = sizeof(st_xpn_server_dict);
     return size;
 }
 
@@ -23,6 +23,8 @@
 
 #include "xpn_server_params.hpp"
 
+#include <algorithm>
+
 #include "base_cpp/debug.hpp"
 #include "base_cpp/ns.hpp"
 #include "base_cpp/workers.hpp"
@@ -80,10 +82,40 @@ void xpn_server_params::show(std::ostream& os) {
         os << " █\tproxy mode: \ton\n";
     } else if (fs_mode == filesystem_mode::memory) {
         os << " █\tmemory mode: \ton\n";
+        if (memory_budget > 0) {
+            os << " █\tmemory budget: \t" << memory_budget / MB << " MB (spill to '" << memory_spill_dir << "')\n";
+        }
     } 
+    if (compressed_cache != (uint64_t)DEFAULT_XPN_SERVER_COMPRESSED_CACHE_MB * MB) {
+        os << " █\tcompressed cache: \t" << compressed_cache / MB << " MB\n";
+    }
+    if (dict_dir != DEFAULT_XPN_SERVER_DICT_DIR) {
+        os << " █\tdictionary dir: \t" << dict_dir << "\n";
+    }
+    if (!dedup_dir.empty()) {
+        os << " █\tdedup dir: \t" << dedup_dir << "\n";
+    }
     if (mqtt_qos != DEFAULT_XPN_SERVER_MQTT_QOS || srv_type == server_type::MQTT) {
         os << " █\tmqtt qos: \t" << mqtt_qos << "\n";
     }
+    if (write_coalesce_us != DEFAULT_XPN_SERVER_WRITE_COALESCE_US) {
+        os << " █\twrite coalesce: \t" << write_coalesce_us << " usec\n";
+    }
+    if (lease_ms != DEFAULT_XPN_SERVER_LEASE_MS) {
+        os << " █\tlease: \t" << lease_ms << " msec\n";
+    }
+    if (max_handles != DEFAULT_XPN_SERVER_MAX_HANDLES) {
+        os << " █\thandles: \t" << max_handles << "\n";
+    }
+    if (max_connections != DEFAULT_XPN_SERVER_MAX_CONNECTIONS) {
+        os << " █\tconnections: \t" << max_connections << " per client\n";
+    }
+    // * scheduler
+    if (sched_fair) {
+        os << " █\tscheduler: \tfair (quantum " << sched_quantum << " bytes, weights " << sched_mdata_weight << ":" << sched_data_weight << ")\n";
+    } else {
+        os << " █\tscheduler: \tfifo\n";
+    }
 
     debug_info("[Server=" << ns::get_host_name() << "] [XPN_SERVER_PARAMS] [xpn_server_params_show] << End");
 }
@@ -100,6 +132,18 @@ void xpn_server_params::show_usage() {
     printf("\t-m, --mqtt_qos        <qos>         enable mqtt with that qos\n");
     printf("\t--connectionless_port <port>        port used by the connectionless socket (default: 0)\n");
     printf("\t--comm_port           <port>        port used by the communcation socket (default: 0)\n");
+    printf("\t--sched               <mode>        fair, fifo request scheduling (default: fair)\n");
+    printf("\t--sched_quantum       <bytes>       data bytes served per client in each round (default: 1 MB)\n");
+    printf("\t--sched_weights       <m>:<d>       metadata and data ops served per cycle (default: 8:1)\n");
+    printf("\t--write_coalesce      <usec>        window to merge adjacent writes, 0 to disable (default: 100)\n");
+    printf("\t--lease               <msec>        lease of the direct access of the local clients, 0 to disable (default: 500)\n");
+    printf("\t--handles             <n>           files kept open for the handles of the clients, 0 to disable (default: 4096)\n");
+    printf("\t--connections         <n>           connections granted to a client to stripe its transfers (default: 8)\n");
+    printf("\t--memory_budget       <mb>          RAM of the memory mode, the rest is spilled to disk (default: 0, unlimited)\n");
+    printf("\t--memory_spill_dir    <path>        directory of the spill file of the memory mode (default: /tmp)\n");
+    printf("\t--compressed_cache    <mb>          RAM for decompressed blocks of compressed partitions, 0 to disable (default: 64)\n");
+    printf("\t--dict_dir            <path>        directory of the compression dictionaries (default: /tmp/xpn_dict)\n");
+    printf("\t--dedup_dir           <path>        store of the deduplicated blocks, enables the deduplication (default: off)\n");
     printf("\t-w, --await                         await for servers to stop\n");
     printf("\t-x, --proxy                         activate proxy mode\n");
     printf("\t-h, --help                          print this usage information\n");
@@ -124,6 +168,19 @@ xpn_server_params::xpn_server_params(int _argc, char *_argv[]) {
     srv_control_port = DEFAULT_XPN_SERVER_CONTROL_PORT;
     srv_comm_port = DEFAULT_XPN_SERVER_COMM_PORT;
     srv_connectionless_port = DEFAULT_XPN_SERVER_CONNECTIONLESS_PORT;
+    sched_fair = true;
+    sched_quantum = DEFAULT_XPN_SERVER_SCHED_QUANTUM;
+    sched_mdata_weight = DEFAULT_XPN_SERVER_SCHED_MDATA_WEIGHT;
+    sched_data_weight = DEFAULT_XPN_SERVER_SCHED_DATA_WEIGHT;
+    write_coalesce_us = DEFAULT_XPN_SERVER_WRITE_COALESCE_US;
+    lease_ms = DEFAULT_XPN_SERVER_LEASE_MS;
+    max_handles = DEFAULT_XPN_SERVER_MAX_HANDLES;
+    max_connections = DEFAULT_XPN_SERVER_MAX_CONNECTIONS;
+    memory_budget = 0;
+    memory_spill_dir = DEFAULT_XPN_SERVER_MEMORY_SPILL_DIR;
+    compressed_cache = (uint64_t)DEFAULT_XPN_SERVER_COMPRESSED_CACHE_MB * MB;
+    dict_dir = DEFAULT_XPN_SERVER_DICT_DIR;
+    dedup_dir = "";
 
     // update user requests
     debug_info("[Server=" << ns::get_host_name()
@@ -152,6 +209,49 @@ xpn_server_params::xpn_server_params(int _argc, char *_argv[]) {
             srv_connectionless_port = ++idx >= argc ? DEFAULT_XPN_SERVER_CONNECTIONLESS_PORT : atoi(argv[idx]);
         } else if (arg == "--comm_port") {
             srv_comm_port = ++idx >= argc ? DEFAULT_XPN_SERVER_COMM_PORT : atoi(argv[idx]);
+        } else if (arg == "--sched") {
+            if (++idx < argc) {
+                if (strcmp("fair", argv[idx]) == 0) {
+                    sched_fair = true;
+                } else if (strcmp("fifo", argv[idx]) == 0) {
+                    sched_fair = false;
+                } else {
+                    printf("ERROR: unknown option %s\n", argv[idx]);
+                    show_usage();
+                }
+            }
+        } else if (arg == "--sched_quantum") {
+            sched_quantum = ++idx >= argc ? DEFAULT_XPN_SERVER_SCHED_QUANTUM : std::max(1LL, atoll(argv[idx]));
+        } else if (arg == "--write_coalesce") {
+            write_coalesce_us = ++idx >= argc ? DEFAULT_XPN_SERVER_WRITE_COALESCE_US : std::max(0, atoi(argv[idx]));
+        } else if (arg == "--lease") {
+            lease_ms = ++idx >= argc ? DEFAULT_XPN_SERVER_LEASE_MS : std::max(0, atoi(argv[idx]));
+        } else if (arg == "--handles") {
+            max_handles = ++idx >= argc ? DEFAULT_XPN_SERVER_MAX_HANDLES : std::max(0, atoi(argv[idx]));
+        } else if (arg == "--connections") {
+            max_connections = ++idx >= argc ? DEFAULT_XPN_SERVER_MAX_CONNECTIONS : std::max(1, atoi(argv[idx]));
+        } else if (arg == "--memory_budget") {
+            memory_budget = ++idx >= argc ? 0 : std::max(0LL, atoll(argv[idx])) * MB;
+        } else if (arg == "--memory_spill_dir") {
+            memory_spill_dir = ++idx >= argc ? DEFAULT_XPN_SERVER_MEMORY_SPILL_DIR : argv[idx];
+        } else if (arg == "--compressed_cache") {
+            compressed_cache = ++idx >= argc ? (uint64_t)DEFAULT_XPN_SERVER_COMPRESSED_CACHE_MB * MB
+                                             : std::max(0LL, atoll(argv[idx])) * MB;
+        } else if (arg == "--dict_dir") {
+            dict_dir = ++idx >= argc ? DEFAULT_XPN_SERVER_DICT_DIR : argv[idx];
+        } else if (arg == "--dedup_dir") {
+            dedup_dir = ++idx >= argc ? "" : argv[idx];
+        } else if (arg == "--sched_weights") {
+            if (++idx < argc) {
+                unsigned int mdata_weight = 0, data_weight = 0;
+                if (sscanf(argv[idx], "%u:%u", &mdata_weight, &data_weight) == 2 && mdata_weight > 0 && data_weight > 0) {
+                    sched_mdata_weight = mdata_weight;
+                    sched_data_weight = data_weight;
+                } else {
+                    printf("ERROR: unknown option %s\n", argv[idx]);
+                    show_usage();
+                }
+            }
         } else if (arg == "-t" || arg == "--thread_mode") {
             if (++idx < argc) {
                 if (isdigit(argv[idx][0])) {
@@ -53,6 +53,16 @@ namespace XPN
   constexpr const int DEFAULT_XPN_SERVER_COMM_PORT = 0;
   constexpr const int DEFAULT_XPN_SERVER_CONNECTIONLESS_PORT = 0;
   constexpr const int DEFAULT_XPN_SERVER_MQTT_QOS = 0;
+  constexpr const int DEFAULT_XPN_SERVER_SCHED_QUANTUM = (1*MB);
+  constexpr const int DEFAULT_XPN_SERVER_SCHED_MDATA_WEIGHT = 8;
+  constexpr const int DEFAULT_XPN_SERVER_SCHED_DATA_WEIGHT = 1;
+  constexpr const int DEFAULT_XPN_SERVER_WRITE_COALESCE_US = 100;
+  constexpr const int DEFAULT_XPN_SERVER_LEASE_MS = 500;
+  constexpr const int DEFAULT_XPN_SERVER_MAX_HANDLES = 4096;
+  constexpr const int DEFAULT_XPN_SERVER_MAX_CONNECTIONS = 8;
+  constexpr const char *DEFAULT_XPN_SERVER_MEMORY_SPILL_DIR = "/tmp";
+  constexpr const int DEFAULT_XPN_SERVER_COMPRESSED_CACHE_MB = 64;
+  constexpr const char *DEFAULT_XPN_SERVER_DICT_DIR = "/tmp/xpn_dict";
 
   /* ... Data structures / Estructuras de datos ........................ */
 
@@ -77,6 +87,36 @@ namespace XPN
     int mqtt_qos;
     int await_stop;
 
+    // request scheduler
+    bool sched_fair;
+    uint64_t sched_quantum;
+    uint32_t sched_mdata_weight;
+    uint32_t sched_data_weight;
+
+    // window to merge adjacent writes of the same file, 0 to disable
+    int write_coalesce_us;
+
+    // lease of the direct access of the clients of the same node to the files, 0 to disable it
+    int lease_ms;
+
+    // files kept open for the clients that reference them by a handle, 0 to always go by path
+    int max_handles;
+    // connections of the same client that stripe its transfers
+    int max_connections;
+
+    // memory mode: RAM for the file blocks in bytes, 0 for unlimited, and where the rest is spilled
+    uint64_t memory_budget;
+    std::string memory_spill_dir;
+
+    // decompressed blocks of the compressed partitions kept in RAM, in bytes, 0 to disable
+    uint64_t compressed_cache;
+
+    // where the compression dictionaries registered by the clients are saved
+    std::string dict_dir;
+
+    // directory of the block store of the deduplication, empty to disable it
+    std::string dedup_dir;
+
     // server arguments
     int    argc;
     char **argv;
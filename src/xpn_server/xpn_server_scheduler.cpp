@@ -0,0 +1,142 @@
+
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "xpn_server_scheduler.hpp"
+
+#include "base_cpp/debug.hpp"
+#include "base_cpp/xpn_env.hpp"
+
+namespace XPN
+{
+
+xpn_server_scheduler::xpn_server_scheduler(const xpn_server_params &params, workers &worker, xpn_stats &stats)
+    : m_worker(worker),
+      m_stats(stats),
+      m_fair(params.sched_fair),
+      m_quantum(params.sched_quantum),
+      m_weights({params.sched_mdata_weight, params.sched_data_weight}) {}
+
+uint64_t xpn_server_scheduler::op_cost(const xpn_server_msg &msg)
+{
+    switch (static_cast<xpn_server_ops>(msg.op)) {
+        case xpn_server_ops::READ_FILE:
+        case xpn_server_ops::WRITE_FILE:
+            return reinterpret_cast<const st_xpn_server_rw*>(msg.msg_buffer)->size;
+        case xpn_server_ops::READ_FILE_V2:
+            return reinterpret_cast<const st_xpn_server_read_v2*>(msg.msg_buffer)->size;
+        case xpn_server_ops::WRITE_FILE_V2:
+            return reinterpret_cast<const st_xpn_server_write_v2*>(msg.msg_buffer)->uncompressed_size;
+        default:
+            // Metadata ops, the zero writes, that move no data, and the flush/preload/checkpoint count as one unit
+            return 1;
+    }
+}
+
+void xpn_server_scheduler::submit(int64_t client_id, const xpn_server_msg &msg, task_t task)
+{
+    if (!m_fair) {
+        m_worker.launch_no_future(std::move(task));
+        return;
+    }
+
+    xpn_server_op_class op_class = xpn_server_op_class_of(static_cast<xpn_server_ops>(msg.op));
+    uint64_t cost = op_class == xpn_server_op_class::data ? std::max<uint64_t>(op_cost(msg), 1) : 1;
+    {
+        std::unique_lock lock(m_mutex);
+        auto &queue = m_queues[static_cast<uint64_t>(op_class)];
+        auto &client = queue.clients[client_id];
+        if (client.requests.empty()) {
+            queue.active.emplace_back(client_id);
+        }
+        client.requests.emplace_back(request{std::move(task), cost, timer()});
+        queue.pending++;
+    }
+    if (xpn_env::get_instance().xpn_stats) {
+        m_stats.m_queue_stats[static_cast<uint64_t>(op_class)].enqueue();
+    }
+    debug_info("[XPN_SERVER_SCHEDULER] [submit] client "<<client_id<<" op "<<xpn_server_ops_name(static_cast<xpn_server_ops>(msg.op))<<" class "<<xpn_server_op_class_name(op_class)<<" cost "<<cost);
+
+    // Every submit launch one run_next, so there is always a worker for each queued request
+    m_worker.launch_no_future([this]() { run_next(); });
+}
+
+xpn_server_op_class xpn_server_scheduler::next_class()
+{
+    auto other = m_current_class == xpn_server_op_class::metadata ? xpn_server_op_class::data : xpn_server_op_class::metadata;
+    bool current_pending = m_queues[static_cast<uint64_t>(m_current_class)].pending > 0;
+    bool other_pending = m_queues[static_cast<uint64_t>(other)].pending > 0;
+
+    if (!current_pending || (other_pending && m_served_in_class >= m_weights[static_cast<uint64_t>(m_current_class)])) {
+        m_current_class = other;
+        m_served_in_class = 0;
+    }
+    m_served_in_class++;
+    return m_current_class;
+}
+
+xpn_server_scheduler::request xpn_server_scheduler::pop(xpn_server_op_class op_class)
+{
+    auto &queue = m_queues[static_cast<uint64_t>(op_class)];
+    // Deficit round robin: the client in front is served while its deficit covers the cost of its next request,
+    // then it goes to the back and the next one receives its quantum
+    while (true) {
+        int64_t client_id = queue.active.front();
+        auto &client = queue.clients[client_id];
+        auto &next = client.requests.front();
+        if (next.cost <= client.deficit || op_class == xpn_server_op_class::metadata) {
+            client.deficit = next.cost <= client.deficit ? client.deficit - next.cost : 0;
+            request req = std::move(next);
+            client.requests.pop_front();
+            queue.pending--;
+            if (client.requests.empty()) {
+                queue.active.pop_front();
+                queue.clients.erase(client_id);
+            } else if (op_class == xpn_server_op_class::metadata) {
+                // Metadata ops are cheap, one per client and turn
+                queue.active.pop_front();
+                queue.active.emplace_back(client_id);
+            }
+            return req;
+        }
+        if (queue.active.size() > 1) {
+            queue.active.pop_front();
+            queue.active.emplace_back(client_id);
+        }
+        queue.clients[queue.active.front()].deficit += m_quantum;
+    }
+}
+
+void xpn_server_scheduler::run_next()
+{
+    request req;
+    xpn_server_op_class op_class;
+    {
+        std::unique_lock lock(m_mutex);
+        op_class = next_class();
+        req = pop(op_class);
+    }
+    if (xpn_env::get_instance().xpn_stats) {
+        m_stats.m_queue_stats[static_cast<uint64_t>(op_class)].dequeue(req.wait.elapsed<std::chrono::microseconds>());
+    }
+    req.task();
+}
+
+} // namespace XPN
@@ -0,0 +1,86 @@
+
+/*
+ *  Copyright 2020-2024 Felix Garcia Carballeira, Diego Camarmas Alonso, Alejandro Calderon Mateos, Dario Muñoz Muñoz
+ *
+ *  This file is part of Expand.
+ *
+ *  Expand is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Expand is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Expand.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "base_cpp/fixed_function.hpp"
+#include "base_cpp/timer.hpp"
+#include "base_cpp/workers.hpp"
+#include "xpn/xpn_stats.hpp"
+#include "xpn_server_ops.hpp"
+#include "xpn_server_params.hpp"
+
+namespace XPN
+{
+    // Request queue between the dispatchers and the workers.
+    // Metadata ops have priority over data ops (bounded by the class weights, so data never starves),
+    // and inside each class the clients are served in deficit round robin.
+    class xpn_server_scheduler
+    {
+    public:
+        using task_t = FixedFunction<void()>;
+
+        xpn_server_scheduler(const xpn_server_params &params, workers &worker, xpn_stats &stats);
+
+        // Queue the task of a client, a worker will pick the next task by the scheduling policy
+        void submit(int64_t client_id, const xpn_server_msg &msg, task_t task);
+
+        static uint64_t op_cost(const xpn_server_msg &msg);
+
+    private:
+        struct request {
+            task_t task;
+            uint64_t cost;
+            timer wait;
+        };
+
+        struct client_queue {
+            std::deque<request> requests;
+            uint64_t deficit = 0;
+        };
+
+        struct class_queue {
+            std::unordered_map<int64_t, client_queue> clients;
+            std::deque<int64_t> active;
+            uint64_t pending = 0;
+        };
+
+        void run_next();
+        request pop(xpn_server_op_class op_class);
+        xpn_server_op_class next_class();
+
+    private:
+        workers &m_worker;
+        xpn_stats &m_stats;
+        const bool m_fair;
+        const uint64_t m_quantum;
+        const std::array<uint32_t, static_cast<uint64_t>(xpn_server_op_class::size)> m_weights;
+
+        std::mutex m_mutex;
+        std::array<class_queue, static_cast<uint64_t>(xpn_server_op_class::size)> m_queues;
+        xpn_server_op_class m_current_class = xpn_server_op_class::metadata;
+        uint32_t m_served_in_class = 0;
+    };
+} // namespace XPN
@@ -0,0 +1,85 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "setup.hpp"
+#include "xpn.h"
+#include "xpn_server/filesystem/xpn_server_filesystem_lz4_block.hpp"
+
+// The blocks of a compressed file keep the checksum of their data, a block that does not match it is not returned
+void run_test(const std::string &data_dir, size_t bsize) {
+    const std::string filename = "/xpn/checksum.bin";
+    const size_t total_bytes = 2 * bsize;
+    // The first block of the data starts after the raw header of the file in the server
+    const size_t checksum_offset =
+        XPN::lz4_block_header::RAW_HEADER_SIZE + offsetof(XPN::lz4_block_header, checksum);
+
+    std::string original_data = setup::generate_Lorem_Ipsum(total_bytes);
+
+    setup::write_file(filename, original_data);
+
+    // Flip a bit of the checksum of the first block, as a corruption in the disk
+    {
+        std::fstream file(data_dir + "/checksum.bin", std::ios::in | std::ios::out | std::ios::binary);
+        char byte;
+        file.seekg(checksum_offset);
+        file.read(&byte, 1);
+        byte ^= 0x1;
+        file.seekp(checksum_offset);
+        file.write(&byte, 1);
+        if (!file) {
+            std::cerr << "Error corrupting the file in the server: " << data_dir << "/checksum.bin" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int fd = xpn_open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening file for reading");
+        exit(EXIT_FAILURE);
+    }
+    std::string read_data;
+    read_data.resize(bsize);
+    ssize_t read_bytes = xpn_pread(fd, read_data.data(), bsize, bsize);
+    if (read_bytes != (ssize_t)bsize || read_data != original_data.substr(bsize)) {
+        std::cerr << "Test Failed: the block without corruption is not read right" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    read_bytes = xpn_pread(fd, read_data.data(), bsize, 0);
+    int read_errno = errno;
+    xpn_close(fd);
+    if (read_bytes >= 0 || read_errno != EIO) {
+        std::cerr << "Test Failed: the corrupted block is read, ret " << read_bytes << " " << strerror(read_errno)
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Test Passed: The corrupted block fails with EIO." << std::endl;
+
+    setup::remove_file(filename);
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_CHECKSUM", "2"}});
+    XPN::xpn_conf::partition part;
+    part.compressed = true;
+    part.bsize = 64 * 1024;
+    part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+    };
+    {
+        LogTimer timer("1 sck server compressed with checksums 64k bsize");
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(tmp_dir + "/xpn1", part.bsize);
+    }
+}
@@ -0,0 +1,148 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+#include "xpn_server/filesystem/xpn_server_filesystem_lz4_block.hpp"
+
+using XPN::lz4_block_header;
+
+void write_file(const std::string &filename, const std::string &data) {
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("Error opening file for writing");
+        exit(EXIT_FAILURE);
+    }
+    if (xpn_pwrite(fd, data.data(), data.size(), 0) != (ssize_t)data.size()) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    xpn_close(fd);
+}
+
+ssize_t read_file(const std::string &filename, std::string &read_data) {
+    int fd = xpn_open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening file for reading");
+        exit(EXIT_FAILURE);
+    }
+    ssize_t read_bytes = xpn_pread(fd, read_data.data(), read_data.size(), 0);
+    int read_errno = errno;
+    xpn_close(fd);
+    errno = read_errno;
+    return read_bytes;
+}
+
+// Rewrite the blocks of a file of the server in the layout of before the header had magic and version, only the two
+// sizes before the same LZ4 data
+void to_legacy_layout(const std::string &path, size_t num_blocks, uint32_t slot_size) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    for (size_t i = 0; i < num_blocks; i++) {
+        const size_t slot = lz4_block_header::RAW_HEADER_SIZE + i * slot_size;
+        lz4_block_header header = {};
+        file.seekg(slot);
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file || header.magic != lz4_block_header::MAGIC || header.compressed_size == 0) {
+            std::cerr << "Error: the block " << i << " of " << path << " is not in the current layout" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::vector<char> compressed(header.compressed_size);
+        file.read(compressed.data(), compressed.size());
+        uint32_t sizes[2] = {header.compressed_size, header.uncompressed_size};
+        file.seekp(slot);
+        file.write(reinterpret_cast<char *>(sizes), sizeof(sizes));
+        file.write(compressed.data(), compressed.size());
+    }
+    if (!file) {
+        std::cerr << "Error rewriting the file in the server: " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The compressed files written with the old block header are still read, and a block of an unknown version of the
+// layout fails with EIO instead of being read as data
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_SHORT_CIRCUIT", "0"}});
+    XPN::xpn_conf::partition part;
+    part.compressed = true;
+    part.bsize = 64 * 1024;
+    part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+    };
+    auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+    const std::string legacy = "/xpn/legacy.bin";
+    const std::string version = "/xpn/version.bin";
+    const uint32_t slot_size = lz4_block_header::slot_size(part.bsize);
+    std::string data = setup::generate_Lorem_Ipsum(2 * part.bsize + part.bsize / 2);
+
+    // The servers are restarted between the steps, so the blocks are not read from their cache
+    {
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        write_file(legacy, data);
+        write_file(version, data);
+    }
+    to_legacy_layout(tmp_dir + "/xpn1/legacy.bin", 3, slot_size);
+    {
+        // Other version of the second block
+        std::fstream file(tmp_dir + "/xpn1/version.bin", std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(lz4_block_header::RAW_HEADER_SIZE + slot_size + offsetof(lz4_block_header, version));
+        char other_version = lz4_block_header::VERSION + 1;
+        file.write(&other_version, 1);
+        if (!file) {
+            std::cerr << "Error rewriting the file in the server: " << tmp_dir << "/xpn1/version.bin" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    {
+        LogTimer timer("1 sck server compressed 64k bsize old block header");
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        std::string read_data(data.size() + part.bsize, 'x');
+        ssize_t read_bytes = read_file(legacy, read_data);
+        if (read_bytes != (ssize_t)data.size() || read_data.compare(0, data.size(), data) != 0) {
+            std::cerr << "Test Failed: The file with the old block header is NOT read, read " << read_bytes << " of "
+                      << data.size() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // A partial write of a block of the old layout rewrites it in the current one
+        std::string patch = setup::generate_Lorem_Ipsum(1000);
+        int fd = xpn_open(legacy.c_str(), O_WRONLY);
+        if (fd < 0 || xpn_pwrite(fd, patch.data(), patch.size(), part.bsize + 100) != (ssize_t)patch.size()) {
+            std::cerr << "Error writing data to file: " << legacy << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        xpn_close(fd);
+        data.replace(part.bsize + 100, patch.size(), patch);
+        read_bytes = read_file(legacy, read_data);
+        if (read_bytes != (ssize_t)data.size() || read_data.compare(0, data.size(), data) != 0) {
+            std::cerr << "Test Failed: The patched file with the old block header is NOT the expected" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::cout << "Test Passed: The file with the old block header is read." << std::endl;
+
+        read_bytes = read_file(version, read_data);
+        if (read_bytes >= 0 || errno != EIO) {
+            std::cerr << "Test Failed: The block of other version is read, ret " << read_bytes << " "
+                      << strerror(errno) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::cout << "Test Passed: The block of other version fails with EIO." << std::endl;
+
+        if (xpn_unlink(legacy.c_str()) < 0 || xpn_unlink(version.c_str()) < 0) {
+            std::cerr << "Error removing the files" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
@@ -0,0 +1,206 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// Concurrent partial writes to the same blocks of a compressed file, each one must survive the Read-Modify-Write of
+// the others
+void run_test(size_t num_threads, size_t bsize) {
+    const std::string filename = "/xpn/compressed_partial_write.bin";
+    const size_t chunk_size = 1000;
+    const size_t num_chunks = 2048;
+    // Half of the file in small unaligned chunks and the other half in full blocks, mixed between the threads
+    const size_t partial_bytes = chunk_size * num_chunks;
+    const size_t full_blocks = 8;
+    const size_t total_bytes = partial_bytes + full_blocks * bsize;
+
+    std::string original_data = setup::generate_Lorem_Ipsum(total_bytes);
+
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("Error opening file for writing");
+        exit(EXIT_FAILURE);
+    }
+
+    LogTimer write_timer("concurrent partial write");
+    std::vector<std::thread> threads;
+    std::atomic_bool write_error = false;
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t c = t; c < num_chunks; c += num_threads) {
+                size_t offset = c * chunk_size;
+                if (xpn_pwrite(fd, original_data.data() + offset, chunk_size, offset) != (ssize_t)chunk_size) {
+                    write_error = true;
+                }
+            }
+            for (size_t b = t; b < full_blocks; b += num_threads) {
+                size_t offset = partial_bytes + b * bsize;
+                if (xpn_pwrite(fd, original_data.data() + offset, bsize, offset) != (ssize_t)bsize) {
+                    write_error = true;
+                }
+            }
+        });
+    }
+    for (auto &&thread : threads) {
+        thread.join();
+    }
+    write_timer.stop();
+    if (write_error) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string read_data;
+    read_data.resize(total_bytes);
+    ssize_t read_bytes = xpn_pread(fd, read_data.data(), total_bytes, 0);
+    xpn_close(fd);
+
+    if (read_bytes != (ssize_t)total_bytes) {
+        std::cerr << "Error reading data from file: " << filename << " " << read_bytes << " of " << total_bytes
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (original_data == read_data) {
+        std::cout << "Test Passed: The written data is identical to the read data." << std::endl;
+    } else {
+        size_t first_diff = 0;
+        while (first_diff < total_bytes && original_data[first_diff] == read_data[first_diff]) first_diff++;
+        std::cerr << "Test Failed: The written data is NOT identical to the read data, first difference at "
+                  << first_diff << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (xpn_unlink(filename.c_str()) < 0) {
+        std::cerr << "Error removing file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Concurrent full block writes, that do not lock the blocks exclusively, and reads of the same blocks. Each block has
+// one writer that reads it back after each write, the reads of the others fill the cache while it is written, so the
+// writer sees its last write and not a version cached by them, and the others see whole versions of the blocks
+void run_full_block_test(size_t num_threads, size_t bsize) {
+    const std::string filename = "/xpn/compressed_full_block_write.bin";
+    const size_t num_blocks = num_threads / 2;
+    const size_t rounds = 64;
+    const std::string versions[2] = {setup::generate_Lorem_Ipsum(num_blocks * bsize),
+                                     setup::generate_random_string(num_blocks * bsize)};
+
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0 || xpn_pwrite(fd, versions[0].data(), versions[0].size(), 0) != (ssize_t)versions[0].size()) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    LogTimer timer("concurrent full block write and read");
+    std::vector<std::thread> threads;
+    std::atomic_bool write_error = false;
+    std::atomic_bool read_error = false;
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            std::string read_data(bsize, 'x');
+            for (size_t r = 0; r < rounds; r++) {
+                if (t < num_blocks) {
+                    size_t offset = t * bsize;
+                    const auto &data = versions[(r + 1) % 2];
+                    if (xpn_pwrite(fd, data.data() + offset, bsize, offset) != (ssize_t)bsize ||
+                        xpn_pread(fd, read_data.data(), bsize, offset) != (ssize_t)bsize ||
+                        read_data.compare(0, bsize, data, offset, bsize) != 0) {
+                        write_error = true;
+                    }
+                    continue;
+                }
+                for (size_t b = 0; b < num_blocks; b++) {
+                    size_t offset = b * bsize;
+                    if (xpn_pread(fd, read_data.data(), bsize, offset) != (ssize_t)bsize ||
+                        (read_data.compare(0, bsize, versions[0], offset, bsize) != 0 &&
+                         read_data.compare(0, bsize, versions[1], offset, bsize) != 0)) {
+                        read_error = true;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &&thread : threads) {
+        thread.join();
+    }
+    timer.stop();
+    xpn_close(fd);
+    if (write_error) {
+        std::cerr << "Test Failed: A block read after its write is NOT the written one" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (read_error) {
+        std::cerr << "Test Failed: A block read while it is written is NOT a written one" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Test Passed: The concurrent full block writes and reads see whole blocks." << std::endl;
+
+    if (xpn_unlink(filename.c_str()) < 0) {
+        std::cerr << "Error removing file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}});
+    XPN::xpn_conf::partition part;
+    part.compressed = true;
+    {
+        LogTimer timer("1 sck server compressed 64k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        };
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(12, part.bsize);
+        run_full_block_test(8, part.bsize);
+    }
+    {
+        LogTimer timer("2 sck server compressed 512k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        };
+        part.bsize = 512 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(12, part.bsize);
+        run_full_block_test(8, part.bsize);
+    }
+    {
+        LogTimer timer("2 sck server compressed lz4hc in disk 64k bsize");
+        part.bsize = 64 * 1024;
+        part.disk_codec = {XPN::codec_type::LZ4HC, 9};
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(12, part.bsize);
+    }
+    {
+        LogTimer timer("2 sck server compressed with dictionary 64k bsize");
+        part.disk_codec = {};
+        part.dictionary = tmp_dir + "/xpn.dict";
+        std::ofstream(part.dictionary) << setup::generate_Lorem_Ipsum(32 * 1024);
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(12, part.bsize);
+    }
+}
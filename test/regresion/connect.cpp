@@ -0,0 +1,67 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The unreachable servers of the partition wait their connect timeout together in the init, or in the first
+// request to them when the connection is lazy, and the files are used with the replicas of the other servers
+void run_test(const XPN::xpn_conf::partition &part, int64_t max_init_ms) {
+    auto start = std::chrono::steady_clock::now();
+    XPN_scope xpn;
+    auto init_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (init_ms > max_init_ms) {
+        std::cerr << "Test Failed: The init takes " << init_ms << " ms, more than " << max_init_ms << " ms"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const std::string filename = "/xpn/connect.bin";
+    std::string data = setup::generate_random_string(4 * part.bsize + part.bsize / 2);
+    setup::write_file(filename, data);
+    setup::check_file(filename, data);
+    setup::remove_file(filename);
+    std::cout << "Test Passed: The init takes " << init_ms << " ms and the files are used without the unreachable "
+              << "servers." << std::endl;
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_CONNECT_TIMEOUT_MS", "1500"}});
+
+    XPN::xpn_conf::partition live_part;
+    live_part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+    };
+    XPN::xpn_conf::partition part;
+    part.replication_level = 2;
+    part.bsize = 64 * 1024;
+    part.server_urls = {
+        live_part.server_urls[0],
+        "sck_server://localhost:3458/" + tmp_dir + "/xpn3",
+        live_part.server_urls[1],
+        "sck_server://localhost:3459/" + tmp_dir + "/xpn4",
+    };
+    auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+    auto cleanup_srvs = setup::start_srvs(live_part);
+    {
+        // One after another the two unreachable servers would take two timeouts
+        LogTimer timer("2 of 4 sck servers unreachable parallel connect");
+        setup::env({{"XPN_CONNECT_PARALLEL", "4"}, {"XPN_CONNECT_LAZY", "0"}});
+        run_test(part, 2500);
+    }
+    {
+        LogTimer timer("2 of 4 sck servers unreachable lazy connect");
+        setup::env({{"XPN_CONNECT_LAZY", "1"}});
+        run_test(part, 500);
+    }
+}
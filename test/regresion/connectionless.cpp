@@ -0,0 +1,166 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The sockets open in this process
+int count_sockets() {
+    int sockets = 0;
+    for (auto &&entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+        std::error_code ec;
+        auto target = std::filesystem::read_symlink(entry.path(), ec);
+        if (!ec && target.string().rfind("socket:", 0) == 0) {
+            sockets++;
+        }
+    }
+    return sockets;
+}
+
+// Many requests one after the other, each one takes a connection of the pool and returns it
+void run_test(size_t bsize, int thread = 0) {
+    const std::string filename = "/xpn/connectionless_" + std::to_string(thread) + ".bin";
+    std::string data = setup::generate_random_string(2 * bsize + 123);
+
+    for (int i = 0; i < 20; i++) {
+        setup::write_file(filename, data);
+        setup::check_file(filename, data);
+        struct stat st;
+        if (xpn_stat(filename.c_str(), &st) < 0 || st.st_size != (off_t)data.size()) {
+            std::cerr << "Test Failed: The size of " << filename << " is NOT " << data.size() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    setup::remove_file(filename);
+}
+
+// The size written at the close has no response, the rename that comes after it by other connection of the pool
+// has to find it
+void run_rename_test(size_t bsize, int thread) {
+    const std::string filename = "/xpn/connectionless_" + std::to_string(thread) + ".bin";
+    const std::string new_filename = "/xpn/connectionless_renamed_" + std::to_string(thread) + ".bin";
+    std::string data = setup::generate_random_string(2 * bsize + 123);
+
+    for (int i = 0; i < 20; i++) {
+        setup::write_file(filename, data);
+        if (xpn_rename(filename.c_str(), new_filename.c_str()) < 0) {
+            std::cerr << "Error renaming " << filename << " to " << new_filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        struct stat st;
+        if (xpn_stat(new_filename.c_str(), &st) < 0 || st.st_size != (off_t)data.size()) {
+            std::cerr << "Test Failed: The size of " << new_filename << " is NOT " << data.size() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        setup::remove_file(new_filename);
+    }
+}
+
+// The connections left in the pool after the requests, from the sockets after the init
+void check_pooled(int sockets_before, int min_pooled, int max_pooled) {
+    int pooled = count_sockets() - sockets_before;
+    if (pooled < min_pooled || pooled > max_pooled) {
+        std::cerr << "Test Failed: " << pooled << " connections are kept, NOT between " << min_pooled << " and "
+                  << max_pooled << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    auto cleanup_data_dir3 = setup::create_empty_dir(tmp_dir + "/xpn3");
+    setup::env({{"XPN_LOCALITY", "0"},
+                {"XPN_CONNECT_RETRY_TIME_MS", "10"},
+                {"XPN_CONNECT", "0"},
+                {"XPN_CONNECTION_POOL", "4"},
+                {"XPN_SHORT_CIRCUIT", "0"}});
+    XPN::xpn_conf::partition part;
+    part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+    };
+    part.bsize = 512 * 1024;
+    auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+    {
+        LogTimer timer("1 sck server 512k bsize");
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        int sockets_before = count_sockets();
+        run_test(part.bsize);
+        check_pooled(sockets_before, 1, 4);
+        std::cout << "Test Passed: The requests one after the other reuse the pooled connections." << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 16; i++) {
+            threads.emplace_back([&part, i]() { run_test(part.bsize, i); });
+        }
+        for (auto &&thread : threads) {
+            thread.join();
+        }
+        check_pooled(sockets_before, 1, 4);
+        std::cout << "Test Passed: The pool of the requests of many threads is bounded." << std::endl;
+    }
+    {
+        LogTimer timer("1 sck server 512k bsize with idle timeout");
+        setup::env({{"XPN_CONNECTION_IDLE_MS", "50"}});
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        int sockets_before = count_sockets();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 16; i++) {
+            threads.emplace_back([&part, i]() { run_test(part.bsize, i); });
+        }
+        for (auto &&thread : threads) {
+            thread.join();
+        }
+        // The next request closes the connections idle for longer and takes a new one
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        struct stat st;
+        if (xpn_stat("/xpn", &st) < 0) {
+            std::cerr << "Error in stat after the idle timeout" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        check_pooled(sockets_before, 1, 1);
+        std::cout << "Test Passed: The pooled connections idle for longer than the timeout are closed." << std::endl;
+    }
+    {
+        LogTimer timer("1 sck server 512k bsize without pool");
+        setup::env({{"XPN_CONNECTION_POOL", "0"}});
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        int sockets_before = count_sockets();
+        run_test(part.bsize);
+        check_pooled(sockets_before, 0, 0);
+        std::cout << "Test Passed: Without pool each request connects." << std::endl;
+    }
+    {
+        LogTimer timer("3 sck server 64k bsize with renames");
+        setup::env({{"XPN_CONNECTION_POOL", "4"}});
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+            "sck_server://localhost:3458/" + tmp_dir + "/xpn3",
+        };
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 12; i++) {
+            threads.emplace_back([&part, i]() { run_rename_test(part.bsize, i); });
+        }
+        for (auto &&thread : threads) {
+            thread.join();
+        }
+        std::cout << "Test Passed: The renames after the writes of many threads find their size." << std::endl;
+    }
+}
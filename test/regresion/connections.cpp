@@ -0,0 +1,85 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The writes and reads of several threads are striped across the connections of the servers, a range that starts
+// and ends out of the blocks and a read after the end of the file check the bounds of the stripes
+void run_test(size_t id, size_t bsize) {
+    const std::string filename = "/xpn/connections_" + std::to_string(id) + ".bin";
+    const size_t total_bytes = 16 * bsize + bsize / 3;
+    std::string data = setup::generate_random_string(total_bytes);
+
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    if (xpn_pwrite(fd, data.data(), total_bytes, 0) != (ssize_t)total_bytes) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    const size_t offset = bsize / 2 + 123;
+    const size_t size = 8 * bsize + 77;
+    std::string patch = setup::generate_random_string(size);
+    if (xpn_pwrite(fd, patch.data(), size, offset) != (ssize_t)size) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    data.replace(offset, size, patch);
+
+    std::string read_data(total_bytes + bsize, 'x');
+    ssize_t read_bytes = xpn_pread(fd, read_data.data(), read_data.size(), 0);
+    xpn_close(fd);
+    if (read_bytes != (ssize_t)total_bytes || read_data.compare(0, total_bytes, data) != 0) {
+        std::cerr << "Test Failed: The data of " << filename << " is NOT the expected, read " << read_bytes << " of "
+                  << total_bytes << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (xpn_unlink(filename.c_str()) < 0) {
+        std::cerr << "Error removing file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"},
+                {"XPN_CONNECT_RETRY_TIME_MS", "10"},
+                {"XPN_SHORT_CIRCUIT", "0"},
+                {"XPN_CONNECTIONS", "4"},
+                {"XPN_STRIPE_SIZE", "16384"}});
+    XPN::xpn_conf::partition part;
+    part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+    };
+    for (bool compressed : {false, true}) {
+        LogTimer timer(compressed ? "2 sck server compressed 64k bsize 4 connections"
+                                  : "2 sck server 64k bsize 4 connections");
+        part.bsize = 64 * 1024;
+        part.compressed = compressed;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        // The servers grant less connections than asked
+        auto cleanup_srvs = setup::start_srvs(part, "--connections 2");
+        XPN_scope xpn;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < 4; i++) {
+            threads.emplace_back([i, &part]() { run_test(i, part.bsize); });
+        }
+        for (auto &&t : threads) {
+            t.join();
+        }
+        std::cout << "Test Passed: The striped transfers are read as written." << std::endl;
+    }
+}
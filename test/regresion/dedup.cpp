@@ -0,0 +1,97 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+static size_t count_blocks(const std::string &dedup_dir) {
+    size_t count = 0;
+    for (auto &entry : std::filesystem::recursive_directory_iterator(dedup_dir)) {
+        if (entry.is_regular_file()) count++;
+    }
+    return count;
+}
+
+// Two files with the same data share the blocks of the store, and the blocks are released with the files
+void run_test(const std::string &dedup_dir, size_t num_blocks, bool check_shared) {
+    const size_t block_size = 512 * 1024;
+    const std::string file_a = "/xpn/dedup_a.bin";
+    const std::string file_b = "/xpn/dedup_b.bin";
+
+    std::string original_data = setup::generate_random_string(num_blocks * block_size);
+    setup::write_file(file_a, original_data);
+    setup::write_file(file_b, original_data);
+    setup::check_file(file_a, original_data);
+    setup::check_file(file_b, original_data);
+    if (check_shared && count_blocks(dedup_dir) > num_blocks) {
+        std::cerr << "Test Failed: The blocks of the same data are stored twice, " << count_blocks(dedup_dir)
+                  << " blocks of " << num_blocks << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // A partial write of a shared block only changes the file written
+    std::string modified_data = original_data;
+    std::string patch = setup::generate_random_string(100);
+    modified_data.replace(1000, patch.size(), patch);
+    int fd = xpn_open(file_b.c_str(), O_WRONLY);
+    if (fd < 0 || xpn_pwrite(fd, patch.data(), patch.size(), 1000) != (ssize_t)patch.size()) {
+        std::cerr << "Error writing the patch to file: " << file_b << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    xpn_close(fd);
+    setup::check_file(file_a, original_data);
+    setup::check_file(file_b, modified_data);
+
+    // Rename over a file releases the blocks of the replaced one
+    if (xpn_rename(file_b.c_str(), file_a.c_str()) < 0) {
+        std::cerr << "Error renaming file: " << file_b << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    setup::check_file(file_a, modified_data);
+    setup::remove_file(file_a);
+    if (count_blocks(dedup_dir) != 0) {
+        std::cerr << "Test Failed: " << count_blocks(dedup_dir) << " blocks are kept after removing the files"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Test Passed: The blocks of the same data are stored once." << std::endl;
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    const std::string dedup_dir = tmp_dir + "/dedup";
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_DEDUP", "1"}});
+    XPN::xpn_conf::partition part;
+    {
+        LogTimer timer("1 sck server 512k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        };
+        part.bsize = 512 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part, "--dedup_dir " + dedup_dir);
+        XPN_scope xpn;
+        run_test(dedup_dir, 8, true);
+    }
+    {
+        // The compressed blocks are deduplicated in the servers, without the fingerprints of the client
+        LogTimer timer("2 sck server compressed 64k bsize");
+        part.compressed = true;
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        };
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part, "--dedup_dir " + dedup_dir);
+        XPN_scope xpn;
+        run_test(dedup_dir, 8, false);
+    }
+}
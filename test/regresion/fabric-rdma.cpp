@@ -0,0 +1,99 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The raw chunks of at least XPN_RDMA_MIN_SIZE to the fabric servers are moved one-sided by the server, the smaller
+// ones, the tail chunks below it, the compressed ones and all of them with XPN_RDMA_MIN_SIZE=0 go in messages. The
+// transfers are done from and to buffers out of the pages, so the registered regions are larger than them, and the
+// data written by one path is read by the other one
+void run_test(size_t bsize) {
+    const std::string filename = "/xpn/fabric_rdma.bin";
+    const size_t rdma_min_size = 64 * 1024;
+    // Below, at and above the minimum, and of many chunks with a tail below it
+    const std::vector<size_t> sizes = {4 * 1024, rdma_min_size - 1, rdma_min_size, 3 * 1024 * 1024 + 12345};
+    const size_t total_bytes = 4 * 1024 * 1024;
+    std::string data = setup::generate_random_string(total_bytes);
+
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    // One large write, read back in transfers of each size, and the reverse
+    std::vector<char> buffer(total_bytes + 1);
+    std::copy(data.begin(), data.end(), buffer.begin() + 1);
+    if (xpn_pwrite(fd, buffer.data() + 1, total_bytes, 0) != (ssize_t)total_bytes) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    for (size_t size : sizes) {
+        size_t offset = (total_bytes - size) / 3;
+        std::fill(buffer.begin(), buffer.end(), 'x');
+        if (xpn_pread(fd, buffer.data() + 1, size, offset) != (ssize_t)size ||
+            data.compare(offset, size, buffer.data() + 1, size) != 0) {
+            std::cerr << "Test Failed: The read of " << size << " is NOT the written data" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        std::string patch = setup::generate_random_string(size);
+        if (xpn_pwrite(fd, patch.data(), size, offset) != (ssize_t)size) {
+            std::cerr << "Error writing " << size << " to file: " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        data.replace(offset, size, patch);
+    }
+    std::fill(buffer.begin(), buffer.end(), 'x');
+    ssize_t read_bytes = xpn_pread(fd, buffer.data() + 1, total_bytes, 0);
+    xpn_close(fd);
+    if (read_bytes != (ssize_t)total_bytes || data.compare(0, total_bytes, buffer.data() + 1, total_bytes) != 0) {
+        std::cerr << "Test Failed: The data is NOT the written one, read " << read_bytes << " of " << total_bytes
+                  << " with bsize " << bsize << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (xpn_unlink(filename.c_str()) < 0) {
+        std::cerr << "Error removing file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_SHORT_CIRCUIT", "0"}});
+    XPN::xpn_conf::partition part;
+    part.server_urls = {
+        "fabric_server://localhost:3456/" + tmp_dir + "/xpn1",
+        "fabric_server://localhost:3457/" + tmp_dir + "/xpn2",
+    };
+    part.bsize = 512 * 1024;
+
+    // XPN_RDMA_MIN_SIZE and XPN_RDMA_CACHE are read again in each init
+    struct rdma_case {
+        std::string name;
+        std::string min_size;
+        std::string cache;
+        bool compressed;
+    };
+    for (auto &&c : std::vector<rdma_case>{{"rdma", "65536", "0", false},
+                                           {"rdma with cached registrations", "65536", "4", false},
+                                           {"messages", "0", "0", false},
+                                           {"compressed in messages", "65536", "0", true}}) {
+        LogTimer timer("2 fabric server 512k bsize " + c.name);
+        setup::env({{"XPN_RDMA_MIN_SIZE", c.min_size}, {"XPN_RDMA_CACHE", c.cache}});
+        part.compressed = c.compressed;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(part.bsize);
+        std::cout << "Test Passed: The fabric transfers with " << c.name << " are read as written." << std::endl;
+    }
+}
@@ -0,0 +1,145 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+void pwrite_or_exit(int fd, const std::string &data, size_t offset, const std::string &filename) {
+    if (xpn_pwrite(fd, data.data(), data.size(), offset) != (ssize_t)data.size()) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void pread_or_exit(int fd, const std::string &data, size_t offset, const std::string &filename) {
+    std::string buffer(data.size(), 'x');
+    if (xpn_pread(fd, buffer.data(), buffer.size(), offset) != (ssize_t)buffer.size() || buffer != data) {
+        std::cerr << "Test Failed: The data of " << filename << " at " << offset << " is NOT the expected" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The server keeps open the files of few handles, the handle of a file is closed when others are opened after it
+// and the reads and writes of its descriptor are done again by path
+void run_evict_test(size_t bsize, int max_handles) {
+    const std::string filename = "/xpn/handles.bin";
+    std::string data = setup::generate_random_string(2 * bsize + 123);
+    setup::write_file(filename, data);
+
+    int fd = xpn_open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    pread_or_exit(fd, data, 0, filename);
+
+    // The handles of other files close the file of this one in the server
+    std::vector<int> others;
+    for (int i = 0; i <= max_handles; i++) {
+        std::string other = "/xpn/handles_other_" + std::to_string(i) + ".bin";
+        setup::write_file(other, data);
+        int other_fd = xpn_open(other.c_str(), O_RDONLY);
+        if (other_fd < 0) {
+            perror("Error opening other file");
+            exit(EXIT_FAILURE);
+        }
+        pread_or_exit(other_fd, data, 0, other);
+        others.push_back(other_fd);
+    }
+
+    std::string patch = setup::generate_random_string(bsize / 2);
+    pwrite_or_exit(fd, patch, bsize - 10, filename);
+    data.replace(bsize - 10, patch.size(), patch);
+    pread_or_exit(fd, data, 0, filename);
+    xpn_close(fd);
+    setup::check_file(filename, data);
+    std::cout << "Test Passed: The descriptor of a closed handle reads and writes by path." << std::endl;
+
+    for (int i = 0; i <= max_handles; i++) {
+        xpn_close(others[i]);
+        setup::remove_file("/xpn/handles_other_" + std::to_string(i) + ".bin");
+    }
+    setup::remove_file(filename);
+}
+
+// Other client moves the file away and back, its handle is closed in the server at each rename and the reads and
+// writes of the descriptor after them go by path to the same file
+void run_rename_test(size_t bsize) {
+    const std::string filename = "/xpn/handles.bin";
+    const std::string tmp_filename = "/xpn/handles_tmp.bin";
+    std::string data = setup::generate_random_string(2 * bsize + 123);
+    setup::write_file(filename, data);
+
+    int fd = xpn_open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    pread_or_exit(fd, data, 0, filename);
+
+    for (auto &&[from, to] : {std::pair{filename, tmp_filename}, std::pair{tmp_filename, filename}}) {
+        XPN::subprocess::process other("/proc/self/exe", {"rename", from, to}, false);
+        if (other.wait_status() != 0) {
+            std::cerr << "Error renaming in other client " << from << " to " << to << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::string patch = setup::generate_random_string(bsize / 2);
+    pwrite_or_exit(fd, patch, bsize, filename);
+    data.replace(bsize, patch.size(), patch);
+    pread_or_exit(fd, data, 0, filename);
+    xpn_close(fd);
+    setup::check_file(filename, data);
+    std::cout << "Test Passed: The descriptor of a file renamed by other client reads and writes by path." << std::endl;
+
+    setup::remove_file(filename);
+}
+
+int main(int argc, char *argv[]) {
+    // The other client of the test
+    if (argc == 4 && std::string(argv[1]) == "rename") {
+        XPN_scope xpn;
+        return xpn_rename(argv[2], argv[3]) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"},
+                {"XPN_CONNECT_RETRY_TIME_MS", "10"},
+                {"XPN_HANDLES", "1"},
+                {"XPN_SESSION_FILE", "0"},
+                {"XPN_SHORT_CIRCUIT", "0"}});
+    XPN::xpn_conf::partition part;
+    const int max_handles = 2;
+    {
+        LogTimer timer("2 sck server 512k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        };
+        part.bsize = 512 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part, "--handles " + std::to_string(max_handles));
+        XPN_scope xpn;
+        run_evict_test(part.bsize, max_handles);
+        run_rename_test(part.bsize);
+    }
+    {
+        LogTimer timer("2 sck server compressed 64k bsize");
+        part.compressed = true;
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part, "--handles " + std::to_string(max_handles));
+        XPN_scope xpn;
+        run_evict_test(part.bsize, max_handles);
+        run_rename_test(part.bsize);
+    }
+}
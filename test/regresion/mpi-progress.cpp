@@ -0,0 +1,134 @@
+#include <sys/resource.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mpi.h"
+#include "xpn_server/mpi_server/mpi_server_comm.hpp"
+
+// The progress thread of the mpi servers in a singleton process, the messages are sent to itself in MPI_COMM_SELF
+void check(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cerr << "Test Failed: " << what << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+double cpu_seconds() {
+    struct rusage usage = {};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    int provided = 0;
+    if (MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided) != MPI_SUCCESS) {
+        std::cerr << "Error in MPI_Init_thread" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (provided != MPI_THREAD_MULTIPLE) {
+        std::cout << "Test Skipped: The MPI library has not MPI_THREAD_MULTIPLE" << std::endl;
+        MPI_Finalize();
+        return 0;
+    }
+    MPI_Comm_set_errhandler(MPI_COMM_SELF, MPI_ERRORS_RETURN);
+    {
+        XPN::mpi_server_progress progress(true);
+        MPI_Status status;
+
+        // The waits of many threads are completed together, the receives before and after the sends
+        const int num_threads = 8;
+        std::vector<std::thread> threads;
+        std::vector<int> rets(num_threads, -1);
+        std::vector<std::string> received(num_threads, std::string(64, '\0'));
+        for (int i = 0; i < num_threads; i++) {
+            threads.emplace_back([&, i]() {
+                MPI_Status thread_status;
+                if (i % 2 == 0) {
+                    rets[i] = progress.probe_recv(received[i].data(), received[i].size(), MPI_CHAR, 0, i, MPI_COMM_SELF,
+                                                  thread_status);
+                } else {
+                    MPI_Request request;
+                    MPI_Irecv(received[i].data(), received[i].size(), MPI_CHAR, 0, i, MPI_COMM_SELF, &request);
+                    rets[i] = progress.wait(request, thread_status);
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (int i = 0; i < num_threads; i++) {
+            std::string msg = "message " + std::to_string(i);
+            msg.resize(64);
+            MPI_Send(msg.data(), msg.size(), MPI_CHAR, 0, i, MPI_COMM_SELF);
+        }
+        for (int i = 0; i < num_threads; i++) {
+            threads[i].join();
+            check(rets[i] == MPI_SUCCESS && received[i].rfind("message " + std::to_string(i), 0) == 0,
+                  "The message " + std::to_string(i) + " is not received");
+        }
+        std::cout << "Test Passed: The waits of many threads are completed." << std::endl;
+
+        // A larger message is taken out of the queue and reported truncated, the next one is received
+        std::string small(8, '\0');
+        std::string large(16, 'x');
+        std::string next(8, 'y');
+        MPI_Send(large.data(), large.size(), MPI_CHAR, 0, 100, MPI_COMM_SELF);
+        MPI_Send(next.data(), next.size(), MPI_CHAR, 0, 100, MPI_COMM_SELF);
+        check(progress.probe_recv(small.data(), small.size(), MPI_CHAR, 0, 100, MPI_COMM_SELF, status) ==
+                  MPI_ERR_TRUNCATE,
+              "The larger message is not truncated");
+        check(progress.probe_recv(small.data(), small.size(), MPI_CHAR, 0, 100, MPI_COMM_SELF, status) == MPI_SUCCESS &&
+                  small == next,
+              "The message after the truncated one is not received");
+        std::cout << "Test Passed: The larger message is truncated." << std::endl;
+
+        // A pending probe without messages does not keep a core busy, and a message after the sleep is received
+        int idle_ret = -1;
+        std::string idle_msg(8, '\0');
+        std::thread idle_thread([&]() {
+            MPI_Status thread_status;
+            idle_ret = progress.probe_recv(idle_msg.data(), idle_msg.size(), MPI_CHAR, 0, 200, MPI_COMM_SELF,
+                                           thread_status);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        double cpu_start = cpu_seconds();
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        double cpu = cpu_seconds() - cpu_start;
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        check(cpu < wall / 2, "The idle progress thread used " + std::to_string(cpu) + " s of cpu in " +
+                                  std::to_string(wall) + " s");
+        MPI_Send(next.data(), next.size(), MPI_CHAR, 0, 200, MPI_COMM_SELF);
+        idle_thread.join();
+        check(idle_ret == MPI_SUCCESS && idle_msg == next, "The message after the idle time is not received");
+        std::cout << "Test Passed: The idle progress thread sleeps." << std::endl;
+
+        // The waits still pending when the server stops fail, and the next ones fail without waiting
+        int probe_ret = MPI_SUCCESS;
+        int wait_ret = MPI_SUCCESS;
+        std::string pending(8, '\0');
+        std::thread probe_thread([&]() {
+            MPI_Status thread_status;
+            probe_ret =
+                progress.probe_recv(pending.data(), pending.size(), MPI_CHAR, 0, 300, MPI_COMM_SELF, thread_status);
+        });
+        std::thread wait_thread([&]() {
+            MPI_Status thread_status;
+            MPI_Request request;
+            MPI_Irecv(pending.data(), pending.size(), MPI_CHAR, 0, 301, MPI_COMM_SELF, &request);
+            wait_ret = progress.wait(request, thread_status);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        progress.stop();
+        probe_thread.join();
+        wait_thread.join();
+        check(probe_ret == MPI_ERR_OTHER && wait_ret == MPI_ERR_OTHER, "The pending waits do not fail at the stop");
+        check(progress.probe_recv(pending.data(), pending.size(), MPI_CHAR, 0, 300, MPI_COMM_SELF, status) ==
+                  MPI_ERR_OTHER,
+              "The waits after the stop do not fail");
+        std::cout << "Test Passed: The pending waits fail at the stop." << std::endl;
+    }
+    MPI_Finalize();
+}
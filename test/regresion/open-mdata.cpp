@@ -0,0 +1,108 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The plain opens and the stats read the metadata header in the same request, the size, the mode and the data of
+// many small files spread in the servers are the written ones, and the missing files and the directories still work
+void run_test(size_t bsize) {
+    const size_t num_files = 64;
+    auto filename = [](size_t i) { return "/xpn/open_mdata_" + std::to_string(i) + ".txt"; };
+    auto size_of = [bsize](size_t i) { return i * bsize / 7 + i; };
+    auto mode_of = [](size_t i) -> mode_t { return i % 2 == 0 ? 0640 : 0600; };
+
+    std::vector<std::string> data(num_files);
+    for (size_t i = 0; i < num_files; i++) {
+        data[i] = setup::generate_Lorem_Ipsum(size_of(i));
+        int fd = xpn_open(filename(i).c_str(), O_CREAT | O_TRUNC | O_WRONLY, mode_of(i));
+        if (fd < 0) {
+            perror("Error opening file");
+            exit(EXIT_FAILURE);
+        }
+        if (xpn_write(fd, data[i].data(), data[i].size()) != (ssize_t)data[i].size()) {
+            std::cerr << "Error writing data to file: " << filename(i) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        xpn_close(fd);
+    }
+
+    for (size_t i = 0; i < num_files; i++) {
+        struct stat st = {};
+        if (xpn_stat(filename(i).c_str(), &st) < 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size != size_of(i) ||
+            (st.st_mode & 0777) != mode_of(i)) {
+            std::cerr << "Test Failed: The stat of " << filename(i) << " is NOT the expected, size " << st.st_size
+                      << " of " << size_of(i) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        int fd = xpn_open(filename(i).c_str(), O_RDONLY);
+        if (fd < 0) {
+            perror("Error opening file");
+            exit(EXIT_FAILURE);
+        }
+        st = {};
+        if (xpn_fstat(fd, &st) < 0 || (size_t)st.st_size != size_of(i)) {
+            std::cerr << "Test Failed: The fstat of " << filename(i) << " is NOT the expected, size " << st.st_size
+                      << " of " << size_of(i) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::string read_data(size_of(i) + bsize, 'x');
+        ssize_t read_bytes = xpn_read(fd, read_data.data(), read_data.size());
+        xpn_close(fd);
+        if (read_bytes != (ssize_t)size_of(i) || read_data.compare(0, read_bytes, data[i]) != 0) {
+            std::cerr << "Test Failed: The data of " << filename(i) << " is NOT the expected, read " << read_bytes
+                      << " of " << size_of(i) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct stat st = {};
+    if (xpn_open("/xpn/open_mdata_missing.txt", O_RDONLY) >= 0 || errno != ENOENT ||
+        xpn_stat("/xpn/open_mdata_missing.txt", &st) >= 0 || errno != ENOENT) {
+        std::cerr << "Test Failed: A missing file is found" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (xpn_mkdir("/xpn/open_mdata_dir", 0755) < 0 || xpn_stat("/xpn/open_mdata_dir", &st) < 0 ||
+        !S_ISDIR(st.st_mode) || xpn_rmdir("/xpn/open_mdata_dir") < 0) {
+        std::cerr << "Test Failed: The stat of a directory is NOT the expected" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < num_files; i++) {
+        if (xpn_unlink(filename(i).c_str()) < 0) {
+            std::cerr << "Error removing file: " << filename(i) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    auto cleanup_data_dir3 = setup::create_empty_dir(tmp_dir + "/xpn3");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}});
+    XPN::xpn_conf::partition part;
+    part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        "sck_server://localhost:3458/" + tmp_dir + "/xpn3",
+    };
+    for (int replication_level : {0, 1}) {
+        LogTimer timer("3 sck server 4k bsize replication " + std::to_string(replication_level));
+        part.bsize = 4096;
+        part.replication_level = replication_level;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(part.bsize);
+        std::cout << "Test Passed: The opens and stats with the metadata are the expected." << std::endl;
+    }
+}
@@ -0,0 +1,77 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The compressed transfers of many small chunks go through several windows compressed and decompressed while the
+// ones before are in the network, the data mixes compressible and random ranges and the read is not aligned
+void run_test(size_t id) {
+    const std::string filename = "/xpn/pipelined_chunks_" + std::to_string(id) + ".bin";
+    std::string data;
+    for (size_t i = 0; i < 12; i++) {
+        data += i % 3 == 0 ? setup::generate_random_string(37 * 1024 + i) : setup::generate_Lorem_Ipsum(91 * 1024 + i);
+    }
+
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    if (xpn_pwrite(fd, data.data(), data.size(), 0) != (ssize_t)data.size()) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const size_t offset = 5000;
+    std::string read_data(data.size(), 'x');
+    ssize_t read_bytes = xpn_pread(fd, read_data.data(), read_data.size(), offset);
+    xpn_close(fd);
+    if (read_bytes != (ssize_t)(data.size() - offset) || read_data.compare(0, read_bytes, data, offset) != 0) {
+        std::cerr << "Test Failed: The data of " << filename << " is NOT the expected, read " << read_bytes << " of "
+                  << data.size() - offset << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (xpn_unlink(filename.c_str()) < 0) {
+        std::cerr << "Error removing file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    XPN::xpn_conf::partition part;
+    part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+    };
+    part.bsize = 512 * 1024;
+    auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+    auto cleanup_srvs = setup::start_srvs(part);
+    for (const char *compression : {"1", "2"}) {
+        LogTimer timer(std::string("2 sck server 4k chunks net compression ") + compression);
+        setup::env({{"XPN_LOCALITY", "0"},
+                    {"XPN_CONNECT_RETRY_TIME_MS", "10"},
+                    {"XPN_SHORT_CIRCUIT", "0"},
+                    {"XPN_NET_COMPRESSION", compression},
+                    {"XPN_SCK_CHUNK_SIZE", "4096"}});
+        XPN_scope xpn;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < 3; i++) {
+            threads.emplace_back([i]() { run_test(i); });
+        }
+        for (auto &&t : threads) {
+            t.join();
+        }
+        std::cout << "Test Passed: The pipelined chunks are read as written." << std::endl;
+    }
+}
@@ -0,0 +1,112 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The reads and writes of the RW_V2 protocol, the operation and its data go in one send and the reply of the read
+// brings the data after it. Transfers below, across and over the blocks, and at offsets that are not aligned
+void run_test(size_t bsize, int thread = 0) {
+    const std::string filename = "/xpn/rw_v2_" + std::to_string(thread) + ".bin";
+    const size_t total_bytes = 4 * bsize + 123;
+    std::string data = setup::generate_random_string(total_bytes);
+
+    setup::write_file(filename, data);
+    setup::check_file(filename, data);
+
+    int fd = xpn_open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t size : {size_t(1), size_t(100), bsize - 1, bsize + 1, 2 * bsize + 17}) {
+        size_t offset = (total_bytes - size) / 3;
+        std::string patch = setup::generate_random_string(size);
+        if (xpn_pwrite(fd, patch.data(), size, offset) != (ssize_t)size) {
+            std::cerr << "Error writing " << size << " to file: " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        data.replace(offset, size, patch);
+
+        std::string buffer(size, 'x');
+        if (xpn_pread(fd, buffer.data(), size, offset) != (ssize_t)size || buffer != patch) {
+            std::cerr << "Test Failed: The read of " << size << " at " << offset << " is NOT the written data"
+                      << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    // A read past the end of the file only brings the bytes up to it
+    std::string buffer(2 * bsize, 'x');
+    if (xpn_pread(fd, buffer.data(), buffer.size(), total_bytes - 10) != 10 ||
+        data.compare(total_bytes - 10, 10, buffer, 0, 10) != 0) {
+        std::cerr << "Test Failed: The read past the end of " << filename << " is NOT the tail" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    xpn_close(fd);
+    setup::check_file(filename, data);
+
+    setup::remove_file(filename);
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    // Over the sockets, without the shared memory channels and the direct access of the clients of the same node,
+    // and without the checksums that RW_V2 has not
+    setup::env({{"XPN_LOCALITY", "0"},
+                {"XPN_CONNECT_RETRY_TIME_MS", "10"},
+                {"XPN_RW_V2", "1"},
+                {"XPN_CHECKSUM", "0"},
+                {"XPN_SHM", "0"},
+                {"XPN_SHORT_CIRCUIT", "0"}});
+    XPN::xpn_conf::partition part;
+    {
+        LogTimer timer("2 sck server 512k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        };
+        part.bsize = 512 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(part.bsize);
+        std::cout << "Test Passed: The RW_V2 transfers are read as written." << std::endl;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; i++) {
+            threads.emplace_back([&part, i]() { run_test(part.bsize, i); });
+        }
+        for (auto &&thread : threads) {
+            thread.join();
+        }
+        std::cout << "Test Passed: The RW_V2 transfers of many threads are read as written." << std::endl;
+    }
+    {
+        LogTimer timer("2 sck server 512k bsize with compression in the network");
+        setup::env({{"XPN_NET_COMPRESSION", "2"}});
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(part.bsize);
+        std::cout << "Test Passed: The compressed RW_V2 transfers are read as written." << std::endl;
+    }
+    {
+        LogTimer timer("2 sck server compressed 64k bsize");
+        setup::env({{"XPN_NET_COMPRESSION", "0"}});
+        part.compressed = true;
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(part.bsize);
+        std::cout << "Test Passed: The RW_V2 transfers of a compressed file are read as written." << std::endl;
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <fcntl.h>
 #include <stdlib.h>
 #include <xpn.h>
 
@@ -120,7 +121,7 @@ class setup {
         });
     }
 
-    [[maybe_unused]] static Defer start_srvs(const XPN::xpn_conf::partition& part) {
+    [[maybe_unused]] static Defer start_srvs(const XPN::xpn_conf::partition& part, const std::string& extra_args = "") {
         XPN_PROFILE_BEGIN_SESSION("Setup servers");
         XPN_PROFILE_FUNCTION();
         std::vector<XPN::subprocess::process> server_processes;
@@ -152,6 +153,10 @@ class setup {
                 srv_commmand += " --port ";
                 srv_commmand += url.port;
             }
+            if (!extra_args.empty()) {
+                srv_commmand += " ";
+                srv_commmand += extra_args;
+            }
             {
                 XPN_PROFILE_SCOPE(std::string("start server ") + std::string(url.server));
                 XPN::subprocess::process srv_process(srv_commmand, false, false);
@@ -239,6 +244,44 @@ class setup {
 
         return result;
     }
+
+    // Create or truncate the file and write data from its start
+    static void write_file(const std::string& filename, const std::string& data) {
+        int fd = xpn_open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            perror("Error opening file for writing");
+            exit(EXIT_FAILURE);
+        }
+        if (xpn_pwrite(fd, data.data(), data.size(), 0) != (ssize_t)data.size()) {
+            std::cerr << "Error writing data to file: " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        xpn_close(fd);
+    }
+
+    // The test fails if the file does not start with data
+    static void check_file(const std::string& filename, const std::string& data) {
+        int fd = xpn_open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            perror("Error opening file for reading");
+            exit(EXIT_FAILURE);
+        }
+        std::string read_data(data.size(), 'x');
+        ssize_t read_bytes = xpn_pread(fd, read_data.data(), data.size(), 0);
+        xpn_close(fd);
+        if (read_bytes != (ssize_t)data.size() || read_data != data) {
+            std::cerr << "Test Failed: The data of " << filename << " is NOT the expected, read " << read_bytes
+                      << " of " << data.size() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    static void remove_file(const std::string& filename) {
+        if (xpn_unlink(filename.c_str()) < 0) {
+            std::cerr << "Error removing file: " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
 };
 
 template <typename unit = std::chrono::milliseconds>
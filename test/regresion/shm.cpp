@@ -0,0 +1,188 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "base_cpp/shm_channel.hpp"
+#include "setup.hpp"
+#include "xpn.h"
+
+// The pids of the clients of the shared memory channels mapped by a process, from the names of the segments
+std::set<pid_t> shm_mapped(const std::string &maps_path) {
+    std::set<pid_t> pids;
+    std::ifstream maps(maps_path);
+    std::string line;
+    const std::string prefix = "/xpn_shm_";
+    while (std::getline(maps, line)) {
+        size_t pos = line.find(prefix);
+        if (pos != std::string::npos) {
+            pids.insert(std::atoi(line.c_str() + pos + prefix.size()));
+        }
+    }
+    return pids;
+}
+
+// The channels of a client that is gone are still mapped by some server
+bool dead_client_mapped() {
+    for (auto &&entry : std::filesystem::directory_iterator("/proc")) {
+        if (!std::isdigit(entry.path().filename().string()[0])) {
+            continue;
+        }
+        for (pid_t pid : shm_mapped(entry.path().string() + "/maps")) {
+            if (::kill(pid, 0) < 0 && errno == ESRCH) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::set<std::string> list_dir(const std::string &path) {
+    std::set<std::string> names;
+    DIR *dirp = xpn_opendir(path.c_str());
+    if (dirp == nullptr) {
+        std::cerr << "Error: Could not open directory " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    struct dirent *dp;
+    while ((dp = xpn_readdir(dirp)) != nullptr) {
+        std::string name = dp->d_name;
+        if (name != "." && name != "..") {
+            names.insert(name);
+        }
+    }
+    xpn_closedir(dirp);
+    return names;
+}
+
+// The transfers larger than the rings wrap around them and wait for the space, and the metadata requests and
+// replies of the other operations go through the same channel
+void run_test(size_t bsize) {
+    const std::string base_dir = "/xpn/shm_dir";
+    const std::string filename = base_dir + "/shm.bin";
+    const std::string new_filename = base_dir + "/shm_renamed.bin";
+    const size_t total_bytes = 3 * XPN::shm_channel::DEFAULT_RING_SIZE + 12345;
+
+    if (xpn_mkdir(base_dir.c_str(), 0755) != 0) {
+        perror("Error creating directory");
+        exit(EXIT_FAILURE);
+    }
+    std::string data = setup::generate_random_string(total_bytes);
+    setup::write_file(filename, data);
+    setup::check_file(filename, data);
+    if (shm_mapped("/proc/self/maps").count(::getpid()) == 0) {
+        std::cerr << "Test Failed: The connection is not in a shared memory channel" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Test Passed: The transfers larger than the ring are read as written with bsize " << bsize << "."
+              << std::endl;
+
+    if (xpn_rename(filename.c_str(), new_filename.c_str()) < 0) {
+        std::cerr << "Error renaming " << filename << " to " << new_filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (list_dir(base_dir) != std::set<std::string>{"shm_renamed.bin"}) {
+        std::cerr << "Test Failed: The directory has not only the renamed file" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    setup::check_file(new_filename, data);
+    std::cout << "Test Passed: The renamed file is listed and read." << std::endl;
+
+    setup::remove_file(new_filename);
+    if (xpn_rmdir(base_dir.c_str()) < 0) {
+        std::cerr << "Error removing directory: " << base_dir << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Other client exits in the middle of a write without disconnecting, the server sees that it is gone and keeps
+// serving the other clients
+void run_exit_test(size_t bsize) {
+    const std::string filename = "/xpn/shm_exit.bin";
+
+    XPN::subprocess::process other("/proc/self/exe", {"exit", filename}, false);
+    if (other.wait_status() != 0) {
+        std::cerr << "Error in other client that exits writing " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    // The server waits the channel for some time before it asks the socket
+    auto start = std::chrono::steady_clock::now();
+    while (dead_client_mapped()) {
+        if (std::chrono::steady_clock::now() - start > std::chrono::seconds(10)) {
+            std::cerr << "Test Failed: The server keeps the channel of the client that exited" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::string data = setup::generate_random_string(2 * bsize);
+    setup::write_file(filename, data);
+    setup::check_file(filename, data);
+    std::cout << "Test Passed: The server closes the channel of the client that exited." << std::endl;
+
+    setup::remove_file(filename);
+}
+
+int main(int argc, char *argv[]) {
+    // The other client of the test, it exits without xpn_destroy while its write is in the channel
+    if (argc == 3 && std::string(argv[1]) == "exit") {
+        if (xpn_init() < 0) {
+            return EXIT_FAILURE;
+        }
+        int fd = xpn_open(argv[2], O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            return EXIT_FAILURE;
+        }
+        std::string data = setup::generate_random_string(8 * XPN::shm_channel::DEFAULT_RING_SIZE);
+        std::thread writer([&]() { xpn_pwrite(fd, data.data(), data.size(), 0); });
+        writer.detach();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ::_exit(EXIT_SUCCESS);
+    }
+
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"},
+                {"XPN_CONNECT_RETRY_TIME_MS", "10"},
+                {"XPN_CONNECT", "1"},
+                {"XPN_SHM", "1"},
+                {"XPN_SHORT_CIRCUIT", "0"}});
+    XPN::xpn_conf::partition part;
+    {
+        LogTimer timer("1 sck server 512k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        };
+        part.bsize = 512 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        {
+            XPN_scope xpn;
+            run_test(part.bsize);
+            run_exit_test(part.bsize);
+        }
+    }
+    {
+        LogTimer timer("2 sck server compressed 64k bsize");
+        part.compressed = true;
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        };
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(part.bsize);
+    }
+}
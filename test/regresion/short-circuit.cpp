@@ -0,0 +1,106 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The data written by the client of the same node is in the file of the server after the header, and the file
+// replaced by other client is read when it is opened again and written by the descriptors opened before, the rename
+// waits until the lease of the old file ends
+void run_test(const std::string &data_dir, size_t bsize, bool check_backing) {
+    const std::string file_a = "/xpn/short_circuit_a.bin";
+    const std::string file_b = "/xpn/short_circuit_b.bin";
+    const size_t total_bytes = 2 * bsize + bsize / 2;
+
+    std::string data_a = setup::generate_random_string(total_bytes);
+    std::string data_b = setup::generate_random_string(total_bytes);
+    setup::write_file(file_a, data_a);
+    setup::write_file(file_b, data_b);
+
+    if (check_backing) {
+        std::ifstream backing(data_dir + "/short_circuit_a.bin", std::ios::binary);
+        std::string backing_data((std::istreambuf_iterator<char>(backing)), std::istreambuf_iterator<char>());
+        if (backing_data.size() != 8192 + total_bytes || backing_data.compare(8192, total_bytes, data_a) != 0) {
+            std::cerr << "Test Failed: The file of the server has not the data after the header, size "
+                      << backing_data.size() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    setup::check_file(file_a, data_a);
+
+    // Other client replaces the file while this one has its descriptor
+    XPN::subprocess::process other("/proc/self/exe", {"rename", file_b, file_a}, false);
+    if (other.wait_status() != 0) {
+        std::cerr << "Error renaming in other client " << file_b << " to " << file_a << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    setup::check_file(file_a, data_b);
+    std::cout << "Test Passed: The file replaced by other client is read." << std::endl;
+
+    // Other client replaces the file while this one writes it, the writes after the rename go to the new file
+    setup::write_file(file_b, data_b);
+    int fd = xpn_open(file_a.c_str(), O_WRONLY);
+    std::string patch = setup::generate_random_string(bsize / 2);
+    if (fd < 0 || xpn_pwrite(fd, patch.data(), patch.size(), 0) != (ssize_t)patch.size()) {
+        std::cerr << "Error writing data to file: " << file_a << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    XPN::subprocess::process other_write("/proc/self/exe", {"rename", file_b, file_a}, false);
+    if (other_write.wait_status() != 0) {
+        std::cerr << "Error renaming in other client " << file_b << " to " << file_a << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (xpn_pwrite(fd, patch.data(), patch.size(), bsize) != (ssize_t)patch.size()) {
+        std::cerr << "Error writing data to file: " << file_a << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    xpn_close(fd);
+    setup::check_file(file_a, std::string(data_b).replace(bsize, patch.size(), patch));
+    std::cout << "Test Passed: The writes after the rename of other client go to the new file." << std::endl;
+
+    setup::remove_file(file_a);
+}
+
+int main(int argc, char *argv[]) {
+    // The other client of the test
+    if (argc == 4 && std::string(argv[1]) == "rename") {
+        XPN_scope xpn;
+        return xpn_rename(argv[2], argv[3]) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_SHORT_CIRCUIT", "1"}});
+    XPN::xpn_conf::partition part;
+    {
+        LogTimer timer("1 sck server 512k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        };
+        part.bsize = 512 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(tmp_dir + "/xpn1", part.bsize, true);
+    }
+    {
+        LogTimer timer("2 sck server compressed 64k bsize");
+        part.compressed = true;
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        };
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(tmp_dir + "/xpn1", part.bsize, false);
+    }
+}
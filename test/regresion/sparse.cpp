@@ -0,0 +1,156 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "setup.hpp"
+#include "xpn.h"
+
+// The zero ranges of the writes are stored as holes, or as blocks of zeros when compressed, and they are read as zeros
+void run_test(const std::string &data_dir, size_t bsize, bool check_holes) {
+    const std::string filename = "/xpn/sparse.bin";
+    const size_t zero_blocks = 16;
+    const size_t total_bytes = (zero_blocks + 2) * bsize;
+
+    // Data, zeros and data
+    std::string original_data(total_bytes, '\0');
+    std::string lorem = setup::generate_Lorem_Ipsum(bsize);
+    original_data.replace(0, bsize, lorem);
+    original_data.replace(total_bytes - bsize, bsize, lorem);
+
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    if (xpn_pwrite(fd, original_data.data(), total_bytes, 0) != (ssize_t)total_bytes) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    // Zeros over the data of the last block, the old data must not be read
+    original_data.replace(total_bytes - bsize, bsize, bsize, '\0');
+    if (xpn_pwrite(fd, original_data.data() + total_bytes - bsize, bsize, total_bytes - bsize) != (ssize_t)bsize) {
+        std::cerr << "Error writing zeros to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string read_data(total_bytes, 'x');
+    ssize_t read_bytes = xpn_pread(fd, read_data.data(), total_bytes, 0);
+    xpn_close(fd);
+    if (read_bytes != (ssize_t)total_bytes || read_data != original_data) {
+        std::cerr << "Test Failed: The written data is NOT identical to the read data, read " << read_bytes << " of "
+                  << total_bytes << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (check_holes) {
+        struct stat st;
+        if (stat((data_dir + "/sparse.bin").c_str(), &st) < 0) {
+            perror("Error stat of the file in the server");
+            exit(EXIT_FAILURE);
+        }
+        if ((size_t)st.st_blocks * 512 > total_bytes / 4) {
+            std::cerr << "Test Failed: The zeros are allocated in the server, " << st.st_blocks * 512 << " bytes of "
+                      << st.st_size << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    std::cout << "Test Passed: The zero ranges are read as zeros." << std::endl;
+
+    setup::remove_file(filename);
+}
+
+// Zero ranges past the end of the file and writes after them at the same time, as the sparse tails of the parts of a
+// checkpoint of many clients to one file, the zeros extend the file but never shrink it under the other writes
+void run_concurrent_test(size_t bsize) {
+    const std::string filename = "/xpn/sparse_concurrent.bin";
+    const size_t num_threads = 8;
+    const size_t rounds = 16;
+    const std::string zeros(2 * bsize, '\0');
+    const std::string data = setup::generate_Lorem_Ipsum(bsize);
+    const size_t part_size = zeros.size() + data.size();
+
+    int fd = xpn_open(filename.c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    // Each round starts at the end of the file, every thread writes its part with the zeros first
+    std::atomic_bool write_error = false;
+    for (size_t r = 0; r < rounds; r++) {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_threads; t++) {
+            threads.emplace_back([&, t]() {
+                size_t offset = (r * num_threads + t) * part_size;
+                if (xpn_pwrite(fd, zeros.data(), zeros.size(), offset) != (ssize_t)zeros.size() ||
+                    xpn_pwrite(fd, data.data(), data.size(), offset + zeros.size()) != (ssize_t)data.size()) {
+                    write_error = true;
+                }
+            });
+        }
+        for (auto &&thread : threads) {
+            thread.join();
+        }
+    }
+    xpn_close(fd);
+    if (write_error) {
+        std::cerr << "Error writing data to file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string expected;
+    for (size_t i = 0; i < rounds * num_threads; i++) {
+        expected += zeros + data;
+    }
+    setup::check_file(filename, expected);
+    std::cout << "Test Passed: The zero ranges do not cut the concurrent writes." << std::endl;
+
+    setup::remove_file(filename);
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    auto cleanup_data_dir2 = setup::create_empty_dir(tmp_dir + "/xpn2");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_SPARSE", "1"}});
+    XPN::xpn_conf::partition part;
+    {
+        LogTimer timer("1 sck server 512k bsize");
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+        };
+        part.bsize = 512 * 1024;
+        setup::env({{"XPN_SHORT_CIRCUIT", "1"}});
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(tmp_dir + "/xpn1", part.bsize, true);
+        run_concurrent_test(part.bsize);
+    }
+    {
+        LogTimer timer("1 sck server 512k bsize without short-circuit");
+        setup::env({{"XPN_SHORT_CIRCUIT", "0"}});
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_concurrent_test(part.bsize);
+    }
+    {
+        LogTimer timer("2 sck server compressed 64k bsize");
+        part.compressed = true;
+        part.server_urls = {
+            "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+            "sck_server://localhost:3457/" + tmp_dir + "/xpn2",
+        };
+        part.bsize = 64 * 1024;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        run_test(tmp_dir + "/xpn1", part.bsize, false);
+    }
+}
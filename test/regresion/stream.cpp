@@ -0,0 +1,115 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "base_cpp/xpn_env.hpp"
+#include "setup.hpp"
+#include "xpn.h"
+#include "xpn_server/filesystem/xpn_server_filesystem_lz4_block.hpp"
+
+using XPN::lz4_block_header;
+
+// Mark on the disk the blocks of a compressed file as of other version of the layout, reading them fails with EIO
+void mark_blocks(const std::string &path, size_t first, size_t last, size_t bsize) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    char other_version = lz4_block_header::VERSION + 1;
+    for (size_t i = first; i < last; i++) {
+        file.seekp(lz4_block_header::RAW_HEADER_SIZE + i * lz4_block_header::slot_size(bsize) +
+                   offsetof(lz4_block_header, version));
+        file.write(&other_version, 1);
+    }
+    if (!file) {
+        std::cerr << "Error rewriting the file in the server: " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The large raw reads and writes are streamed by the server in chunks, the writes and reads start and end out of
+// the chunks and the blocks, and a read after the end of the file ends in a chunk shorter than the others.
+// In the compressed files the chunks of a write end in the blocks, the blocks that it covers are written whole and
+// not read, so the write succeeds even when they cannot be read
+void run_test(const XPN::xpn_conf::partition &part, const std::string &data_dir) {
+    const std::string filename = "/xpn/stream.bin";
+    const size_t bsize = part.bsize;
+    const size_t total_bytes = 3 * bsize + 12345;
+    std::string data = setup::generate_random_string(total_bytes);
+    const size_t offset = bsize / 2 + 777;
+    const size_t size = 2 * bsize;
+
+    // The servers are restarted after the first write, so the blocks are not read from their cache
+    {
+        auto cleanup_srvs = setup::start_srvs(part);
+        XPN_scope xpn;
+        int fd = xpn_open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            perror("Error opening file");
+            exit(EXIT_FAILURE);
+        }
+        if (xpn_pwrite(fd, data.data(), total_bytes, 0) != (ssize_t)total_bytes) {
+            std::cerr << "Error writing data to file: " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        xpn_close(fd);
+    }
+    // The compressed and the V2 transfers go by smaller chunks that are not streamed
+    auto &env = XPN::xpn_env::get_instance();
+    if (part.compressed && env.xpn_net_compression == 0 && env.xpn_rw_v2 == 0) {
+        mark_blocks(data_dir + "/stream.bin", (offset + bsize - 1) / bsize, (offset + size) / bsize, bsize);
+    }
+
+    auto cleanup_srvs = setup::start_srvs(part);
+    XPN_scope xpn;
+    int fd = xpn_open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    std::string patch = setup::generate_random_string(size);
+    if (xpn_pwrite(fd, patch.data(), size, offset) != (ssize_t)size) {
+        std::cerr << "Test Failed: The write is NOT done, the blocks that it covers are read" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    data.replace(offset, size, patch);
+
+    std::string read_data(total_bytes + 3 * 1024 * 1024, 'x');
+    ssize_t read_bytes = xpn_pread(fd, read_data.data(), read_data.size(), 0);
+    if (read_bytes != (ssize_t)total_bytes || read_data.compare(0, total_bytes, data) != 0) {
+        std::cerr << "Test Failed: The data is NOT the expected, read " << read_bytes << " of " << total_bytes
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    read_bytes = xpn_pread(fd, read_data.data(), size, offset + 1);
+    xpn_close(fd);
+    if (read_bytes != (ssize_t)size || read_data.compare(0, size, data, offset + 1, size) != 0) {
+        std::cerr << "Test Failed: The range is NOT the expected, read " << read_bytes << " of " << size << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (xpn_unlink(filename.c_str()) < 0) {
+        std::cerr << "Error removing file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main() {
+    std::string tmp_dir = "/tmp/" + std::to_string(::getpid());
+    auto cleanup_tmp_dir = setup::create_empty_dir(tmp_dir);
+    auto cleanup_data_dir1 = setup::create_empty_dir(tmp_dir + "/xpn1");
+    setup::env({{"XPN_LOCALITY", "0"}, {"XPN_CONNECT_RETRY_TIME_MS", "10"}, {"XPN_SHORT_CIRCUIT", "0"}});
+    XPN::xpn_conf::partition part;
+    part.server_urls = {
+        "sck_server://localhost:3456/" + tmp_dir + "/xpn1",
+    };
+    for (bool compressed : {false, true}) {
+        LogTimer timer(compressed ? "1 sck server compressed 4m bsize" : "1 sck server 4m bsize");
+        part.bsize = 4 * 1024 * 1024;
+        part.compressed = compressed;
+        auto cleanup_conf = setup::create_xpn_conf(tmp_dir + "/xpn.conf", part);
+        run_test(part, tmp_dir + "/xpn1");
+        std::cout << "Test Passed: The streamed transfers are read as written." << std::endl;
+    }
+}